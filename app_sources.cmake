@@ -0,0 +1,70 @@
+#
+# (c) 2021 - Codium Electronique
+# Tous droits reserves
+# Ce fichier fait partie du projet ESIREM Quantum main board
+#
+# Sources de l'application hors point d'entree (src/main.c), partagees avec
+# les applications de test (tests/) : chacune les inclut avec
+# include(<racine du depot>/app_sources.cmake) apres find_package(Zephyr).
+#
+
+set(ESIREM_QUANTUM_MAIN_APP_DIR ${CMAKE_CURRENT_LIST_DIR})
+
+target_sources(app PRIVATE
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/settings.c
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/ble_service_config.c
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/ble_service_user.c
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/ble_service_diag.c
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/ble.c
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/core.c
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/clock_sync.c
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/latency.c
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/retained.c
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/stats.c
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/odometer.c
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/traffic.c
+)
+target_sources_ifdef(CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG app PRIVATE
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/eventlog.c
+)
+target_sources_ifdef(CONFIG_ESIREM_QUANTUM_MAIN_LED_PWM app PRIVATE
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/led_pwm.c
+)
+target_sources_ifdef(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT app PRIVATE
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/trigger_input.c
+)
+target_sources_ifdef(CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP app PRIVATE
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/deepsleep.c
+)
+target_sources_ifdef(CONFIG_ESIREM_QUANTUM_MAIN_WATCHDOG app PRIVATE
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/watchdog.c
+)
+target_sources_ifdef(CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT app PRIVATE
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/memstat.c
+)
+if(CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT_HEAP)
+  zephyr_ld_options(
+    -Wl,--wrap=malloc
+    -Wl,--wrap=calloc
+    -Wl,--wrap=realloc
+    -Wl,--wrap=free
+  )
+endif()
+target_sources_ifdef(CONFIG_ESIREM_QUANTUM_MAIN_TRACE app PRIVATE
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/trace.c
+)
+target_sources_ifdef(CONFIG_ESIREM_QUANTUM_MAIN_CMAC app PRIVATE
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/cmac.c
+)
+target_sources_ifdef(CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER app PRIVATE
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/ble_beacon_trigger.c
+)
+target_sources_ifdef(CONFIG_ESIREM_QUANTUM_MAIN_PROVISION app PRIVATE
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/ble_service_prov.c
+)
+target_sources_ifdef(CONFIG_ESIREM_QUANTUM_MAIN_MESH app PRIVATE
+  ${ESIREM_QUANTUM_MAIN_APP_DIR}/src/mesh.c
+)
+
+zephyr_include_directories(${ESIREM_QUANTUM_MAIN_APP_DIR})
+zephyr_library_include_directories(${ESIREM_QUANTUM_MAIN_APP_DIR})
@@ -0,0 +1,47 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * bench.h - 07/12/2021
+ * Mesures de performance des chemins critiques (build de developpement)
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_BENCH_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_BENCH_H_INCLUDED
+
+#include <zephyr/types.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**@brief Mesures alimentees depuis le code mesure lui-meme */
+    enum esirem_quantum_main_bench_probe
+    {
+        /* Une execution de la fonction de travail du core */
+        ESIREM_QUANTUM_MAIN_BENCH_PROBE_CORE_WORK = 0x00UL,
+        ESIREM_QUANTUM_MAIN_BENCH_PROBE_COUNT,
+    };
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_BENCH)
+
+    /**@brief cycles : duree mesuree avec l'API timing */
+    void esirem_quantum_main_bench_record(enum esirem_quantum_main_bench_probe probe, uint64_t cycles);
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_BENCH_H_INCLUDED
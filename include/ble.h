@@ -20,8 +20,26 @@
 extern "C" {
 #endif
 
+#include <zephyr/types.h>
+
+#include <stddef.h>
+
 int ble_init(void);
 
+/**@brief Arret / reprise de l'advertising connectable (mise en veille) */
+int esirem_quantum_main_ble_adv_suspend(void);
+int esirem_quantum_main_ble_adv_resume(void);
+
+/**@brief Longueur maximale du suffixe du nom BLE : le nom complet tient
+ * avec les flags dans les 31 octets d'advertising */
+#define ESIREM_QUANTUM_MAIN_BLE_NAME_SUFFIX_MAX_LEN (6)
+
+/**@brief Nom BLE = CONFIG_BT_DEVICE_NAME-suffixe (sans terminateur) */
+int esirem_quantum_main_ble_set_name_suffix(const char* suffix, size_t len);
+
+/**@brief Nombre de centraux connectes */
+uint8_t esirem_quantum_main_ble_conn_count(void);
+
 #ifdef __cplusplus
 }
 #endif
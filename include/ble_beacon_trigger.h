@@ -0,0 +1,72 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * ble_beacon_trigger.h - 07/12/2021
+ * Declenchement sans connexion par advertisements signes
+ *
+ * Format des donnees constructeur (AD type 0xFF) :
+ *
+ * | company id (2) | tag projet (2) | opcode (1) | compteur (4) | MAC (4) |
+ *
+ * Tous les champs sont en little endian. Le MAC est l'AES-CMAC tronque a
+ * 4 octets calcule sur les 9 premiers octets avec la cle partagee. Le
+ * compteur doit etre strictement croissant, un beacon dont le compteur est
+ * inferieur ou egal au dernier accepte est ignore (anti-rejeu).
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_BLE_BEACON_TRIGGER_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_BLE_BEACON_TRIGGER_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#include <zephyr/types.h>
+#include <settings/settings.h>
+
+/**@brief Tag projet present dans chaque beacon ("MM") */
+#define ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_TAG 0x4d4d
+
+/**@brief Taille de la cle AES-128 partagee */
+#define ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_KEY_LEN 16
+
+/**@brief Taille du MAC tronque en fin de beacon */
+#define ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_MAC_LEN 4
+
+/**@brief Taille des donnees signees (company id a compteur inclus) */
+#define ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_SIGNED_LEN 9
+
+/**@brief Taille totale des donnees constructeur du beacon */
+#define ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_DATA_LEN                            \
+    (ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_SIGNED_LEN                             \
+     + ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_MAC_LEN)
+
+enum esirem_quantum_main_beacon_trigger_opcode
+{
+    ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_OPCODE_STOP = 0x00UL,
+    ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_OPCODE_TRIG = 0x01UL,
+};
+
+extern struct settings_handler esirem_quantum_main_beacon_trigger_settings_hdlrs;
+
+int esirem_quantum_main_beacon_trigger_start(void);
+/**@brief Remplace la cle partagee en RAM (provisionnement), sans sauvegarde */
+void esirem_quantum_main_beacon_trigger_set_key(const uint8_t* key);
+/**@brief Traite les donnees constructeur d'un advertisement (callback de
+ * scan, ou appel direct par les tests) */
+void esirem_quantum_main_beacon_trigger_process(const uint8_t* data, uint8_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_BLE_BEACON_TRIGGER_H_INCLUDED
@@ -22,6 +22,7 @@ extern "C" {
 #endif
 
 #include <zephyr/types.h>
+#include <bluetooth/gatt.h>
 #include <bluetooth/uuid.h>
 
 /**@bried UUIDs du service installateur / configuration */
@@ -31,13 +32,45 @@ extern "C" {
 #define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_SEQ_DURATION_MS 0x01
 #define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_TON_MS 0x02
 #define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_TOFF_MS 0x03
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_CURRENT_UA 0x04
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_INTENSITY_PCT 0x05
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_FADE_IN_MS 0x06
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_FADE_OUT_MS 0x07
+/**@brief Lecture et ecriture groupees de tous les parametres */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_ALL 0x08
+/**@brief Generation de la configuration (lecture, notification a chaque
+ * changement) */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_GENERATION 0x09
+/**@brief Mode de sequence (0 : periodes entieres, 1 : duree exacte) */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_SEQ_MODE 0x0A
+
+/**@brief Erreurs ATT applicatives des ecritures de parametres (une valeur
+ * hors bornes renvoie BT_ATT_ERR_OUT_OF_RANGE) */
+enum esirem_quantum_main_ble_service_config_att_err {
+    ESIREM_QUANTUM_MAIN_SERVICE_CONFIG_ATT_ERR_PERIOD_TOO_SHORT = 0x80,
+    ESIREM_QUANTUM_MAIN_SERVICE_CONFIG_ATT_ERR_SEQ_TOO_SHORT = 0x81,
+    ESIREM_QUANTUM_MAIN_SERVICE_CONFIG_ATT_ERR_TOO_MANY_PERIODS = 0x82,
+    ESIREM_QUANTUM_MAIN_SERVICE_CONFIG_ATT_ERR_NOT_DIVISIBLE = 0x83,
+};
 
 /**@brief Structures UUIDs BLE pour le service configuration */
 extern const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config;
+extern const struct bt_gatt_service_static esirem_quantum_main_service_config;
 
 extern const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_seq_duration_ms;
 extern const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_ton_ms;
 extern const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_toff_ms;
+extern const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_current_ua;
+extern const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_intensity_pct;
+extern const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_fade_in_ms;
+extern const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_fade_out_ms;
+extern const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_seq_mode;
+extern const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_all;
+extern const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_generation;
+
+/**@brief Signale aux centraux abonnes la nouvelle generation (envoi differe
+ * sur la file systeme, les changements rapproches sont regroupes) */
+void esirem_quantum_main_ble_service_config_generation_notify(uint32_t generation);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,61 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * ble_service_diag.h - 07/12/2021
+ * Definitions service BLE diagnostic ESIREM Quantum board
+ * Donne acces aux mesures de fonctionnement du dispositif
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_BLE_SERVICE_DIAG_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_BLE_SERVICE_DIAG_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <bluetooth/uuid.h>
+
+/**@brief UUIDs du service diagnostic */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG 0x03
+
+/**@brief Histogrammes de latence (lecture seule) */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_LATENCY 0x01
+/**@brief Point de controle (remise a zero des mesures) */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_CTRL 0x02
+/**@brief Temps par etat, compteurs d'activite et energie LED (lecture seule) */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_STATS 0x03
+/**@brief Occupation maximale des piles et du tas (lecture seule) */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_MEMORY 0x04
+/**@brief Compteurs de vie (lecture seule) */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_ODOMETER 0x05
+/**@brief Journal d'evenements : lecture de la plage, ecriture du numero de
+ * depart, enregistrements notifies */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_EVENTLOG 0x06
+/**@brief Debit de commandes, erreurs ATT et notifications (lecture seule) */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_TRAFFIC 0x07
+
+/**@brief Opcodes du point de controle */
+enum esirem_quantum_main_ble_service_diag_ctrl_opcode {
+    ESIREM_QUANTUM_MAIN_SERVICE_DIAG_CTRL_RESET_LATENCY = 0x01,
+    ESIREM_QUANTUM_MAIN_SERVICE_DIAG_CTRL_RESET_STATS = 0x02,
+    ESIREM_QUANTUM_MAIN_SERVICE_DIAG_CTRL_RESET_TRAFFIC = 0x03,
+};
+
+struct bt_conn;
+
+void esirem_quantum_main_ble_service_diag_disconnected(struct bt_conn* conn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_BLE_SERVICE_DIAG_H_INCLUDED
@@ -0,0 +1,88 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * ble_service_prov.h - 07/12/2021
+ * Provisionnement usine : identite DIS, suffixe du nom BLE, configuration
+ * initiale et cle beacon ecrits en une transaction authentifiee
+ *
+ * Format de l'enregistrement (suite de champs type (1) | longueur (1) |
+ * valeur, chaque type au plus une fois) :
+ *
+ * - 0x01 a 0x04 : numero de serie, modele, fabricant, revision materielle
+ * (chaines DIS sans terminateur, 1 a CONFIG_BT_DIS_STR_MAX - 1 octets) ;
+ * - 0x05 : suffixe du nom BLE (1 a ESIREM_QUANTUM_MAIN_BLE_NAME_SUFFIX_MAX_LEN
+ * octets), a defaut les 4 derniers caracteres du numero de serie ;
+ * - 0x06 : configuration initiale, meme format que la caracteristique "Tous
+ * les parametres" du service configuration ;
+ * - 0x07 : cle AES-128 des beacons de declenchement.
+ *
+ * Le MAC de la commande COMMIT est l'AES-CMAC (16 octets) calcule avec la
+ * cle de provisionnement sur le defi (8 octets) suivi de l'enregistrement.
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_BLE_SERVICE_PROV_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_BLE_SERVICE_PROV_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr/types.h>
+#include <settings/settings.h>
+
+/**@brief UUIDs du service provisionnement */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_PROV 0x04
+
+/**@brief Defi de la transaction en cours (lecture seule) */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_PROV_CHRC_CHALLENGE 0x01
+/**@brief Point de controle de la transaction (ecriture seule) */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_PROV_CHRC_CTRL 0x02
+
+/**@brief Taille du defi et du MAC */
+#define ESIREM_QUANTUM_MAIN_PROV_CHALLENGE_LEN (8)
+#define ESIREM_QUANTUM_MAIN_PROV_MAC_LEN       (16)
+
+/**@brief Opcodes du point de controle
+ *
+ * - BEGIN : opcode seul, tire un nouveau defi et vide l'enregistrement ;
+ * - DATA : opcode | offset (2) | octets de l'enregistrement ;
+ * - COMMIT : opcode | longueur de l'enregistrement (2) | MAC (16).
+ */
+enum esirem_quantum_main_ble_service_prov_ctrl_opcode {
+    ESIREM_QUANTUM_MAIN_SERVICE_PROV_CTRL_BEGIN = 0x01,
+    ESIREM_QUANTUM_MAIN_SERVICE_PROV_CTRL_DATA = 0x02,
+    ESIREM_QUANTUM_MAIN_SERVICE_PROV_CTRL_COMMIT = 0x03,
+};
+
+/**@brief Types des champs de l'enregistrement */
+enum esirem_quantum_main_prov_field {
+    ESIREM_QUANTUM_MAIN_PROV_FIELD_SERIAL = 0x01,
+    ESIREM_QUANTUM_MAIN_PROV_FIELD_MODEL = 0x02,
+    ESIREM_QUANTUM_MAIN_PROV_FIELD_MANUF = 0x03,
+    ESIREM_QUANTUM_MAIN_PROV_FIELD_HW_REV = 0x04,
+    ESIREM_QUANTUM_MAIN_PROV_FIELD_NAME_SUFFIX = 0x05,
+    ESIREM_QUANTUM_MAIN_PROV_FIELD_CONFIG = 0x06,
+    ESIREM_QUANTUM_MAIN_PROV_FIELD_BEACON_KEY = 0x07,
+    ESIREM_QUANTUM_MAIN_PROV_FIELD_COUNT,
+};
+
+struct bt_conn;
+
+extern struct settings_handler esirem_quantum_main_prov_settings_hdlrs;
+
+int esirem_quantum_main_ble_service_prov_init(void);
+void esirem_quantum_main_ble_service_prov_disconnected(struct bt_conn* conn);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_BLE_SERVICE_PROV_H_INCLUDED
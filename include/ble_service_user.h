@@ -20,6 +20,7 @@ extern "C" {
 #endif
 
 #include <zephyr/types.h>
+#include <bluetooth/conn.h>
 #include <bluetooth/uuid.h>
 
 /**@brief UUIDs du service utilisateur (declenchement du dispositif) */
@@ -28,12 +29,35 @@ extern "C" {
 /**@brief UUIDs caracteristique etat du dispositif */
 #define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER_CHRC_STATE 0x01
 
+/**@brief UUIDs caracteristique synchronisation d'horloge avec le central */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER_CHRC_CLOCK 0x02
+
+/**@brief UUIDs caracteristique avancement du cycle en cours */
+#define ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER_CHRC_PROGRESS 0x03
+
+/**@brief Taille de la valeur d'avancement : index de periode, temps ecoule
+ * et temps restant (ms), en uint32 little endian */
+#define ESIREM_QUANTUM_MAIN_SERVICE_USER_PROGRESS_LEN (3 * sizeof(uint32_t))
+
+/**@brief Tailles des ecritures sur la caracteristique horloge :
+ * ping (horodatage central) ou sync (horodatage central + RTT mesure) */
+#define ESIREM_QUANTUM_MAIN_SERVICE_USER_CLOCK_PING_LEN (sizeof(int64_t))
+#define ESIREM_QUANTUM_MAIN_SERVICE_USER_CLOCK_SYNC_LEN (sizeof(int64_t) + sizeof(uint32_t))
+
+/**@brief Taille d'une commande de declenchement programme :
+ * opcode + instant de depart (us, base de temps du central) */
+#define ESIREM_QUANTUM_MAIN_SERVICE_USER_STATE_START_AT_LEN (1 + sizeof(int64_t))
+
 enum esirem_quantum_main_ble_service_user_state {
     ESIREM_QUANTUM_MAIN_SERVICE_USER_STATE_OFF = 0x00UL,
     ESIREM_QUANTUM_MAIN_SERVICE_USER_STATE_ON = 0x01,
+    ESIREM_QUANTUM_MAIN_SERVICE_USER_STATE_START_AT = 0x02,
 };
 
 int esirem_quantum_main_ble_service_user_chrc_state_indicate_change(const bool device_state);
+/**@brief Libere l'emplacement de notification d'avancement de la connexion
+ * et oublie la base de temps du central s'il etait synchronise */
+void esirem_quantum_main_ble_service_user_disconnected(struct bt_conn* conn);
 
 #ifdef __cplusplus
 }
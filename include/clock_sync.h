@@ -0,0 +1,67 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * clock_sync.h - 07/12/2021
+ * Base de temps partagee avec le central pour les declenchements
+ * synchronises de plusieurs cartes
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_CLOCK_SYNC_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_CLOCK_SYNC_H_INCLUDED
+
+#include <zephyr/types.h>
+#include <bluetooth/conn.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**@brief Nombre d'echanges conserves pour le filtrage (RTT minimal) */
+#define ESIREM_QUANTUM_MAIN_CLOCK_SYNC_WINDOW_SZ (8)
+
+    /**@brief Rapport du dernier declenchement synchronise, en base de temps
+     * du central */
+    struct esirem_quantum_main_clock_sync_report
+    {
+        int64_t offset_us;
+        int64_t start_central_us;
+        int32_t start_err_us;
+    } __packed;
+
+    int64_t esirem_quantum_main_clock_sync_local_us(void);
+
+    /**@brief Ping du central conn : un autre central que le precedent
+     * remplace sa base de temps */
+    int64_t esirem_quantum_main_clock_sync_ping(const struct bt_conn* conn, int64_t central_us);
+    int esirem_quantum_main_clock_sync_update(const struct bt_conn* conn, int64_t central_us, uint32_t rtt_us);
+    /**@brief Oublie la base de temps si conn est le central synchronise */
+    void esirem_quantum_main_clock_sync_disconnected(const struct bt_conn* conn);
+
+    bool esirem_quantum_main_clock_sync_is_synced(void);
+    int esirem_quantum_main_clock_sync_central_us(int64_t* central_us);
+
+    /**@brief Refuse (-EAGAIN) sans synchronisation avec le central conn */
+    int esirem_quantum_main_clock_sync_trig_new_cycle_at(const struct bt_conn* conn, int64_t central_start_us);
+    void esirem_quantum_main_clock_sync_cycle_started(int64_t start_ticks);
+    void esirem_quantum_main_clock_sync_cycle_cancelled(void);
+
+    void esirem_quantum_main_clock_sync_get_report(
+        struct esirem_quantum_main_clock_sync_report* report);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_CLOCK_SYNC_H_INCLUDED
@@ -0,0 +1,47 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * cmac.h - 07/12/2021
+ * AES-CMAC des beacons et du provisionnement
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_CMAC_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_CMAC_H_INCLUDED
+
+#include <zephyr/types.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define ESIREM_QUANTUM_MAIN_CMAC_KEY_LEN (16)
+#define ESIREM_QUANTUM_MAIN_CMAC_MAC_LEN (16)
+
+    /**@brief AES-CMAC de prefix suivi de data, tronque a mac_len octets
+     * (prefix peut etre NULL si prefix_len est nul) */
+    int esirem_quantum_main_cmac_compute(
+        const uint8_t* key, const uint8_t* prefix, size_t prefix_len, const uint8_t* data,
+        size_t len, uint8_t* mac, size_t mac_len);
+
+    /**@brief Comparaison en temps constant, pour ne pas renseigner sur le
+     * MAC attendu */
+    bool esirem_quantum_main_cmac_equal(const uint8_t* a, const uint8_t* b, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_CMAC_H_INCLUDED
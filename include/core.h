@@ -33,12 +33,91 @@ extern "C"
         ESIREM_QUANTUM_MAIN_CORE_DEVICE_STATE_RUNNING = 0x01UL,
     };
 
-#define ESIREM_QUANTUM_MAIN_CORE_SETTINGS_KEY_STR_MAX_LEN (40)
+/**@brief Taille d'un buffer de cle complete ("esirem_quantum_main/<cle>"),
+ * terminateur compris */
+#define ESIREM_QUANTUM_MAIN_CORE_SETTINGS_KEY_STR_MAX_LEN (48)
+
+/**@brief Nombre maximal d'entrees dans la table des parametres, pour
+ * dimensionner les buffers qui transportent tous les parametres */
+#define ESIREM_QUANTUM_MAIN_CORE_SETTINGS_MAX_COUNT (8)
+
+    /**@brief Avancement du cycle en cours */
+    struct esirem_quantum_main_core_progress
+    {
+        uint32_t period_index;
+        uint32_t elapsed_ms;
+        uint32_t remaining_ms;
+    };
+
+    /**@brief Etat du core conserve en RAM retenue pour reprendre un cycle
+     * interrompu par un reset a chaud */
+    struct esirem_quantum_main_core_snapshot
+    {
+        /* Etat ON / OFF du cycle en cours, IDLE sinon */
+        uint32_t state;
+        uint32_t period_index;
+        /* Temps ecoule depuis le debut du cycle au dernier front */
+        uint32_t elapsed_ms;
+        /* Reprises successives du meme cycle */
+        uint32_t resume_count;
+        /* Valeurs des parametres, dans l'ordre de la table */
+        uint32_t settings[ESIREM_QUANTUM_MAIN_CORE_SETTINGS_MAX_COUNT];
+    };
 
     extern const char esirem_quantum_main_core_setting_key_module[];
     extern const char esirem_quantum_main_core_setting_key_led_seq_duration_ms[];
     extern const char esirem_quantum_main_core_setting_key_led_ton_duration_ms[];
     extern const char esirem_quantum_main_core_setting_key_led_toff_duration_ms[];
+    extern const char esirem_quantum_main_core_setting_key_led_current_ua[];
+    extern const char esirem_quantum_main_core_setting_key_led_intensity_pct[];
+    extern const char esirem_quantum_main_core_setting_key_led_fade_in_ms[];
+    extern const char esirem_quantum_main_core_setting_key_led_fade_out_ms[];
+    extern const char esirem_quantum_main_core_setting_key_led_seq_mode[];
+
+    /**@brief Index des parametres dans la table, ordre de la caracteristique
+     * "tous les parametres" du service configuration */
+    enum esirem_quantum_main_core_setting_index
+    {
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS = 0x00UL,
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS          = 0x01UL,
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS         = 0x02UL,
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_CURRENT_UA      = 0x03UL,
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT   = 0x04UL,
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_FADE_IN_MS      = 0x05UL,
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_FADE_OUT_MS     = 0x06UL,
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_MODE        = 0x07UL,
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT,
+    };
+
+    /**@brief Modes de sequence (parametre cfg/led/seq_mode) */
+    enum esirem_quantum_main_core_seq_mode
+    {
+        /* Nombre entier de periodes : Sequence / (Ton + Toff), le reste de
+         * la division est ignore */
+        ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_PERIODS = 0x00UL,
+        /* Duree exacte : la derniere periode est tronquee (Ton puis Toff)
+         * pour que le cycle dure exactement Sequence */
+        ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_EXACT   = 0x01UL,
+    };
+
+    /**@brief Resultat de la validation d'un jeu de parametres candidat */
+    enum esirem_quantum_main_core_setting_check_result
+    {
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK               = 0x00UL,
+        /* Valeur hors des bornes minval / maxval du parametre */
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OUT_OF_RANGE     = 0x01UL,
+        /* Ton + Toff sous CONFIG_ESIREM_QUANTUM_MAIN_CORE_PERIOD_MIN_MS */
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_PERIOD_TOO_SHORT = 0x02UL,
+        /* Sequence plus courte qu'une periode, ou nulle en mode duree
+         * exacte */
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_SEQ_TOO_SHORT    = 0x03UL,
+        /* Plus de CONFIG_ESIREM_QUANTUM_MAIN_CORE_PERIOD_COUNT_MAX periodes */
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_TOO_MANY_PERIODS = 0x04UL,
+        /* Sequence non multiple de la periode
+         * (CONFIG_ESIREM_QUANTUM_MAIN_CORE_SEQ_DIVISIBLE) */
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_NOT_DIVISIBLE    = 0x05UL,
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_COUNT,
+    };
 
     struct esirem_quantum_main_core_setting_map_uuid_keyptr
     {
@@ -51,14 +130,23 @@ extern "C"
     };
 
     extern const struct esirem_quantum_main_core_setting_map_uuid_keyptr
-        esirem_quantum_main_core_setting_map_uuid_keyptr[];
+        esirem_quantum_main_core_setting_map_uuid_keyptr[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
 
     extern struct settings_handler esirem_quantum_main_core_settings_hdlrs;
 
     int esirem_quantum_main_core_trig_new_cycle(void);
+    int esirem_quantum_main_core_trig_new_cycle_at(int64_t start_ticks);
     int esirem_quantum_main_core_stop_cycle(void);
 
+    int64_t esirem_quantum_main_core_get_last_start_ticks(void);
+    uint32_t esirem_quantum_main_core_get_led_current_ua(void);
+    void esirem_quantum_main_core_get_progress(struct esirem_quantum_main_core_progress* progress);
+
     uint8_t esirem_quantum_main_core_device_running(void);
+    /**@brief Ni cycle en cours, ni declenchement programme */
+    bool esirem_quantum_main_core_is_idle(void);
+    /**@brief Arret demande, le cycle se termine au prochain front OFF */
+    bool esirem_quantum_main_core_stop_pending(void);
 
     int esirem_quantum_main_core_init(void);
 
@@ -67,6 +155,41 @@ extern "C"
         char* setting_full_key, size_t setting_full_key_sz);
     
     uint32_t esirem_quantum_main_core_setting_get_map_uuid_keyptr_size();
+    /**@brief Valeur courante d'un parametre, lue sans passer par les settings */
+    uint32_t esirem_quantum_main_core_setting_get(
+        const struct esirem_quantum_main_core_setting_map_uuid_keyptr* map_uuid_keyptr);
+    /**@brief Evalue les parametres courants avec une seule valeur remplacee,
+     * sans rien modifier */
+    enum esirem_quantum_main_core_setting_check_result esirem_quantum_main_core_setting_check(
+        const struct esirem_quantum_main_core_setting_map_uuid_keyptr* map_uuid_keyptr,
+        uint32_t value);
+    /**@brief Evalue un jeu complet de parametres (ordre de la table), sans
+     * rien modifier */
+    enum esirem_quantum_main_core_setting_check_result
+    esirem_quantum_main_core_settings_check(const uint32_t* values);
+    /**@brief Valide puis publie en une fois tous les parametres (ordre de la
+     * table), en RAM seulement, sans sauvegarde : pour une modification
+     * durable, voir esirem_quantum_main_core_settings_store */
+    enum esirem_quantum_main_core_setting_check_result
+    esirem_quantum_main_core_settings_publish(const uint32_t* values);
+    /**@brief Valide, sauvegarde en flash puis publie en RAM tous les
+     * parametres (ordre de la table), sous le verrou des parametres.
+     * commit_cb, facultatif, est appele entre la sauvegarde et la
+     * publication. Si une sauvegarde ou commit_cb echoue, la flash est
+     * restauree et rien n'est publie.
+     * Renvoie 0, -EINVAL (regle enfreinte, voir result) ou l'erreur de la
+     * sauvegarde ou de commit_cb */
+    int esirem_quantum_main_core_settings_store(
+        const uint32_t* values, enum esirem_quantum_main_core_setting_check_result* result,
+        int (*commit_cb)(void* user_data), void* user_data);
+    /**@brief Comme esirem_quantum_main_core_settings_store pour un seul
+     * parametre, les autres gardant leur valeur courante : seule la cle
+     * modifiee est reecrite en flash */
+    int esirem_quantum_main_core_setting_store(
+        const struct esirem_quantum_main_core_setting_map_uuid_keyptr* map_uuid_keyptr, uint32_t value,
+        enum esirem_quantum_main_core_setting_check_result* result);
+    /**@brief Generation de la configuration, change a chaque modification */
+    uint32_t esirem_quantum_main_core_setting_get_generation(void);
 
     bool esirem_quantum_main_core_error_occured();
 
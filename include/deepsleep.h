@@ -0,0 +1,62 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * deepsleep.h - 07/12/2021
+ * Mise en veille apres inactivite (stockage, transport)
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_DEEPSLEEP_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_DEEPSLEEP_H_INCLUDED
+
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP)
+
+    /**@brief Acces a la pile BLE et au SoC utilises par la politique de mise
+     * en veille */
+    struct esirem_quantum_main_deepsleep_hooks
+    {
+        /**@brief Nombre de centraux connectes */
+        uint8_t (*conn_count)(void);
+        int (*adv_suspend)(void);
+        int (*adv_resume)(void);
+        /**@brief Passage en System OFF, ne rend pas la main sur carte */
+        void (*system_off)(void);
+    };
+
+    /**@brief Remplace les hooks (tests), NULL pour revenir a la pile BLE et
+     * au SoC */
+    void esirem_quantum_main_deepsleep_set_hooks(const struct esirem_quantum_main_deepsleep_hooks* hooks);
+
+    /**@brief A appeler apres ble_init : demarre le delai d'inactivite */
+    int esirem_quantum_main_deepsleep_init(void);
+
+    /**@brief Relance le delai d'inactivite (fin de cycle, deconnexion) */
+    void esirem_quantum_main_deepsleep_activity(void);
+
+#else
+
+    static inline void esirem_quantum_main_deepsleep_activity(void)
+    {
+    }
+
+#endif // CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_DEEPSLEEP_H_INCLUDED
@@ -0,0 +1,114 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * eventlog.h - 07/12/2021
+ * Journal d'evenements persistant en flash
+ *
+ * Le journal occupe la partition "eventlog" (voir eventlog.overlay). Chaque
+ * evenement recoit un numero de sequence croissant, conserve au travers des
+ * redemarrages, qui sert d'offset de reprise lors de la lecture.
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_EVENTLOG_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_EVENTLOG_H_INCLUDED
+
+#include <zephyr/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    enum esirem_quantum_main_eventlog_evt
+    {
+        /* arg : cause du reset (hwinfo) */
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_BOOT         = 0x00UL,
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_TRIG         = 0x01UL,
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_STOP         = 0x02UL,
+        /* arg : index de la periode atteinte */
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_CYCLE_END    = 0x03UL,
+        /* arg : code d'erreur */
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_ERROR        = 0x04UL,
+        /* arg : valeur ecrite (un parametre) ou generation de la
+         * configuration (tous les parametres, service ou mesh) */
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_CONFIG_WRITE = 0x05UL,
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_REBOOT       = 0x06UL,
+        /* arg : index de la periode reprise apres un reset a chaud */
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_RESUME       = 0x07UL,
+        /* arg : canal du watchdog a l'origine du reset */
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_WATCHDOG     = 0x08UL,
+        /* arg : 0 System OFF, 1 advertising suspendu */
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_SLEEP        = 0x09UL,
+        /* arg : 0 timer, 1 bouton */
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_WAKE         = 0x0AUL,
+        /* arg : masque des champs provisionnes (bit = type du champ) */
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_PROVISION    = 0x0BUL,
+    };
+
+    /**@brief Enregistrement tel que stocke en flash et transmis au central
+     * (little endian). Le CRC-8 couvre les 15 premiers octets. */
+    struct esirem_quantum_main_eventlog_record
+    {
+        uint32_t seq;
+        uint32_t uptime_ms;
+        uint32_t arg;
+        uint16_t boot;
+        uint8_t evt;
+        uint8_t crc;
+    } __packed;
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG)
+
+    /**@brief reset_cause : masque RESET_* hwinfo, enregistre avec le
+     * demarrage */
+    int esirem_quantum_main_eventlog_init(uint32_t reset_cause);
+
+    /**@brief Ajoute un evenement, utilisable depuis tout contexte. L'ecriture
+     * en flash est differee et groupee. */
+    void esirem_quantum_main_eventlog_add(enum esirem_quantum_main_eventlog_evt evt, uint32_t arg);
+
+    /**@brief Demande l'ecriture des evenements en attente */
+    void esirem_quantum_main_eventlog_flush(void);
+    /**@brief Ecrit les evenements en attente avant de rendre la main */
+    void esirem_quantum_main_eventlog_flush_sync(void);
+
+    /**@brief Nombre d'evenements perdus faute de place dans le buffer RAM */
+    uint32_t esirem_quantum_main_eventlog_get_dropped(void);
+
+    /**@brief Plage des enregistrements lisibles en flash : [oldest, next[ */
+    void esirem_quantum_main_eventlog_get_range(uint32_t* oldest, uint32_t* next);
+
+    /**@brief Lit au plus count enregistrements a partir de seq. Retourne le
+     * nombre lu ou un code d'erreur negatif. */
+    int esirem_quantum_main_eventlog_read(
+        uint32_t seq, struct esirem_quantum_main_eventlog_record* records, size_t count);
+
+#else
+
+    static inline void esirem_quantum_main_eventlog_add(
+        enum esirem_quantum_main_eventlog_evt evt, uint32_t arg)
+    {
+    }
+
+    static inline void esirem_quantum_main_eventlog_flush_sync(void)
+    {
+    }
+
+#endif // CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_EVENTLOG_H_INCLUDED
@@ -0,0 +1,69 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * latency.h - 07/12/2021
+ * Histogrammes de latence des chemins critiques
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_LATENCY_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_LATENCY_H_INCLUDED
+
+#include <zephyr/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**@brief Nombre de classes des histogrammes : la classe i compte les
+ * latences dans [2^i, 2^(i+1)[ us, la derniere classe tout ce qui depasse */
+#define ESIREM_QUANTUM_MAIN_LATENCY_BUCKET_COUNT (20)
+
+    enum esirem_quantum_main_latency_probe
+    {
+        /* Ecriture declenchement -> premier allumage LED */
+        ESIREM_QUANTUM_MAIN_LATENCY_PROBE_TRIG_TO_EDGE   = 0x00UL,
+        /* Ecriture arret -> LED eteinte */
+        ESIREM_QUANTUM_MAIN_LATENCY_PROBE_STOP_TO_OFF    = 0x01UL,
+        /* Premier allumage LED -> notification de l'etat */
+        ESIREM_QUANTUM_MAIN_LATENCY_PROBE_EDGE_TO_NOTIFY = 0x02UL,
+        ESIREM_QUANTUM_MAIN_LATENCY_PROBE_COUNT,
+    };
+
+    /**@brief Histogramme d'une sonde, tel que transmis par le service
+     * diagnostic (uint32 little endian) */
+    struct esirem_quantum_main_latency_hist
+    {
+        uint32_t count;
+        uint32_t max_us;
+        uint32_t buckets[ESIREM_QUANTUM_MAIN_LATENCY_BUCKET_COUNT];
+    };
+
+    int esirem_quantum_main_latency_init(void);
+
+    void esirem_quantum_main_latency_start(enum esirem_quantum_main_latency_probe probe);
+    void esirem_quantum_main_latency_stop(enum esirem_quantum_main_latency_probe probe);
+    /**@brief Desarme la sonde sans mesure : commande refusee ou sans effet */
+    void esirem_quantum_main_latency_cancel(enum esirem_quantum_main_latency_probe probe);
+
+    void esirem_quantum_main_latency_get(
+        enum esirem_quantum_main_latency_probe probe,
+        struct esirem_quantum_main_latency_hist* hist);
+    void esirem_quantum_main_latency_reset(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_LATENCY_H_INCLUDED
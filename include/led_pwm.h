@@ -0,0 +1,47 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * led_pwm.h - 07/12/2021
+ * Intensite et rampes d'allumage / d'extinction de la LED par PWM
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_LED_PWM_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_LED_PWM_H_INCLUDED
+
+#include <zephyr/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**@brief pin : numero absolu (port * 32 + broche) */
+    int esirem_quantum_main_led_pwm_init(uint32_t pin, bool active_low);
+
+    /**@brief Recalcule les rampes si un parametre a change. A appeler hors
+     * d'un front, typiquement au debut d'un cycle : une rampe en cours est
+     * interrompue. */
+    void esirem_quantum_main_led_pwm_configure(
+        uint32_t intensity_pct, uint32_t fade_in_ms, uint32_t fade_out_ms);
+
+    /**@brief Lance la rampe d'allumage puis maintient l'intensite */
+    int esirem_quantum_main_led_pwm_on(void);
+    /**@brief Lance la rampe d'extinction, le PWM s'arrete a la fin */
+    int esirem_quantum_main_led_pwm_off(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_LED_PWM_H_INCLUDED
@@ -0,0 +1,62 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * memstat.h - 07/12/2021
+ * Occupation maximale des piles des threads et du tas malloc
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_MEMSTAT_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_MEMSTAT_H_INCLUDED
+
+#include <zephyr/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**@brief Nombre de caracteres du nom de thread conserves (sans terminateur) */
+#define ESIREM_QUANTUM_MAIN_MEMSTAT_NAME_LEN (8)
+
+    /**@brief Pire occupation observee de la pile d'un thread */
+    struct esirem_quantum_main_memstat_stack
+    {
+        char name[ESIREM_QUANTUM_MAIN_MEMSTAT_NAME_LEN];
+        uint32_t size;
+        uint32_t max_used;
+    };
+
+    /**@brief Occupation du tas malloc (octets demandes, hors entetes) */
+    struct esirem_quantum_main_memstat_heap
+    {
+        uint32_t arena_size;
+        uint32_t cur_used;
+        uint32_t max_used;
+    };
+
+    int esirem_quantum_main_memstat_init(void);
+
+    /**@brief Parcourt les piles des threads et met a jour les maxima */
+    void esirem_quantum_main_memstat_sample(void);
+
+    /**@brief Copie au plus max_count entrees, retourne le nombre copie */
+    uint8_t esirem_quantum_main_memstat_get_stacks(
+        struct esirem_quantum_main_memstat_stack* stacks, uint8_t max_count);
+    void esirem_quantum_main_memstat_get_heap(struct esirem_quantum_main_memstat_heap* heap);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_MEMSTAT_H_INCLUDED
@@ -0,0 +1,76 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * mesh.h - 07/12/2021
+ * Propagation des declenchements par Bluetooth Mesh
+ *
+ * Modeles exposes sur l'element principal :
+ * - Generic OnOff server : ON -> declenchement d'un cycle, OFF -> arret
+ * - Modele vendeur : lecture / ecriture des parametres de sequence,
+ * declenchement horodate (statistiques de latence et de sauts) et lecture
+ * des statistiques
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_MESH_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_MESH_H_INCLUDED
+
+#include <zephyr/types.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**@brief Identifiant du modele vendeur ESIREM Quantum main */
+#define ESIREM_QUANTUM_MAIN_MESH_VND_MODEL_ID 0x0001
+
+/**@brief Opcodes du modele vendeur (3 octets, company id en suffixe) */
+#define ESIREM_QUANTUM_MAIN_MESH_VND_OP_CONFIG_GET    0x01
+#define ESIREM_QUANTUM_MAIN_MESH_VND_OP_CONFIG_SET    0x02
+#define ESIREM_QUANTUM_MAIN_MESH_VND_OP_CONFIG_STATUS 0x03
+#define ESIREM_QUANTUM_MAIN_MESH_VND_OP_TRIG          0x04
+#define ESIREM_QUANTUM_MAIN_MESH_VND_OP_STATS_GET     0x05
+#define ESIREM_QUANTUM_MAIN_MESH_VND_OP_STATS_STATUS  0x06
+
+    /**@brief Statistiques de propagation des declenchements horodates */
+    struct esirem_quantum_main_mesh_stats
+    {
+        uint32_t rx_count;
+        uint8_t hop_min;
+        uint8_t hop_max;
+        uint32_t hop_sum;
+        uint32_t latency_count;
+        uint32_t latency_min_us;
+        uint32_t latency_max_us;
+        uint64_t latency_sum_us;
+    };
+
+    struct bt_mesh_elem;
+
+    int esirem_quantum_main_mesh_init(void);
+    int esirem_quantum_main_mesh_start(void);
+
+    void esirem_quantum_main_mesh_state_publish(bool device_state);
+
+    void esirem_quantum_main_mesh_get_stats(struct esirem_quantum_main_mesh_stats* stats);
+
+    /**@brief Element principal du noeud : les tests retrouvent ses modeles
+     * et appellent directement leurs handlers, sans la pile mesh */
+    struct bt_mesh_elem* esirem_quantum_main_mesh_elem(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_MESH_H_INCLUDED
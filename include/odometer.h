@@ -0,0 +1,62 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * odometer.h - 07/12/2021
+ * Compteurs de vie du dispositif, jamais remis a zero
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_ODOMETER_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_ODOMETER_H_INCLUDED
+
+#include <zephyr/types.h>
+#include <settings/settings.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    enum esirem_quantum_main_odometer_counter
+    {
+        ESIREM_QUANTUM_MAIN_ODOMETER_CYCLES        = 0x00UL,
+        ESIREM_QUANTUM_MAIN_ODOMETER_LED_ON_MS     = 0x01UL,
+        ESIREM_QUANTUM_MAIN_ODOMETER_REBOOTS       = 0x02UL,
+        ESIREM_QUANTUM_MAIN_ODOMETER_ERRORS        = 0x03UL,
+        ESIREM_QUANTUM_MAIN_ODOMETER_CONFIG_WRITES = 0x04UL,
+        ESIREM_QUANTUM_MAIN_ODOMETER_COUNT,
+    };
+
+    /**@brief Compteurs conserves en RAM retenue et sauvegardes en flash */
+    struct esirem_quantum_main_odometer
+    {
+        uint64_t counters[ESIREM_QUANTUM_MAIN_ODOMETER_COUNT];
+    };
+
+    extern struct settings_handler esirem_quantum_main_odometer_settings_hdlrs;
+
+    /**@brief A appeler apres esirem_quantum_main_retained_init et avant le
+     * chargement des settings : compte le demarrage */
+    int esirem_quantum_main_odometer_init(void);
+
+    void esirem_quantum_main_odometer_add(
+        enum esirem_quantum_main_odometer_counter counter, uint32_t value);
+    void esirem_quantum_main_odometer_get(struct esirem_quantum_main_odometer* odometer);
+
+    /**@brief Sauvegarde immediate en flash, avant un redemarrage volontaire */
+    int esirem_quantum_main_odometer_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_ODOMETER_H_INCLUDED
@@ -0,0 +1,114 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * retained.h - 07/12/2021
+ * Donnees conservees en RAM au travers d'un reset a chaud
+ *
+ * La zone est placee en section noinit (non initialisee au demarrage) et
+ * protegee par un CRC : apres une coupure d'alimentation ou si la zone a ete
+ * corrompue, elle est remise a zero.
+ *
+ * Les compteurs de vie (statistiques, odometre) y sont regroupes par module
+ * dans un esirem_quantum_main_retained_store, sauvegarde en flash a intervalle
+ * long (voir retained.c).
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_RETAINED_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_RETAINED_H_INCLUDED
+
+#include <include/core.h>
+#include <include/odometer.h>
+#include <include/stats.h>
+#include <include/watchdog.h>
+
+#include <kernel.h>
+#include <settings/settings.h>
+#include <zephyr/types.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    struct esirem_quantum_main_retained
+    {
+        uint32_t magic;
+        uint32_t crc;
+        /* Donnees protegees par le CRC */
+        struct esirem_quantum_main_stats_counters stats;
+        struct esirem_quantum_main_odometer odometer;
+        struct esirem_quantum_main_core_snapshot core;
+        struct esirem_quantum_main_watchdog_fault watchdog;
+    };
+
+    extern struct esirem_quantum_main_retained esirem_quantum_main_retained;
+
+    bool esirem_quantum_main_retained_init(void);
+    bool esirem_quantum_main_retained_was_valid(void);
+    void esirem_quantum_main_retained_update(void);
+
+/* Taille maximale d'une partie sauvegardee en flash */
+#define ESIREM_QUANTUM_MAIN_RETAINED_STORE_MAX_SIZE (64)
+
+    /**@brief Partie de la RAM retenue sauvegardee en flash par un module
+     *
+     * Le module modifie la partie sous store->lock, passe store->dirty a
+     * true, puis appelle esirem_quantum_main_retained_update. */
+    struct esirem_quantum_main_retained_store
+    {
+        /* Cle settings complete ("module/nom") */
+        const char* key;
+        void* data;
+        size_t size;
+        uint32_t flush_interval_s;
+        /* Mise a jour avant sauvegarde (optionnelle), verrou pris */
+        void (*prepare)(void* data);
+        /* Ajoute les valeurs lues en flash a la RAM retenue, verrou pris */
+        void (*merge)(void* data, const void* saved);
+        struct k_spinlock lock;
+        bool dirty;
+        struct k_work_delayable flush_work;
+    };
+
+#define ESIREM_QUANTUM_MAIN_RETAINED_STORE_DEFINE(                                                 \
+    _name, _key, _member, _flush_interval_s, _prepare, _merge)                                     \
+    struct esirem_quantum_main_retained_store _name = {                                            \
+        .key              = _key,                                                                  \
+        .data             = &esirem_quantum_main_retained._member,                                 \
+        .size             = sizeof(esirem_quantum_main_retained._member),                          \
+        .flush_interval_s = _flush_interval_s,                                                     \
+        .prepare          = _prepare,                                                              \
+        .merge            = _merge,                                                                \
+    };                                                                                             \
+    BUILD_ASSERT(                                                                                  \
+        sizeof(esirem_quantum_main_retained._member) <= ESIREM_QUANTUM_MAIN_RETAINED_STORE_MAX_SIZE)
+
+    /**@brief A appeler apres esirem_quantum_main_retained_init : demarre les
+     * sauvegardes periodiques */
+    void esirem_quantum_main_retained_store_start(struct esirem_quantum_main_retained_store* store);
+
+    /**@brief Sauvegarde immediate en flash si la partie a change */
+    int esirem_quantum_main_retained_store_flush(struct esirem_quantum_main_retained_store* store);
+
+    /**@brief Chargement de la valeur sauvegardee, depuis le h_set du module */
+    int esirem_quantum_main_retained_store_load(
+        struct esirem_quantum_main_retained_store* store, size_t len, settings_read_cb read_cb,
+        void* cb_arg);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_RETAINED_H_INCLUDED
@@ -19,6 +19,10 @@
 #include <zephyr/types.h>
 
 extern const uint32_t settings_val_max_percent;
+extern const uint32_t settings_val_max_duration_ms;
+extern const uint32_t settings_val_max_seq_duration_ms;
+extern const uint32_t settings_val_max_current_ua;
+extern const uint32_t settings_val_max_seq_mode;
 
 int esirem_quantum_main_settings_init();
 
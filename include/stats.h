@@ -0,0 +1,77 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * stats.h - 07/12/2021
+ * Temps passe dans chaque etat du core, compteurs d'activite et estimation
+ * de l'energie consommee par la LED
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_STATS_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_STATS_H_INCLUDED
+
+#include <zephyr/types.h>
+#include <settings/settings.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**@brief Etats comptabilises, memes valeurs que les etats du core */
+    enum esirem_quantum_main_stats_state
+    {
+        ESIREM_QUANTUM_MAIN_STATS_STATE_IDLE  = 0x00UL,
+        ESIREM_QUANTUM_MAIN_STATS_STATE_ON    = 0x01UL,
+        ESIREM_QUANTUM_MAIN_STATS_STATE_OFF   = 0x02UL,
+        ESIREM_QUANTUM_MAIN_STATS_STATE_ERROR = 0x03UL,
+        ESIREM_QUANTUM_MAIN_STATS_STATE_COUNT,
+    };
+
+    enum esirem_quantum_main_stats_counter
+    {
+        ESIREM_QUANTUM_MAIN_STATS_COUNTER_EDGES     = 0x00UL,
+        ESIREM_QUANTUM_MAIN_STATS_COUNTER_CYCLES    = 0x01UL,
+        ESIREM_QUANTUM_MAIN_STATS_COUNTER_WORK_RUNS = 0x02UL,
+        ESIREM_QUANTUM_MAIN_STATS_COUNTER_COUNT,
+    };
+
+    /**@brief Compteurs conserves en RAM retenue et sauvegardes en flash */
+    struct esirem_quantum_main_stats_counters
+    {
+        uint64_t residency_ms[ESIREM_QUANTUM_MAIN_STATS_STATE_COUNT];
+        uint32_t counters[ESIREM_QUANTUM_MAIN_STATS_COUNTER_COUNT];
+    };
+
+    struct esirem_quantum_main_stats
+    {
+        struct esirem_quantum_main_stats_counters counters;
+        uint64_t led_energy_uj;
+    };
+
+    extern struct settings_handler esirem_quantum_main_stats_settings_hdlrs;
+
+    int esirem_quantum_main_stats_init(void);
+
+    void esirem_quantum_main_stats_state_enter(enum esirem_quantum_main_stats_state state);
+    void esirem_quantum_main_stats_count(enum esirem_quantum_main_stats_counter counter);
+
+    void esirem_quantum_main_stats_get(struct esirem_quantum_main_stats* stats);
+    void esirem_quantum_main_stats_reset(void);
+    /**@brief Sauvegarde immediate en flash si les compteurs ont change */
+    void esirem_quantum_main_stats_flush(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_STATS_H_INCLUDED
@@ -0,0 +1,96 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * trace.h - 07/12/2021
+ * Trace binaire des evenements du chemin critique
+ *
+ * Les evenements sont enregistres dans un buffer circulaire en RAM
+ * (horodatage en cycles, identifiant, argument 32 bits) sans verrou ni
+ * formatage. Un evenement absent de CONFIG_ESIREM_QUANTUM_MAIN_TRACE_EVENT_MASK
+ * est elimine a la compilation.
+ *
+ * Le decodeur scripts/trace_decode.py lit les noms des evenements dans ce
+ * fichier : ne pas changer le format de l'enum.
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_TRACE_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_TRACE_H_INCLUDED
+
+#include <zephyr/types.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    enum esirem_quantum_main_trace_evt
+    {
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_TRIG        = 0,
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_STOP        = 1,
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_LED_ON      = 2,
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_LED_OFF     = 3,
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_IDLE        = 4,
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_ERROR       = 5,
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_BLE_CONNECTED    = 6,
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_BLE_DISCONNECTED = 7,
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_BLE_USER_WRITE   = 8,
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_BLE_CONFIG_WRITE = 9,
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_BLE_CONFIG_READ  = 10,
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_SETTINGS_SET     = 11,
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_BEACON_RX        = 12,
+    };
+
+    /**@brief Enregistrement de trace, tel que transmis au decodeur */
+    struct esirem_quantum_main_trace_record
+    {
+        uint32_t timestamp;
+        uint32_t arg;
+        uint16_t evt;
+        uint16_t seq;
+    } __packed;
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_TRACE)
+
+#define ESIREM_QUANTUM_MAIN_TRACE_EVT_ENABLED(_evt)                             \
+    ((CONFIG_ESIREM_QUANTUM_MAIN_TRACE_EVENT_MASK >> (_evt)) & 0x01)
+
+    void esirem_quantum_main_trace_record(uint16_t evt, uint32_t arg);
+
+    int esirem_quantum_main_trace_init(void);
+    void esirem_quantum_main_trace_process(void);
+
+/**@brief Enregistre un evenement. _evt doit etre une constante pour que le
+ * filtrage soit resolu a la compilation. */
+#define ESIREM_QUANTUM_MAIN_TRACE(_evt, _arg)                                   \
+    do                                                                         \
+    {                                                                          \
+        if (ESIREM_QUANTUM_MAIN_TRACE_EVT_ENABLED(_evt))                        \
+        {                                                                      \
+            esirem_quantum_main_trace_record((_evt), (uint32_t) (_arg));        \
+        }                                                                      \
+    } while (0)
+
+#else
+
+#define ESIREM_QUANTUM_MAIN_TRACE(_evt, _arg)                                   \
+    do                                                                         \
+    {                                                                          \
+    } while (0)
+
+#endif // CONFIG_ESIREM_QUANTUM_MAIN_TRACE
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_TRACE_H_INCLUDED
@@ -0,0 +1,75 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * traffic.h - 07/12/2021
+ * Charge BLE : debit de commandes, erreurs ATT et notifications perdues
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_TRAFFIC_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_TRAFFIC_H_INCLUDED
+
+#include <zephyr/types.h>
+#include <bluetooth/gatt.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    enum esirem_quantum_main_traffic_counter
+    {
+        /**@brief Ecritures GATT sur les services utilisateur et configuration */
+        ESIREM_QUANTUM_MAIN_TRAFFIC_COMMANDS         = 0x00UL,
+        /**@brief Callbacks GATT terminees par une erreur ATT */
+        ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERRORS       = 0x01UL,
+        /**@brief Notifications acceptees par la pile, une par central */
+        ESIREM_QUANTUM_MAIN_TRAFFIC_NOTIFY_SENT      = 0x02UL,
+        /**@brief Notifications refusees par la pile (plus de buffer, etc.) */
+        ESIREM_QUANTUM_MAIN_TRAFFIC_NOTIFY_FAILED    = 0x03UL,
+        /**@brief Notifications d'avancement fusionnees, la precedente etant
+         * encore en vol */
+        ESIREM_QUANTUM_MAIN_TRAFFIC_NOTIFY_COALESCED = 0x04UL,
+        ESIREM_QUANTUM_MAIN_TRAFFIC_COUNTER_COUNT,
+    };
+
+    struct esirem_quantum_main_traffic
+    {
+        uint32_t counters[ESIREM_QUANTUM_MAIN_TRAFFIC_COUNTER_COUNT];
+        /**@brief Commandes recues pendant la derniere seconde complete */
+        uint32_t commands_per_s;
+        /**@brief Maximum de commandes par seconde depuis la remise a zero */
+        uint32_t commands_per_s_max;
+    };
+
+    void esirem_quantum_main_traffic_count(enum esirem_quantum_main_traffic_counter counter);
+    void esirem_quantum_main_traffic_get(struct esirem_quantum_main_traffic* traffic);
+    void esirem_quantum_main_traffic_reset(void);
+
+    /**@brief Compte le resultat d'un envoi de notification */
+    static inline void esirem_quantum_main_traffic_notify_result(int err)
+    {
+        esirem_quantum_main_traffic_count(
+            err ? ESIREM_QUANTUM_MAIN_TRAFFIC_NOTIFY_FAILED
+                : ESIREM_QUANTUM_MAIN_TRAFFIC_NOTIFY_SENT);
+    }
+
+/**@brief BT_GATT_ERR qui compte l'erreur ATT retournee au central */
+#define ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(_att_err)                          \
+    (esirem_quantum_main_traffic_count(ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERRORS), \
+     BT_GATT_ERR(_att_err))
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_TRAFFIC_H_INCLUDED
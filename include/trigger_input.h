@@ -0,0 +1,31 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * trigger_input.h - 07/12/2021
+ * Entree de declenchement physique (bouton, contact sec)
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_TRIGGER_INPUT_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_TRIGGER_INPUT_H_INCLUDED
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**@brief A appeler apres esirem_quantum_main_core_init */
+    int esirem_quantum_main_trigger_input_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_TRIGGER_INPUT_H_INCLUDED
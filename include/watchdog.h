@@ -0,0 +1,94 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * watchdog.h - 07/12/2021
+ * Surveillance des taches : core, pile BLE et superviseur
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_INCLUDE_WATCHDOG_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_INCLUDE_WATCHDOG_H_INCLUDED
+
+#include <zephyr/types.h>
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /**@brief Origine du dernier declenchement du watchdog */
+    enum esirem_quantum_main_watchdog_channel
+    {
+        ESIREM_QUANTUM_MAIN_WATCHDOG_CHANNEL_NONE = 0x00UL,
+        ESIREM_QUANTUM_MAIN_WATCHDOG_CHANNEL_CORE = 0x01UL,
+        ESIREM_QUANTUM_MAIN_WATCHDOG_CHANNEL_BLE  = 0x02UL,
+        ESIREM_QUANTUM_MAIN_WATCHDOG_CHANNEL_MAIN = 0x03UL,
+        /* Watchdog materiel : aucune tache n'a pu etre identifiee */
+        ESIREM_QUANTUM_MAIN_WATCHDOG_CHANNEL_HW   = 0x04UL,
+    };
+
+    /**@brief Conserve en RAM retenue au travers du reset */
+    struct esirem_quantum_main_watchdog_fault
+    {
+        uint32_t last_channel;
+        uint32_t count;
+        /* Uptime au moment du declenchement */
+        uint32_t uptime_ms;
+        /* Non nul entre le declenchement et le demarrage suivant */
+        uint32_t pending;
+    };
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_WATCHDOG)
+
+    /**@brief A appeler apres esirem_quantum_main_retained_init et
+     * esirem_quantum_main_eventlog_init. reset_cause : masque RESET_* hwinfo */
+    int esirem_quantum_main_watchdog_init(uint32_t reset_cause);
+
+    /**@brief Alimente le canal du core pendant un cycle. timeout_ms est le
+     * plus long des delais Ton / Toff de la periode, sans la marge. */
+    void esirem_quantum_main_watchdog_core_feed(uint32_t timeout_ms);
+    /**@brief Libere le canal du core en fin de cycle */
+    void esirem_quantum_main_watchdog_core_disarm(void);
+
+    /**@brief Demarre la sonde de la pile BLE, apres bt_enable */
+    int esirem_quantum_main_watchdog_ble_start(void);
+
+    void esirem_quantum_main_watchdog_main_feed(void);
+
+    void esirem_quantum_main_watchdog_get_fault(struct esirem_quantum_main_watchdog_fault* fault);
+
+#else
+
+    static inline void esirem_quantum_main_watchdog_core_feed(uint32_t timeout_ms)
+    {
+    }
+
+    static inline void esirem_quantum_main_watchdog_core_disarm(void)
+    {
+    }
+
+    static inline int esirem_quantum_main_watchdog_ble_start(void)
+    {
+        return 0;
+    }
+
+    static inline void esirem_quantum_main_watchdog_main_feed(void)
+    {
+    }
+
+#endif // CONFIG_ESIREM_QUANTUM_MAIN_WATCHDOG
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // ESIREM_QUANTUM_MAIN_INCLUDE_WATCHDOG_H_INCLUDED
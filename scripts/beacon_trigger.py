@@ -0,0 +1,49 @@
+#!/usr/bin/env python3
+#
+# (c) 2021 - Codium Electronique
+# Tous droits reserves
+# Ce fichier fait partie du projet ESIREM Quantum main board
+#
+# Genere les donnees constructeur d'un beacon de declenchement signe
+# (voir include/ble_beacon_trigger.h pour le format).
+#
+# Exemple :
+#   beacon_trigger.py --key 000102030405060708090a0b0c0d0e0f --counter 42 trig
+#
+
+import argparse
+import struct
+
+from cryptography.hazmat.primitives.cmac import CMAC
+from cryptography.hazmat.primitives.ciphers import algorithms
+
+BEACON_TAG = 0x4D4D
+BEACON_MAC_LEN = 4
+OPCODES = {"stop": 0x00, "trig": 0x01}
+
+
+def beacon_payload(key, company_id, opcode, counter):
+    signed = struct.pack("<HHBI", company_id, BEACON_TAG, opcode, counter)
+    cmac = CMAC(algorithms.AES(key))
+    cmac.update(signed)
+    return signed + cmac.finalize()[:BEACON_MAC_LEN]
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Genere un beacon de declenchement signe"
+    )
+    parser.add_argument("--key", required=True, help="cle AES-128 en hexa")
+    parser.add_argument("--company-id", type=lambda v: int(v, 0), default=0xFFFF)
+    parser.add_argument("--counter", type=int, required=True)
+    parser.add_argument("opcode", choices=OPCODES.keys())
+    args = parser.parse_args()
+
+    payload = beacon_payload(
+        bytes.fromhex(args.key), args.company_id, OPCODES[args.opcode], args.counter
+    )
+    print(payload.hex())
+
+
+if __name__ == "__main__":
+    main()
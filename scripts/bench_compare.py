@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+#
+# (c) 2021 - Codium Electronique
+# Tous droits reserves
+# Ce fichier fait partie du projet ESIREM Quantum main board
+#
+# Extrait le resume du benchmark (lignes "BENCH,..." de la console, voir
+# tests/bench) et compare deux versions du firmware.
+#
+# Exemple :
+#   bench_compare.py console_v1.log
+#   bench_compare.py console_v1.log console_v2.log
+#
+
+import argparse
+import csv
+import sys
+
+FIELDS = ("name", "param", "count", "min_ns", "avg_ns", "max_ns")
+
+
+def load(path):
+    results = {}
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            start = line.find("BENCH,")
+            if start < 0:
+                continue
+            row = next(csv.reader([line[start + len("BENCH,"):].strip()]))
+            if len(row) != len(FIELDS) or row[0] in ("name", "done"):
+                continue
+            results[(row[0], int(row[1]))] = {
+                field: int(val) for field, val in zip(FIELDS[2:], row[2:])}
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare deux resumes de benchmark")
+    parser.add_argument("base", help="console de la version de reference")
+    parser.add_argument("new", nargs="?", help="console de la version a comparer")
+    args = parser.parse_args()
+
+    base = load(args.base)
+    new = load(args.new) if args.new else None
+    writer = csv.writer(sys.stdout)
+
+    if new is None:
+        writer.writerow(FIELDS)
+        for (name, param), res in sorted(base.items()):
+            writer.writerow([name, param] + [res[f] for f in FIELDS[2:]])
+        return 0
+
+    writer.writerow(("name", "param", "avg_ns_base", "avg_ns_new", "delta_pct"))
+    for key in sorted(set(base) | set(new)):
+        old_avg = base.get(key, {}).get("avg_ns")
+        new_avg = new.get(key, {}).get("avg_ns")
+        delta = ""
+        if old_avg and new_avg is not None:
+            delta = "%+.1f" % ((new_avg - old_avg) * 100.0 / old_avg)
+        writer.writerow([key[0], key[1], old_avg, new_avg, delta])
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
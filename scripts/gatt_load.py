@@ -0,0 +1,296 @@
+#!/usr/bin/env python3
+#
+# (c) 2021 - Codium Electronique
+# Tous droits reserves
+# Ce fichier fait partie du projet ESIREM Quantum main board
+#
+# Generateur de charge GATT : un ou plusieurs centraux (un adaptateur BlueZ
+# chacun) pilotent les services utilisateur et configuration au plus vite,
+# puis le resultat cote poste est compare a la caracteristique "Charge BLE"
+# du service diagnostic (voir include/traffic.h).
+#
+# Scenarios, attribues aux centraux dans l'ordre des adaptateurs :
+#   trig    declenchements / arrets en rafale (etat 1 puis 0)
+#   params  ecritures de Ton (valeur courante et +1 en alternance, restauree
+#           a la fin) ; chaque ecriture passe par la flash, le debit est
+#           borne par --params-rate pour ne pas user la partition NVS
+#   churn   abonnements / desabonnements en boucle a l'etat et l'avancement
+#
+# La cible est une carte, ou le firmware native_posix lance avec un
+# controleur du PC (zephyr.exe --bt-dev=hci0) : chaque central doit alors
+# utiliser un autre controleur. Sans adaptateurs, le script ne tourne pas
+# en integration continue : les compteurs et les callbacks GATT sous
+# plusieurs centraux simules y sont verifies par tests/core (test_traffic.c).
+#
+# Les pertes de notifications sont les notifications envoyees par la carte
+# (une par central abonne) moins celles recues par l'ensemble des centraux.
+#
+# Exemple :
+#   gatt_load.py --address F0:12:34:56:78:9A --adapter hci1 --adapter hci2 \
+#       --scenario trig params --duration 60
+#
+
+import argparse
+import asyncio
+import re
+import struct
+import time
+
+from bleak import BleakClient
+from bleak.exc import BleakError
+
+SERVICE_CONFIG = 0x01
+SERVICE_USER = 0x02
+SERVICE_DIAG = 0x03
+
+CONFIG_CHRC_TON_MS = 0x02
+USER_CHRC_STATE = 0x01
+USER_CHRC_PROGRESS = 0x03
+DIAG_CHRC_CTRL = 0x02
+DIAG_CHRC_TRAFFIC = 0x07
+
+DIAG_CTRL_RESET_TRAFFIC = 0x03
+
+# Ecritures flash par seconde au plus pour le scenario params
+PARAMS_RATE_MAX = 10.0
+
+TRAFFIC_FIELDS = (
+    "commands_per_s",
+    "commands_per_s_max",
+    "commands",
+    "att_errors",
+    "notify_sent",
+    "notify_failed",
+    "notify_coalesced",
+)
+
+ATT_ERROR_RE = re.compile(r"ATT error: 0x([0-9a-fA-F]{2})")
+
+
+def chrc_uuid(service, chrc):
+    # Voir ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC (include/ble_uuid.h)
+    return "53a8%02x%02x-0001-4d4d-4d4d-45534952454d" % (service, chrc)
+
+
+class CentralStats:
+    def __init__(self, adapter, scenario):
+        self.adapter = adapter
+        self.scenario = scenario
+        self.commands = 0
+        self.att_errors = {}
+        self.other_errors = 0
+        self.notifications = {USER_CHRC_STATE: 0, USER_CHRC_PROGRESS: 0}
+
+    def error(self, exc):
+        match = ATT_ERROR_RE.search(str(exc))
+        if not match:
+            self.other_errors += 1
+            return
+        code = int(match.group(1), 16)
+        self.att_errors[code] = self.att_errors.get(code, 0) + 1
+
+    def notify_cb(self, chrc):
+        def cb(_sender, _data):
+            self.notifications[chrc] += 1
+
+        return cb
+
+
+async def command(client, stats, uuid, data):
+    stats.commands += 1
+    try:
+        await client.write_gatt_char(uuid, data, response=True)
+    except BleakError as exc:
+        stats.error(exc)
+
+
+async def subscribe(client, stats):
+    for chrc in (USER_CHRC_STATE, USER_CHRC_PROGRESS):
+        await client.start_notify(
+            chrc_uuid(SERVICE_USER, chrc), stats.notify_cb(chrc)
+        )
+
+
+async def unsubscribe(client):
+    for chrc in (USER_CHRC_STATE, USER_CHRC_PROGRESS):
+        await client.stop_notify(chrc_uuid(SERVICE_USER, chrc))
+
+
+async def scenario_trig(client, stats, deadline, _args):
+    state = chrc_uuid(SERVICE_USER, USER_CHRC_STATE)
+    while time.monotonic() < deadline:
+        await command(client, stats, state, b"\x01")
+        await command(client, stats, state, b"\x00")
+
+
+async def scenario_params(client, stats, deadline, args):
+    ton = chrc_uuid(SERVICE_CONFIG, CONFIG_CHRC_TON_MS)
+    (value,) = struct.unpack("<I", await client.read_gatt_char(ton))
+    period = 1.0 / args.params_rate
+    n = 0
+    try:
+        while time.monotonic() < deadline:
+            next_write = time.monotonic() + period
+            await command(client, stats, ton, struct.pack("<I", value + (n & 1)))
+            n += 1
+            await asyncio.sleep(max(0.0, next_write - time.monotonic()))
+    finally:
+        await command(client, stats, ton, struct.pack("<I", value))
+
+
+async def scenario_churn(client, stats, deadline, _args):
+    while time.monotonic() < deadline:
+        await unsubscribe(client)
+        await subscribe(client, stats)
+
+
+SCENARIOS = {
+    "trig": scenario_trig,
+    "params": scenario_params,
+    "churn": scenario_churn,
+}
+
+
+async def diag_reset(args):
+    async with BleakClient(args.address, adapter=args.adapter[0]) as client:
+        await client.write_gatt_char(
+            chrc_uuid(SERVICE_DIAG, DIAG_CHRC_CTRL),
+            bytes([DIAG_CTRL_RESET_TRAFFIC]),
+            response=True,
+        )
+
+
+async def diag_traffic(args):
+    async with BleakClient(args.address, adapter=args.adapter[0]) as client:
+        data = await client.read_gatt_char(
+            chrc_uuid(SERVICE_DIAG, DIAG_CHRC_TRAFFIC)
+        )
+    return dict(zip(TRAFFIC_FIELDS, struct.unpack("<7I", data[:28])))
+
+
+async def central_run(args, stats, ready, start, timing):
+    async with BleakClient(args.address, adapter=stats.adapter) as client:
+        await subscribe(client, stats)
+        ready.release()
+        await start.wait()
+        await SCENARIOS[stats.scenario](client, stats, timing["deadline"], args)
+        # Dernieres notifications en vol
+        await asyncio.sleep(1.0)
+        await unsubscribe(client)
+
+
+async def run(args):
+    centrals = [
+        CentralStats(adapter, args.scenario[i % len(args.scenario)])
+        for i, adapter in enumerate(args.adapter)
+    ]
+    ready = asyncio.Semaphore(0)
+    start = asyncio.Event()
+    timing = {}
+
+    # Le service diagnostic est lu par des connexions courtes, avant et
+    # apres la charge : un adaptateur ne peut ouvrir qu'une connexion vers
+    # la carte
+    await diag_reset(args)
+    tasks = [
+        asyncio.create_task(central_run(args, stats, ready, start, timing))
+        for stats in centrals
+    ]
+
+    # Les connexions sont etablies en sequence par BlueZ : les scenarios
+    # partent ensemble, une fois tous les centraux abonnes
+    for _ in centrals:
+        await ready.acquire()
+    begin = time.monotonic()
+    timing["deadline"] = begin + args.duration
+    start.set()
+    await asyncio.gather(*tasks)
+    elapsed = time.monotonic() - begin
+    device = await diag_traffic(args)
+
+    return centrals, elapsed, device
+
+
+def report(centrals, elapsed, device):
+    total_commands = 0
+    total_att_errors = 0
+    total_notifications = 0
+
+    print("central,scenario,commandes,cmd_par_s,erreurs_att,autres_erreurs,notif_etat,notif_avancement")
+    for stats in centrals:
+        att_errors = sum(stats.att_errors.values())
+        notifications = sum(stats.notifications.values())
+        total_commands += stats.commands
+        total_att_errors += att_errors
+        total_notifications += notifications
+        print(
+            "%s,%s,%u,%.1f,%u,%u,%u,%u"
+            % (
+                stats.adapter,
+                stats.scenario,
+                stats.commands,
+                stats.commands / elapsed,
+                att_errors,
+                stats.other_errors,
+                stats.notifications[USER_CHRC_STATE],
+                stats.notifications[USER_CHRC_PROGRESS],
+            )
+        )
+        for code, count in sorted(stats.att_errors.items()):
+            print("  erreur ATT 0x%02x : %u" % (code, count))
+
+    print()
+    print("total poste : %u commandes en %.1f s (%.1f cmd/s), %u erreurs ATT (%.2f %%), %u notifications recues"
+          % (total_commands, elapsed, total_commands / elapsed, total_att_errors,
+             100.0 * total_att_errors / max(total_commands, 1), total_notifications))
+    print("carte       : " + ", ".join("%s=%u" % (k, v) for k, v in device.items()))
+
+    # Les notifications fusionnees (avancement) ne sont pas envoyees, les
+    # refus de la pile sont comptes a part
+    lost = device["notify_sent"] - total_notifications
+    print(
+        "notifications : %u envoyees, %u recues, %d perdues (%.2f %%), %u refusees par la pile, %u fusionnees"
+        % (device["notify_sent"], total_notifications, lost,
+           100.0 * lost / max(device["notify_sent"], 1), device["notify_failed"],
+           device["notify_coalesced"])
+    )
+    if device["commands"] != total_commands:
+        print("ecart de commandes poste / carte : %d" % (total_commands - device["commands"]))
+    if device["att_errors"] != total_att_errors:
+        print("ecart d'erreurs ATT poste / carte : %d" % (total_att_errors - device["att_errors"]))
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Charge GATT multi-centraux sur les services utilisateur et configuration"
+    )
+    parser.add_argument("--address", required=True, help="adresse BLE de la carte")
+    parser.add_argument(
+        "--adapter",
+        action="append",
+        required=True,
+        help="adaptateur BlueZ d'un central (a repeter, ex. hci1)",
+    )
+    parser.add_argument(
+        "--scenario",
+        nargs="+",
+        choices=SCENARIOS.keys(),
+        default=["trig"],
+        help="scenarios attribues aux centraux dans l'ordre",
+    )
+    parser.add_argument("--duration", type=float, default=30.0, help="duree (s)")
+    parser.add_argument(
+        "--params-rate",
+        type=float,
+        default=2.0,
+        help="ecritures par seconde du scenario params (chacune ecrit la flash)",
+    )
+    args = parser.parse_args()
+    if not 0.0 < args.params_rate <= PARAMS_RATE_MAX:
+        parser.error("--params-rate doit etre dans ]0, %g]" % PARAMS_RATE_MAX)
+
+    report(*asyncio.run(run(args)))
+
+
+if __name__ == "__main__":
+    main()
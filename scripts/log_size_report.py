@@ -0,0 +1,85 @@
+#!/usr/bin/env python3
+#
+# (c) 2021 - Codium Electronique
+# Tous droits reserves
+# Ce fichier fait partie du projet ESIREM Quantum main board
+#
+# Compare l'empreinte de deux builds (logs texte / logs dictionnaire) :
+# ROM et RAM de zephyr.elf, nombre de messages du dictionnaire et, avec les
+# captures de console du benchmark, cout moyen d'un appel de log.
+#
+# Exemple :
+#   log_size_report.py build_text build_dict
+#   log_size_report.py build_text build_dict --bench console_text.log console_dict.log
+#
+
+import argparse
+import json
+import os
+import sys
+
+from elftools.elf.constants import SH_FLAGS
+from elftools.elf.elffile import ELFFile
+
+from bench_compare import load as bench_load
+
+# Debut de la RAM du nRF52833 : en dessous, la section est en flash
+RAM_START = 0x20000000
+
+
+def elf_sizes(build_dir):
+    rom = 0
+    ram = 0
+    with open(os.path.join(build_dir, "zephyr", "zephyr.elf"), "rb") as f:
+        for section in ELFFile(f).iter_sections():
+            flags = section["sh_flags"]
+            if not flags & SH_FLAGS.SHF_ALLOC:
+                continue
+            if section["sh_addr"] >= RAM_START:
+                ram += section["sh_size"]
+                # .data est aussi copiee depuis la flash
+                if section["sh_type"] != "SHT_NOBITS":
+                    rom += section["sh_size"]
+            else:
+                rom += section["sh_size"]
+    return rom, ram
+
+
+def dict_msg_count(build_dir):
+    path = os.path.join(build_dir, "zephyr", "log_dictionary.json")
+    if not os.path.exists(path):
+        return None
+    with open(path, encoding="utf-8") as f:
+        return len(json.load(f).get("log_subsys", {}).get("log_msgs", []))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare l'empreinte des logs de deux builds")
+    parser.add_argument("base", help="build de reference (logs texte)")
+    parser.add_argument("new", help="build a comparer (logs dictionnaire)")
+    parser.add_argument(
+        "--bench", nargs=2, metavar=("BASE_LOG", "NEW_LOG"),
+        help="captures de console du benchmark des deux builds")
+    args = parser.parse_args()
+
+    print("name,base,new,delta")
+    base_rom, base_ram = elf_sizes(args.base)
+    new_rom, new_ram = elf_sizes(args.new)
+    print("rom_bytes,%d,%d,%+d" % (base_rom, new_rom, new_rom - base_rom))
+    print("ram_bytes,%d,%d,%+d" % (base_ram, new_ram, new_ram - base_ram))
+
+    count = dict_msg_count(args.new)
+    if count is not None:
+        print("dict_msgs,,%d," % count)
+
+    if args.bench:
+        base = bench_load(args.bench[0]).get(("log_msg", 0))
+        new = bench_load(args.bench[1]).get(("log_msg", 0))
+        if base and new:
+            print("log_msg_avg_ns,%d,%d,%+d" % (
+                base["avg_ns"], new["avg_ns"], new["avg_ns"] - base["avg_ns"]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
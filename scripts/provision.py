@@ -0,0 +1,104 @@
+#!/usr/bin/env python3
+#
+# (c) 2021 - Codium Electronique
+# Tous droits reserves
+# Ce fichier fait partie du projet ESIREM Quantum main board
+#
+# Genere les ecritures du point de controle de provisionnement pour un defi
+# lu sur la carte (voir include/ble_service_prov.h pour le format).
+#
+# Exemple :
+#   provision.py --key 000102030405060708090a0b0c0d0e0f \
+#       --challenge 0011223344556677 --serial 21120042 --hw REV-B \
+#       --config 15000,500,500,10000,100,0,0,0
+#
+
+import argparse
+import struct
+
+from cryptography.hazmat.primitives.cmac import CMAC
+from cryptography.hazmat.primitives.ciphers import algorithms
+
+CTRL_BEGIN = 0x01
+CTRL_DATA = 0x02
+CTRL_COMMIT = 0x03
+
+FIELD_SERIAL = 0x01
+FIELD_MODEL = 0x02
+FIELD_MANUF = 0x03
+FIELD_HW_REV = 0x04
+FIELD_NAME_SUFFIX = 0x05
+FIELD_CONFIG = 0x06
+FIELD_BEACON_KEY = 0x07
+
+
+def field(type_, value):
+    return struct.pack("<BB", type_, len(value)) + value
+
+
+def provision_record(args):
+    record = b""
+    for type_, value in (
+        (FIELD_SERIAL, args.serial),
+        (FIELD_MODEL, args.model),
+        (FIELD_MANUF, args.manuf),
+        (FIELD_HW_REV, args.hw),
+        (FIELD_NAME_SUFFIX, args.name_suffix),
+    ):
+        if value:
+            record += field(type_, value.encode())
+    if args.config:
+        values = [int(v, 0) for v in args.config.split(",")]
+        record += field(FIELD_CONFIG, struct.pack("<%dI" % len(values), *values))
+    if args.beacon_key:
+        record += field(FIELD_BEACON_KEY, bytes.fromhex(args.beacon_key))
+    return record
+
+
+def provision_writes(key, challenge, record, mtu):
+    # ATT_MTU - 3 octets d'entete ATT - 3 octets d'entete DATA
+    chunk = mtu - 6
+    cmac = CMAC(algorithms.AES(key))
+    cmac.update(challenge + record)
+
+    writes = []
+    for offset in range(0, len(record), chunk):
+        writes.append(
+            struct.pack("<BH", CTRL_DATA, offset) + record[offset : offset + chunk]
+        )
+    writes.append(struct.pack("<BH", CTRL_COMMIT, len(record)) + cmac.finalize())
+    return writes
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description="Genere les ecritures de provisionnement d'une carte"
+    )
+    parser.add_argument("--key", required=True, help="cle AES-128 en hexa")
+    parser.add_argument(
+        "--challenge", required=True, help="defi lu apres BEGIN (8 octets hexa)"
+    )
+    parser.add_argument("--mtu", type=int, default=65)
+    parser.add_argument("--serial")
+    parser.add_argument("--model")
+    parser.add_argument("--manuf")
+    parser.add_argument("--hw")
+    parser.add_argument("--name-suffix")
+    parser.add_argument(
+        "--config", help="valeurs des parametres dans l'ordre de la table"
+    )
+    parser.add_argument("--beacon-key", help="cle beacon AES-128 en hexa")
+    args = parser.parse_args()
+
+    writes = provision_writes(
+        bytes.fromhex(args.key),
+        bytes.fromhex(args.challenge),
+        provision_record(args),
+        args.mtu,
+    )
+    for write in writes:
+        print(write.hex())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,94 @@
+#!/usr/bin/env python3
+#
+# (c) 2021 - Codium Electronique
+# Tous droits reserves
+# Ce fichier fait partie du projet ESIREM Quantum main board
+#
+# Decode un vidage du buffer de trace binaire (voir src/trace.c).
+#
+# Capture du vidage avec J-Link, canal RTT 1 :
+#   JLinkRTTLogger -Device NRF52833_XXAA -If SWD -Speed 4000 -RTTChannel 1 trace.bin
+# puis ecrire 'd' sur le canal descendant 1 (JLinkRTTClient / telnet 19021).
+#
+# Exemple :
+#   trace_decode.py trace.bin
+#
+
+import argparse
+import os
+import re
+import struct
+import sys
+
+HEADER_FMT = "<IBBHI"
+RECORD_FMT = "<IIHH"
+DUMP_MAGIC = 0x52545145
+DUMP_VERSION = 1
+
+TRACE_H = os.path.join(os.path.dirname(__file__), "..", "include", "trace.h")
+EVT_RE = re.compile(r"ESIREM_QUANTUM_MAIN_TRACE_EVT_(\w+)\s*=\s*(\d+)")
+
+
+def load_event_names(path):
+    with open(path, encoding="utf-8") as f:
+        return {int(val): name for name, val in EVT_RE.findall(f.read())}
+
+
+def decode(data, names):
+    header_sz = struct.calcsize(HEADER_FMT)
+    offset = 0
+
+    while offset + header_sz <= len(data):
+        magic, version, record_sz, count, cycles_per_sec = struct.unpack_from(
+            HEADER_FMT, data, offset
+        )
+        if magic != DUMP_MAGIC:
+            offset += 1
+            continue
+        if version != DUMP_VERSION or record_sz != struct.calcsize(RECORD_FMT):
+            sys.exit(f"Unsupported dump version {version} / record size {record_sz}")
+        offset += header_sz
+
+        prev_seq = None
+        prev_ts = None
+        elapsed = 0
+        for _ in range(count):
+            # Vidage abandonne par la carte (hote trop lent) ou capture
+            # coupee : on garde les enregistrements deja recus
+            if offset + record_sz > len(data):
+                print("--- dump truncated ---")
+                return
+            ts, arg, evt, seq = struct.unpack_from(RECORD_FMT, data, offset)
+            offset += record_sz
+
+            if prev_seq is not None and seq != (prev_seq + 1) & 0xFFFF:
+                print("--- records lost (overwritten during dump) ---")
+            prev_seq = seq
+
+            # Horodatage 32 bits : on accumule les ecarts pour passer les
+            # debordements du compteur
+            if prev_ts is None:
+                prev_ts = ts
+            elapsed += (ts - prev_ts) & 0xFFFFFFFF
+            prev_ts = ts
+
+            print(
+                f"{elapsed * 1e6 / cycles_per_sec:14.1f} us  "
+                f"{names.get(evt, f'EVT_{evt}'):<20} 0x{arg:08x} ({arg})"
+            )
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode un vidage de trace")
+    parser.add_argument("dump", help="fichier binaire capture sur le canal RTT")
+    parser.add_argument("--header", default=TRACE_H, help="chemin de trace.h")
+    args = parser.parse_args()
+
+    with open(args.dump, "rb") as f:
+        data = f.read()
+
+    decode(data, load_event_names(args.header))
+
+
+if __name__ == "__main__":
+    main()
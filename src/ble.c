@@ -18,11 +18,16 @@
 #include <zephyr.h>
 #include <zephyr/types.h>
 
+#include <errno.h>
+#include <string.h>
+#include <sys/util.h>
+
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/conn.h>
 #include <bluetooth/gatt.h>
 #include <bluetooth/hci.h>
 #include <bluetooth/uuid.h>
+#include <drivers/hwinfo.h>
 
 #include <settings/settings.h>
 
@@ -30,75 +35,94 @@
 
 #include <include/ble_uuid.h>
 #include <include/common.h>
+#include <include/deepsleep.h>
 #include <include/ble_service_config.h>
+#include <include/ble_beacon_trigger.h>
+#include <include/ble_service_diag.h>
+#include <include/ble_service_prov.h>
+#include <include/ble_service_user.h>
+#include <include/mesh.h>
+#include <include/trace.h>
+#include <include/watchdog.h>
 
 LOG_MODULE_REGISTER(esirem_quantum_main_ble, CONFIG_LOG_MAX_LEVEL);
 
-/* TODO: ajouter la fin du NS dans le nom BLE*/
 #define DEVICE_NAME     CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN (sizeof(DEVICE_NAME) - 1)
 
-static const struct bt_data ble_advert[] = {
+BUILD_ASSERT(
+    DEVICE_NAME_LEN + 1 + ESIREM_QUANTUM_MAIN_BLE_NAME_SUFFIX_MAX_LEN <= CONFIG_BT_DEVICE_NAME_MAX,
+    "CONFIG_BT_DEVICE_NAME_MAX too small for the name suffix");
+
+/* Le nom est remplace par bt_get_name() une fois le suffixe connu */
+#define BLE_ADVERT_NAME_IDX (1)
+
+static struct bt_data ble_advert[] = {
     BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
     BT_DATA(BT_DATA_NAME_COMPLETE, DEVICE_NAME, DEVICE_NAME_LEN),
 };
 
+static bool ble_name_suffix_set = false;
+
 static const struct bt_data ble_service_discovery[] = {
     BT_DATA_BYTES(
         BT_DATA_UUID128_ALL,
         ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE(ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG)),
 };
 
+static atomic_t ble_conn_count = ATOMIC_INIT(0);
+
+/*
+ * Les callbacks de connexion identifient le central par l'index de la
+ * connexion : aucune mise en forme de chaine (bt_addr_le_to_str) ni copie
+ * (log_strdup), compatible avec les logs dictionnaire. L'adresse n'est
+ * journalisee qu'une fois, a la connexion, en hexdump.
+ */
+
 static void connected(struct bt_conn* conn, uint8_t err)
 {
-    char str_peer_addr[BT_ADDR_LE_STR_LEN];
-
-    bt_addr_le_to_str(
-        bt_conn_get_dst(conn), str_peer_addr, sizeof(str_peer_addr));
+    ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_BLE_CONNECTED, err);
     if (err)
     {
-        LOG_ERR(
-            "Connection to peer %s failed (err %u)\n",
-            log_strdup(str_peer_addr), err);
+        LOG_ERR("Connection failed, err %u", err);
         return;
     }
 
+    atomic_inc(&ble_conn_count);
+
     // Sécurité level 2 : chiffrement sans authentification (fait par notre cle
     // libsodium avec fonctions maison)
     bt_conn_set_security(conn, BT_SECURITY_L2);
 
-    LOG_DBG("Connected to peer %s", log_strdup(str_peer_addr));
+    LOG_DBG("Connected, conn %u", bt_conn_index(conn));
+    LOG_HEXDUMP_DBG(bt_conn_get_dst(conn), sizeof(bt_addr_le_t), "Peer address");
     return;
 }
 
 static void disconnected(struct bt_conn* conn, uint8_t reason)
 {
-    char str_peer_addr[BT_ADDR_LE_STR_LEN];
-
-    bt_addr_le_to_str(
-        bt_conn_get_dst(conn), str_peer_addr, sizeof(str_peer_addr));
-    LOG_DBG(
-        "Disconnected from peer %s, reason %u\n", log_strdup(str_peer_addr),
-        reason);
+    ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_BLE_DISCONNECTED, reason);
+    esirem_quantum_main_ble_service_diag_disconnected(conn);
+    esirem_quantum_main_ble_service_user_disconnected(conn);
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_PROVISION)
+    esirem_quantum_main_ble_service_prov_disconnected(conn);
+#endif
+    atomic_dec(&ble_conn_count);
+    esirem_quantum_main_deepsleep_activity();
+    LOG_DBG("Disconnected, conn %u reason %u", bt_conn_index(conn), reason);
     return;
 }
 
 static void security_changed(
     struct bt_conn* conn, bt_security_t level, enum bt_security_err err)
 {
-    char addr[BT_ADDR_LE_STR_LEN];
-
-    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
-
     if (!err)
     {
-        LOG_DBG("Security changed: %s level %u\n", log_strdup(addr), level);
+        LOG_DBG("Security changed, conn %u level %u", bt_conn_index(conn), level);
     }
     else
     {
-        LOG_ERR(
-            "Security failed: %s level %u err %d\n", log_strdup(addr), level,
-            err);
+        LOG_ERR("Security failed, conn %u level %u err %d", bt_conn_index(conn), level, err);
     }
 }
 
@@ -110,31 +134,19 @@ static struct bt_conn_cb conn_callbacks = {
 
 static void pairing_confirm(struct bt_conn* conn)
 {
-    char addr[BT_ADDR_LE_STR_LEN];
-
-    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
-
     bt_conn_auth_pairing_confirm(conn);
 
-    LOG_DBG("Pairing confirmed: %s\n", log_strdup(addr));
+    LOG_DBG("Pairing confirmed, conn %u", bt_conn_index(conn));
 }
 
 static void pairing_complete(struct bt_conn* conn, bool bonded)
 {
-    char addr[BT_ADDR_LE_STR_LEN];
-
-    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
-
-    LOG_DBG("Pairing completed: %s, bonded: %d\n", log_strdup(addr), bonded);
+    LOG_DBG("Pairing completed, conn %u bonded %d", bt_conn_index(conn), bonded);
 }
 
 static void pairing_failed(struct bt_conn* conn, enum bt_security_err reason)
 {
-    char addr[BT_ADDR_LE_STR_LEN];
-
-    bt_addr_le_to_str(bt_conn_get_dst(conn), addr, sizeof(addr));
-
-    LOG_DBG("Pairing failed conn: %s, reason %d\n", log_strdup(addr), reason);
+    LOG_DBG("Pairing failed, conn %u reason %d", bt_conn_index(conn), reason);
 }
 
 static struct bt_conn_auth_cb conn_auth_callbacks = {
@@ -145,6 +157,91 @@ static struct bt_conn_auth_cb conn_auth_callbacks = {
     .pairing_failed   = pairing_failed,
 };
 
+int esirem_quantum_main_ble_set_name_suffix(const char* suffix, size_t len)
+{
+    char name[CONFIG_BT_DEVICE_NAME_MAX + 1];
+    int err;
+
+    if (!len || len > ESIREM_QUANTUM_MAIN_BLE_NAME_SUFFIX_MAX_LEN)
+    {
+        return -EINVAL;
+    }
+
+    snprintk(name, sizeof(name), DEVICE_NAME "-%.*s", (int) len, suffix);
+
+    /* bt_set_name ne sauvegarde bt/name que si le nom change */
+    err = bt_set_name(name);
+    if (err)
+    {
+        return err;
+    }
+    ble_name_suffix_set = true;
+
+    ble_advert[BLE_ADVERT_NAME_IDX].data     = (const uint8_t*) bt_get_name();
+    ble_advert[BLE_ADVERT_NAME_IDX].data_len = (uint8_t) strlen(bt_get_name());
+#if !defined(CONFIG_ESIREM_QUANTUM_MAIN_MESH)
+    /* -EAGAIN si l'advertising n'est pas encore demarre : sans effet */
+    bt_le_adv_update_data(
+        ble_advert, ARRAY_SIZE(ble_advert), ble_service_discovery,
+        ARRAY_SIZE(ble_service_discovery));
+#endif
+
+    return 0;
+}
+
+/* Carte non provisionnee : suffixe tire de l'identifiant du composant */
+static void ble_name_suffix_default(void)
+{
+#if defined(CONFIG_HWINFO)
+    uint8_t id[8];
+    char suffix[5];
+    ssize_t id_len;
+
+    id_len = hwinfo_get_device_id(id, sizeof(id));
+    if (id_len < 2)
+    {
+        LOG_ERR("Failed to get device id, err: %d", (int) id_len);
+        return;
+    }
+
+    bin2hex(&id[id_len - 2], 2, suffix, sizeof(suffix));
+    esirem_quantum_main_ble_set_name_suffix(suffix, sizeof(suffix) - 1);
+#endif
+}
+
+uint8_t esirem_quantum_main_ble_conn_count(void)
+{
+    return (uint8_t) atomic_get(&ble_conn_count);
+}
+
+int esirem_quantum_main_ble_adv_resume(void)
+{
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_MESH)
+    /* L'advertising (provisionnement / proxy) est gere par la pile mesh */
+    return esirem_quantum_main_mesh_start();
+#else
+    int err = bt_le_adv_start(
+        BT_LE_ADV_CONN, ble_advert, ARRAY_SIZE(ble_advert),
+        ble_service_discovery, ARRAY_SIZE(ble_service_discovery));
+    if (err)
+    {
+        LOG_ERR("Failed to start advertising, err: %d", err);
+        return err;
+    }
+    LOG_DBG("BLE advertising started");
+    return 0;
+#endif
+}
+
+int esirem_quantum_main_ble_adv_suspend(void)
+{
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_MESH)
+    return -ENOTSUP;
+#else
+    return bt_le_adv_stop();
+#endif
+}
+
 int ble_init(void)
 {
     int err;
@@ -155,22 +252,48 @@ int ble_init(void)
     err = bt_enable(NULL);
     if (err)
     {
-        LOG_ERR("Failed to init ble, err : %d\n", err);
+        LOG_ERR("Failed to init ble, err : %d", err);
         return err;
     }
-    LOG_DBG("BLE initialized\n");
+    LOG_DBG("BLE initialized");
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_MESH)
+    err = esirem_quantum_main_mesh_init();
+    if (err)
+    {
+        return err;
+    }
+#endif
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_PROVISION)
+    esirem_quantum_main_ble_service_prov_init();
+#endif
 
     settings_load();
+    if (!ble_name_suffix_set)
+    {
+        ble_name_suffix_default();
+    }
 
-    err = bt_le_adv_start(
-        BT_LE_ADV_CONN, ble_advert, ARRAY_SIZE(ble_advert),
-        ble_service_discovery, ARRAY_SIZE(ble_service_discovery));
+    err = esirem_quantum_main_ble_adv_resume();
+    if (err)
+    {
+        return err;
+    }
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER)
+    err = esirem_quantum_main_beacon_trigger_start();
+    if (err)
+    {
+        return err;
+    }
+#endif
+
+    err = esirem_quantum_main_watchdog_ble_start();
     if (err)
     {
-        LOG_ERR("Failed to start advertising, err: %d\n", err);
         return err;
     }
-    LOG_DBG("BLE advertising started\n");
 
     return 0;
 }
\ No newline at end of file
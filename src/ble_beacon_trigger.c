@@ -0,0 +1,378 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * ble_beacon_trigger.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Le device scanne en passif (role observer) en parallele de
+ * l'advertising connectable.
+ * - Chaque advertisement est filtre sur les donnees constructeur
+ * (company id + tag projet) avant tout calcul.
+ * - Le MAC est verifie avec la cle partagee, puis le compteur est compare
+ * au dernier compteur accepte.
+ * - La commande est executee directement depuis le callback de scan, sans
+ * connexion ni decouverte de services, tant que son compteur reste sous la
+ * borne sauvegardee.
+ * - Le scan ne tourne que si une cle valide est presente : il demarre quand
+ * une cle est provisionnee, s'arrete si elle est effacee.
+ * - Le compteur est sauvegarde par pas : la flash contient une borne
+ * (compteur accepte + CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_COUNTER_STEP)
+ * reecrite seulement quand un compteur l'atteint. Apres un redemarrage, le
+ * dernier compteur accepte repart de cette borne : les compteurs inferieurs
+ * sont refuses, l'emetteur doit sauter d'au moins un pas.
+ * - Un compteur qui atteint la borne n'est accepte qu'une fois la nouvelle
+ * borne en flash : la commande est passee a la file d'attente systeme, qui
+ * sauvegarde puis l'execute, ou l'abandonne si la sauvegarde echoue. Les
+ * beacons recus pendant la sauvegarde sont ignores.
+ */
+
+#include <include/ble_beacon_trigger.h>
+#include <include/cmac.h>
+#include <include/common.h>
+#include <include/core.h>
+#include <include/trace.h>
+
+#include <zephyr.h>
+#include <zephyr/types.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/byteorder.h>
+#include <sys/util.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/gap.h>
+#include <bluetooth/hci.h>
+
+#include <settings/settings.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_beacon_trigger, CONFIG_LOG_MAX_LEVEL);
+
+#define BEACON_SETTINGS_KEY_MODULE "esirem_quantum_main_beacon"
+#define BEACON_SETTINGS_KEY_KEY    "key"
+#define BEACON_SETTINGS_KEY_CTR    "ctr"
+
+/* Scan passif sans filtrage des doublons : le controleur filtre par
+ * adresse, ce qui masquerait les beacons successifs d'un meme emetteur */
+#define BEACON_SCAN_PARAM                                                      \
+    BT_LE_SCAN_PARAM(                                                          \
+        BT_LE_SCAN_TYPE_PASSIVE, BT_LE_SCAN_OPT_NONE,                          \
+        BT_GAP_SCAN_FAST_INTERVAL, BT_GAP_SCAN_FAST_WINDOW)
+
+static uint8_t beacon_key[ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_KEY_LEN];
+static bool beacon_key_valid = false;
+
+/**@brief Dernier compteur accepte, modifie depuis le thread RX ou, pendant
+ * une sauvegarde de borne, depuis la file d'attente systeme */
+static uint32_t beacon_last_counter = 0;
+/**@brief Borne sauvegardee en flash, superieure ou egale au dernier
+ * compteur accepte */
+static uint32_t beacon_counter_bound = 0;
+/**@brief Commande en attente de la sauvegarde de la borne, valide tant que
+ * beacon_counter_save_pending est vrai */
+static uint32_t beacon_pending_counter;
+static uint8_t beacon_pending_opcode;
+static atomic_t beacon_counter_save_pending = ATOMIC_INIT(0);
+
+/**@brief Vrai une fois la pile BLE prete (esirem_quantum_main_beacon_trigger_start) */
+static bool beacon_bt_ready = false;
+static bool beacon_scanning = false;
+
+static bool beacon_key_is_null(const uint8_t* key)
+{
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_KEY_LEN; i++)
+    {
+        if (key[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void beacon_execute(uint8_t opcode, uint32_t counter)
+{
+    int status;
+
+    ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_BEACON_RX, counter);
+
+    switch (opcode)
+    {
+        case ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_OPCODE_TRIG:
+            status = esirem_quantum_main_core_trig_new_cycle();
+            break;
+
+        case ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_OPCODE_STOP:
+            status = esirem_quantum_main_core_stop_cycle();
+            break;
+
+        default:
+            LOG_DBG("Unknown beacon opcode %u", opcode);
+            return;
+    }
+
+    if (status)
+    {
+        LOG_DBG("Beacon command %u refused, err: %d", opcode, status);
+    }
+}
+
+/* Sauvegarde la borne suivante puis execute la commande qui l'a atteinte */
+static void beacon_counter_save_work_fn(struct k_work* work)
+{
+    uint32_t counter = beacon_pending_counter;
+    uint32_t bound =
+        counter > UINT32_MAX - CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_COUNTER_STEP
+            ? UINT32_MAX
+            : counter + CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_COUNTER_STEP;
+    int status;
+
+    status = settings_save_one(
+        BEACON_SETTINGS_KEY_MODULE "/" BEACON_SETTINGS_KEY_CTR, &bound,
+        sizeof(bound));
+    if (status)
+    {
+        /* Commande abandonnee : sans borne en flash, elle serait rejouable
+         * apres un redemarrage */
+        LOG_ERR("Failed to save beacon counter, command dropped, err: %d", status);
+        atomic_clear(&beacon_counter_save_pending);
+        return;
+    }
+
+    atomic_set((atomic_t*) &beacon_counter_bound, (atomic_val_t) bound);
+    atomic_set((atomic_t*) &beacon_last_counter, (atomic_val_t) counter);
+    beacon_execute(beacon_pending_opcode, counter);
+    atomic_clear(&beacon_counter_save_pending);
+}
+
+static K_WORK_DEFINE(beacon_counter_save_work, beacon_counter_save_work_fn);
+
+void esirem_quantum_main_beacon_trigger_process(const uint8_t* data, uint8_t len)
+{
+    uint8_t mac[ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_MAC_LEN];
+    uint32_t counter;
+    uint8_t opcode;
+
+    if (len != ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_DATA_LEN
+        || sys_get_le16(&data[0])
+               != CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_COMPANY_ID
+        || sys_get_le16(&data[2]) != ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_TAG)
+    {
+        return;
+    }
+
+    opcode  = data[4];
+    counter = sys_get_le32(&data[5]);
+
+    /* Un meme beacon est recu plusieurs fois par evenement d'advertising :
+     * on ecarte les doublons avant le calcul du MAC. Pendant la sauvegarde
+     * d'une borne, le dernier compteur accepte n'est pas encore a jour */
+    if (counter <= (uint32_t) atomic_get((atomic_t*) &beacon_last_counter)
+        || atomic_get(&beacon_counter_save_pending))
+    {
+        return;
+    }
+
+    if (esirem_quantum_main_cmac_compute(
+            beacon_key, NULL, 0, data, ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_SIGNED_LEN, mac,
+            sizeof(mac)))
+    {
+        LOG_ERR("Failed to compute beacon MAC");
+        return;
+    }
+
+    if (!esirem_quantum_main_cmac_equal(
+            mac, &data[ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_SIGNED_LEN],
+            sizeof(mac)))
+    {
+        LOG_DBG("Invalid beacon MAC");
+        return;
+    }
+
+    if (counter >= (uint32_t) atomic_get((atomic_t*) &beacon_counter_bound))
+    {
+        /* Le compteur n'est accepte qu'apres la sauvegarde de la borne */
+        beacon_pending_counter = counter;
+        beacon_pending_opcode  = opcode;
+        atomic_set(&beacon_counter_save_pending, 1);
+        k_work_submit(&beacon_counter_save_work);
+        return;
+    }
+
+    atomic_set((atomic_t*) &beacon_last_counter, (atomic_val_t) counter);
+    beacon_execute(opcode, counter);
+}
+
+static bool beacon_ad_parse_cb(struct bt_data* ad, void* user_data)
+{
+    if (ad->type != BT_DATA_MANUFACTURER_DATA)
+    {
+        return true;
+    }
+
+    esirem_quantum_main_beacon_trigger_process(ad->data, ad->data_len);
+    return false;
+}
+
+static void beacon_scan_cb(
+    const bt_addr_le_t* addr, int8_t rssi, uint8_t adv_type,
+    struct net_buf_simple* buf)
+{
+    if (!beacon_key_valid)
+    {
+        return;
+    }
+
+    if (adv_type != BT_GAP_ADV_TYPE_ADV_NONCONN_IND
+        && adv_type != BT_GAP_ADV_TYPE_ADV_SCAN_IND)
+    {
+        return;
+    }
+
+    bt_data_parse(buf, beacon_ad_parse_cb, NULL);
+}
+
+/* Aligne le scan sur la presence d'une cle, depuis la file systeme : la
+ * cle peut changer depuis le thread RX BLE (provisionnement) */
+static void beacon_scan_update_work_fn(struct k_work* work)
+{
+    int err;
+
+    if (beacon_key_valid && !beacon_scanning)
+    {
+        err = bt_le_scan_start(BEACON_SCAN_PARAM, beacon_scan_cb);
+        if (err)
+        {
+            LOG_ERR("Failed to start beacon scan, err: %d", err);
+            return;
+        }
+        beacon_scanning = true;
+        LOG_DBG("Beacon scan started");
+    }
+    else if (!beacon_key_valid && beacon_scanning)
+    {
+        err = bt_le_scan_stop();
+        if (err)
+        {
+            LOG_ERR("Failed to stop beacon scan, err: %d", err);
+            return;
+        }
+        beacon_scanning = false;
+        LOG_DBG("Beacon scan stopped");
+    }
+}
+
+static K_WORK_DEFINE(beacon_scan_update_work, beacon_scan_update_work_fn);
+
+/* A appeler apres bt_enable et settings_load */
+int esirem_quantum_main_beacon_trigger_start(void)
+{
+    if (!beacon_key_valid)
+    {
+        if (hex2bin(
+                CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_DEFAULT_KEY,
+                sizeof(CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_DEFAULT_KEY)
+                    - 1,
+                beacon_key, sizeof(beacon_key))
+            == sizeof(beacon_key))
+        {
+            beacon_key_valid = !beacon_key_is_null(beacon_key);
+        }
+    }
+
+    beacon_bt_ready = true;
+    if (!beacon_key_valid)
+    {
+        /* Pas de scan inutile : il demarrera au provisionnement de la cle */
+        LOG_INF("No beacon key provisioned, beacon scan off");
+        return 0;
+    }
+
+    k_work_submit(&beacon_scan_update_work);
+    return 0;
+}
+
+void esirem_quantum_main_beacon_trigger_set_key(const uint8_t* key)
+{
+    memcpy(beacon_key, key, sizeof(beacon_key));
+    beacon_key_valid = !beacon_key_is_null(beacon_key);
+    if (beacon_bt_ready)
+    {
+        k_work_submit(&beacon_scan_update_work);
+    }
+}
+
+/*
+ * Gestion des parametres : cle partagee et dernier compteur accepte
+ */
+
+static int beacon_settings_set(
+    const char* name, size_t len, settings_read_cb read_cb, void* cb_arg)
+{
+    const char* next;
+    int status;
+
+    if (settings_name_steq(name, BEACON_SETTINGS_KEY_KEY, &next) && !next)
+    {
+        uint8_t key[ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_KEY_LEN];
+
+        if (len != sizeof(key))
+        {
+            LOG_ERR("Invalid size");
+            return -EINVAL;
+        }
+
+        status = read_cb(cb_arg, key, sizeof(key));
+        if (status < 0)
+        {
+            LOG_ERR("Failed to read settings value");
+            return status;
+        }
+
+        memcpy(beacon_key, key, sizeof(beacon_key));
+        beacon_key_valid = !beacon_key_is_null(beacon_key);
+        return 0;
+    }
+
+    if (settings_name_steq(name, BEACON_SETTINGS_KEY_CTR, &next) && !next)
+    {
+        uint32_t counter = 0;
+
+        if (len != sizeof(counter))
+        {
+            LOG_ERR("Invalid size");
+            return -EINVAL;
+        }
+
+        status = read_cb(cb_arg, &counter, sizeof(counter));
+        if (status < 0)
+        {
+            LOG_ERR("Failed to read settings value");
+            return status;
+        }
+
+        /* Saut a la borne sauvegardee : les compteurs acceptes depuis la
+         * derniere sauvegarde sont refuses */
+        atomic_set((atomic_t*) &beacon_last_counter, (atomic_val_t) counter);
+        atomic_set((atomic_t*) &beacon_counter_bound, (atomic_val_t) counter);
+        return 0;
+    }
+
+    return -ENOENT;
+}
+
+struct settings_handler esirem_quantum_main_beacon_trigger_settings_hdlrs = {
+    .name  = BEACON_SETTINGS_KEY_MODULE,
+    .h_set = beacon_settings_set,
+};
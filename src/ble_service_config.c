@@ -17,10 +17,16 @@
 #include <include/common.h>
 #include <include/ble_service_config.h>
 #include <include/core.h>
+#include <include/eventlog.h>
+#include <include/odometer.h>
+#include <include/trace.h>
+#include <include/traffic.h>
 
+#include <zephyr.h>
 #include <zephyr/types.h>
 
 #include <errno.h>
+#include <sys/byteorder.h>
 
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/conn.h>
@@ -54,117 +60,256 @@ const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_to
     BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
         ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG,
         ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_TOFF_MS));
+const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_current_ua =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG,
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_CURRENT_UA));
+const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_intensity_pct =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG,
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_INTENSITY_PCT));
+const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_fade_in_ms =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG,
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_FADE_IN_MS));
+const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_fade_out_ms =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG,
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_FADE_OUT_MS));
+const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_led_seq_mode =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG,
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_LED_SEQ_MODE));
+const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_all =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG,
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_ALL));
+const struct bt_uuid_128 esirem_quantum_main_ble_uuid_service_config_chrc_generation =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG,
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_CONFIG_CHRC_GENERATION));
+
+/* Chaque caracteristique porte en user_data son entree de la table des
+ * parametres : ni recherche par UUID ni passage par les settings en lecture */
+#define SERVICE_CONFIG_CHRC_MAP(_index)                                        \
+    ((void*) &esirem_quantum_main_core_setting_map_uuid_keyptr[_index])
+
+static const uint8_t service_config_check_att_err[] = {
+    [ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK]           = 0,
+    [ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OUT_OF_RANGE] = BT_ATT_ERR_OUT_OF_RANGE,
+    [ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_PERIOD_TOO_SHORT] =
+        ESIREM_QUANTUM_MAIN_SERVICE_CONFIG_ATT_ERR_PERIOD_TOO_SHORT,
+    [ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_SEQ_TOO_SHORT] =
+        ESIREM_QUANTUM_MAIN_SERVICE_CONFIG_ATT_ERR_SEQ_TOO_SHORT,
+    [ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_TOO_MANY_PERIODS] =
+        ESIREM_QUANTUM_MAIN_SERVICE_CONFIG_ATT_ERR_TOO_MANY_PERIODS,
+    [ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_NOT_DIVISIBLE] =
+        ESIREM_QUANTUM_MAIN_SERVICE_CONFIG_ATT_ERR_NOT_DIVISIBLE,
+};
 
-static int service_config_get_attr_map_uuid_keyptr(
-    const struct bt_gatt_attr* attr,
-    const struct esirem_quantum_main_core_setting_map_uuid_keyptr** match_uuid_keyptr)
+BUILD_ASSERT(ARRAY_SIZE(service_config_check_att_err) == ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_COUNT);
+
+static ssize_t service_config_write_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, const void* buf,
+    uint16_t len, uint16_t offset, uint8_t flags)
 {
-    if (!attr || !match_uuid_keyptr)
+    enum esirem_quantum_main_core_setting_check_result result;
+    int status = 0;
+
+    LOG_DBG("Write config value");
+    esirem_quantum_main_traffic_count(ESIREM_QUANTUM_MAIN_TRAFFIC_COMMANDS);
+    ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_BLE_CONFIG_WRITE, len);
+    if (offset)
     {
-        return -EINVAL;
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
     }
 
-    *match_uuid_keyptr = NULL;
-    uint32_t size      = esirem_quantum_main_core_setting_get_map_uuid_keyptr_size();
-    for (uint8_t i = 0; i < size; i++)
+    if (len != sizeof(uint32_t))
     {
-        if (!bt_uuid_cmp(esirem_quantum_main_core_setting_map_uuid_keyptr[i].uuid, attr->uuid))
-        {
-            *match_uuid_keyptr = &esirem_quantum_main_core_setting_map_uuid_keyptr[i];
-            return 0;
-        }
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
     }
 
-    LOG_ERR("UUID attr not found");
-    return -EINVAL;
-}
+    LOG_DBG(
+        "Received write request for setting %u",
+        (uint32_t) ((const struct esirem_quantum_main_core_setting_map_uuid_keyptr*) attr->user_data
+                    - esirem_quantum_main_core_setting_map_uuid_keyptr));
 
-static int service_config_get_full_key_name_from_attr(
-    const struct bt_gatt_attr* attr, char* setting_full_key,
-    size_t setting_full_key_sz)
-{
-    const struct esirem_quantum_main_core_setting_map_uuid_keyptr* map_uuid_keyptr = NULL;
-    int status                                                     = 0;
-
-    status = service_config_get_attr_map_uuid_keyptr(attr, &map_uuid_keyptr);
-    if (status)
+    /* Meme chemin que l'ecriture de tous les parametres : sauvegarde en
+     * flash avant publication, rien n'est publie si elle echoue */
+    status = esirem_quantum_main_core_setting_store(attr->user_data, sys_get_le32(buf), &result);
+    if (result != ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK)
     {
-        LOG_ERR("Failed to get settings map_uuid_keyptr for attr");
-        return status;
+        LOG_DBG("Config value refused, rule %u", result);
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(service_config_check_att_err[result]);
     }
-    status = esirem_quantum_main_core_setting_get_full_key(
-        map_uuid_keyptr, setting_full_key, setting_full_key_sz);
     if (status)
     {
-        LOG_ERR("Failed to get full key name for attr");
-        return status;
+        LOG_ERR("Failed to save settings to flash, err: %d", status);
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_UNLIKELY);
     }
-    return 0;
+    esirem_quantum_main_odometer_add(ESIREM_QUANTUM_MAIN_ODOMETER_CONFIG_WRITES, 1);
+    esirem_quantum_main_eventlog_add(
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_CONFIG_WRITE, sys_get_le32(buf));
+
+    return len;
 }
 
-static ssize_t service_config_write_cb(
+static ssize_t service_config_read_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, void* buf,
+    uint16_t len, uint16_t offset)
+{
+    uint8_t value[sizeof(uint32_t)];
+
+    LOG_DBG("Read config value");
+    ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_BLE_CONFIG_READ, offset);
+    sys_put_le32(esirem_quantum_main_core_setting_get(attr->user_data), value);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+
+/* Ecriture de tous les parametres en une fois : seul moyen de passer d'un
+ * jeu de durees valide a un autre quand chaque etape intermediaire enfreint
+ * une regle entre parametres */
+static ssize_t service_config_all_write_cb(
     struct bt_conn* conn, const struct bt_gatt_attr* attr, const void* buf,
     uint16_t len, uint16_t offset, uint8_t flags)
 {
-    char settings_key_str[ESIREM_QUANTUM_MAIN_CORE_SETTINGS_KEY_STR_MAX_LEN];
-    int status = 0;
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    enum esirem_quantum_main_core_setting_check_result result;
+    int status;
 
-    LOG_DBG("Write config value");
-    status = service_config_get_full_key_name_from_attr(
-        attr, settings_key_str, sizeof(settings_key_str));
-    if (status)
+    LOG_DBG("Write all config values");
+    esirem_quantum_main_traffic_count(ESIREM_QUANTUM_MAIN_TRAFFIC_COMMANDS);
+    ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_BLE_CONFIG_WRITE, len);
+    if (offset)
     {
-        return status;
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
     }
-    LOG_DBG("Received write request for %s", log_strdup(settings_key_str));
 
-    status = settings_runtime_set(settings_key_str, buf, sizeof(uint32_t));
-    if (status)
+    if (len != sizeof(values))
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        values[i] = sys_get_le32(&((const uint8_t*) buf)[i * sizeof(uint32_t)]);
+    }
+
+    /* Sauvegarde en flash avant publication : en cas d'echec les valeurs
+     * en vigueur restent celles stockees */
+    status = esirem_quantum_main_core_settings_store(values, &result, NULL, NULL);
+    if (result != ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK)
     {
-        LOG_ERR("Failed to write settings, err: %d", status);
-        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+        LOG_DBG("Config values refused, rule %u", result);
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(service_config_check_att_err[result]);
     }
-    status = settings_save_one(settings_key_str, buf, sizeof(uint32_t));
     if (status)
     {
         LOG_ERR("Failed to save settings to flash, err: %d", status);
-        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_UNLIKELY);
     }
+    esirem_quantum_main_odometer_add(ESIREM_QUANTUM_MAIN_ODOMETER_CONFIG_WRITES, 1);
+    esirem_quantum_main_eventlog_add(
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_CONFIG_WRITE,
+        esirem_quantum_main_core_setting_get_generation());
 
     return len;
 }
 
-static ssize_t service_config_read_cb(
+/* Tous les parametres dans l'ordre de la table (4 octets chacun) : une
+ * seule requete apres chaque reconnexion si l'ATT_MTU le permet */
+static ssize_t service_config_all_read_cb(
     struct bt_conn* conn, const struct bt_gatt_attr* attr, void* buf,
     uint16_t len, uint16_t offset)
 {
-    char settings_key_str[ESIREM_QUANTUM_MAIN_CORE_SETTINGS_KEY_STR_MAX_LEN];
-    int status       = 0;
-    ssize_t data_len = 0;
+    uint8_t value[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT * sizeof(uint32_t)];
 
-    LOG_DBG("Read config value");
-    status = service_config_get_full_key_name_from_attr(
-        attr, settings_key_str, sizeof(settings_key_str));
-    if (status)
+    LOG_DBG("Read all config values");
+    ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_BLE_CONFIG_READ, offset);
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        sys_put_le32(
+            esirem_quantum_main_core_setting_get(&esirem_quantum_main_core_setting_map_uuid_keyptr[i]),
+            &value[i * sizeof(uint32_t)]);
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+
+/*
+ * Generation de la configuration : le central met les parametres en cache
+ * avec la generation lue, puis ne relit les parametres (caracteristique
+ * "tous les parametres") que si la generation a change, a la reconnexion ou
+ * sur notification. La notification part de la file systeme : le changement
+ * est applique depuis le thread RX BLE ou pendant le chargement des settings.
+ */
+
+/* Service, 4 attributs par parametre (declaration, valeur, CUD, CPF), puis
+ * les 3 attributs de "tous les parametres" (declaration, valeur, CUD) :
+ * index de la declaration. Verifie apres la declaration du service. */
+#define SERVICE_CONFIG_ATTR_GENERATION (1 + ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT * 4 + 3)
+
+static bool service_config_generation_notification_enabled = false;
+
+static void service_config_generation_work_fn(struct k_work* work);
+static K_WORK_DEFINE(service_config_generation_work, service_config_generation_work_fn);
+
+static void service_config_generation_work_fn(struct k_work* work)
+{
+    uint8_t value[sizeof(uint32_t)];
+    int err;
+
+    sys_put_le32(esirem_quantum_main_core_setting_get_generation(), value);
+    err = bt_gatt_notify(
+        NULL, &esirem_quantum_main_service_config.attrs[SERVICE_CONFIG_ATTR_GENERATION], value,
+        sizeof(value));
+    esirem_quantum_main_traffic_notify_result(err);
+    if (err)
     {
-        return BT_GATT_ERR(BT_ATT_ERR_NOT_SUPPORTED);
+        LOG_ERR("Failed to send config generation, err: %d", err);
     }
-    LOG_DBG("Received read request for %s", log_strdup(settings_key_str));
+}
 
-    data_len = settings_runtime_get(settings_key_str, buf, len);
-    if (data_len < 0)
+void esirem_quantum_main_ble_service_config_generation_notify(uint32_t generation)
+{
+    LOG_DBG("Config generation %u", generation);
+    if (service_config_generation_notification_enabled)
     {
-        LOG_ERR("Failed to read settings, err: %d", data_len);
-        return BT_GATT_ERR(BT_ATT_ERR_NOT_SUPPORTED);
+        k_work_submit(&service_config_generation_work);
     }
+}
 
-    return data_len;
+static ssize_t service_config_generation_read_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, void* buf,
+    uint16_t len, uint16_t offset)
+{
+    uint8_t value[sizeof(uint32_t)];
+
+    LOG_DBG("Read config generation");
+    sys_put_le32(esirem_quantum_main_core_setting_get_generation(), value);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+
+static void
+service_config_generation_ccc_cfg_changed(const struct bt_gatt_attr* attr, uint16_t value)
+{
+    LOG_DBG("Generation CCC config changed: %hx", value);
+    service_config_generation_notification_enabled = (value == BT_GATT_CCC_NOTIFY);
 }
 
 static const char service_config_chrc_led_seq_duration_ms_cud_str[] =
     "Durée total séquence LED (ms)";
 static const char service_config_chrc_led_ton_ms_cud_str[]  = "Ton LED (ms)";
 static const char service_config_chrc_led_toff_ms_cud_str[] = "Toff LED (ms)";
+static const char service_config_chrc_led_current_ua_cud_str[] = "Courant LED (uA)";
+static const char service_config_chrc_led_intensity_pct_cud_str[] = "Intensité LED (%)";
+static const char service_config_chrc_led_fade_in_ms_cud_str[]  = "Rampe allumage LED (ms)";
+static const char service_config_chrc_led_fade_out_ms_cud_str[] = "Rampe extinction LED (ms)";
+static const char service_config_chrc_led_seq_mode_cud_str[] = "Mode séquence";
+static const char service_config_chrc_all_cud_str[] = "Tous les paramètres";
+static const char service_config_chrc_generation_cud_str[] = "Génération config";
 
 static const struct bt_gatt_cpf chrc_cpf = {
     .format      = 0x08, /* uint32 */
@@ -182,7 +327,8 @@ BT_GATT_SERVICE_DEFINE(
         (struct bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_seq_duration_ms,
         BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
         BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, service_config_read_cb,
-        service_config_write_cb, NULL),
+        service_config_write_cb,
+        SERVICE_CONFIG_CHRC_MAP(ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS)),
     BT_GATT_CUD(
         service_config_chrc_led_seq_duration_ms_cud_str, BT_GATT_PERM_READ),
     BT_GATT_CPF(&chrc_cpf),
@@ -190,13 +336,72 @@ BT_GATT_SERVICE_DEFINE(
         (struct bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_ton_ms,
         BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
         BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, service_config_read_cb,
-        service_config_write_cb, NULL),
+        service_config_write_cb,
+        SERVICE_CONFIG_CHRC_MAP(ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS)),
     BT_GATT_CUD(service_config_chrc_led_ton_ms_cud_str, BT_GATT_PERM_READ),
     BT_GATT_CPF(&chrc_cpf),
     BT_GATT_CHARACTERISTIC(
         (struct bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_toff_ms,
         BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
         BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, service_config_read_cb,
-        service_config_write_cb, NULL),
+        service_config_write_cb,
+        SERVICE_CONFIG_CHRC_MAP(ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS)),
     BT_GATT_CUD(service_config_chrc_led_toff_ms_cud_str, BT_GATT_PERM_READ),
-    BT_GATT_CPF(&chrc_cpf),);
+    BT_GATT_CPF(&chrc_cpf),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_current_ua,
+        BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+        BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, service_config_read_cb,
+        service_config_write_cb,
+        SERVICE_CONFIG_CHRC_MAP(ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_CURRENT_UA)),
+    BT_GATT_CUD(service_config_chrc_led_current_ua_cud_str, BT_GATT_PERM_READ),
+    BT_GATT_CPF(&chrc_cpf),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_intensity_pct,
+        BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+        BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, service_config_read_cb,
+        service_config_write_cb,
+        SERVICE_CONFIG_CHRC_MAP(ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT)),
+    BT_GATT_CUD(service_config_chrc_led_intensity_pct_cud_str, BT_GATT_PERM_READ),
+    BT_GATT_CPF(&chrc_cpf),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_fade_in_ms,
+        BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+        BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, service_config_read_cb,
+        service_config_write_cb,
+        SERVICE_CONFIG_CHRC_MAP(ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_FADE_IN_MS)),
+    BT_GATT_CUD(service_config_chrc_led_fade_in_ms_cud_str, BT_GATT_PERM_READ),
+    BT_GATT_CPF(&chrc_cpf),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_fade_out_ms,
+        BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+        BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, service_config_read_cb,
+        service_config_write_cb,
+        SERVICE_CONFIG_CHRC_MAP(ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_FADE_OUT_MS)),
+    BT_GATT_CUD(service_config_chrc_led_fade_out_ms_cud_str, BT_GATT_PERM_READ),
+    BT_GATT_CPF(&chrc_cpf),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_seq_mode,
+        BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+        BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, service_config_read_cb,
+        service_config_write_cb,
+        SERVICE_CONFIG_CHRC_MAP(ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_MODE)),
+    BT_GATT_CUD(service_config_chrc_led_seq_mode_cud_str, BT_GATT_PERM_READ),
+    BT_GATT_CPF(&chrc_cpf),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_all,
+        BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE,
+        service_config_all_read_cb, service_config_all_write_cb, NULL),
+    BT_GATT_CUD(service_config_chrc_all_cud_str, BT_GATT_PERM_READ),
+    /* Index SERVICE_CONFIG_ATTR_GENERATION */
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_generation,
+        BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY, BT_GATT_PERM_READ,
+        service_config_generation_read_cb, NULL, NULL),
+    BT_GATT_CUD(service_config_chrc_generation_cud_str, BT_GATT_PERM_READ),
+    BT_GATT_CCC(
+        service_config_generation_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),);
+
+/* La generation (declaration, valeur, CUD, CCC) termine le service */
+BUILD_ASSERT(
+    SERVICE_CONFIG_ATTR_GENERATION + 4 == ARRAY_SIZE(attr_esirem_quantum_main_service_config));
@@ -0,0 +1,519 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * ble_service_diag.c - 07/12/2021
+ * Donne acces aux mesures de fonctionnement du dispositif
+ */
+
+#include <include/ble_uuid.h>
+#include <include/ble_service_diag.h>
+#include <include/common.h>
+#include <include/eventlog.h>
+#include <include/latency.h>
+#include <include/memstat.h>
+#include <include/odometer.h>
+#include <include/stats.h>
+#include <include/traffic.h>
+
+#include <zephyr/types.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/byteorder.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+#include <bluetooth/gatt.h>
+#include <bluetooth/hci.h>
+#include <bluetooth/uuid.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_service_diag, CONFIG_LOG_MAX_LEVEL);
+
+/*
+ * Les mesures sont serialisees a chaque lecture. Une valeur plus longue que
+ * l'ATT_MTU est lue en plusieurs requetes (read blob) : la valeur est alors
+ * reconstruite a chaque requete et peut evoluer entre deux morceaux.
+ */
+
+#define SERVICE_DIAG_LATENCY_HIST_LEN                                          \
+    ((2 + ESIREM_QUANTUM_MAIN_LATENCY_BUCKET_COUNT) * sizeof(uint32_t))
+#define SERVICE_DIAG_LATENCY_LEN                                               \
+    (ESIREM_QUANTUM_MAIN_LATENCY_PROBE_COUNT * SERVICE_DIAG_LATENCY_HIST_LEN)
+
+static ssize_t service_diag_latency_read_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, void* buf,
+    uint16_t len, uint16_t offset)
+{
+    struct esirem_quantum_main_latency_hist hist;
+    uint8_t value[SERVICE_DIAG_LATENCY_LEN];
+    uint8_t* ptr = value;
+
+    LOG_DBG("Read latency histograms");
+    for (uint8_t probe = 0; probe < ESIREM_QUANTUM_MAIN_LATENCY_PROBE_COUNT; probe++)
+    {
+        esirem_quantum_main_latency_get(probe, &hist);
+
+        sys_put_le32(hist.count, ptr);
+        ptr += sizeof(uint32_t);
+        sys_put_le32(hist.max_us, ptr);
+        ptr += sizeof(uint32_t);
+        for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_LATENCY_BUCKET_COUNT; i++)
+        {
+            sys_put_le32(hist.buckets[i], ptr);
+            ptr += sizeof(uint32_t);
+        }
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+
+#define SERVICE_DIAG_STATS_LEN                                                 \
+    (ESIREM_QUANTUM_MAIN_STATS_STATE_COUNT * sizeof(uint64_t)                  \
+     + ESIREM_QUANTUM_MAIN_STATS_COUNTER_COUNT * sizeof(uint32_t)              \
+     + sizeof(uint64_t))
+
+static ssize_t service_diag_stats_read_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, void* buf,
+    uint16_t len, uint16_t offset)
+{
+    struct esirem_quantum_main_stats stats;
+    uint8_t value[SERVICE_DIAG_STATS_LEN];
+    uint8_t* ptr = value;
+
+    LOG_DBG("Read stats");
+    esirem_quantum_main_stats_get(&stats);
+
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_STATS_STATE_COUNT; i++)
+    {
+        sys_put_le64(stats.counters.residency_ms[i], ptr);
+        ptr += sizeof(uint64_t);
+    }
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_STATS_COUNTER_COUNT; i++)
+    {
+        sys_put_le32(stats.counters.counters[i], ptr);
+        ptr += sizeof(uint32_t);
+    }
+    sys_put_le64(stats.led_energy_uj, ptr);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+
+static ssize_t service_diag_odometer_read_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, void* buf,
+    uint16_t len, uint16_t offset)
+{
+    struct esirem_quantum_main_odometer odometer;
+    uint8_t value[ESIREM_QUANTUM_MAIN_ODOMETER_COUNT * sizeof(uint64_t)];
+
+    LOG_DBG("Read odometer");
+    esirem_quantum_main_odometer_get(&odometer);
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_ODOMETER_COUNT; i++)
+    {
+        sys_put_le64(odometer.counters[i], &value[i * sizeof(uint64_t)]);
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+
+#define SERVICE_DIAG_TRAFFIC_LEN                                               \
+    ((ESIREM_QUANTUM_MAIN_TRAFFIC_COUNTER_COUNT + 2) * sizeof(uint32_t))
+
+static ssize_t service_diag_traffic_read_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, void* buf,
+    uint16_t len, uint16_t offset)
+{
+    struct esirem_quantum_main_traffic traffic;
+    uint8_t value[SERVICE_DIAG_TRAFFIC_LEN];
+    uint8_t* ptr = value;
+
+    LOG_DBG("Read traffic");
+    esirem_quantum_main_traffic_get(&traffic);
+
+    sys_put_le32(traffic.commands_per_s, ptr);
+    ptr += sizeof(uint32_t);
+    sys_put_le32(traffic.commands_per_s_max, ptr);
+    ptr += sizeof(uint32_t);
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_TRAFFIC_COUNTER_COUNT; i++)
+    {
+        sys_put_le32(traffic.counters[i], ptr);
+        ptr += sizeof(uint32_t);
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG)
+/*
+ * Lecture du journal : le central lit la plage disponible, s'abonne aux
+ * notifications puis ecrit le numero de sequence de depart. Les
+ * enregistrements sont envoyes en continu, plusieurs par notification selon
+ * l'ATT_MTU, avec quelques notifications en vol pour remplir chaque
+ * evenement de connexion. Le flux s'arrete sur le dernier enregistrement
+ * present en flash ; apres une deconnexion, le central reprend a partir du
+ * dernier numero recu.
+ */
+
+/* Service et 5 caracteristiques fixes (declaration, valeur, CUD) : index de
+ * la declaration. Verifie apres la declaration du service. */
+#define SERVICE_DIAG_ATTR_EVENTLOG         (1 + 5 * 3)
+#define SERVICE_DIAG_EVENTLOG_IN_FLIGHT    (3)
+#define SERVICE_DIAG_EVENTLOG_MAX_RECORDS  (15)
+#define SERVICE_DIAG_EVENTLOG_RETRY_MS     (20)
+
+extern const struct bt_gatt_service_static esirem_quantum_main_service_diag;
+
+static struct bt_conn* service_diag_eventlog_conn = NULL;
+static uint32_t service_diag_eventlog_seq         = 0;
+static atomic_t service_diag_eventlog_in_flight   = ATOMIC_INIT(0);
+static K_MUTEX_DEFINE(service_diag_eventlog_mutex);
+
+static void service_diag_eventlog_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(service_diag_eventlog_work, service_diag_eventlog_work_fn);
+
+/* A appeler mutex pris */
+static void service_diag_eventlog_stop(void)
+{
+    if (service_diag_eventlog_conn)
+    {
+        bt_conn_unref(service_diag_eventlog_conn);
+        service_diag_eventlog_conn = NULL;
+    }
+    atomic_set(&service_diag_eventlog_in_flight, 0);
+}
+
+static void service_diag_eventlog_sent_cb(struct bt_conn* conn, void* user_data)
+{
+    atomic_dec(&service_diag_eventlog_in_flight);
+    k_work_reschedule(&service_diag_eventlog_work, K_NO_WAIT);
+}
+
+static void service_diag_eventlog_work_fn(struct k_work* work)
+{
+    struct esirem_quantum_main_eventlog_record records[SERVICE_DIAG_EVENTLOG_MAX_RECORDS];
+    struct bt_gatt_notify_params params = {
+        .attr = &esirem_quantum_main_service_diag.attrs[SERVICE_DIAG_ATTR_EVENTLOG],
+        .data = records,
+        .func = service_diag_eventlog_sent_cb,
+    };
+    uint32_t oldest;
+    uint32_t next;
+    size_t max_count;
+    int count;
+    int err;
+
+    k_mutex_lock(&service_diag_eventlog_mutex, K_FOREVER);
+    if (!service_diag_eventlog_conn)
+    {
+        goto out;
+    }
+
+    max_count = MIN(
+        (bt_gatt_get_mtu(service_diag_eventlog_conn) - 3)
+            / sizeof(struct esirem_quantum_main_eventlog_record),
+        ARRAY_SIZE(records));
+
+    while (atomic_get(&service_diag_eventlog_in_flight) < SERVICE_DIAG_EVENTLOG_IN_FLIGHT)
+    {
+        count = esirem_quantum_main_eventlog_read(
+            service_diag_eventlog_seq, records, max_count);
+        if (count == -ENOENT)
+        {
+            /* Enregistrements ecrases depuis la demande : on saute au plus
+             * ancien encore present */
+            esirem_quantum_main_eventlog_get_range(&oldest, &next);
+            service_diag_eventlog_seq = oldest;
+            continue;
+        }
+
+        if (count <= 0)
+        {
+            if (atomic_get(&service_diag_eventlog_in_flight) == 0)
+            {
+                LOG_DBG("Event log stream done at %u", service_diag_eventlog_seq);
+                service_diag_eventlog_stop();
+            }
+            goto out;
+        }
+
+        params.len = count * sizeof(struct esirem_quantum_main_eventlog_record);
+        atomic_inc(&service_diag_eventlog_in_flight);
+        err = bt_gatt_notify_cb(service_diag_eventlog_conn, &params);
+        if (err == -ENOMEM)
+        {
+            /* Plus de buffer : reprise a la fin d'une notification en vol */
+            if (atomic_dec(&service_diag_eventlog_in_flight) == 1)
+            {
+                k_work_reschedule(
+                    &service_diag_eventlog_work, K_MSEC(SERVICE_DIAG_EVENTLOG_RETRY_MS));
+            }
+            goto out;
+        }
+        esirem_quantum_main_traffic_notify_result(err);
+        if (err)
+        {
+            LOG_DBG("Event log stream aborted, err: %d", err);
+            service_diag_eventlog_stop();
+            goto out;
+        }
+
+        service_diag_eventlog_seq += count;
+    }
+
+out:
+    k_mutex_unlock(&service_diag_eventlog_mutex);
+}
+
+static ssize_t service_diag_eventlog_read_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, void* buf,
+    uint16_t len, uint16_t offset)
+{
+    uint8_t value[3 * sizeof(uint32_t)];
+    uint32_t oldest;
+    uint32_t next;
+
+    LOG_DBG("Read event log range");
+    esirem_quantum_main_eventlog_get_range(&oldest, &next);
+    sys_put_le32(oldest, &value[0]);
+    sys_put_le32(next, &value[4]);
+    sys_put_le32(esirem_quantum_main_eventlog_get_dropped(), &value[8]);
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+
+static ssize_t service_diag_eventlog_write_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, const void* buf,
+    uint16_t len, uint16_t offset, uint8_t flags)
+{
+    LOG_DBG("Write event log start");
+    if (offset)
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    if (len != sizeof(uint32_t))
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    if (!bt_gatt_is_subscribed(conn, attr, BT_GATT_CCC_NOTIFY))
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_CCC_IMPROPER_CONF);
+    }
+
+    k_mutex_lock(&service_diag_eventlog_mutex, K_FOREVER);
+    if (service_diag_eventlog_conn && service_diag_eventlog_conn != conn)
+    {
+        k_mutex_unlock(&service_diag_eventlog_mutex);
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
+    }
+
+    if (!service_diag_eventlog_conn)
+    {
+        service_diag_eventlog_conn = bt_conn_ref(conn);
+    }
+    service_diag_eventlog_seq = sys_get_le32(buf);
+    k_mutex_unlock(&service_diag_eventlog_mutex);
+
+    /* Les evenements encore en RAM seront lus par la demande suivante */
+    esirem_quantum_main_eventlog_flush();
+    k_work_reschedule(&service_diag_eventlog_work, K_NO_WAIT);
+
+    return len;
+}
+
+static void service_diag_eventlog_ccc_cfg_changed(const struct bt_gatt_attr* attr, uint16_t value)
+{
+    LOG_DBG("Event log notifications %s", value == BT_GATT_CCC_NOTIFY ? "enabled" : "disabled");
+}
+#endif // CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG
+
+void esirem_quantum_main_ble_service_diag_disconnected(struct bt_conn* conn)
+{
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG)
+    k_mutex_lock(&service_diag_eventlog_mutex, K_FOREVER);
+    if (service_diag_eventlog_conn == conn)
+    {
+        service_diag_eventlog_stop();
+    }
+    k_mutex_unlock(&service_diag_eventlog_mutex);
+#endif
+}
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT)
+#define SERVICE_DIAG_MEMORY_STACK_LEN                                          \
+    (ESIREM_QUANTUM_MAIN_MEMSTAT_NAME_LEN + 2 * sizeof(uint32_t))
+#define SERVICE_DIAG_MEMORY_LEN                                                \
+    (3 * sizeof(uint32_t) + sizeof(uint8_t)                                    \
+     + CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT_MAX_THREADS * SERVICE_DIAG_MEMORY_STACK_LEN)
+
+static ssize_t service_diag_memory_read_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, void* buf,
+    uint16_t len, uint16_t offset)
+{
+    struct esirem_quantum_main_memstat_stack stacks[CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT_MAX_THREADS];
+    struct esirem_quantum_main_memstat_heap heap;
+    uint8_t value[SERVICE_DIAG_MEMORY_LEN];
+    uint8_t* ptr = value;
+    uint8_t count;
+
+    LOG_DBG("Read memory usage");
+    esirem_quantum_main_memstat_get_heap(&heap);
+    count = esirem_quantum_main_memstat_get_stacks(stacks, ARRAY_SIZE(stacks));
+
+    sys_put_le32(heap.arena_size, ptr);
+    ptr += sizeof(uint32_t);
+    sys_put_le32(heap.cur_used, ptr);
+    ptr += sizeof(uint32_t);
+    sys_put_le32(heap.max_used, ptr);
+    ptr += sizeof(uint32_t);
+    *ptr++ = count;
+    for (uint8_t i = 0; i < count; i++)
+    {
+        memcpy(ptr, stacks[i].name, ESIREM_QUANTUM_MAIN_MEMSTAT_NAME_LEN);
+        ptr += ESIREM_QUANTUM_MAIN_MEMSTAT_NAME_LEN;
+        sys_put_le32(stacks[i].size, ptr);
+        ptr += sizeof(uint32_t);
+        sys_put_le32(stacks[i].max_used, ptr);
+        ptr += sizeof(uint32_t);
+    }
+
+    return bt_gatt_attr_read(conn, attr, buf, len, offset, value, ptr - value);
+}
+#endif // CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT
+
+static ssize_t service_diag_ctrl_write_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, const void* buf,
+    uint16_t len, uint16_t offset, uint8_t flags)
+{
+    LOG_DBG("Write diag control point");
+    if (offset)
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    if (len != 1)
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    switch (((const uint8_t*) buf)[0])
+    {
+        case ESIREM_QUANTUM_MAIN_SERVICE_DIAG_CTRL_RESET_LATENCY:
+            esirem_quantum_main_latency_reset();
+            break;
+
+        case ESIREM_QUANTUM_MAIN_SERVICE_DIAG_CTRL_RESET_STATS:
+            esirem_quantum_main_stats_reset();
+            break;
+
+        case ESIREM_QUANTUM_MAIN_SERVICE_DIAG_CTRL_RESET_TRAFFIC:
+            esirem_quantum_main_traffic_reset();
+            break;
+
+        default:
+            return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_NOT_SUPPORTED);
+    }
+
+    return len;
+}
+
+static struct bt_uuid_128 service_diag_uuid = BT_UUID_INIT_128(
+    ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE(ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG));
+static struct bt_uuid_128 service_diag_chrc_latency_uuid =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_LATENCY));
+static struct bt_uuid_128 service_diag_chrc_stats_uuid =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_STATS));
+static struct bt_uuid_128 service_diag_chrc_odometer_uuid =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_ODOMETER));
+static struct bt_uuid_128 service_diag_chrc_traffic_uuid =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_TRAFFIC));
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG)
+static struct bt_uuid_128 service_diag_chrc_eventlog_uuid =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_EVENTLOG));
+#endif
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT)
+static struct bt_uuid_128 service_diag_chrc_memory_uuid =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_MEMORY));
+#endif
+static struct bt_uuid_128 service_diag_chrc_ctrl_uuid =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_DIAG_CHRC_CTRL));
+
+static const char service_diag_chrc_latency_cud_str[] = "Latences (us)";
+static const char service_diag_chrc_ctrl_cud_str[]    = "Controle diag";
+static const char service_diag_chrc_stats_cud_str[]   = "Etats et energie";
+static const char service_diag_chrc_odometer_cud_str[] = "Compteurs de vie";
+static const char service_diag_chrc_traffic_cud_str[]  = "Charge BLE";
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG)
+static const char service_diag_chrc_eventlog_cud_str[] = "Journal";
+#endif
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT)
+static const char service_diag_chrc_memory_cud_str[]  = "Piles et tas";
+#endif
+
+/* Declaration du service diagnostic ESIREM_QUANTUM_MAIN */
+BT_GATT_SERVICE_DEFINE(
+    esirem_quantum_main_service_diag,
+    BT_GATT_PRIMARY_SERVICE((struct bt_uuid*) &service_diag_uuid),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &service_diag_chrc_latency_uuid, BT_GATT_CHRC_READ,
+        BT_GATT_PERM_READ, service_diag_latency_read_cb, NULL, NULL),
+    BT_GATT_CUD(service_diag_chrc_latency_cud_str, BT_GATT_PERM_READ),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &service_diag_chrc_ctrl_uuid, BT_GATT_CHRC_WRITE,
+        BT_GATT_PERM_WRITE, NULL, service_diag_ctrl_write_cb, NULL),
+    BT_GATT_CUD(service_diag_chrc_ctrl_cud_str, BT_GATT_PERM_READ),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &service_diag_chrc_stats_uuid, BT_GATT_CHRC_READ,
+        BT_GATT_PERM_READ, service_diag_stats_read_cb, NULL, NULL),
+    BT_GATT_CUD(service_diag_chrc_stats_cud_str, BT_GATT_PERM_READ),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &service_diag_chrc_odometer_uuid, BT_GATT_CHRC_READ,
+        BT_GATT_PERM_READ, service_diag_odometer_read_cb, NULL, NULL),
+    BT_GATT_CUD(service_diag_chrc_odometer_cud_str, BT_GATT_PERM_READ),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &service_diag_chrc_traffic_uuid, BT_GATT_CHRC_READ,
+        BT_GATT_PERM_READ, service_diag_traffic_read_cb, NULL, NULL),
+    BT_GATT_CUD(service_diag_chrc_traffic_cud_str, BT_GATT_PERM_READ),
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG)
+    /* Index SERVICE_DIAG_ATTR_EVENTLOG */
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &service_diag_chrc_eventlog_uuid,
+        BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
+        BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, service_diag_eventlog_read_cb,
+        service_diag_eventlog_write_cb, NULL),
+    BT_GATT_CUD(service_diag_chrc_eventlog_cud_str, BT_GATT_PERM_READ),
+    BT_GATT_CCC(
+        service_diag_eventlog_ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+#endif
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT)
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &service_diag_chrc_memory_uuid, BT_GATT_CHRC_READ,
+        BT_GATT_PERM_READ, service_diag_memory_read_cb, NULL, NULL),
+    BT_GATT_CUD(service_diag_chrc_memory_cud_str, BT_GATT_PERM_READ),
+#endif
+);
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG)
+/* Le journal (declaration, valeur, CUD, CCC) precede seulement la memoire
+ * (declaration, valeur, CUD) */
+BUILD_ASSERT(
+    SERVICE_DIAG_ATTR_EVENTLOG + 4 + (IS_ENABLED(CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT) ? 3 : 0)
+    == ARRAY_SIZE(attr_esirem_quantum_main_service_diag));
+#endif
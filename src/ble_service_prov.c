@@ -0,0 +1,518 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * ble_service_prov.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Le banc de production ouvre une transaction (BEGIN), lit le defi, envoie
+ * l'enregistrement par morceaux (DATA) puis le valide (COMMIT) avec un MAC
+ * calcule sur le defi et l'enregistrement. Le defi est a usage unique : un
+ * COMMIT rejoue ou echoue oblige a recommencer la transaction.
+ * - L'enregistrement est entierement verifie (MAC, champs, regles de la
+ * configuration) avant toute ecriture. La configuration est sauvegardee sous
+ * les cles du core puis l'enregistrement tel quel, en dernier : c'est le
+ * point de validation. Si une ecriture echoue, les cles deja ecrites sont
+ * restaurees et rien n'est applique ; l'erreur n'est renvoyee que dans ce
+ * cas.
+ * - Au demarrage, l'enregistrement est rejoue apres le chargement des autres
+ * settings (h_commit) : il l'emporte sur d'anciennes valeurs bt/dis.
+ * - La configuration initiale reste stockee sous les cles du core pour
+ * qu'une ecriture ulterieure par le service configuration prenne le pas.
+ * - Les ecritures arrivent toutes du thread RX BLE : pas de verrou.
+ */
+
+#include <include/ble.h>
+#include <include/ble_beacon_trigger.h>
+#include <include/ble_service_prov.h>
+#include <include/ble_uuid.h>
+#include <include/cmac.h>
+#include <include/core.h>
+#include <include/eventlog.h>
+#include <include/traffic.h>
+
+#include <zephyr.h>
+#include <zephyr/types.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/byteorder.h>
+#include <sys/util.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/conn.h>
+#include <bluetooth/crypto.h>
+#include <bluetooth/gatt.h>
+#include <bluetooth/uuid.h>
+
+#include <settings/settings.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_service_prov, CONFIG_LOG_MAX_LEVEL);
+
+#define PROV_SETTINGS_KEY_MODULE "esirem_quantum_main_prov"
+#define PROV_SETTINGS_KEY_RECORD "rec"
+
+#define PROV_KEY_LEN ESIREM_QUANTUM_MAIN_CMAC_KEY_LEN
+
+/* Suffixe par defaut : fin du numero de serie */
+#define PROV_NAME_SUFFIX_FROM_SERIAL_LEN (4)
+
+#define PROV_CTRL_DATA_HDR_LEN   (1 + sizeof(uint16_t))
+#define PROV_CTRL_COMMIT_LEN     (1 + sizeof(uint16_t) + ESIREM_QUANTUM_MAIN_PROV_MAC_LEN)
+
+struct prov_fields
+{
+    const uint8_t* value[ESIREM_QUANTUM_MAIN_PROV_FIELD_COUNT];
+    uint8_t len[ESIREM_QUANTUM_MAIN_PROV_FIELD_COUNT];
+};
+
+/* Cles DIS (settings bt/dis) des champs d'identite */
+static const char* const prov_dis_keys[ESIREM_QUANTUM_MAIN_PROV_FIELD_COUNT] = {
+    [ESIREM_QUANTUM_MAIN_PROV_FIELD_SERIAL] = "bt/dis/serial",
+    [ESIREM_QUANTUM_MAIN_PROV_FIELD_MODEL]  = "bt/dis/model",
+    [ESIREM_QUANTUM_MAIN_PROV_FIELD_MANUF]  = "bt/dis/manuf",
+    [ESIREM_QUANTUM_MAIN_PROV_FIELD_HW_REV] = "bt/dis/hw",
+};
+
+static uint8_t prov_key[PROV_KEY_LEN];
+static bool prov_key_valid = false;
+
+static uint8_t prov_challenge[ESIREM_QUANTUM_MAIN_PROV_CHALLENGE_LEN];
+/**@brief Central qui a ouvert la transaction, NULL si aucune en cours */
+static struct bt_conn* prov_conn = NULL;
+
+/**@brief Enregistrement en cours de reception, ou charge depuis la flash
+ * jusqu'au h_commit des settings */
+static uint8_t prov_record[CONFIG_ESIREM_QUANTUM_MAIN_PROVISION_RECORD_MAX];
+static uint16_t prov_record_loaded_len = 0;
+
+static bool prov_key_is_null(const uint8_t* key)
+{
+    for (uint8_t i = 0; i < PROV_KEY_LEN; i++)
+    {
+        if (key[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool prov_field_len_valid(enum esirem_quantum_main_prov_field type, uint8_t len)
+{
+    switch (type)
+    {
+        case ESIREM_QUANTUM_MAIN_PROV_FIELD_SERIAL:
+        case ESIREM_QUANTUM_MAIN_PROV_FIELD_MODEL:
+        case ESIREM_QUANTUM_MAIN_PROV_FIELD_MANUF:
+        case ESIREM_QUANTUM_MAIN_PROV_FIELD_HW_REV:
+            /* Les chaines DIS sont terminees par un zero */
+            return len && len < CONFIG_BT_DIS_STR_MAX;
+
+        case ESIREM_QUANTUM_MAIN_PROV_FIELD_NAME_SUFFIX:
+            return len && len <= ESIREM_QUANTUM_MAIN_BLE_NAME_SUFFIX_MAX_LEN;
+
+        case ESIREM_QUANTUM_MAIN_PROV_FIELD_CONFIG:
+            return len == ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT * sizeof(uint32_t);
+
+        case ESIREM_QUANTUM_MAIN_PROV_FIELD_BEACON_KEY:
+            return IS_ENABLED(CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER)
+                   && len == ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_KEY_LEN;
+
+        default:
+            return false;
+    }
+}
+
+static int prov_record_parse(const uint8_t* record, size_t len, struct prov_fields* fields)
+{
+    uint8_t type;
+    uint8_t field_len;
+
+    memset(fields, 0, sizeof(*fields));
+    while (len)
+    {
+        if (len < 2 || record[1] > len - 2)
+        {
+            return -EINVAL;
+        }
+
+        type      = record[0];
+        field_len = record[1];
+        if (type >= ESIREM_QUANTUM_MAIN_PROV_FIELD_COUNT || fields->value[type]
+            || !prov_field_len_valid(type, field_len))
+        {
+            LOG_ERR("Invalid provisioning field %u", type);
+            return -EINVAL;
+        }
+
+        fields->value[type] = &record[2];
+        fields->len[type]   = field_len;
+        record += 2 + field_len;
+        len -= 2 + field_len;
+    }
+
+    return 0;
+}
+
+static void prov_config_values(const struct prov_fields* fields, uint32_t* values)
+{
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        values[i] = sys_get_le32(
+            &fields->value[ESIREM_QUANTUM_MAIN_PROV_FIELD_CONFIG][i * sizeof(uint32_t)]);
+    }
+}
+
+/* Identite DIS, nom BLE et cle beacon : rien n'est ecrit en flash ici */
+static void prov_identity_apply(const struct prov_fields* fields)
+{
+    const uint8_t* serial = fields->value[ESIREM_QUANTUM_MAIN_PROV_FIELD_SERIAL];
+    uint8_t serial_len    = fields->len[ESIREM_QUANTUM_MAIN_PROV_FIELD_SERIAL];
+    int status;
+
+    for (uint8_t type = 0; type < ESIREM_QUANTUM_MAIN_PROV_FIELD_COUNT; type++)
+    {
+        if (!prov_dis_keys[type] || !fields->value[type])
+        {
+            continue;
+        }
+
+        status = settings_runtime_set(prov_dis_keys[type], fields->value[type], fields->len[type]);
+        if (status)
+        {
+            LOG_ERR("Failed to set DIS field %u, err: %d", type, status);
+        }
+    }
+
+    if (fields->value[ESIREM_QUANTUM_MAIN_PROV_FIELD_NAME_SUFFIX])
+    {
+        status = esirem_quantum_main_ble_set_name_suffix(
+            (const char*) fields->value[ESIREM_QUANTUM_MAIN_PROV_FIELD_NAME_SUFFIX],
+            fields->len[ESIREM_QUANTUM_MAIN_PROV_FIELD_NAME_SUFFIX]);
+    }
+    else if (serial)
+    {
+        status = esirem_quantum_main_ble_set_name_suffix(
+            (const char*) &serial[serial_len - MIN(serial_len, PROV_NAME_SUFFIX_FROM_SERIAL_LEN)],
+            MIN(serial_len, PROV_NAME_SUFFIX_FROM_SERIAL_LEN));
+    }
+    else
+    {
+        status = 0;
+    }
+    if (status)
+    {
+        LOG_ERR("Failed to set BLE name, err: %d", status);
+    }
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER)
+    if (fields->value[ESIREM_QUANTUM_MAIN_PROV_FIELD_BEACON_KEY])
+    {
+        esirem_quantum_main_beacon_trigger_set_key(
+            fields->value[ESIREM_QUANTUM_MAIN_PROV_FIELD_BEACON_KEY]);
+    }
+#endif
+}
+
+/* Point de validation de la transaction : l'enregistrement est ecrit en
+ * dernier, apres la configuration */
+static int prov_record_save(void* user_data)
+{
+    uint16_t record_len = *(const uint16_t*) user_data;
+    int status;
+
+    status = settings_save_one(
+        PROV_SETTINGS_KEY_MODULE "/" PROV_SETTINGS_KEY_RECORD, prov_record, record_len);
+    if (status)
+    {
+        LOG_ERR("Failed to save provisioning record, err: %d", status);
+    }
+    return status;
+}
+
+static ssize_t prov_commit(const uint8_t* buf, uint16_t len)
+{
+    uint8_t mac[ESIREM_QUANTUM_MAIN_PROV_MAC_LEN];
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    enum esirem_quantum_main_core_setting_check_result result;
+    struct prov_fields fields;
+    uint16_t record_len;
+    uint32_t field_mask = 0;
+    int status;
+
+    if (len != PROV_CTRL_COMMIT_LEN)
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    record_len = sys_get_le16(&buf[1]);
+    if (record_len > sizeof(prov_record))
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    /* Defi a usage unique, y compris en cas d'echec */
+    prov_conn = NULL;
+    if (esirem_quantum_main_cmac_compute(
+            prov_key, prov_challenge, sizeof(prov_challenge), prov_record, record_len, mac,
+            sizeof(mac))
+        || !esirem_quantum_main_cmac_equal(mac, &buf[3], sizeof(mac)))
+    {
+        LOG_ERR("Invalid provisioning MAC");
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_AUTHENTICATION);
+    }
+
+    if (prov_record_parse(prov_record, record_len, &fields))
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+    }
+
+    if (fields.value[ESIREM_QUANTUM_MAIN_PROV_FIELD_CONFIG])
+    {
+        prov_config_values(&fields, values);
+        result = esirem_quantum_main_core_settings_check(values);
+        if (result != ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK)
+        {
+            LOG_ERR("Provisioning config refused, rule %u", result);
+            return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+        }
+    }
+
+    /* Configuration (deja verifiee) puis enregistrement d'identite, en une
+     * validation : si une ecriture echoue la flash est restauree et rien
+     * n'est applique */
+    if (fields.value[ESIREM_QUANTUM_MAIN_PROV_FIELD_CONFIG])
+    {
+        status = esirem_quantum_main_core_settings_store(
+            values, &result, prov_record_save, &record_len);
+    }
+    else
+    {
+        status = prov_record_save(&record_len);
+    }
+    if (status)
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_UNLIKELY);
+    }
+
+    /* Plus d'echec possible : l'identite est appliquee en RAM seulement */
+    prov_identity_apply(&fields);
+
+    for (uint8_t type = 0; type < ESIREM_QUANTUM_MAIN_PROV_FIELD_COUNT; type++)
+    {
+        if (fields.value[type])
+        {
+            field_mask |= BIT(type);
+        }
+    }
+    esirem_quantum_main_eventlog_add(ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_PROVISION, field_mask);
+    LOG_INF("Provisioned, fields 0x%02x", field_mask);
+
+    return len;
+}
+
+static ssize_t service_prov_ctrl_write_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, const void* buf,
+    uint16_t len, uint16_t offset, uint8_t flags)
+{
+    const uint8_t* data = buf;
+    uint16_t data_offset;
+
+    esirem_quantum_main_traffic_count(ESIREM_QUANTUM_MAIN_TRAFFIC_COMMANDS);
+    if (offset)
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    if (!len)
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+
+    if (!prov_key_valid)
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_WRITE_NOT_PERMITTED);
+    }
+
+    if (data[0] == ESIREM_QUANTUM_MAIN_SERVICE_PROV_CTRL_BEGIN)
+    {
+        if (len != 1)
+        {
+            return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+        }
+
+        if (bt_rand(prov_challenge, sizeof(prov_challenge)))
+        {
+            return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_UNLIKELY);
+        }
+        memset(prov_record, 0, sizeof(prov_record));
+        prov_conn = conn;
+        return len;
+    }
+
+    /* DATA et COMMIT uniquement dans la transaction ouverte par ce central */
+    if (prov_conn != conn)
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_WRITE_REQ_REJECTED);
+    }
+
+    switch (data[0])
+    {
+        case ESIREM_QUANTUM_MAIN_SERVICE_PROV_CTRL_DATA:
+            if (len < PROV_CTRL_DATA_HDR_LEN)
+            {
+                return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+            }
+
+            data_offset = sys_get_le16(&data[1]);
+            if (data_offset > sizeof(prov_record)
+                || len - PROV_CTRL_DATA_HDR_LEN > sizeof(prov_record) - data_offset)
+            {
+                return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+            }
+
+            memcpy(&prov_record[data_offset], &data[PROV_CTRL_DATA_HDR_LEN],
+                   len - PROV_CTRL_DATA_HDR_LEN);
+            return len;
+
+        case ESIREM_QUANTUM_MAIN_SERVICE_PROV_CTRL_COMMIT:
+            return prov_commit(data, len);
+
+        default:
+            return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_NOT_SUPPORTED);
+    }
+}
+
+static ssize_t service_prov_challenge_read_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, void* buf,
+    uint16_t len, uint16_t offset)
+{
+    return bt_gatt_attr_read(
+        conn, attr, buf, len, offset, prov_challenge, sizeof(prov_challenge));
+}
+
+void esirem_quantum_main_ble_service_prov_disconnected(struct bt_conn* conn)
+{
+    if (prov_conn == conn)
+    {
+        prov_conn = NULL;
+    }
+}
+
+int esirem_quantum_main_ble_service_prov_init(void)
+{
+    if (hex2bin(
+            CONFIG_ESIREM_QUANTUM_MAIN_PROVISION_KEY,
+            sizeof(CONFIG_ESIREM_QUANTUM_MAIN_PROVISION_KEY) - 1, prov_key,
+            sizeof(prov_key))
+        == sizeof(prov_key))
+    {
+        prov_key_valid = !prov_key_is_null(prov_key);
+    }
+
+    if (!prov_key_valid)
+    {
+        LOG_ERR("No provisioning key, provisioning disabled");
+    }
+
+    return 0;
+}
+
+static struct bt_uuid_128 service_prov_uuid = BT_UUID_INIT_128(
+    ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE(ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_PROV));
+static struct bt_uuid_128 service_prov_chrc_challenge_uuid =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_PROV, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_PROV_CHRC_CHALLENGE));
+static struct bt_uuid_128 service_prov_chrc_ctrl_uuid =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_PROV, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_PROV_CHRC_CTRL));
+
+static const char service_prov_chrc_challenge_cud_str[] = "Defi";
+static const char service_prov_chrc_ctrl_cud_str[]      = "Provisionnement";
+
+/* Les morceaux DATA peuvent etre ecrits sans reponse : l'ordre des
+ * operations ATT est garanti sur une meme connexion */
+BT_GATT_SERVICE_DEFINE(
+    esirem_quantum_main_service_prov,
+    BT_GATT_PRIMARY_SERVICE((struct bt_uuid*) &service_prov_uuid),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &service_prov_chrc_challenge_uuid, BT_GATT_CHRC_READ,
+        BT_GATT_PERM_READ, service_prov_challenge_read_cb, NULL, NULL),
+    BT_GATT_CUD(service_prov_chrc_challenge_cud_str, BT_GATT_PERM_READ),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &service_prov_chrc_ctrl_uuid,
+        BT_GATT_CHRC_WRITE | BT_GATT_CHRC_WRITE_WITHOUT_RESP, BT_GATT_PERM_WRITE,
+        NULL, service_prov_ctrl_write_cb, NULL),
+    BT_GATT_CUD(service_prov_chrc_ctrl_cud_str, BT_GATT_PERM_READ), );
+
+/*
+ * Gestion des parametres : enregistrement de provisionnement
+ */
+
+static int prov_settings_set(
+    const char* name, size_t len, settings_read_cb read_cb, void* cb_arg)
+{
+    const char* next;
+    int status;
+
+    if (!settings_name_steq(name, PROV_SETTINGS_KEY_RECORD, &next) || next)
+    {
+        return -ENOENT;
+    }
+
+    if (len > sizeof(prov_record))
+    {
+        LOG_ERR("Invalid size");
+        return -EINVAL;
+    }
+
+    status = read_cb(cb_arg, prov_record, len);
+    if (status < 0)
+    {
+        LOG_ERR("Failed to read settings value");
+        return status;
+    }
+
+    prov_record_loaded_len = (uint16_t) len;
+    return 0;
+}
+
+/* Rejoue l'identite une fois toutes les cles chargees */
+static int prov_settings_commit(void)
+{
+    struct prov_fields fields;
+
+    if (!prov_record_loaded_len)
+    {
+        return 0;
+    }
+
+    if (prov_record_parse(prov_record, prov_record_loaded_len, &fields))
+    {
+        LOG_ERR("Invalid stored provisioning record");
+    }
+    else
+    {
+        prov_identity_apply(&fields);
+    }
+
+    prov_record_loaded_len = 0;
+    return 0;
+}
+
+struct settings_handler esirem_quantum_main_prov_settings_hdlrs = {
+    .name     = PROV_SETTINGS_KEY_MODULE,
+    .h_set    = prov_settings_set,
+    .h_commit = prov_settings_commit,
+};
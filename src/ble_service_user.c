@@ -15,12 +15,17 @@
 
 #include <include/ble_uuid.h>
 #include <include/ble_service_user.h>
+#include <include/clock_sync.h>
 #include <include/common.h>
 #include <include/core.h>
+#include <include/latency.h>
+#include <include/trace.h>
+#include <include/traffic.h>
 
 #include <zephyr/types.h>
 
 #include <errno.h>
+#include <sys/byteorder.h>
 
 #include <bluetooth/bluetooth.h>
 #include <bluetooth/conn.h>
@@ -33,6 +38,8 @@
 LOG_MODULE_REGISTER(esirem_quantum_main_service_user, CONFIG_LOG_MAX_LEVEL);
 
 static bool notification_enabled = false;
+static bool clock_notification_enabled = false;
+static bool progress_notification_enabled = false;
 
 /*
  * Gestion des notifications / indications
@@ -72,22 +79,53 @@ static ssize_t service_user_state_write_cb(
 
     /* On appelle le callback de changement d'état */
     LOG_DBG("Write user state");
-    if (((uint8_t *)buf)[0] != 0x00)
+    esirem_quantum_main_traffic_count(ESIREM_QUANTUM_MAIN_TRAFFIC_COMMANDS);
+    ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_BLE_USER_WRITE, len);
+    if (offset)
     {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    if (len == ESIREM_QUANTUM_MAIN_SERVICE_USER_STATE_START_AT_LEN
+        && ((uint8_t *)buf)[0] == ESIREM_QUANTUM_MAIN_SERVICE_USER_STATE_START_AT)
+    {
+        ret = esirem_quantum_main_clock_sync_trig_new_cycle_at(
+            conn, (int64_t) sys_get_le64(&((uint8_t *)buf)[1]));
+        if (ret == -EBUSY)
+        {
+            LOG_DBG("Failed to program start");
+            return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
+        }
+        else if (ret)
+        {
+            LOG_DBG("Invalid start time, err: %d", ret);
+            return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+        }
+    }
+    else if (len != sizeof(uint8_t))
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+    }
+    else if (((uint8_t *)buf)[0] != 0x00)
+    {
+        esirem_quantum_main_latency_start(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_TRIG_TO_EDGE);
         ret = esirem_quantum_main_core_trig_new_cycle();
         if (ret)
         {
+            esirem_quantum_main_latency_cancel(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_TRIG_TO_EDGE);
             LOG_DBG("Failed to set state ON");
-            return BT_GATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
+            return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
         }
     }
     else
     {
+        esirem_quantum_main_latency_start(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_STOP_TO_OFF);
         ret = esirem_quantum_main_core_stop_cycle();
         if (ret)
         {
+            esirem_quantum_main_latency_cancel(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_STOP_TO_OFF);
             LOG_DBG("Failed to set state OFF");
-            return BT_GATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
+            return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
         }
     }
 
@@ -104,7 +142,7 @@ static ssize_t service_user_state_read_cb(
     LOG_DBG("Read user state");
     if (0 == len)
     {
-        return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
     }
 
     len_read = bt_gatt_attr_read(
@@ -112,13 +150,84 @@ static ssize_t service_user_state_read_cb(
     return len_read;
 }
 
+static void
+service_user_clock_ccc_cfg_changed(const struct bt_gatt_attr* attr, uint16_t value)
+{
+    LOG_DBG("Clock CCC config changed: %hx", value);
+    clock_notification_enabled = (value == BT_GATT_CCC_NOTIFY);
+    return;
+}
+
+static ssize_t service_user_clock_write_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, const void* buf,
+    uint16_t len, uint16_t offset, uint8_t flags);
+
+static ssize_t service_user_clock_read_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, void* buf,
+    uint16_t len, uint16_t offset)
+{
+    struct esirem_quantum_main_clock_sync_report report;
+    uint8_t report_buf[sizeof(report)];
+
+    LOG_DBG("Read clock sync report");
+    esirem_quantum_main_clock_sync_get_report(&report);
+
+    sys_put_le64((uint64_t) report.offset_us, &report_buf[0]);
+    sys_put_le64((uint64_t) report.start_central_us, &report_buf[8]);
+    sys_put_le32((uint32_t) report.start_err_us, &report_buf[16]);
+
+    return bt_gatt_attr_read(
+        conn, attr, buf, len, offset, report_buf, sizeof(report_buf));
+}
+
+static void
+service_user_progress_ccc_cfg_changed(const struct bt_gatt_attr* attr, uint16_t value)
+{
+    LOG_DBG("Progress CCC config changed: %hx", value);
+    progress_notification_enabled = (value == BT_GATT_CCC_NOTIFY);
+    return;
+}
+
+static void service_user_progress_encode(uint8_t* buf)
+{
+    struct esirem_quantum_main_core_progress progress;
+
+    esirem_quantum_main_core_get_progress(&progress);
+    sys_put_le32(progress.period_index, &buf[0]);
+    sys_put_le32(progress.elapsed_ms, &buf[4]);
+    sys_put_le32(progress.remaining_ms, &buf[8]);
+}
+
+static ssize_t service_user_progress_read_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, void* buf,
+    uint16_t len, uint16_t offset)
+{
+    uint8_t progress_buf[ESIREM_QUANTUM_MAIN_SERVICE_USER_PROGRESS_LEN];
+
+    LOG_DBG("Read progress");
+    service_user_progress_encode(progress_buf);
+
+    return bt_gatt_attr_read(
+        conn, attr, buf, len, offset, progress_buf, sizeof(progress_buf));
+}
+
 static struct bt_uuid_128 service_user_uuid =
     BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE(ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER));
 static struct bt_uuid_128 service_user_chrc_state_uuid =
     BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
         ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER_CHRC_STATE));
 
+static struct bt_uuid_128 service_user_chrc_clock_uuid =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER_CHRC_CLOCK));
+
+static struct bt_uuid_128 service_user_chrc_progress_uuid =
+    BT_UUID_INIT_128(ESIREM_QUANTUM_MAIN_BLE_UUID_ENCODE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER_CHRC_PROGRESS));
+
 static const char service_user_chrc_state_cud_str[] = "Etat Quantum main";
+static const char service_user_chrc_progress_cud_str[] = "Avancement cycle";
+static const char service_user_chrc_clock_cud_str[] = "Horloge synchro";
 
 static const struct bt_gatt_cpf chrc_state_cpf = {
     .format      = 0x01, /* boolean */
@@ -141,13 +250,223 @@ BT_GATT_SERVICE_DEFINE(
     BT_GATT_CCC(
         service_user_ccc_cfg_changed,
         BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT),
-    BT_GATT_CPF(&chrc_state_cpf));
+    BT_GATT_CPF(&chrc_state_cpf),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &service_user_chrc_clock_uuid,
+        BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE | BT_GATT_CHRC_NOTIFY,
+        BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, service_user_clock_read_cb,
+        service_user_clock_write_cb, NULL),
+    BT_GATT_CUD(service_user_chrc_clock_cud_str, BT_GATT_PERM_READ_ENCRYPT),
+    BT_GATT_CCC(
+        service_user_clock_ccc_cfg_changed,
+        BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT),
+    BT_GATT_CHARACTERISTIC(
+        (struct bt_uuid*) &service_user_chrc_progress_uuid,
+        BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+        BT_GATT_PERM_READ, service_user_progress_read_cb, NULL, NULL),
+    BT_GATT_CUD(service_user_chrc_progress_cud_str, BT_GATT_PERM_READ_ENCRYPT),
+    BT_GATT_CCC(
+        service_user_progress_ccc_cfg_changed,
+        BT_GATT_PERM_READ_ENCRYPT | BT_GATT_PERM_WRITE_ENCRYPT));
+
+/*
+ * Notifications d'avancement
+ *
+ * Une tache periodique echantillonne l'avancement du core pendant un cycle.
+ * La periode est celle de la configuration, rallongee si besoin a
+ * l'intervalle de connexion le plus long : on n'envoie jamais plus d'une
+ * notification par evenement de connexion.
+ *
+ * Chaque lien n'a qu'une notification en vol : si la precedente n'est pas
+ * encore partie (lien congestionne), l'echantillon est abandonne et le
+ * suivant, plus recent, le remplace. Une notification encore en file a
+ * la deconnexion est liberee sans appel du callback d'envoi : l'emplacement
+ * est libere a la deconnexion.
+ */
+
+static void service_user_progress_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(service_user_progress_work, service_user_progress_work_fn);
+static ATOMIC_DEFINE(service_user_progress_in_flight, CONFIG_BT_MAX_CONN);
+
+static void service_user_progress_sent_cb(struct bt_conn* conn, void* user_data)
+{
+    atomic_clear_bit(service_user_progress_in_flight, bt_conn_index(conn));
+}
+
+static void service_user_progress_notify_conn_cb(struct bt_conn* conn, void* data)
+{
+    struct bt_gatt_notify_params* params = data;
+    uint8_t conn_idx                     = bt_conn_index(conn);
+    int err;
+
+    if (!bt_gatt_is_subscribed(conn, params->attr, BT_GATT_CCC_NOTIFY))
+    {
+        return;
+    }
+
+    if (atomic_test_and_set_bit(service_user_progress_in_flight, conn_idx))
+    {
+        LOG_DBG("Progress notification coalesced");
+        esirem_quantum_main_traffic_count(ESIREM_QUANTUM_MAIN_TRAFFIC_NOTIFY_COALESCED);
+        return;
+    }
+
+    err = bt_gatt_notify_cb(conn, params);
+    esirem_quantum_main_traffic_notify_result(err);
+    if (err)
+    {
+        atomic_clear_bit(service_user_progress_in_flight, conn_idx);
+    }
+}
+
+static void service_user_progress_conn_interval_cb(struct bt_conn* conn, void* data)
+{
+    uint32_t* interval_ms = data;
+    struct bt_conn_info info;
+
+    if (bt_conn_get_info(conn, &info))
+    {
+        return;
+    }
+
+    /* Intervalle de connexion en unites de 1.25 ms */
+    *interval_ms = MAX(*interval_ms, DIV_ROUND_UP((uint32_t) info.le.interval * 5U, 4U));
+}
+
+static void service_user_progress_work_fn(struct k_work* work)
+{
+    uint8_t buf[ESIREM_QUANTUM_MAIN_SERVICE_USER_PROGRESS_LEN];
+    uint32_t interval_ms = CONFIG_ESIREM_QUANTUM_MAIN_PROGRESS_NOTIFY_INTERVAL_MS;
+    struct bt_gatt_notify_params params = {
+        .attr = &esirem_quantum_main_service_user.attrs[10],
+        .data = buf,
+        .len  = sizeof(buf),
+        .func = service_user_progress_sent_cb,
+    };
+
+    if (!progress_notification_enabled)
+    {
+        return;
+    }
+
+    service_user_progress_encode(buf);
+    bt_conn_foreach(BT_CONN_TYPE_LE, service_user_progress_notify_conn_cb, &params);
+
+    /* Fin de cycle : la derniere notification (tout a zero) est partie */
+    if (!esirem_quantum_main_core_device_running())
+    {
+        return;
+    }
+
+    bt_conn_foreach(BT_CONN_TYPE_LE, service_user_progress_conn_interval_cb, &interval_ms);
+    k_work_schedule(&service_user_progress_work, K_MSEC(interval_ms));
+}
+
+/* Ecriture sur la caracteristique horloge : ping ou mise a jour de l'offset.
+ * Le pong (horodatage central, horodatage local) est notifie uniquement au
+ * central emetteur du ping. */
+static ssize_t service_user_clock_write_cb(
+    struct bt_conn* conn, const struct bt_gatt_attr* attr, const void* buf,
+    uint16_t len, uint16_t offset, uint8_t flags)
+{
+    int64_t central_us = 0;
+    int64_t local_us   = 0;
+    uint8_t pong[2 * sizeof(int64_t)];
+    int ret = 0;
+
+    LOG_DBG("Write clock sync");
+    esirem_quantum_main_traffic_count(ESIREM_QUANTUM_MAIN_TRAFFIC_COMMANDS);
+    if (offset)
+    {
+        return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+    }
+
+    if (len == ESIREM_QUANTUM_MAIN_SERVICE_USER_CLOCK_PING_LEN)
+    {
+        central_us = (int64_t) sys_get_le64(buf);
+        local_us   = esirem_quantum_main_clock_sync_ping(conn, central_us);
+
+        if (!clock_notification_enabled)
+        {
+            return len;
+        }
+
+        sys_put_le64((uint64_t) central_us, &pong[0]);
+        sys_put_le64((uint64_t) local_us, &pong[8]);
+        ret = bt_gatt_notify(conn, &esirem_quantum_main_service_user.attrs[6], pong, sizeof(pong));
+        esirem_quantum_main_traffic_notify_result(ret);
+        if (ret)
+        {
+            LOG_ERR("Failed to send clock pong, err: %d", ret);
+        }
+        return len;
+    }
+
+    if (len == ESIREM_QUANTUM_MAIN_SERVICE_USER_CLOCK_SYNC_LEN)
+    {
+        ret = esirem_quantum_main_clock_sync_update(
+            conn, (int64_t) sys_get_le64(buf),
+            sys_get_le32(&((const uint8_t*) buf)[sizeof(int64_t)]));
+        if (ret)
+        {
+            return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+        }
+        return len;
+    }
+
+    return ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+}
+
+void esirem_quantum_main_ble_service_user_disconnected(struct bt_conn* conn)
+{
+    atomic_clear_bit(service_user_progress_in_flight, bt_conn_index(conn));
+    esirem_quantum_main_clock_sync_disconnected(conn);
+}
+
+struct service_user_state_notify
+{
+    uint8_t value;
+    int err;
+    bool sent;
+};
+
+/* Une notification par central abonne : le compteur de notifications
+ * envoyees se compare a la somme des notifications recues */
+static void service_user_state_notify_conn_cb(struct bt_conn* conn, void* data)
+{
+    struct service_user_state_notify* notify = data;
+    int err;
+
+    if (!bt_gatt_is_subscribed(conn, &esirem_quantum_main_service_user.attrs[1], BT_GATT_CCC_NOTIFY))
+    {
+        return;
+    }
+
+    err = bt_gatt_notify(
+        conn, &esirem_quantum_main_service_user.attrs[1], &notify->value, sizeof(notify->value));
+    esirem_quantum_main_traffic_notify_result(err);
+    if (err)
+    {
+        notify->err = err;
+    }
+    else
+    {
+        notify->sent = true;
+    }
+}
 
 /* Envoi d'une notification quand l'etat du device a change */
 int esirem_quantum_main_ble_service_user_chrc_state_indicate_change(const bool device_state)
 {
-    int err;
-    uint8_t buf[1] = {0};
+    struct service_user_state_notify notify = {
+        .value = device_state,
+    };
+
+    /* Debut ou fin de cycle : echantillonne immediatement l'avancement */
+    if (progress_notification_enabled)
+    {
+        k_work_reschedule(&service_user_progress_work, K_NO_WAIT);
+    }
 
     if (!notification_enabled)
     {
@@ -156,12 +475,14 @@ int esirem_quantum_main_ble_service_user_chrc_state_indicate_change(const bool d
 
     LOG_DBG("Sending notification state changed");
 
-    buf[0] = device_state;
-
-    err = bt_gatt_notify(NULL, &esirem_quantum_main_service_user.attrs[1], buf, sizeof(buf));
-    if (err)
+    bt_conn_foreach(BT_CONN_TYPE_LE, service_user_state_notify_conn_cb, &notify);
+    if (notify.err)
+    {
+        LOG_ERR("Failed to send state indication, err: %d", notify.err);
+    }
+    if (notify.sent && device_state)
     {
-        LOG_ERR("Failed to send state indication, err: %d", err);
+        esirem_quantum_main_latency_stop(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_EDGE_TO_NOTIFY);
     }
-    return err;
+    return notify.err;
 }
@@ -0,0 +1,302 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * clock_sync.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Le central envoie un ping portant son horodatage T1, la carte note son
+ * horodatage local t2 a la reception et renvoie (T1, t2).
+ * - Le central mesure le temps aller-retour (RTT) a la reception du pong
+ * puis renvoie (T1, RTT) a la carte.
+ * - La carte estime offset = T1 + RTT / 2 - t2. Seul l'echantillon de RTT
+ * minimal parmi les derniers echanges est retenu : c'est celui dont le
+ * delai de propagation est le plus symetrique.
+ * - Un declenchement "a l'instant T" (base de temps du central) est converti
+ * en ticks locaux et programme dans le core. Les instants passes ou au-dela
+ * de CONFIG_ESIREM_QUANTUM_MAIN_CLOCK_SYNC_MAX_HORIZON_MS sont refuses.
+ * - Au depart du cycle, le core signale l'instant reel : l'ecart a l'instant
+ * demande est fige et renvoye au central avec l'instant reel exprime dans sa
+ * base de temps, pour qu'il calcule l'ecart entre cartes. Un depart non
+ * programme ou une annulation efface la demande.
+ * - Avec deux centraux connectes, les echanges d'un seul sont retenus : un
+ * ping d'un autre central, ou la deconnexion du central synchronise, vide
+ * la fenetre, l'offset et le rapport. Les mises a jour et les declenchements
+ * programmes d'un autre central que le dernier a avoir envoye un ping sont
+ * refuses : ils sont exprimes dans une autre base de temps.
+ */
+
+#include <include/clock_sync.h>
+#include <include/core.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_clock_sync, CONFIG_LOG_MAX_LEVEL);
+
+/**@brief Horodatages du central acceptes (us) : les sommes et differences
+ * avec l'horloge locale ne peuvent pas deborder */
+#define CLOCK_SYNC_CENTRAL_US_MAX (INT64_MAX / 2)
+
+struct clock_sync_sample
+{
+    int64_t offset_us;
+    uint32_t rtt_us;
+};
+
+static struct k_spinlock clock_sync_lock;
+
+/**@brief Central dont la base de temps est suivie (dernier ping recu) */
+static const struct bt_conn* clock_sync_conn = NULL;
+
+static int64_t clock_sync_ping_central_us = 0;
+static int64_t clock_sync_ping_local_us   = 0;
+static bool clock_sync_ping_pending       = false;
+
+static struct clock_sync_sample clock_sync_window[ESIREM_QUANTUM_MAIN_CLOCK_SYNC_WINDOW_SZ];
+static uint8_t clock_sync_window_idx = 0;
+static uint8_t clock_sync_window_cnt = 0;
+
+static int64_t clock_sync_offset_us = 0;
+static bool clock_sync_synced       = false;
+
+/**@brief Instant local (ticks) demande pour le declenchement synchronise
+ * en attente, 0 si aucun */
+static int64_t clock_sync_requested_start_ticks = 0;
+
+/**@brief Depart reel (ticks) et ecart au depart demande du dernier cycle
+ * synchronise, 0 si le dernier cycle ne l'etait pas */
+static int64_t clock_sync_report_start_ticks = 0;
+static int64_t clock_sync_report_err_ticks   = 0;
+
+int64_t esirem_quantum_main_clock_sync_local_us(void)
+{
+    return (int64_t) k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+/* A appeler verrou pris : oublie la base de temps du central suivi */
+static void clock_sync_reset_locked(void)
+{
+    clock_sync_ping_pending = false;
+    clock_sync_window_idx   = 0;
+    clock_sync_window_cnt   = 0;
+    memset(clock_sync_window, 0, sizeof(clock_sync_window));
+    clock_sync_offset_us          = 0;
+    clock_sync_synced             = false;
+    clock_sync_report_start_ticks = 0;
+    clock_sync_report_err_ticks   = 0;
+}
+
+/* Reception d'un ping : renvoie l'horodatage local a retourner au central */
+int64_t esirem_quantum_main_clock_sync_ping(const struct bt_conn* conn, int64_t central_us)
+{
+    int64_t local_us     = esirem_quantum_main_clock_sync_local_us();
+    k_spinlock_key_t key = k_spin_lock(&clock_sync_lock);
+
+    if (conn != clock_sync_conn)
+    {
+        LOG_DBG("Clock sync central changed");
+        clock_sync_reset_locked();
+        clock_sync_conn = conn;
+    }
+    clock_sync_ping_central_us = central_us;
+    clock_sync_ping_local_us   = local_us;
+    clock_sync_ping_pending    = true;
+
+    k_spin_unlock(&clock_sync_lock, key);
+    return local_us;
+}
+
+/* Reception du RTT mesure par le central pour le dernier ping */
+int esirem_quantum_main_clock_sync_update(const struct bt_conn* conn, int64_t central_us, uint32_t rtt_us)
+{
+    k_spinlock_key_t key = k_spin_lock(&clock_sync_lock);
+    uint32_t best_rtt_us = UINT32_MAX;
+
+    if (conn != clock_sync_conn || !clock_sync_ping_pending || central_us != clock_sync_ping_central_us
+        || central_us < 0 || central_us > CLOCK_SYNC_CENTRAL_US_MAX)
+    {
+        k_spin_unlock(&clock_sync_lock, key);
+        return -EINVAL;
+    }
+    clock_sync_ping_pending = false;
+
+    clock_sync_window[clock_sync_window_idx].offset_us =
+        central_us + (rtt_us / 2) - clock_sync_ping_local_us;
+    clock_sync_window[clock_sync_window_idx].rtt_us = rtt_us;
+    clock_sync_window_idx = (clock_sync_window_idx + 1) % ARRAY_SIZE(clock_sync_window);
+    if (clock_sync_window_cnt < ARRAY_SIZE(clock_sync_window))
+    {
+        clock_sync_window_cnt++;
+    }
+
+    for (uint8_t i = 0; i < clock_sync_window_cnt; i++)
+    {
+        if (clock_sync_window[i].rtt_us < best_rtt_us)
+        {
+            best_rtt_us          = clock_sync_window[i].rtt_us;
+            clock_sync_offset_us = clock_sync_window[i].offset_us;
+        }
+    }
+    clock_sync_synced = true;
+
+    k_spin_unlock(&clock_sync_lock, key);
+
+    LOG_DBG("Clock offset updated, rtt %u us", rtt_us);
+    return 0;
+}
+
+void esirem_quantum_main_clock_sync_disconnected(const struct bt_conn* conn)
+{
+    k_spinlock_key_t key = k_spin_lock(&clock_sync_lock);
+
+    if (conn == clock_sync_conn)
+    {
+        clock_sync_reset_locked();
+        clock_sync_conn = NULL;
+    }
+
+    k_spin_unlock(&clock_sync_lock, key);
+}
+
+bool esirem_quantum_main_clock_sync_is_synced(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&clock_sync_lock);
+    bool synced          = clock_sync_synced;
+
+    k_spin_unlock(&clock_sync_lock, key);
+    return synced;
+}
+
+/* Instant courant exprime dans la base de temps du central */
+int esirem_quantum_main_clock_sync_central_us(int64_t* central_us)
+{
+    int64_t local_us     = esirem_quantum_main_clock_sync_local_us();
+    k_spinlock_key_t key = k_spin_lock(&clock_sync_lock);
+    int status           = -EAGAIN;
+
+    if (clock_sync_synced)
+    {
+        *central_us = local_us + clock_sync_offset_us;
+        status      = 0;
+    }
+
+    k_spin_unlock(&clock_sync_lock, key);
+    return status;
+}
+
+/* Declenchement d'un cycle a l'instant central_start_us (base du central) */
+int esirem_quantum_main_clock_sync_trig_new_cycle_at(const struct bt_conn* conn, int64_t central_start_us)
+{
+    int64_t now_ticks    = k_uptime_ticks();
+    k_spinlock_key_t key = k_spin_lock(&clock_sync_lock);
+    int64_t delay_us;
+    int64_t start_ticks;
+    int status;
+
+    if (!clock_sync_synced || conn != clock_sync_conn)
+    {
+        k_spin_unlock(&clock_sync_lock, key);
+        return -EAGAIN;
+    }
+
+    /* Delai calcule en relatif, instant negatif refuse avant : pas de
+     * debordement pour un instant aberrant envoye par le central */
+    if (central_start_us < 0)
+    {
+        k_spin_unlock(&clock_sync_lock, key);
+        return -ETIME;
+    }
+    delay_us = central_start_us
+               - ((int64_t) k_ticks_to_us_floor64(now_ticks) + clock_sync_offset_us);
+    if (delay_us <= 0)
+    {
+        k_spin_unlock(&clock_sync_lock, key);
+        return -ETIME;
+    }
+    if (delay_us > (int64_t) CONFIG_ESIREM_QUANTUM_MAIN_CLOCK_SYNC_MAX_HORIZON_MS * 1000)
+    {
+        k_spin_unlock(&clock_sync_lock, key);
+        return -ERANGE;
+    }
+    start_ticks = now_ticks + (int64_t) k_us_to_ticks_ceil64((uint64_t) delay_us);
+
+    /* Memorise avant la programmation : le depart peut survenir avant le
+     * retour du core */
+    clock_sync_requested_start_ticks = start_ticks;
+    k_spin_unlock(&clock_sync_lock, key);
+
+    status = esirem_quantum_main_core_trig_new_cycle_at(start_ticks);
+    if (status)
+    {
+        key = k_spin_lock(&clock_sync_lock);
+        if (clock_sync_requested_start_ticks == start_ticks)
+        {
+            clock_sync_requested_start_ticks = 0;
+        }
+        k_spin_unlock(&clock_sync_lock, key);
+    }
+    return status;
+}
+
+/* Appele par le core au depart de chaque cycle */
+void esirem_quantum_main_clock_sync_cycle_started(int64_t start_ticks)
+{
+    k_spinlock_key_t key = k_spin_lock(&clock_sync_lock);
+
+    clock_sync_report_start_ticks = 0;
+    clock_sync_report_err_ticks   = 0;
+    if (clock_sync_requested_start_ticks && start_ticks >= clock_sync_requested_start_ticks)
+    {
+        clock_sync_report_start_ticks = start_ticks;
+        clock_sync_report_err_ticks   = start_ticks - clock_sync_requested_start_ticks;
+    }
+    clock_sync_requested_start_ticks = 0;
+
+    k_spin_unlock(&clock_sync_lock, key);
+}
+
+/* Appele par le core a l'annulation d'un depart programme */
+void esirem_quantum_main_clock_sync_cycle_cancelled(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&clock_sync_lock);
+
+    clock_sync_requested_start_ticks = 0;
+
+    k_spin_unlock(&clock_sync_lock, key);
+}
+
+void esirem_quantum_main_clock_sync_get_report(
+    struct esirem_quantum_main_clock_sync_report* report)
+{
+    k_spinlock_key_t key = k_spin_lock(&clock_sync_lock);
+
+    report->offset_us        = clock_sync_offset_us;
+    report->start_central_us = 0;
+    report->start_err_us     = 0;
+
+    /* Le rapport n'est valide que si le dernier cycle est bien celui
+     * programme */
+    if (clock_sync_report_start_ticks)
+    {
+        report->start_central_us =
+            (int64_t) k_ticks_to_us_floor64(clock_sync_report_start_ticks)
+            + clock_sync_offset_us;
+        report->start_err_us =
+            (int32_t) MIN(k_ticks_to_us_floor64(clock_sync_report_err_ticks), INT32_MAX);
+    }
+
+    k_spin_unlock(&clock_sync_lock, key);
+}
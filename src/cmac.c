@@ -0,0 +1,69 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * cmac.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - AES-CMAC tinycrypt commun aux beacons signes (MAC tronque) et au
+ * provisionnement (MAC du defi suivi de l'enregistrement).
+ * - Le contexte est sur la pile de l'appelant : pas de verrou.
+ */
+
+#include <include/cmac.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <tinycrypt/aes.h>
+#include <tinycrypt/cmac_mode.h>
+#include <tinycrypt/constants.h>
+
+BUILD_ASSERT(ESIREM_QUANTUM_MAIN_CMAC_KEY_LEN == TC_AES_KEY_SIZE);
+BUILD_ASSERT(ESIREM_QUANTUM_MAIN_CMAC_MAC_LEN == TC_AES_BLOCK_SIZE);
+
+int esirem_quantum_main_cmac_compute(
+    const uint8_t* key, const uint8_t* prefix, size_t prefix_len, const uint8_t* data,
+    size_t len, uint8_t* mac, size_t mac_len)
+{
+    struct tc_aes_key_sched_struct sched;
+    struct tc_cmac_struct state;
+    uint8_t tag[TC_AES_BLOCK_SIZE];
+
+    if (mac_len > sizeof(tag))
+    {
+        return -EINVAL;
+    }
+
+    if (tc_cmac_setup(&state, key, &sched) != TC_CRYPTO_SUCCESS
+        || (prefix_len && tc_cmac_update(&state, prefix, prefix_len) != TC_CRYPTO_SUCCESS)
+        || tc_cmac_update(&state, data, len) != TC_CRYPTO_SUCCESS
+        || tc_cmac_final(tag, &state) != TC_CRYPTO_SUCCESS)
+    {
+        return -EIO;
+    }
+
+    memcpy(mac, tag, mac_len);
+    return 0;
+}
+
+bool esirem_quantum_main_cmac_equal(const uint8_t* a, const uint8_t* b, size_t len)
+{
+    uint8_t diff = 0;
+
+    for (size_t i = 0; i < len; i++)
+    {
+        diff |= a[i] ^ b[i];
+    }
+    return diff == 0;
+}
@@ -28,8 +28,20 @@
 
 #include <include/ble_service_config.h>
 #include <include/ble_service_user.h>
+#include <include/bench.h>
+#include <include/clock_sync.h>
 #include <include/core.h>
+#include <include/deepsleep.h>
+#include <include/eventlog.h>
+#include <include/latency.h>
+#include <include/led_pwm.h>
+#include <include/mesh.h>
+#include <include/odometer.h>
+#include <include/retained.h>
 #include <include/settings.h>
+#include <include/stats.h>
+#include <include/trace.h>
+#include <include/watchdog.h>
 
 #include <device.h>
 #include <drivers/gpio.h>
@@ -39,6 +51,10 @@
 #include <zephyr.h>
 
 #include <stdbool.h>
+#include <string.h>
+
+#include <random/rand32.h>
+#include <timing/timing.h>
 
 #include <logging/log.h>
 
@@ -86,14 +102,40 @@ enum esirem_quantum_main_core_state
  * suivant les cas)
  */
 
+/* Valeurs par defaut des durees, restaurees si les valeurs chargees ne
+ * respectent pas les regles entre parametres */
+#define ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_SEQ_DURATION_MS (15000)
+#define ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_TON_MS          (500)
+#define ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_TOFF_MS         (500)
+
 /**@brief Durée de la sequence de clignotement */
-static uint32_t esirem_quantum_main_core_setting_led_seq_duration_ms = 15000;
+static uint32_t esirem_quantum_main_core_setting_led_seq_duration_ms =
+    ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_SEQ_DURATION_MS;
 /**@brief Temps ON LED */
-static uint32_t esirem_quantum_main_core_setting_led_ton_duration_ms = 500;
+static uint32_t esirem_quantum_main_core_setting_led_ton_duration_ms =
+    ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_TON_MS;
 /**@brief Temps OFF LED */
-static uint32_t esirem_quantum_main_core_setting_led_toff_duration_ms = 500;
+static uint32_t esirem_quantum_main_core_setting_led_toff_duration_ms =
+    ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_TOFF_MS;
 /**@brief Nombre de periodes ON/OFF dans un cycle */
 static uint32_t esirem_quantum_main_core_setting_led_period_count = 50;
+/**@brief Courant LED allumee, pour l'estimation de l'energie consommee */
+static uint32_t esirem_quantum_main_core_setting_led_current_ua = 10000;
+/**@brief Intensite LED allumee (%, luminosite percue) */
+static uint32_t esirem_quantum_main_core_setting_led_intensity_pct = 100;
+/**@brief Durees des rampes d'allumage et d'extinction, limitees a Ton et
+ * Toff */
+static uint32_t esirem_quantum_main_core_setting_led_fade_in_ms  = 0;
+static uint32_t esirem_quantum_main_core_setting_led_fade_out_ms = 0;
+/**@brief Mode de sequence : nombre entier de periodes, ou duree exacte
+ * avec une derniere periode tronquee */
+static uint32_t esirem_quantum_main_core_setting_led_seq_mode =
+    ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_PERIODS;
+
+/**@brief Generation de la configuration, incrementee a chaque changement
+ * applique. Tiree au hasard au demarrage : un central qui a mis en cache la
+ * generation d'avant un redemarrage ne la retrouve pas par coincidence. */
+static atomic_t esirem_quantum_main_core_setting_generation = ATOMIC_INIT(0);
 
 /*
  * Noms des parametres
@@ -104,10 +146,32 @@ const char esirem_quantum_main_core_setting_key_led_seq_duration_ms[] =
     "cfg/led/seq_duration_ms";
 const char esirem_quantum_main_core_setting_key_led_ton_duration_ms[]  = "cfg/led/ton_ms";
 const char esirem_quantum_main_core_setting_key_led_toff_duration_ms[] = "cfg/led/toff_ms";
+const char esirem_quantum_main_core_setting_key_led_current_ua[]       = "cfg/led/current_ua";
+const char esirem_quantum_main_core_setting_key_led_intensity_pct[]    = "cfg/led/intensity_pct";
+const char esirem_quantum_main_core_setting_key_led_fade_in_ms[]       = "cfg/led/fade_in_ms";
+const char esirem_quantum_main_core_setting_key_led_fade_out_ms[]      = "cfg/led/fade_out_ms";
+const char esirem_quantum_main_core_setting_key_led_seq_mode[]         = "cfg/led/seq_mode";
+
+/* Chaque cle complete ("module/cle" et terminateur) doit tenir dans le
+ * buffer de esirem_quantum_main_core_setting_get_full_key */
+#define ESIREM_QUANTUM_MAIN_CORE_SETTING_KEY_FITS(_key)                        \
+    BUILD_ASSERT(                                                              \
+        sizeof(esirem_quantum_main_core_setting_key_module) + sizeof(_key)     \
+            <= ESIREM_QUANTUM_MAIN_CORE_SETTINGS_KEY_STR_MAX_LEN,              \
+        #_key " too long")
+
+ESIREM_QUANTUM_MAIN_CORE_SETTING_KEY_FITS(esirem_quantum_main_core_setting_key_led_seq_duration_ms);
+ESIREM_QUANTUM_MAIN_CORE_SETTING_KEY_FITS(esirem_quantum_main_core_setting_key_led_ton_duration_ms);
+ESIREM_QUANTUM_MAIN_CORE_SETTING_KEY_FITS(esirem_quantum_main_core_setting_key_led_toff_duration_ms);
+ESIREM_QUANTUM_MAIN_CORE_SETTING_KEY_FITS(esirem_quantum_main_core_setting_key_led_current_ua);
+ESIREM_QUANTUM_MAIN_CORE_SETTING_KEY_FITS(esirem_quantum_main_core_setting_key_led_intensity_pct);
+ESIREM_QUANTUM_MAIN_CORE_SETTING_KEY_FITS(esirem_quantum_main_core_setting_key_led_fade_in_ms);
+ESIREM_QUANTUM_MAIN_CORE_SETTING_KEY_FITS(esirem_quantum_main_core_setting_key_led_fade_out_ms);
+ESIREM_QUANTUM_MAIN_CORE_SETTING_KEY_FITS(esirem_quantum_main_core_setting_key_led_seq_mode);
 
 const struct esirem_quantum_main_core_setting_map_uuid_keyptr
-    esirem_quantum_main_core_setting_map_uuid_keyptr[] = {
-        {
+    esirem_quantum_main_core_setting_map_uuid_keyptr[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT] = {
+        [ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] = {
             .uuid =
                 (const struct
                  bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_seq_duration_ms,
@@ -115,47 +179,275 @@ const struct esirem_quantum_main_core_setting_map_uuid_keyptr
             .ptrval = &esirem_quantum_main_core_setting_led_seq_duration_ms,
             .keylen = sizeof(esirem_quantum_main_core_setting_key_led_seq_duration_ms) - 1,
             .minval = NULL,
-            .maxval = NULL,
+            .maxval = &settings_val_max_seq_duration_ms,
         },
-        {
+        [ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS] = {
             .uuid   = (const struct
                      bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_ton_ms,
             .key    = esirem_quantum_main_core_setting_key_led_ton_duration_ms,
             .ptrval = &esirem_quantum_main_core_setting_led_ton_duration_ms,
             .keylen = sizeof(esirem_quantum_main_core_setting_key_led_ton_duration_ms) - 1,
             .minval = NULL,
-            .maxval = NULL,
+            .maxval = &settings_val_max_duration_ms,
         },
-        {
+        [ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS] = {
             .uuid   = (const struct
                      bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_toff_ms,
             .key    = esirem_quantum_main_core_setting_key_led_toff_duration_ms,
             .ptrval = &esirem_quantum_main_core_setting_led_toff_duration_ms,
             .keylen = sizeof(esirem_quantum_main_core_setting_key_led_toff_duration_ms) - 1,
             .minval = NULL,
-            .maxval = NULL,
+            .maxval = &settings_val_max_duration_ms,
+        },
+        [ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_CURRENT_UA] = {
+            .uuid   = (const struct
+                     bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_current_ua,
+            .key    = esirem_quantum_main_core_setting_key_led_current_ua,
+            .ptrval = &esirem_quantum_main_core_setting_led_current_ua,
+            .keylen = sizeof(esirem_quantum_main_core_setting_key_led_current_ua) - 1,
+            .minval = NULL,
+            .maxval = &settings_val_max_current_ua,
+        },
+        [ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT] = {
+            .uuid   = (const struct
+                     bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_intensity_pct,
+            .key    = esirem_quantum_main_core_setting_key_led_intensity_pct,
+            .ptrval = &esirem_quantum_main_core_setting_led_intensity_pct,
+            .keylen = sizeof(esirem_quantum_main_core_setting_key_led_intensity_pct) - 1,
+            .minval = NULL,
+            .maxval = &settings_val_max_percent,
+        },
+        [ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_FADE_IN_MS] = {
+            .uuid   = (const struct
+                     bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_fade_in_ms,
+            .key    = esirem_quantum_main_core_setting_key_led_fade_in_ms,
+            .ptrval = &esirem_quantum_main_core_setting_led_fade_in_ms,
+            .keylen = sizeof(esirem_quantum_main_core_setting_key_led_fade_in_ms) - 1,
+            .minval = NULL,
+            .maxval = &settings_val_max_duration_ms,
+        },
+        [ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_FADE_OUT_MS] = {
+            .uuid   = (const struct
+                     bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_fade_out_ms,
+            .key    = esirem_quantum_main_core_setting_key_led_fade_out_ms,
+            .ptrval = &esirem_quantum_main_core_setting_led_fade_out_ms,
+            .keylen = sizeof(esirem_quantum_main_core_setting_key_led_fade_out_ms) - 1,
+            .minval = NULL,
+            .maxval = &settings_val_max_duration_ms,
+        },
+        [ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_MODE] = {
+            .uuid   = (const struct
+                     bt_uuid*) &esirem_quantum_main_ble_uuid_service_config_chrc_led_seq_mode,
+            .key    = esirem_quantum_main_core_setting_key_led_seq_mode,
+            .ptrval = &esirem_quantum_main_core_setting_led_seq_mode,
+            .keylen = sizeof(esirem_quantum_main_core_setting_key_led_seq_mode) - 1,
+            .minval = NULL,
+            .maxval = &settings_val_max_seq_mode,
         },
 };
 
+BUILD_ASSERT(
+    ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT <= ESIREM_QUANTUM_MAIN_CORE_SETTINGS_MAX_COUNT);
+
+/* Les valeurs par defaut doivent passer les regles entre parametres */
+BUILD_ASSERT(
+    ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_TON_MS + ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_TOFF_MS
+    >= CONFIG_ESIREM_QUANTUM_MAIN_CORE_PERIOD_MIN_MS);
+BUILD_ASSERT(
+    ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_SEQ_DURATION_MS
+        / (ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_TON_MS + ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_TOFF_MS)
+    <= CONFIG_ESIREM_QUANTUM_MAIN_CORE_PERIOD_COUNT_MAX);
+
 /* Fonction d'execution d'un declenchement : controle des LEDs */
 static atomic_t esirem_quantum_main_led_core_state     = ATOMIC_INIT(ESIREM_QUANTUM_MAIN_CORE_STATE_INIT);
 static uint32_t esirem_quantum_main_led_core_work_stop = 0;
 static struct k_work_delayable esirem_quantum_main_led_core_work;
 
+/* File d'attente dediee, prioritaire sur la file systeme : une ecriture
+ * flash (settings) en cours sur la file systeme ne retarde pas les fronts */
+static K_THREAD_STACK_DEFINE(
+    esirem_quantum_main_led_core_work_q_stack, CONFIG_ESIREM_QUANTUM_MAIN_CORE_STACK_SIZE);
+static struct k_work_q esirem_quantum_main_led_core_work_q;
+
 const struct device* dev_led = NULL;
 
+/**@brief Instant (ticks d'uptime) du premier allumage du dernier cycle */
+static int64_t esirem_quantum_main_led_core_last_start_ticks = 0;
+static struct k_spinlock esirem_quantum_main_led_core_last_start_lock;
+
+/**@brief Index de la periode ON/OFF en cours, ecrit uniquement par la
+ * fonction d'execution, lu par esirem_quantum_main_core_get_progress */
+static uint32_t cur_cycle_count = 0;
+
+/*
+ * Reprise apres un reset a chaud : l'etat du cycle est recopie en RAM
+ * retenue a chaque front, les parametres a chaque modification. Au
+ * redemarrage, si un cycle etait en cours, il reprend a la periode
+ * interrompue avec les parametres sauvegardes, sans attendre le chargement
+ * des settings. Un passage en erreur ne modifie pas la copie : le cycle
+ * reprend apres le redemarrage du superviseur.
+ */
+
+static struct k_spinlock esirem_quantum_main_core_snapshot_lock;
+/**@brief Vrai entre une reprise et la fin du chargement des settings */
+static bool esirem_quantum_main_core_resumed_skip_load = false;
+
+/**@brief Au-dela, le cycle est abandonne : evite une boucle de redemarrages
+ * si l'erreur se reproduit a chaque reprise */
+#define ESIREM_QUANTUM_MAIN_CORE_RESUME_MAX (3)
+
+static void esirem_quantum_main_core_snapshot_save_state(enum esirem_quantum_main_core_state state)
+{
+    struct esirem_quantum_main_core_snapshot* snapshot = &esirem_quantum_main_retained.core;
+    int64_t elapsed_ticks;
+    k_spinlock_key_t key;
+
+    if (state == ESIREM_QUANTUM_MAIN_CORE_STATE_ERROR)
+    {
+        return;
+    }
+
+    elapsed_ticks = k_uptime_ticks() - esirem_quantum_main_core_get_last_start_ticks();
+
+    key                    = k_spin_lock(&esirem_quantum_main_core_snapshot_lock);
+    snapshot->state        = (uint32_t) state;
+    snapshot->period_index = cur_cycle_count;
+    snapshot->elapsed_ms   = (uint32_t) MIN(k_ticks_to_ms_floor64(elapsed_ticks), UINT32_MAX);
+    if (state == ESIREM_QUANTUM_MAIN_CORE_STATE_IDLE)
+    {
+        snapshot->resume_count = 0;
+    }
+    k_spin_unlock(&esirem_quantum_main_core_snapshot_lock, key);
+
+    esirem_quantum_main_retained_update();
+}
+
+static void esirem_quantum_main_core_snapshot_save_settings(void)
+{
+    struct esirem_quantum_main_core_snapshot* snapshot = &esirem_quantum_main_retained.core;
+    k_spinlock_key_t key = k_spin_lock(&esirem_quantum_main_core_snapshot_lock);
+
+    for (uint8_t i = 0; i < ARRAY_SIZE(esirem_quantum_main_core_setting_map_uuid_keyptr); i++)
+    {
+        snapshot->settings[i] = (uint32_t) atomic_get(
+            (atomic_t*) esirem_quantum_main_core_setting_map_uuid_keyptr[i].ptrval);
+    }
+    k_spin_unlock(&esirem_quantum_main_core_snapshot_lock, key);
+
+    esirem_quantum_main_retained_update();
+}
+
+/* Les etats comptabilises par stats.c reprennent les valeurs du core */
+BUILD_ASSERT(
+    (uint32_t) ESIREM_QUANTUM_MAIN_CORE_STATE_ERROR
+    == (uint32_t) ESIREM_QUANTUM_MAIN_STATS_STATE_ERROR);
+
+static int esirem_quantum_main_core_led_set(bool on)
+{
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_LED_PWM)
+    return on ? esirem_quantum_main_led_pwm_on() : esirem_quantum_main_led_pwm_off();
+#else
+    return gpio_pin_set(dev_led, PIN, on);
+#endif
+}
+
+/* Intensite et rampes lues au debut de chaque cycle */
+static void esirem_quantum_main_core_led_configure(void)
+{
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_LED_PWM)
+    uint32_t ton_ms  = (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_ton_duration_ms);
+    uint32_t toff_ms = (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_toff_duration_ms);
+
+    esirem_quantum_main_led_pwm_configure(
+        (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_intensity_pct),
+        MIN((uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_fade_in_ms), ton_ms),
+        MIN((uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_fade_out_ms), toff_ms));
+#endif
+}
+
+static void esirem_quantum_main_led_core_set_state(enum esirem_quantum_main_core_state state)
+{
+    atomic_set(&esirem_quantum_main_led_core_state, (atomic_val_t) state);
+    esirem_quantum_main_stats_state_enter((enum esirem_quantum_main_stats_state) state);
+    esirem_quantum_main_core_snapshot_save_state(state);
+    if (state == ESIREM_QUANTUM_MAIN_CORE_STATE_IDLE || state == ESIREM_QUANTUM_MAIN_CORE_STATE_ERROR)
+    {
+        esirem_quantum_main_watchdog_core_disarm();
+    }
+    if (state == ESIREM_QUANTUM_MAIN_CORE_STATE_IDLE)
+    {
+        esirem_quantum_main_deepsleep_activity();
+    }
+    if (state == ESIREM_QUANTUM_MAIN_CORE_STATE_ERROR)
+    {
+        esirem_quantum_main_odometer_add(ESIREM_QUANTUM_MAIN_ODOMETER_ERRORS, 1);
+        esirem_quantum_main_eventlog_add(ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_ERROR, 0);
+    }
+}
+
+static bool esirem_quantum_main_core_seq_mode_exact(void)
+{
+    return (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_seq_mode)
+           == ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_EXACT;
+}
+
+/* Durees ON et OFF de la periode index. En mode duree exacte, la derniere
+ * periode est tronquee pour que le cycle dure exactement la sequence. */
+static void esirem_quantum_main_core_period_durations(
+    uint32_t index, uint32_t* ton_ms, uint32_t* toff_ms)
+{
+    uint32_t led_period_count =
+        (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_period_count);
+    uint32_t remaining_ms;
+
+    *ton_ms  = (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_ton_duration_ms);
+    *toff_ms = (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_toff_duration_ms);
+
+    if (!esirem_quantum_main_core_seq_mode_exact() || !led_period_count
+        || index != led_period_count - 1)
+    {
+        return;
+    }
+
+    remaining_ms = (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_seq_duration_ms)
+                   - (led_period_count - 1) * (*ton_ms + *toff_ms);
+    *ton_ms  = MIN(*ton_ms, remaining_ms);
+    *toff_ms = remaining_ms - *ton_ms;
+}
+
+/* Fin de cycle (derniere periode jouee ou arret demande), LED deja eteinte */
+static void esirem_quantum_main_led_core_cycle_end(enum esirem_quantum_main_core_state cur_state)
+{
+    if ((uint32_t) atomic_get(&esirem_quantum_main_led_core_work_stop))
+    {
+        esirem_quantum_main_latency_stop(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_STOP_TO_OFF);
+    }
+    atomic_set(&esirem_quantum_main_led_core_work_stop, 0x00U);
+    ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_IDLE, cur_cycle_count);
+    if (cur_state != ESIREM_QUANTUM_MAIN_CORE_STATE_INIT)
+    {
+        esirem_quantum_main_stats_count(ESIREM_QUANTUM_MAIN_STATS_COUNTER_CYCLES);
+        esirem_quantum_main_odometer_add(ESIREM_QUANTUM_MAIN_ODOMETER_CYCLES, 1);
+        esirem_quantum_main_eventlog_add(
+            ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_CYCLE_END, cur_cycle_count);
+    }
+    esirem_quantum_main_led_core_set_state(ESIREM_QUANTUM_MAIN_CORE_STATE_IDLE);
+    esirem_quantum_main_ble_service_user_chrc_state_indicate_change(
+        (bool) ESIREM_QUANTUM_MAIN_CORE_DEVICE_STATE_IDLE);
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_MESH)
+    esirem_quantum_main_mesh_state_publish((bool) ESIREM_QUANTUM_MAIN_CORE_DEVICE_STATE_IDLE);
+#endif
+}
+
 static void esirem_quantum_main_led_core_work_run_fn(struct k_work* work)
 {
-    static uint8_t cur_cycle_count = 0;
-    int err                        = 0;
+    int err = 0;
 
     enum esirem_quantum_main_core_state cur_state =
         (enum esirem_quantum_main_core_state) atomic_get(&esirem_quantum_main_led_core_state);
 
-    uint32_t led_ton_duration_ms =
-        (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_ton_duration_ms);
-    uint32_t led_toff_duration_ms =
-        (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_toff_duration_ms);
+    uint32_t led_ton_duration_ms  = 0;
+    uint32_t led_toff_duration_ms = 0;
     uint32_t led_period_count =
         (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_period_count);
 
@@ -165,33 +457,66 @@ static void esirem_quantum_main_led_core_work_run_fn(struct k_work* work)
         return;
     }
 
-    LOG_DBG("Run esirem_quantum_main_core fn");
+    esirem_quantum_main_stats_count(ESIREM_QUANTUM_MAIN_STATS_COUNTER_WORK_RUNS);
+
     switch (cur_state)
     {
         case ESIREM_QUANTUM_MAIN_CORE_STATE_IDLE:
             /* Declenche un nouveau cycle */
             cur_cycle_count = 0;
+            {
+                int64_t start_ticks = k_uptime_ticks();
+                k_spinlock_key_t key =
+                    k_spin_lock(&esirem_quantum_main_led_core_last_start_lock);
+                esirem_quantum_main_led_core_last_start_ticks = start_ticks;
+                k_spin_unlock(&esirem_quantum_main_led_core_last_start_lock, key);
+                esirem_quantum_main_clock_sync_cycle_started(start_ticks);
+            }
+            esirem_quantum_main_core_led_configure();
             /* Pas de break : la LED était eteinte on l'allume */
 
         case ESIREM_QUANTUM_MAIN_CORE_STATE_OFF:
+            /* Mode duree exacte : fin du temps OFF tronque de la derniere
+             * periode */
+            if (cur_cycle_count >= led_period_count)
+            {
+                esirem_quantum_main_led_core_cycle_end(cur_state);
+                break;
+            }
+
             /* Passe la LED ON */
-            LOG_DBG("Switching LED ON");
-            err = gpio_pin_set(dev_led, PIN, 1);
+            esirem_quantum_main_core_period_durations(
+                cur_cycle_count, &led_ton_duration_ms, &led_toff_duration_ms);
+            ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_LED_ON, cur_cycle_count);
+            err = esirem_quantum_main_core_led_set(true);
             if (err)
             {
                 LOG_ERR("Cannot set PWM");
-                atomic_set(
-                    &esirem_quantum_main_led_core_state, (atomic_val_t) ESIREM_QUANTUM_MAIN_CORE_STATE_ERROR);
+                ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_ERROR, err);
+                esirem_quantum_main_led_core_set_state(ESIREM_QUANTUM_MAIN_CORE_STATE_ERROR);
                 return;
             }
-            atomic_set(&esirem_quantum_main_led_core_state, (atomic_val_t) ESIREM_QUANTUM_MAIN_CORE_STATE_ON);
+            esirem_quantum_main_stats_count(ESIREM_QUANTUM_MAIN_STATS_COUNTER_EDGES);
+            if (!cur_cycle_count)
+            {
+                esirem_quantum_main_latency_stop(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_TRIG_TO_EDGE);
+                esirem_quantum_main_latency_start(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_EDGE_TO_NOTIFY);
+            }
+            esirem_quantum_main_led_core_set_state(ESIREM_QUANTUM_MAIN_CORE_STATE_ON);
             /* On planifie la prochaine execution de la fonction pour
              * couper la LED */
-            k_work_schedule(&esirem_quantum_main_led_core_work, K_MSEC(led_ton_duration_ms));
+            k_work_schedule_for_queue(
+                &esirem_quantum_main_led_core_work_q, &esirem_quantum_main_led_core_work,
+                K_MSEC(led_ton_duration_ms));
+            esirem_quantum_main_watchdog_core_feed(MAX(led_ton_duration_ms, led_toff_duration_ms));
             if (!cur_cycle_count)
             {
                 esirem_quantum_main_ble_service_user_chrc_state_indicate_change(
                     (bool) ESIREM_QUANTUM_MAIN_CORE_DEVICE_STATE_RUNNING);
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_MESH)
+                esirem_quantum_main_mesh_state_publish(
+                    (bool) ESIREM_QUANTUM_MAIN_CORE_DEVICE_STATE_RUNNING);
+#endif
             }
             break;
 
@@ -201,40 +526,65 @@ static void esirem_quantum_main_led_core_work_run_fn(struct k_work* work)
             cur_cycle_count = led_period_count;
         case ESIREM_QUANTUM_MAIN_CORE_STATE_ON:
         default:
-            LOG_DBG("Switching LED OFF");
             /* Repasse la LED OFF */
-            err = gpio_pin_set(dev_led, PIN, 0);
+            ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_LED_OFF, cur_cycle_count);
+            err = esirem_quantum_main_core_led_set(false);
             if (err)
             {
                 LOG_ERR("Cannot set LED OFF");
-                atomic_set(
-                    &esirem_quantum_main_led_core_state, (atomic_val_t) ESIREM_QUANTUM_MAIN_CORE_STATE_ERROR);
+                ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_ERROR, err);
+                esirem_quantum_main_led_core_set_state(ESIREM_QUANTUM_MAIN_CORE_STATE_ERROR);
                 return;
             }
+            if (cur_state != ESIREM_QUANTUM_MAIN_CORE_STATE_INIT)
+            {
+                esirem_quantum_main_stats_count(ESIREM_QUANTUM_MAIN_STATS_COUNTER_EDGES);
+            }
 
-            if (++cur_cycle_count >= led_period_count
-                || (uint32_t) atomic_get(&esirem_quantum_main_led_core_work_stop))
+            /* Le temps OFF de la derniere periode n'est attendu qu'en mode
+             * duree exacte */
+            esirem_quantum_main_core_period_durations(
+                cur_cycle_count, &led_ton_duration_ms, &led_toff_duration_ms);
+            if (cur_state == ESIREM_QUANTUM_MAIN_CORE_STATE_INIT
+                || (uint32_t) atomic_get(&esirem_quantum_main_led_core_work_stop)
+                || (++cur_cycle_count >= led_period_count
+                    && !(esirem_quantum_main_core_seq_mode_exact() && led_toff_duration_ms)))
             {
-                atomic_set(&esirem_quantum_main_led_core_work_stop, 0x00U);
-                atomic_set(
-                    &esirem_quantum_main_led_core_state, (atomic_val_t) ESIREM_QUANTUM_MAIN_CORE_STATE_IDLE);
-                esirem_quantum_main_ble_service_user_chrc_state_indicate_change(
-                    (bool) ESIREM_QUANTUM_MAIN_CORE_DEVICE_STATE_IDLE);
+                esirem_quantum_main_led_core_cycle_end(cur_state);
             }
             else
             {
                 /* Sinon, on replanifie une execution de la fonction pour
                  * allumer la LED */
-                atomic_set(
-                    &esirem_quantum_main_led_core_state, (atomic_val_t) ESIREM_QUANTUM_MAIN_CORE_STATE_OFF);
-                k_work_schedule(
-                    &esirem_quantum_main_led_core_work, K_MSEC(led_toff_duration_ms));
+                esirem_quantum_main_led_core_set_state(ESIREM_QUANTUM_MAIN_CORE_STATE_OFF);
+                k_work_schedule_for_queue(
+                    &esirem_quantum_main_led_core_work_q, &esirem_quantum_main_led_core_work,
+                    K_MSEC(led_toff_duration_ms));
+                esirem_quantum_main_watchdog_core_feed(
+                    MAX(led_ton_duration_ms, led_toff_duration_ms));
             }
             break;
     }
     return;
 }
 
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_BENCH)
+/* Mesure la duree de chaque execution pour le benchmark */
+static void esirem_quantum_main_led_core_work_bench_fn(struct k_work* work)
+{
+    timing_t start = timing_counter_get();
+    timing_t end;
+
+    esirem_quantum_main_led_core_work_run_fn(work);
+    end = timing_counter_get();
+    esirem_quantum_main_bench_record(
+        ESIREM_QUANTUM_MAIN_BENCH_PROBE_CORE_WORK, timing_cycles_get(&start, &end));
+}
+#define ESIREM_QUANTUM_MAIN_LED_CORE_WORK_FN esirem_quantum_main_led_core_work_bench_fn
+#else
+#define ESIREM_QUANTUM_MAIN_LED_CORE_WORK_FN esirem_quantum_main_led_core_work_run_fn
+#endif
+
 /* Requete de declenchement d'un nouveau cycle */
 int esirem_quantum_main_core_trig_new_cycle(void)
 {
@@ -246,20 +596,74 @@ int esirem_quantum_main_core_trig_new_cycle(void)
         return -EBUSY;
     }
 
-    if (!k_work_delayable_is_pending(&esirem_quantum_main_led_core_work))
+    /* Un depart est deja programme (declenchement synchronise ou requete
+     * precedente non encore traitee) */
+    if (k_work_delayable_is_pending(&esirem_quantum_main_led_core_work))
     {
-        k_work_schedule(&esirem_quantum_main_led_core_work, K_NO_WAIT);
+        return -EBUSY;
     }
+
+    ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_TRIG, 0);
+    esirem_quantum_main_eventlog_add(ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_TRIG, 0);
+    k_work_schedule_for_queue(
+        &esirem_quantum_main_led_core_work_q, &esirem_quantum_main_led_core_work, K_NO_WAIT);
     return 0;
 }
 
+/* Requete de declenchement d'un nouveau cycle a un instant donne (ticks
+ * d'uptime locaux), utilise pour synchroniser plusieurs cartes */
+int esirem_quantum_main_core_trig_new_cycle_at(int64_t start_ticks)
+{
+    enum esirem_quantum_main_core_state cur_led_state =
+        (enum esirem_quantum_main_core_state) atomic_get(&esirem_quantum_main_led_core_state);
+
+    if (cur_led_state != ESIREM_QUANTUM_MAIN_CORE_STATE_IDLE)
+    {
+        return -EBUSY;
+    }
+
+    if (start_ticks <= k_uptime_ticks())
+    {
+        return -ETIME;
+    }
+
+    if (k_work_delayable_is_pending(&esirem_quantum_main_led_core_work))
+    {
+        return -EBUSY;
+    }
+
+    ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_TRIG, (uint32_t) start_ticks);
+    esirem_quantum_main_eventlog_add(
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_TRIG, (uint32_t) k_ticks_to_ms_floor64(start_ticks));
+    k_work_schedule_for_queue(
+        &esirem_quantum_main_led_core_work_q, &esirem_quantum_main_led_core_work,
+        K_TIMEOUT_ABS_TICKS(start_ticks));
+    return 0;
+}
+
+int64_t esirem_quantum_main_core_get_last_start_ticks(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&esirem_quantum_main_led_core_last_start_lock);
+    int64_t start_ticks  = esirem_quantum_main_led_core_last_start_ticks;
+
+    k_spin_unlock(&esirem_quantum_main_led_core_last_start_lock, key);
+    return start_ticks;
+}
+
 int esirem_quantum_main_core_stop_cycle(void)
 {
     enum esirem_quantum_main_core_state cur_led_state =
         (enum esirem_quantum_main_core_state) atomic_get(&esirem_quantum_main_led_core_state);
 
     if (cur_led_state == ESIREM_QUANTUM_MAIN_CORE_STATE_IDLE)
+    {
+        /* Annule un eventuel declenchement programme ; pas d'extinction a
+         * mesurer */
+        k_work_cancel_delayable(&esirem_quantum_main_led_core_work);
+        esirem_quantum_main_clock_sync_cycle_cancelled();
+        esirem_quantum_main_latency_cancel(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_STOP_TO_OFF);
         return 0;
+    }
 
     if (cur_led_state != ESIREM_QUANTUM_MAIN_CORE_STATE_OFF
          && cur_led_state != ESIREM_QUANTUM_MAIN_CORE_STATE_ON
@@ -268,12 +672,51 @@ int esirem_quantum_main_core_stop_cycle(void)
         return -EBUSY;
     }
 
+    ESIREM_QUANTUM_MAIN_TRACE(ESIREM_QUANTUM_MAIN_TRACE_EVT_CORE_STOP, cur_led_state);
+    esirem_quantum_main_eventlog_add(ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_STOP, cur_led_state);
     if (cur_led_state != ESIREM_QUANTUM_MAIN_CORE_STATE_IDLE)
         atomic_set(&esirem_quantum_main_led_core_work_stop, 0x01U);
 
     return 0;
 }
 
+/* Avancement du cycle en cours, tout a zero si aucun cycle n'est en cours */
+void esirem_quantum_main_core_get_progress(struct esirem_quantum_main_core_progress* progress)
+{
+    enum esirem_quantum_main_core_state cur_led_state =
+        (enum esirem_quantum_main_core_state) atomic_get(&esirem_quantum_main_led_core_state);
+    uint32_t led_period_ms =
+        (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_ton_duration_ms)
+        + (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_toff_duration_ms);
+    uint32_t led_period_count =
+        (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_period_count);
+    uint64_t elapsed_ms;
+    uint64_t total_ms;
+
+    memset(progress, 0, sizeof(*progress));
+
+    if (cur_led_state != ESIREM_QUANTUM_MAIN_CORE_STATE_ON
+        && cur_led_state != ESIREM_QUANTUM_MAIN_CORE_STATE_OFF)
+    {
+        return;
+    }
+
+    elapsed_ms = k_ticks_to_ms_floor64(
+        k_uptime_ticks() - esirem_quantum_main_core_get_last_start_ticks());
+    total_ms   = esirem_quantum_main_core_seq_mode_exact()
+                     ? (uint64_t) atomic_get(&esirem_quantum_main_core_setting_led_seq_duration_ms)
+                     : (uint64_t) led_period_count * led_period_ms;
+
+    progress->period_index = cur_cycle_count;
+    progress->elapsed_ms   = (uint32_t) MIN(elapsed_ms, UINT32_MAX);
+    progress->remaining_ms = (elapsed_ms < total_ms) ? (uint32_t) MIN(total_ms - elapsed_ms, UINT32_MAX) : 0;
+}
+
+uint32_t esirem_quantum_main_core_get_led_current_ua(void)
+{
+    return (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_current_ua);
+}
+
 bool esirem_quantum_main_core_error_occured()
 {
     enum esirem_quantum_main_core_state cur_led_state =
@@ -298,14 +741,132 @@ uint8_t esirem_quantum_main_core_device_running(void)
     return 0x00;
 }
 
+bool esirem_quantum_main_core_is_idle(void)
+{
+    return atomic_get(&esirem_quantum_main_led_core_state) == ESIREM_QUANTUM_MAIN_CORE_STATE_IDLE
+           && !k_work_delayable_is_pending(&esirem_quantum_main_led_core_work);
+}
+
+bool esirem_quantum_main_core_stop_pending(void)
+{
+    return (uint32_t) atomic_get(&esirem_quantum_main_led_core_work_stop) != 0;
+}
+
+static void esirem_quantum_main_core_update_period_count(void)
+{
+    uint32_t period_ms =
+        (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_ton_duration_ms)
+        + (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_toff_duration_ms);
+
+    uint32_t seq_ms = (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_seq_duration_ms);
+
+    /* Garde-fou : les regles de validation excluent deja une periode nulle */
+    if (!period_ms)
+    {
+        atomic_set(&esirem_quantum_main_core_setting_led_period_count, 0);
+        return;
+    }
+
+    atomic_set(
+        &esirem_quantum_main_core_setting_led_period_count,
+        esirem_quantum_main_core_seq_mode_exact() ? DIV_ROUND_UP(seq_ms, period_ms) : seq_ms / period_ms);
+}
+
+/* Reprend le cycle interrompu par un reset a chaud. Renvoie true si un cycle
+ * a ete repris. */
+static bool esirem_quantum_main_core_resume(void)
+{
+    struct esirem_quantum_main_core_snapshot* snapshot = &esirem_quantum_main_retained.core;
+    enum esirem_quantum_main_core_state state = (enum esirem_quantum_main_core_state) snapshot->state;
+    uint32_t duration_ms;
+    uint32_t ton_ms;
+    uint32_t toff_ms;
+
+    if (!esirem_quantum_main_retained_was_valid()
+        || (state != ESIREM_QUANTUM_MAIN_CORE_STATE_ON && state != ESIREM_QUANTUM_MAIN_CORE_STATE_OFF))
+    {
+        return false;
+    }
+
+    if (snapshot->resume_count >= ESIREM_QUANTUM_MAIN_CORE_RESUME_MAX)
+    {
+        LOG_ERR("Too many resumes, dropping interrupted cycle");
+        return false;
+    }
+    snapshot->resume_count++;
+    esirem_quantum_main_retained_update();
+
+    for (uint8_t i = 0; i < ARRAY_SIZE(esirem_quantum_main_core_setting_map_uuid_keyptr); i++)
+    {
+        atomic_set(
+            (atomic_t*) esirem_quantum_main_core_setting_map_uuid_keyptr[i].ptrval,
+            (atomic_val_t) snapshot->settings[i]);
+    }
+    esirem_quantum_main_core_update_period_count();
+
+    /* En mode duree exacte, l'etat OFF peut suivre la derniere periode */
+    if (snapshot->period_index > (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_period_count)
+        || (snapshot->period_index == (uint32_t) atomic_get(&esirem_quantum_main_core_setting_led_period_count)
+            && state == ESIREM_QUANTUM_MAIN_CORE_STATE_ON))
+    {
+        return false;
+    }
+
+    cur_cycle_count = snapshot->period_index;
+    {
+        k_spinlock_key_t key = k_spin_lock(&esirem_quantum_main_led_core_last_start_lock);
+        esirem_quantum_main_led_core_last_start_ticks =
+            k_uptime_ticks() - k_ms_to_ticks_ceil64(snapshot->elapsed_ms);
+        k_spin_unlock(&esirem_quantum_main_led_core_last_start_lock, key);
+    }
+
+    /* La periode interrompue est rejouee en entier */
+    esirem_quantum_main_core_led_configure();
+    if (state == ESIREM_QUANTUM_MAIN_CORE_STATE_ON)
+    {
+        esirem_quantum_main_core_led_set(true);
+        esirem_quantum_main_core_period_durations(cur_cycle_count, &ton_ms, &toff_ms);
+        duration_ms = ton_ms;
+    }
+    else
+    {
+        /* L'index a deja avance au front OFF */
+        esirem_quantum_main_core_led_set(false);
+        esirem_quantum_main_core_period_durations(cur_cycle_count - 1, &ton_ms, &toff_ms);
+        duration_ms = toff_ms;
+    }
+
+    esirem_quantum_main_core_resumed_skip_load = true;
+    esirem_quantum_main_led_core_set_state(state);
+    k_work_init_delayable(&esirem_quantum_main_led_core_work, ESIREM_QUANTUM_MAIN_LED_CORE_WORK_FN);
+    k_work_schedule_for_queue(
+        &esirem_quantum_main_led_core_work_q, &esirem_quantum_main_led_core_work,
+        K_MSEC(duration_ms));
+    esirem_quantum_main_watchdog_core_feed(MAX(ton_ms, toff_ms));
+
+    esirem_quantum_main_eventlog_add(ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_RESUME, cur_cycle_count);
+    LOG_INF("Resumed cycle at period %u", cur_cycle_count);
+    return true;
+}
+
 /* Initialisation du esirem_quantum_main_core */
 int esirem_quantum_main_core_init(void)
 {
+    const struct k_work_queue_config cfg = {
+        .name = "core",
+    };
     int scheduled;
     int ret;
 
     LOG_DBG("Init esirem_quantum_main_core");
 
+    k_work_queue_start(
+        &esirem_quantum_main_led_core_work_q, esirem_quantum_main_led_core_work_q_stack,
+        K_THREAD_STACK_SIZEOF(esirem_quantum_main_led_core_work_q_stack),
+        CONFIG_ESIREM_QUANTUM_MAIN_CORE_PRIORITY, &cfg);
+
+    atomic_set(&esirem_quantum_main_core_setting_generation, (atomic_val_t) sys_rand32_get());
+
     dev_led = device_get_binding(LED0);
     if (NULL == dev_led)
     {
@@ -313,23 +874,37 @@ int esirem_quantum_main_core_init(void)
         return -EIO;
     }
 
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_LED_PWM)
+    /* Le PWM prend la main sur la broche de la LED */
+    ret = esirem_quantum_main_led_pwm_init(
+        DT_GPIO_PIN(LED0_NODE, gpios) + 32 * DT_PROP_OR(DT_GPIO_CTLR(LED0_NODE, gpios), port, 0),
+        (FLAGS & GPIO_ACTIVE_LOW) != 0);
+    if (ret)
+    {
+        return -EIO;
+    }
+#else
     ret = gpio_pin_configure(dev_led, PIN, GPIO_OUTPUT_ACTIVE | FLAGS);
 	if (ret < 0) {
 		return -EIO;
 	}
+#endif
 
-    gpio_pin_set(dev_led, PIN, 0);
+    if (esirem_quantum_main_core_resume())
+    {
+        return 0;
+    }
 
-    atomic_set(
-        &esirem_quantum_main_core_setting_led_period_count,
-        atomic_get(&esirem_quantum_main_core_setting_led_seq_duration_ms)
-            / (atomic_get(&esirem_quantum_main_core_setting_led_ton_duration_ms)
-               + atomic_get(&esirem_quantum_main_core_setting_led_toff_duration_ms)));
+    esirem_quantum_main_core_led_set(false);
+
+    esirem_quantum_main_core_update_period_count();
+    esirem_quantum_main_core_snapshot_save_settings();
 
     /* On lance une premiere execution de la fonction, l'etat
      * est a init, la fonction coupe la LED et repasse en IDLE */
-    k_work_init_delayable(&esirem_quantum_main_led_core_work, esirem_quantum_main_led_core_work_run_fn);
-    scheduled = k_work_schedule(&esirem_quantum_main_led_core_work, K_NO_WAIT);
+    k_work_init_delayable(&esirem_quantum_main_led_core_work, ESIREM_QUANTUM_MAIN_LED_CORE_WORK_FN);
+    scheduled = k_work_schedule_for_queue(
+        &esirem_quantum_main_led_core_work_q, &esirem_quantum_main_led_core_work, K_NO_WAIT);
     if (!scheduled)
     {
         LOG_ERR("Error while submitting esirem_quantum_main_led_core_work in init");
@@ -356,26 +931,268 @@ uint32_t esirem_quantum_main_core_setting_get_map_uuid_keyptr_size()
     return esirem_quantum_main_core_setting_map_uuid_keyptr_sz;
 }
 
+uint32_t esirem_quantum_main_core_setting_get(
+    const struct esirem_quantum_main_core_setting_map_uuid_keyptr* map_uuid_keyptr)
+{
+    return (uint32_t) atomic_get((atomic_t*) map_uuid_keyptr->ptrval);
+}
+
+uint32_t esirem_quantum_main_core_setting_get_generation(void)
+{
+    return (uint32_t) atomic_get(&esirem_quantum_main_core_setting_generation);
+}
+
 static int esirem_quantum_main_core_settings_retrieve_map_uuid_keyptr(
     const char* name,
     const struct esirem_quantum_main_core_setting_map_uuid_keyptr** match_uuid_keyptr)
 {
+    const char* next;
+
     *match_uuid_keyptr = NULL;
 
+    /* Comparaison exacte : une cle prolongee ("cfg/led/ton_msX") est refusee */
     for (uint8_t i = 0; i < esirem_quantum_main_core_setting_map_uuid_keyptr_sz; i++)
     {
-        if (!strncmp(
-                name, esirem_quantum_main_core_setting_map_uuid_keyptr[i].key,
-                esirem_quantum_main_core_setting_map_uuid_keyptr[i].keylen))
+        if (settings_name_steq(name, esirem_quantum_main_core_setting_map_uuid_keyptr[i].key, &next)
+            && !next)
         {
             *match_uuid_keyptr = &esirem_quantum_main_core_setting_map_uuid_keyptr[i];
             return 0;
         }
     }
-    LOG_ERR("Invalid name, cannot retrieve data for %s", log_strdup(name));
+    LOG_ERR("Invalid setting name");
     return -EINVAL;
 }
 
+/*
+ * Validation des parametres
+ *
+ * Les bornes de chaque parametre sont declarees dans la table (minval,
+ * maxval), les regles entre parametres ci-dessous. Une modification est
+ * evaluee en une passe sur une copie candidate de tous les parametres, puis
+ * publiee sous le mutex : deux ecrivains (BLE, mesh) ne peuvent pas publier
+ * chacun une valeur valide dont la combinaison ne l'est pas.
+ *
+ * Pendant le chargement des settings les valeurs arrivent une par une dans
+ * un ordre quelconque : seules les bornes sont controlees, les regles le
+ * sont sur l'ensemble au commit.
+ */
+
+static K_MUTEX_DEFINE(esirem_quantum_main_core_settings_mutex);
+/**@brief Vrai apres le premier chargement des settings */
+static bool esirem_quantum_main_core_settings_committed = false;
+
+static bool esirem_quantum_main_core_setting_in_range(
+    const struct esirem_quantum_main_core_setting_map_uuid_keyptr* map_uuid_keyptr, uint32_t value)
+{
+    return (!map_uuid_keyptr->minval || value >= *map_uuid_keyptr->minval)
+           && (!map_uuid_keyptr->maxval || value <= *map_uuid_keyptr->maxval);
+}
+
+static enum esirem_quantum_main_core_setting_check_result
+esirem_quantum_main_core_settings_validate(const uint32_t* values)
+{
+    uint32_t period_ms;
+
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        if (!esirem_quantum_main_core_setting_in_range(
+                &esirem_quantum_main_core_setting_map_uuid_keyptr[i], values[i]))
+        {
+            return ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OUT_OF_RANGE;
+        }
+    }
+
+    /* Ton et Toff sont bornes : pas de debordement */
+    period_ms = values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]
+                + values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS];
+    if (period_ms < CONFIG_ESIREM_QUANTUM_MAIN_CORE_PERIOD_MIN_MS)
+    {
+        return ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_PERIOD_TOO_SHORT;
+    }
+
+    /* Mode duree exacte : la derniere periode est tronquee, aucune regle de
+     * longueur minimale (hors sequence nulle) ni de divisibilite */
+    if (values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_MODE] == ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_EXACT)
+    {
+        if (!values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS])
+        {
+            return ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_SEQ_TOO_SHORT;
+        }
+        if (DIV_ROUND_UP(values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS], period_ms)
+            > CONFIG_ESIREM_QUANTUM_MAIN_CORE_PERIOD_COUNT_MAX)
+        {
+            return ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_TOO_MANY_PERIODS;
+        }
+        return ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK;
+    }
+
+    if (values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] < period_ms)
+    {
+        return ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_SEQ_TOO_SHORT;
+    }
+
+    if (values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] / period_ms
+        > CONFIG_ESIREM_QUANTUM_MAIN_CORE_PERIOD_COUNT_MAX)
+    {
+        return ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_TOO_MANY_PERIODS;
+    }
+
+    if (IS_ENABLED(CONFIG_ESIREM_QUANTUM_MAIN_CORE_SEQ_DIVISIBLE)
+        && values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] % period_ms)
+    {
+        return ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_NOT_DIVISIBLE;
+    }
+
+    return ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK;
+}
+
+static void esirem_quantum_main_core_settings_snapshot(uint32_t* values)
+{
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        values[i] = esirem_quantum_main_core_setting_get(&esirem_quantum_main_core_setting_map_uuid_keyptr[i]);
+    }
+}
+
+/* A appeler mutex pris, valeurs deja validees */
+static void esirem_quantum_main_core_settings_apply_locked(const uint32_t* values)
+{
+    bool changed = false;
+
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        if (atomic_set(
+                (atomic_t*) esirem_quantum_main_core_setting_map_uuid_keyptr[i].ptrval,
+                (atomic_val_t) values[i])
+            != (atomic_val_t) values[i])
+        {
+            changed = true;
+        }
+    }
+
+    if (changed)
+    {
+        esirem_quantum_main_core_update_period_count();
+        esirem_quantum_main_core_snapshot_save_settings();
+        esirem_quantum_main_ble_service_config_generation_notify(
+            (uint32_t) atomic_inc(&esirem_quantum_main_core_setting_generation) + 1);
+    }
+}
+
+enum esirem_quantum_main_core_setting_check_result esirem_quantum_main_core_setting_check(
+    const struct esirem_quantum_main_core_setting_map_uuid_keyptr* map_uuid_keyptr, uint32_t value)
+{
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+
+    esirem_quantum_main_core_settings_snapshot(values);
+    values[map_uuid_keyptr - esirem_quantum_main_core_setting_map_uuid_keyptr] = value;
+    return esirem_quantum_main_core_settings_validate(values);
+}
+
+enum esirem_quantum_main_core_setting_check_result
+esirem_quantum_main_core_settings_check(const uint32_t* values)
+{
+    return esirem_quantum_main_core_settings_validate(values);
+}
+
+enum esirem_quantum_main_core_setting_check_result
+esirem_quantum_main_core_settings_publish(const uint32_t* values)
+{
+    enum esirem_quantum_main_core_setting_check_result result;
+
+    k_mutex_lock(&esirem_quantum_main_core_settings_mutex, K_FOREVER);
+    result = esirem_quantum_main_core_settings_validate(values);
+    if (result == ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK)
+    {
+        esirem_quantum_main_core_settings_apply_locked(values);
+    }
+    k_mutex_unlock(&esirem_quantum_main_core_settings_mutex);
+
+    return result;
+}
+
+/* A appeler mutex pris : sauvegarde les parametres index 0 a count - 1 */
+static int esirem_quantum_main_core_settings_save_locked(const uint32_t* values, uint8_t count)
+{
+    char settings_key_str[ESIREM_QUANTUM_MAIN_CORE_SETTINGS_KEY_STR_MAX_LEN];
+    int status = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        status = esirem_quantum_main_core_setting_get_full_key(
+            &esirem_quantum_main_core_setting_map_uuid_keyptr[i], settings_key_str,
+            sizeof(settings_key_str));
+        if (!status)
+        {
+            /* NVS n'ecrit pas une valeur identique a celle deja stockee */
+            status = settings_save_one(settings_key_str, &values[i], sizeof(values[i]));
+        }
+        if (status)
+        {
+            LOG_ERR("Failed to save setting %u, err: %d", i, status);
+            return status;
+        }
+    }
+
+    return 0;
+}
+
+int esirem_quantum_main_core_settings_store(
+    const uint32_t* values, enum esirem_quantum_main_core_setting_check_result* result,
+    int (*commit_cb)(void* user_data), void* user_data)
+{
+    uint32_t old_values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    int status;
+
+    k_mutex_lock(&esirem_quantum_main_core_settings_mutex, K_FOREVER);
+    *result = esirem_quantum_main_core_settings_validate(values);
+    if (*result != ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK)
+    {
+        k_mutex_unlock(&esirem_quantum_main_core_settings_mutex);
+        return -EINVAL;
+    }
+
+    esirem_quantum_main_core_settings_snapshot(old_values);
+    status = esirem_quantum_main_core_settings_save_locked(values, ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT);
+    if (!status && commit_cb)
+    {
+        status = commit_cb(user_data);
+    }
+
+    if (status)
+    {
+        /* La flash reprend les valeurs en RAM, toujours en vigueur. Les cles
+         * non modifiees ne sont pas reecrites. */
+        esirem_quantum_main_core_settings_save_locked(old_values, ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT);
+    }
+    else
+    {
+        esirem_quantum_main_core_settings_apply_locked(values);
+    }
+    k_mutex_unlock(&esirem_quantum_main_core_settings_mutex);
+
+    return status;
+}
+
+int esirem_quantum_main_core_setting_store(
+    const struct esirem_quantum_main_core_setting_map_uuid_keyptr* map_uuid_keyptr, uint32_t value,
+    enum esirem_quantum_main_core_setting_check_result* result)
+{
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    int status;
+
+    /* Verrou recursif : le jeu complet est pris et sauvegarde sans qu'une
+     * autre ecriture ne s'intercale */
+    k_mutex_lock(&esirem_quantum_main_core_settings_mutex, K_FOREVER);
+    esirem_quantum_main_core_settings_snapshot(values);
+    values[map_uuid_keyptr - esirem_quantum_main_core_setting_map_uuid_keyptr] = value;
+    status = esirem_quantum_main_core_settings_store(values, result, NULL, NULL);
+    k_mutex_unlock(&esirem_quantum_main_core_settings_mutex);
+
+    return status;
+}
+
 /**@brief Appele pendant le chargement / la modification de valeur via settings
  * API pour modifier la valeur d'un parametre.
  */
@@ -385,6 +1202,8 @@ static int esirem_quantum_main_core_settings_set(
     int status                                                     = 0;
     uint32_t tmp_val                                               = 0;
     const struct esirem_quantum_main_core_setting_map_uuid_keyptr* map_uuid_keyptr = NULL;
+    enum esirem_quantum_main_core_setting_check_result result = ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK;
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
 
     LOG_DBG("Write config value");
     status = esirem_quantum_main_core_settings_retrieve_map_uuid_keyptr(name, &map_uuid_keyptr);
@@ -392,6 +1211,9 @@ static int esirem_quantum_main_core_settings_set(
     {
         return status;
     }
+    ESIREM_QUANTUM_MAIN_TRACE(
+        ESIREM_QUANTUM_MAIN_TRACE_EVT_SETTINGS_SET,
+        map_uuid_keyptr - esirem_quantum_main_core_setting_map_uuid_keyptr);
 
     if (len != sizeof(uint32_t))
     {
@@ -399,34 +1221,47 @@ static int esirem_quantum_main_core_settings_set(
         return -EINVAL;
     }
 
+    /* Cycle repris : les parametres viennent de la RAM retenue */
+    if (esirem_quantum_main_core_resumed_skip_load)
+    {
+        return 0;
+    }
+
+    /* Un enregistrement tronque laisserait une partie de tmp_val a zero */
     status = read_cb(cb_arg, &tmp_val, sizeof(uint32_t));
-    if (status < 0)
+    if (status != sizeof(uint32_t))
     {
-        LOG_ERR("Failed to read settings value");
-        return status;
+        LOG_ERR("Failed to read settings value, ret: %d", status);
+        return status < 0 ? status : -EINVAL;
     }
 
-    if ((map_uuid_keyptr->minval && tmp_val < *map_uuid_keyptr->minval)
-        || (map_uuid_keyptr->maxval && tmp_val > *map_uuid_keyptr->maxval))
+    k_mutex_lock(&esirem_quantum_main_core_settings_mutex, K_FOREVER);
+    esirem_quantum_main_core_settings_snapshot(values);
+    values[map_uuid_keyptr - esirem_quantum_main_core_setting_map_uuid_keyptr] = tmp_val;
+    if (esirem_quantum_main_core_settings_committed)
     {
-        LOG_ERR(
-            "Invalid value for setting %s", log_strdup(map_uuid_keyptr->key));
-        return -EINVAL;
+        result = esirem_quantum_main_core_settings_validate(values);
+    }
+    else if (!esirem_quantum_main_core_setting_in_range(map_uuid_keyptr, tmp_val))
+    {
+        result = ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OUT_OF_RANGE;
     }
 
-    if (
-        map_uuid_keyptr->ptrval == &esirem_quantum_main_core_setting_led_seq_duration_ms
-        || map_uuid_keyptr->ptrval == &esirem_quantum_main_core_setting_led_ton_duration_ms
-        || map_uuid_keyptr->ptrval == &esirem_quantum_main_core_setting_led_toff_duration_ms)
+    if (result != ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK)
     {
-        atomic_set(
-            &esirem_quantum_main_core_setting_led_period_count,
-            atomic_get(&esirem_quantum_main_core_setting_led_seq_duration_ms)
-                / (atomic_get(&esirem_quantum_main_core_setting_led_ton_duration_ms)
-                   + atomic_get(&esirem_quantum_main_core_setting_led_toff_duration_ms)));
+        k_mutex_unlock(&esirem_quantum_main_core_settings_mutex);
+        LOG_ERR(
+            "Invalid value for setting %u, rule %u",
+            (uint32_t) (map_uuid_keyptr - esirem_quantum_main_core_setting_map_uuid_keyptr), result);
+        return -EINVAL;
     }
 
-    LOG_DBG("Config value %s changed", log_strdup(map_uuid_keyptr->key));
+    esirem_quantum_main_core_settings_apply_locked(values);
+    k_mutex_unlock(&esirem_quantum_main_core_settings_mutex);
+
+    LOG_DBG(
+        "Config value %u changed",
+        (uint32_t) (map_uuid_keyptr - esirem_quantum_main_core_setting_map_uuid_keyptr));
     return 0;
 }
 
@@ -455,11 +1290,34 @@ static int esirem_quantum_main_core_settings_get(const char* key, char* val, int
 /**@brief appele apres la fin du chargement des parametres. */
 static int esirem_quantum_main_core_settings_commit(void)
 {
-    atomic_set(
-        &esirem_quantum_main_core_setting_led_period_count,
-        atomic_get(&esirem_quantum_main_core_setting_led_seq_duration_ms)
-            / (atomic_get(&esirem_quantum_main_core_setting_led_ton_duration_ms)
-               + atomic_get(&esirem_quantum_main_core_setting_led_toff_duration_ms)));
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    enum esirem_quantum_main_core_setting_check_result result;
+
+    esirem_quantum_main_core_settings_committed = true;
+
+    if (esirem_quantum_main_core_resumed_skip_load)
+    {
+        esirem_quantum_main_core_resumed_skip_load = false;
+        return 0;
+    }
+
+    k_mutex_lock(&esirem_quantum_main_core_settings_mutex, K_FOREVER);
+    esirem_quantum_main_core_settings_snapshot(values);
+    result = esirem_quantum_main_core_settings_validate(values);
+    if (result != ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK)
+    {
+        /* Bornes deja controlees au chargement : seules les durees peuvent
+         * enfreindre une regle */
+        LOG_ERR("Stored settings break rule %u, restoring default durations", result);
+        values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] =
+            ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_SEQ_DURATION_MS;
+        values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]  = ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_TON_MS;
+        values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS] = ESIREM_QUANTUM_MAIN_CORE_DEFAULT_LED_TOFF_MS;
+        esirem_quantum_main_core_settings_apply_locked(values);
+    }
+    esirem_quantum_main_core_update_period_count();
+    esirem_quantum_main_core_snapshot_save_settings();
+    k_mutex_unlock(&esirem_quantum_main_core_settings_mutex);
 
     return 0;
 }
@@ -475,27 +1333,24 @@ int esirem_quantum_main_core_setting_get_full_key(
     const struct esirem_quantum_main_core_setting_map_uuid_keyptr* map_uuid_keyptr,
     char* setting_full_key, size_t setting_full_key_sz)
 {
-    if (!map_uuid_keyptr || !setting_full_key
-        || setting_full_key_sz < ESIREM_QUANTUM_MAIN_CORE_SETTINGS_KEY_STR_MAX_LEN)
+    /* Module, '/', nom du parametre puis terminateur */
+    const size_t module_len = sizeof(esirem_quantum_main_core_setting_key_module) - 1;
+
+    if (!map_uuid_keyptr || !setting_full_key)
     {
         return -EINVAL;
     }
 
-    memcpy(
-        setting_full_key, esirem_quantum_main_core_setting_key_module,
-        sizeof(esirem_quantum_main_core_setting_key_module) - 1);
-    setting_full_key[sizeof(esirem_quantum_main_core_setting_key_module) - 1] = '/';
-
-    if (map_uuid_keyptr->keylen > ESIREM_QUANTUM_MAIN_CORE_SETTINGS_KEY_STR_MAX_LEN
-                                      - sizeof(esirem_quantum_main_core_setting_key_module))
+    if (module_len + 1 + map_uuid_keyptr->keylen + 1 > setting_full_key_sz)
     {
         LOG_ERR("buffer too short for full key name");
         return -EINVAL;
     }
 
-    strncpy(
-        &setting_full_key[sizeof(esirem_quantum_main_core_setting_key_module)],
-        map_uuid_keyptr->key, map_uuid_keyptr->keylen);
+    memcpy(setting_full_key, esirem_quantum_main_core_setting_key_module, module_len);
+    setting_full_key[module_len] = '/';
+    memcpy(&setting_full_key[module_len + 1], map_uuid_keyptr->key, map_uuid_keyptr->keylen);
+    setting_full_key[module_len + 1 + map_uuid_keyptr->keylen] = '\0';
 
     return 0;
 }
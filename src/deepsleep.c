@@ -0,0 +1,249 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * deepsleep.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Un delai d'inactivite est relance a chaque fin de cycle et a chaque
+ * deconnexion. A son expiration, si aucun central n'est connecte et
+ * qu'aucun cycle n'est en cours ou programme, la carte se met en veille.
+ * - Sans reveil par timer (CONFIG_..._WAKE_INTERVAL_MIN = 0) : les
+ * compteurs et le journal sont sauvegardes puis la carte passe en System
+ * OFF. Seul le bouton (alias devicetree sw0, detection SENSE du GPIO) la
+ * reveille, par un reset : l'advertising reprend a la fin de
+ * l'initialisation.
+ * - Avec reveil par timer : le nRF52 ne peut pas sortir du System OFF sur
+ * RTC. L'advertising est suspendu et la carte reste en System ON, CPU au
+ * repos, jusqu'a l'expiration du timer (RTC) ou l'appui sur le bouton.
+ * - Les appels a la pile BLE et le passage en System OFF passent par des
+ * hooks (esirem_quantum_main_deepsleep_set_hooks) : la politique se teste
+ * sur native_posix, sans pile BLE ni gestion d'energie.
+ */
+
+#include <include/ble.h>
+#include <include/core.h>
+#include <include/deepsleep.h>
+#include <include/eventlog.h>
+#include <include/odometer.h>
+#include <include/stats.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+
+#include <device.h>
+#include <drivers/gpio.h>
+#if defined(CONFIG_PM)
+#include <pm/pm.h>
+#endif
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_deepsleep, CONFIG_LOG_MAX_LEVEL);
+
+#define DEEPSLEEP_BUTTON_NODE DT_ALIAS(sw0)
+
+#define DEEPSLEEP_MODE_SYSTEM_OFF (0)
+#define DEEPSLEEP_MODE_SUSPEND    (1)
+
+#define DEEPSLEEP_WAKE_TIMER  (0)
+#define DEEPSLEEP_WAKE_BUTTON (1)
+
+static void deepsleep_soc_system_off(void);
+
+static const struct esirem_quantum_main_deepsleep_hooks deepsleep_default_hooks = {
+    .conn_count  = esirem_quantum_main_ble_conn_count,
+    .adv_suspend = esirem_quantum_main_ble_adv_suspend,
+    .adv_resume  = esirem_quantum_main_ble_adv_resume,
+    .system_off  = deepsleep_soc_system_off,
+};
+
+static const struct esirem_quantum_main_deepsleep_hooks* deepsleep_hooks = &deepsleep_default_hooks;
+
+static atomic_t deepsleep_suspended = ATOMIC_INIT(0);
+
+static void deepsleep_idle_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(deepsleep_idle_work, deepsleep_idle_work_fn);
+
+#if DT_NODE_HAS_STATUS(DEEPSLEEP_BUTTON_NODE, okay)
+static const struct device* deepsleep_button_dev;
+#define DEEPSLEEP_BUTTON_PIN   DT_GPIO_PIN(DEEPSLEEP_BUTTON_NODE, gpios)
+#define DEEPSLEEP_BUTTON_FLAGS DT_GPIO_FLAGS(DEEPSLEEP_BUTTON_NODE, gpios)
+#endif
+
+#if CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP_WAKE_INTERVAL_MIN > 0
+
+static atomic_t deepsleep_wake_source = ATOMIC_INIT(DEEPSLEEP_WAKE_TIMER);
+
+static void deepsleep_wake_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(deepsleep_wake_work, deepsleep_wake_work_fn);
+
+static void deepsleep_wake_work_fn(struct k_work* work)
+{
+    uint32_t source = (uint32_t) atomic_set(&deepsleep_wake_source, DEEPSLEEP_WAKE_TIMER);
+    int err;
+
+    if (!atomic_cas(&deepsleep_suspended, 1, 0))
+    {
+        return;
+    }
+
+    err = deepsleep_hooks->adv_resume();
+    if (err)
+    {
+        LOG_ERR("Failed to resume advertising, err: %d", err);
+    }
+
+    LOG_INF("Wake up (%s)", source == DEEPSLEEP_WAKE_BUTTON ? "button" : "timer");
+    esirem_quantum_main_eventlog_add(ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_WAKE, source);
+    esirem_quantum_main_deepsleep_activity();
+}
+
+#endif
+
+#if DT_NODE_HAS_STATUS(DEEPSLEEP_BUTTON_NODE, okay)
+
+static struct gpio_callback deepsleep_button_cb_data;
+
+static void deepsleep_button_cb(const struct device* dev, struct gpio_callback* cb, uint32_t pins)
+{
+#if CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP_WAKE_INTERVAL_MIN > 0
+    if (atomic_get(&deepsleep_suspended))
+    {
+        atomic_set(&deepsleep_wake_source, DEEPSLEEP_WAKE_BUTTON);
+        k_work_reschedule(&deepsleep_wake_work, K_NO_WAIT);
+    }
+#endif
+}
+
+static int deepsleep_button_init(void)
+{
+    int err;
+
+    deepsleep_button_dev = device_get_binding(DT_GPIO_LABEL(DEEPSLEEP_BUTTON_NODE, gpios));
+    if (!deepsleep_button_dev)
+    {
+        LOG_ERR("Wake button device not found");
+        return -ENODEV;
+    }
+
+    err = gpio_pin_configure(
+        deepsleep_button_dev, DEEPSLEEP_BUTTON_PIN, GPIO_INPUT | DEEPSLEEP_BUTTON_FLAGS);
+    if (err)
+    {
+        return err;
+    }
+
+    gpio_init_callback(&deepsleep_button_cb_data, deepsleep_button_cb, BIT(DEEPSLEEP_BUTTON_PIN));
+    err = gpio_add_callback(deepsleep_button_dev, &deepsleep_button_cb_data);
+    if (err)
+    {
+        return err;
+    }
+
+    return gpio_pin_interrupt_configure(
+        deepsleep_button_dev, DEEPSLEEP_BUTTON_PIN, GPIO_INT_EDGE_TO_ACTIVE);
+}
+
+#endif
+
+static void deepsleep_soc_system_off(void)
+{
+#if DT_NODE_HAS_STATUS(DEEPSLEEP_BUTTON_NODE, okay)
+    /* Un niveau actif programme la detection SENSE, seule source de reveil */
+    gpio_pin_interrupt_configure(
+        deepsleep_button_dev, DEEPSLEEP_BUTTON_PIN, GPIO_INT_LEVEL_ACTIVE);
+#endif
+
+#if defined(CONFIG_PM)
+    pm_power_state_force((struct pm_state_info){PM_STATE_SOFT_OFF, 0, 0});
+#else
+    LOG_ERR("No System OFF on this target");
+#endif
+}
+
+#if CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP_WAKE_INTERVAL_MIN == 0
+
+static void deepsleep_system_off(void)
+{
+    /* La RAM n'est pas retenue en System OFF : tout ce qui ne vit qu'en RAM
+     * retenue doit etre en flash avant l'arret */
+    esirem_quantum_main_odometer_flush();
+    esirem_quantum_main_stats_flush();
+    esirem_quantum_main_eventlog_flush_sync();
+
+    deepsleep_hooks->system_off();
+}
+
+#endif
+
+static void deepsleep_idle_work_fn(struct k_work* work)
+{
+    int err;
+
+    if (!esirem_quantum_main_core_is_idle() || deepsleep_hooks->conn_count())
+    {
+        /* Le delai est relance par la fin du cycle ou la deconnexion */
+        return;
+    }
+
+    err = deepsleep_hooks->adv_suspend();
+    if (err)
+    {
+        LOG_ERR("Failed to suspend advertising, err: %d", err);
+        esirem_quantum_main_deepsleep_activity();
+        return;
+    }
+
+#if CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP_WAKE_INTERVAL_MIN > 0
+    LOG_INF("Idle, advertising suspended");
+    esirem_quantum_main_eventlog_add(
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_SLEEP, DEEPSLEEP_MODE_SUSPEND);
+    atomic_set(&deepsleep_suspended, 1);
+    k_work_schedule(
+        &deepsleep_wake_work, K_MINUTES(CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP_WAKE_INTERVAL_MIN));
+#else
+    LOG_INF("Idle, entering System OFF");
+    esirem_quantum_main_eventlog_add(
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_SLEEP, DEEPSLEEP_MODE_SYSTEM_OFF);
+    deepsleep_system_off();
+#endif
+}
+
+void esirem_quantum_main_deepsleep_set_hooks(const struct esirem_quantum_main_deepsleep_hooks* hooks)
+{
+    deepsleep_hooks = hooks ? hooks : &deepsleep_default_hooks;
+}
+
+void esirem_quantum_main_deepsleep_activity(void)
+{
+    k_work_reschedule(
+        &deepsleep_idle_work, K_MINUTES(CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP_IDLE_MIN));
+}
+
+int esirem_quantum_main_deepsleep_init(void)
+{
+#if DT_NODE_HAS_STATUS(DEEPSLEEP_BUTTON_NODE, okay)
+    int err = deepsleep_button_init();
+
+    if (err)
+    {
+        LOG_ERR("Failed to init wake button, err: %d", err);
+        return err;
+    }
+#elif CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP_WAKE_INTERVAL_MIN == 0
+    LOG_WRN("No wake button, System OFF exits on reset only");
+#endif
+
+    esirem_quantum_main_deepsleep_activity();
+    return 0;
+}
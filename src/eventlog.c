@@ -0,0 +1,366 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * eventlog.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - La partition est decoupee en secteurs effacables, remplis d'
+ * enregistrements de taille fixe. L'enregistrement de sequence seq occupe
+ * toujours l'emplacement seq % nombre d'emplacements : la position d'un
+ * enregistrement se deduit de son numero, sans index.
+ * - Le premier ecrit dans un secteur l'efface : le secteur le plus ancien
+ * est recycle (journal circulaire).
+ * - Les evenements sont d'abord places dans un buffer en RAM puis ecrits par
+ * lots depuis une file d'attente dediee, de basse priorite, pour que les
+ * effacements ne retardent ni le core ni la pile BLE.
+ * - Au demarrage, le premier enregistrement valide de chaque secteur donne
+ * le secteur le plus recent, puis le dernier emplacement ecrit de ce
+ * secteur donne la position d'ecriture. Un enregistrement dont l'ecriture a
+ * echoue laisse un emplacement vierge : le scan passe par-dessus.
+ * - Un enregistrement interrompu par une coupure garde un CRC invalide : il
+ * est transmis tel quel, le central l'ignore.
+ */
+
+#include <include/eventlog.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+#include <string.h>
+#include <sys/crc.h>
+
+#include <storage/flash_map.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_eventlog, CONFIG_LOG_MAX_LEVEL);
+
+#define EVENTLOG_AREA_ID      FLASH_AREA_ID(eventlog)
+#define EVENTLOG_AREA_SIZE    FLASH_AREA_SIZE(eventlog)
+#define EVENTLOG_SECTOR_SIZE  CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG_SECTOR_SIZE
+#define EVENTLOG_RECORD_SZ    sizeof(struct esirem_quantum_main_eventlog_record)
+#define EVENTLOG_PER_SECTOR   (EVENTLOG_SECTOR_SIZE / EVENTLOG_RECORD_SZ)
+#define EVENTLOG_SECTOR_COUNT (EVENTLOG_AREA_SIZE / EVENTLOG_SECTOR_SIZE)
+#define EVENTLOG_SLOT_COUNT   (EVENTLOG_PER_SECTOR * EVENTLOG_SECTOR_COUNT)
+#define EVENTLOG_BUF_COUNT    CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG_BUF_COUNT
+#define EVENTLOG_CRC_LEN      offsetof(struct esirem_quantum_main_eventlog_record, crc)
+
+BUILD_ASSERT(
+    EVENTLOG_AREA_SIZE % EVENTLOG_SECTOR_SIZE == 0 && EVENTLOG_SECTOR_COUNT >= 2,
+    "Event log partition must hold at least two whole sectors");
+BUILD_ASSERT(EVENTLOG_SECTOR_SIZE % EVENTLOG_RECORD_SZ == 0);
+
+static const struct flash_area* eventlog_fa;
+static uint16_t eventlog_boot = 0;
+
+/* Les enregistrements [flash_next, ram_next[ attendent dans le buffer RAM,
+ * a l'index seq % EVENTLOG_BUF_COUNT */
+static struct k_spinlock eventlog_lock;
+static struct esirem_quantum_main_eventlog_record eventlog_buf[EVENTLOG_BUF_COUNT];
+static uint32_t eventlog_flash_next = 0;
+static uint32_t eventlog_ram_next   = 0;
+static uint32_t eventlog_dropped    = 0;
+
+static K_THREAD_STACK_DEFINE(
+    eventlog_work_q_stack, CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG_STACK_SIZE);
+static struct k_work_q eventlog_work_q;
+
+static void eventlog_flush_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(eventlog_flush_work, eventlog_flush_work_fn);
+
+static uint8_t eventlog_record_crc(const struct esirem_quantum_main_eventlog_record* record)
+{
+    return crc8_ccitt(0xff, record, EVENTLOG_CRC_LEN);
+}
+
+static bool eventlog_record_valid(const struct esirem_quantum_main_eventlog_record* record)
+{
+    return record->seq != UINT32_MAX && record->crc == eventlog_record_crc(record);
+}
+
+static bool eventlog_record_erased(const struct esirem_quantum_main_eventlog_record* record)
+{
+    const uint8_t* ptr = (const uint8_t*) record;
+
+    for (size_t i = 0; i < EVENTLOG_RECORD_SZ; i++)
+    {
+        if (ptr[i] != 0xff)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static off_t eventlog_slot_offset(uint32_t seq)
+{
+    return (off_t) (seq % EVENTLOG_SLOT_COUNT) * EVENTLOG_RECORD_SZ;
+}
+
+static int eventlog_write_record(const struct esirem_quantum_main_eventlog_record* record)
+{
+    off_t offset = eventlog_slot_offset(record->seq);
+    int err;
+
+    if (offset % EVENTLOG_SECTOR_SIZE == 0)
+    {
+        err = flash_area_erase(eventlog_fa, offset, EVENTLOG_SECTOR_SIZE);
+        if (err)
+        {
+            return err;
+        }
+    }
+
+    return flash_area_write(eventlog_fa, offset, record, EVENTLOG_RECORD_SZ);
+}
+
+static void eventlog_flush_work_fn(struct k_work* work)
+{
+    struct esirem_quantum_main_eventlog_record record;
+    k_spinlock_key_t key;
+    uint32_t seq;
+    int err;
+
+    for (;;)
+    {
+        key = k_spin_lock(&eventlog_lock);
+        seq = eventlog_flash_next;
+        if (seq == eventlog_ram_next)
+        {
+            k_spin_unlock(&eventlog_lock, key);
+            break;
+        }
+        record = eventlog_buf[seq % EVENTLOG_BUF_COUNT];
+        k_spin_unlock(&eventlog_lock, key);
+
+        /* Un enregistrement non ecrit laisse un emplacement vide, ignore par
+         * le scan : la correspondance sequence / emplacement est conservee */
+        err = eventlog_write_record(&record);
+        if (err)
+        {
+            LOG_ERR("Failed to write event %u, err: %d", seq, err);
+        }
+
+        key                 = k_spin_lock(&eventlog_lock);
+        eventlog_flash_next = seq + 1;
+        k_spin_unlock(&eventlog_lock, key);
+    }
+}
+
+void esirem_quantum_main_eventlog_add(enum esirem_quantum_main_eventlog_evt evt, uint32_t arg)
+{
+    struct esirem_quantum_main_eventlog_record* record;
+    k_spinlock_key_t key = k_spin_lock(&eventlog_lock);
+    uint32_t pending     = eventlog_ram_next - eventlog_flash_next;
+
+    if (pending >= EVENTLOG_BUF_COUNT)
+    {
+        eventlog_dropped++;
+        k_spin_unlock(&eventlog_lock, key);
+        return;
+    }
+
+    record            = &eventlog_buf[eventlog_ram_next % EVENTLOG_BUF_COUNT];
+    record->seq       = eventlog_ram_next;
+    record->uptime_ms = k_uptime_get_32();
+    record->arg       = arg;
+    record->boot      = eventlog_boot;
+    record->evt       = (uint8_t) evt;
+    record->crc       = eventlog_record_crc(record);
+    eventlog_ram_next++;
+    pending++;
+    k_spin_unlock(&eventlog_lock, key);
+
+    /* Ecriture groupee : au plus tard apres le delai, plus tot si le buffer
+     * se remplit */
+    if (pending >= EVENTLOG_BUF_COUNT / 2)
+    {
+        k_work_reschedule_for_queue(&eventlog_work_q, &eventlog_flush_work, K_NO_WAIT);
+    }
+    else
+    {
+        k_work_schedule_for_queue(
+            &eventlog_work_q, &eventlog_flush_work,
+            K_MSEC(CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG_FLUSH_DELAY_MS));
+    }
+}
+
+void esirem_quantum_main_eventlog_flush(void)
+{
+    k_work_reschedule_for_queue(&eventlog_work_q, &eventlog_flush_work, K_NO_WAIT);
+}
+
+void esirem_quantum_main_eventlog_flush_sync(void)
+{
+    struct k_work_sync sync;
+
+    esirem_quantum_main_eventlog_flush();
+    k_work_flush_delayable(&eventlog_flush_work, &sync);
+}
+
+uint32_t esirem_quantum_main_eventlog_get_dropped(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&eventlog_lock);
+    uint32_t dropped     = eventlog_dropped;
+
+    k_spin_unlock(&eventlog_lock, key);
+    return dropped;
+}
+
+void esirem_quantum_main_eventlog_get_range(uint32_t* oldest, uint32_t* next)
+{
+    k_spinlock_key_t key = k_spin_lock(&eventlog_lock);
+    uint32_t flash_next  = eventlog_flash_next;
+
+    k_spin_unlock(&eventlog_lock, key);
+
+    /* Le secteur suivant le secteur courant sera le prochain efface : il
+     * n'est pas annonce */
+    *next   = flash_next;
+    *oldest = flash_next
+              - MIN(flash_next,
+                    (EVENTLOG_SECTOR_COUNT - 1) * EVENTLOG_PER_SECTOR
+                        + flash_next % EVENTLOG_PER_SECTOR);
+}
+
+int esirem_quantum_main_eventlog_read(
+    uint32_t seq, struct esirem_quantum_main_eventlog_record* records, size_t count)
+{
+    uint32_t oldest;
+    uint32_t next;
+    size_t i;
+    int err;
+
+    esirem_quantum_main_eventlog_get_range(&oldest, &next);
+    if (seq < oldest || seq > next)
+    {
+        return -ENOENT;
+    }
+
+    count = MIN(count, next - seq);
+    for (i = 0; i < count; i++)
+    {
+        err = flash_area_read(
+            eventlog_fa, eventlog_slot_offset(seq + i), &records[i], EVENTLOG_RECORD_SZ);
+        if (err)
+        {
+            return err;
+        }
+    }
+
+    return (int) count;
+}
+
+/* Sequence du premier emplacement d'un secteur, deduite de son premier
+ * enregistrement valide */
+static bool eventlog_sector_base(uint32_t sector, uint32_t* base_seq, uint16_t* boot)
+{
+    struct esirem_quantum_main_eventlog_record record;
+    uint32_t slot;
+
+    for (uint32_t pos = 0; pos < EVENTLOG_PER_SECTOR; pos++)
+    {
+        slot = sector * EVENTLOG_PER_SECTOR + pos;
+        if (flash_area_read(eventlog_fa, slot * EVENTLOG_RECORD_SZ, &record, sizeof(record))
+            || !eventlog_record_valid(&record) || record.seq % EVENTLOG_SLOT_COUNT != slot)
+        {
+            continue;
+        }
+
+        *base_seq = record.seq - pos;
+        *boot     = record.boot;
+        return true;
+    }
+
+    return false;
+}
+
+/* Retrouve la position d'ecriture a partir du contenu de la partition */
+static void eventlog_scan(void)
+{
+    struct esirem_quantum_main_eventlog_record record;
+    uint32_t head_seq = 0;
+    int head_sector   = -1;
+    uint32_t last     = 0;
+    uint32_t base_seq;
+    uint16_t boot;
+
+    for (uint32_t sector = 0; sector < EVENTLOG_SECTOR_COUNT; sector++)
+    {
+        if (!eventlog_sector_base(sector, &base_seq, &boot))
+        {
+            continue;
+        }
+
+        if (head_sector < 0 || base_seq > head_seq)
+        {
+            head_sector   = (int) sector;
+            head_seq      = base_seq;
+            eventlog_boot = boot + 1;
+        }
+    }
+
+    if (head_sector < 0)
+    {
+        LOG_DBG("Event log empty");
+        return;
+    }
+
+    /* Le secteur n'est pas lu jusqu'au premier emplacement vierge : une
+     * ecriture en echec a pu en laisser un avant les suivantes */
+    for (uint32_t pos = 0; pos < EVENTLOG_PER_SECTOR; pos++)
+    {
+        if (flash_area_read(
+                eventlog_fa, head_sector * EVENTLOG_SECTOR_SIZE + pos * EVENTLOG_RECORD_SZ,
+                &record, sizeof(record))
+            || eventlog_record_erased(&record))
+        {
+            continue;
+        }
+
+        last = pos;
+        if (eventlog_record_valid(&record))
+        {
+            eventlog_boot = record.boot + 1;
+        }
+    }
+
+    eventlog_flash_next = head_seq + last + 1;
+    eventlog_ram_next   = eventlog_flash_next;
+    LOG_DBG("Event log next seq %u, boot %u", eventlog_flash_next, eventlog_boot);
+}
+
+int esirem_quantum_main_eventlog_init(uint32_t reset_cause)
+{
+    const struct k_work_queue_config cfg = {
+        .name = "eventlog",
+    };
+    int err;
+
+    err = flash_area_open(EVENTLOG_AREA_ID, &eventlog_fa);
+    if (err)
+    {
+        LOG_ERR("Failed to open event log partition, err: %d", err);
+        return err;
+    }
+
+    eventlog_scan();
+
+    k_work_queue_start(
+        &eventlog_work_q, eventlog_work_q_stack,
+        K_THREAD_STACK_SIZEOF(eventlog_work_q_stack), K_LOWEST_APPLICATION_THREAD_PRIO,
+        &cfg);
+
+    esirem_quantum_main_eventlog_add(ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_BOOT, reset_cause);
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * latency.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Chaque sonde est armee par un horodatage de depart (compteur de cycles
+ * CPU via l'API timing, DWT sur nRF52) et desarmee au point d'arrivee.
+ * - La latence est classee dans un histogramme a echelle logarithmique
+ * (puissances de 2 en us) : peu de RAM et la queue de distribution reste
+ * lisible.
+ * - Une arrivee sans depart arme est ignoree (ex : cycle lance par un beacon
+ * pour la sonde declenchement -> allumage).
+ * - Une commande refusee, ou un arret sans cycle en cours, desarme sa sonde :
+ * la prochaine arrivee ne mesure pas depuis ce depart.
+ */
+
+#include <include/latency.h>
+
+#include <zephyr.h>
+
+#include <string.h>
+
+#include <timing/timing.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_latency, CONFIG_LOG_MAX_LEVEL);
+
+static struct k_spinlock latency_lock;
+static timing_t latency_start[ESIREM_QUANTUM_MAIN_LATENCY_PROBE_COUNT];
+static bool latency_armed[ESIREM_QUANTUM_MAIN_LATENCY_PROBE_COUNT];
+static struct esirem_quantum_main_latency_hist
+    latency_hist[ESIREM_QUANTUM_MAIN_LATENCY_PROBE_COUNT];
+
+static uint8_t latency_bucket(uint32_t latency_us)
+{
+    uint8_t bucket = 0;
+
+    while (latency_us > 1 && bucket < ESIREM_QUANTUM_MAIN_LATENCY_BUCKET_COUNT - 1)
+    {
+        latency_us >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void esirem_quantum_main_latency_start(enum esirem_quantum_main_latency_probe probe)
+{
+    timing_t now         = timing_counter_get();
+    k_spinlock_key_t key = k_spin_lock(&latency_lock);
+
+    latency_start[probe] = now;
+    latency_armed[probe] = true;
+
+    k_spin_unlock(&latency_lock, key);
+}
+
+void esirem_quantum_main_latency_stop(enum esirem_quantum_main_latency_probe probe)
+{
+    timing_t now         = timing_counter_get();
+    k_spinlock_key_t key = k_spin_lock(&latency_lock);
+    struct esirem_quantum_main_latency_hist* hist = &latency_hist[probe];
+    uint64_t latency_ns;
+    uint32_t latency_us;
+
+    if (!latency_armed[probe])
+    {
+        k_spin_unlock(&latency_lock, key);
+        return;
+    }
+    latency_armed[probe] = false;
+
+    latency_ns = timing_cycles_to_ns(timing_cycles_get(&latency_start[probe], &now));
+    latency_us = (uint32_t) MIN(latency_ns / NSEC_PER_USEC, UINT32_MAX);
+
+    hist->count++;
+    hist->max_us = MAX(hist->max_us, latency_us);
+    hist->buckets[latency_bucket(latency_us)]++;
+
+    k_spin_unlock(&latency_lock, key);
+}
+
+void esirem_quantum_main_latency_cancel(enum esirem_quantum_main_latency_probe probe)
+{
+    k_spinlock_key_t key = k_spin_lock(&latency_lock);
+
+    latency_armed[probe] = false;
+    k_spin_unlock(&latency_lock, key);
+}
+
+void esirem_quantum_main_latency_get(
+    enum esirem_quantum_main_latency_probe probe,
+    struct esirem_quantum_main_latency_hist* hist)
+{
+    k_spinlock_key_t key = k_spin_lock(&latency_lock);
+
+    memcpy(hist, &latency_hist[probe], sizeof(*hist));
+    k_spin_unlock(&latency_lock, key);
+}
+
+void esirem_quantum_main_latency_reset(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&latency_lock);
+
+    memset(latency_hist, 0, sizeof(latency_hist));
+    memset(latency_armed, 0, sizeof(latency_armed));
+    k_spin_unlock(&latency_lock, key);
+
+    LOG_DBG("Latency histograms reset");
+}
+
+int esirem_quantum_main_latency_init(void)
+{
+    timing_init();
+    timing_start();
+
+    return 0;
+}
@@ -0,0 +1,187 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * led_pwm.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - La LED est pilotee par le PWM1 via nrfx, a 1 kHz (horloge 1 MHz,
+ * 1000 pas). Le driver PWM de Zephyr (et l'API LED) ne sait pas jouer de
+ * sequence : le peripherique est utilise directement.
+ * - Une table de correction gamma (2.2) convertit une luminosite percue
+ * sur 256 niveaux en rapport cyclique.
+ * - Les rampes sont precalculees dans des buffers RAM, recalcules
+ * uniquement quand l'intensite ou une duree de rampe change. Le PWM les
+ * lit par DMA (EasyDMA) : une rampe ne coute aucun traitement CPU.
+ * - Chaque echantillon est rejoue refresh + 1 periodes, ce qui limite la
+ * taille des buffers pour les rampes longues.
+ * - Apres la rampe d'allumage, le PWM maintient la derniere valeur. La
+ * rampe d'extinction se termine par l'arret du PWM, la broche revient a
+ * son niveau de repos (LED eteinte).
+ */
+
+#include <include/led_pwm.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+
+#include <nrfx_pwm.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_led_pwm, CONFIG_LOG_MAX_LEVEL);
+
+/* 1 MHz / 1000 : une periode PWM par ms */
+#define LED_PWM_COUNTERTOP (1000)
+#define LED_PWM_LEVEL_MAX  (255)
+#define LED_PWM_RAMP_MAX   CONFIG_ESIREM_QUANTUM_MAIN_LED_PWM_RAMP_MAX_SAMPLES
+
+/* Bit 15 d'une valeur de sequence (POLARITY, FallingEdge) : la sortie est
+ * haute pendant la valeur de comparaison puis basse jusqu'a COUNTERTOP. A 0
+ * (RisingEdge), elle est basse pendant la valeur de comparaison. Comme le
+ * driver pwm_nrfx de Zephyr, le bit est mis pour une LED active a l'etat
+ * haut et laisse a 0 pour une LED active a l'etat bas : le rapport cyclique
+ * est toujours le temps LED allumee. */
+#define LED_PWM_POLARITY_FALLING (0x8000U)
+
+/**@brief Rapport cyclique (sur LED_PWM_COUNTERTOP) par niveau percu */
+static const uint16_t led_pwm_gamma[LED_PWM_LEVEL_MAX + 1] = {
+       0,    0,    0,    0,    0,    0,    0,    0,    0,    1,    1,    1,    1,    1,    2,    2,
+       2,    3,    3,    3,    4,    4,    5,    5,    6,    6,    7,    7,    8,    8,    9,   10,
+      10,   11,   12,   13,   13,   14,   15,   16,   17,   18,   19,   20,   21,   22,   23,   24,
+      25,   27,   28,   29,   30,   32,   33,   34,   36,   37,   38,   40,   41,   43,   45,   46,
+      48,   49,   51,   53,   55,   56,   58,   60,   62,   64,   66,   68,   70,   72,   74,   76,
+      78,   80,   82,   85,   87,   89,   92,   94,   96,   99,  101,  104,  106,  109,  111,  114,
+     117,  119,  122,  125,  128,  130,  133,  136,  139,  142,  145,  148,  151,  154,  157,  160,
+     164,  167,  170,  173,  177,  180,  184,  187,  190,  194,  198,  201,  205,  208,  212,  216,
+     220,  223,  227,  231,  235,  239,  243,  247,  251,  255,  259,  263,  267,  272,  276,  280,
+     284,  289,  293,  298,  302,  307,  311,  316,  320,  325,  330,  334,  339,  344,  349,  354,
+     359,  364,  369,  374,  379,  384,  389,  394,  399,  405,  410,  415,  421,  426,  431,  437,
+     442,  448,  453,  459,  465,  470,  476,  482,  488,  494,  500,  505,  511,  517,  523,  530,
+     536,  542,  548,  554,  560,  567,  573,  580,  586,  592,  599,  605,  612,  619,  625,  632,
+     639,  646,  652,  659,  666,  673,  680,  687,  694,  701,  708,  715,  723,  730,  737,  745,
+     752,  759,  767,  774,  782,  789,  797,  805,  812,  820,  828,  836,  843,  851,  859,  867,
+     875,  883,  891,  899,  908,  916,  924,  932,  941,  949,  957,  966,  974,  983,  991, 1000,
+};
+
+static const nrfx_pwm_t led_pwm = NRFX_PWM_INSTANCE(1);
+
+static nrf_pwm_values_common_t led_pwm_ramp_up[LED_PWM_RAMP_MAX];
+static nrf_pwm_values_common_t led_pwm_ramp_down[LED_PWM_RAMP_MAX];
+static nrf_pwm_sequence_t led_pwm_seq_up;
+static nrf_pwm_sequence_t led_pwm_seq_down;
+
+static uint16_t led_pwm_polarity     = 0;
+static uint32_t led_pwm_intensity_pct = UINT32_MAX;
+static uint32_t led_pwm_fade_in_ms    = UINT32_MAX;
+static uint32_t led_pwm_fade_out_ms   = UINT32_MAX;
+
+static uint16_t led_pwm_value(uint32_t level)
+{
+    return led_pwm_gamma[level] | led_pwm_polarity;
+}
+
+/* Remplit une rampe de from a to (niveaux percus) sur fade_ms. Une rampe
+ * nulle se reduit a un echantillon : la valeur finale. */
+static void led_pwm_build_ramp(
+    nrf_pwm_sequence_t* seq, nrf_pwm_values_common_t* buf, uint32_t from, uint32_t to,
+    uint32_t fade_ms)
+{
+    uint32_t count = CLAMP(fade_ms, 1, LED_PWM_RAMP_MAX);
+
+    for (uint32_t i = 1; i <= count; i++)
+    {
+        int32_t level = (int32_t) from + ((int32_t) to - (int32_t) from) * (int32_t) i
+                                             / (int32_t) count;
+        buf[i - 1] = led_pwm_value((uint32_t) level);
+    }
+
+    seq->values.p_common = buf;
+    seq->length          = (uint16_t) count;
+    seq->repeats         = fade_ms > count ? fade_ms / count - 1 : 0;
+    seq->end_delay       = 0;
+}
+
+void esirem_quantum_main_led_pwm_configure(
+    uint32_t intensity_pct, uint32_t fade_in_ms, uint32_t fade_out_ms)
+{
+    uint32_t level;
+
+    if (intensity_pct == led_pwm_intensity_pct && fade_in_ms == led_pwm_fade_in_ms
+        && fade_out_ms == led_pwm_fade_out_ms)
+    {
+        return;
+    }
+
+    /* Le DMA ne doit plus lire les buffers pendant leur mise a jour */
+    nrfx_pwm_stop(&led_pwm, true);
+
+    level = MIN(intensity_pct, 100) * LED_PWM_LEVEL_MAX / 100;
+    led_pwm_build_ramp(&led_pwm_seq_up, led_pwm_ramp_up, 0, level, fade_in_ms);
+    led_pwm_build_ramp(&led_pwm_seq_down, led_pwm_ramp_down, level, 0, fade_out_ms);
+
+    led_pwm_intensity_pct = intensity_pct;
+    led_pwm_fade_in_ms    = fade_in_ms;
+    led_pwm_fade_out_ms   = fade_out_ms;
+    LOG_DBG("LED ramps %u %%, in %u ms, out %u ms", intensity_pct, fade_in_ms, fade_out_ms);
+}
+
+int esirem_quantum_main_led_pwm_on(void)
+{
+    /* Sans drapeau STOP, le PWM maintient la derniere valeur de la rampe */
+    nrfx_pwm_simple_playback(&led_pwm, &led_pwm_seq_up, 1, 0);
+    return 0;
+}
+
+int esirem_quantum_main_led_pwm_off(void)
+{
+    if (!led_pwm_fade_out_ms)
+    {
+        nrfx_pwm_stop(&led_pwm, false);
+        return 0;
+    }
+
+    nrfx_pwm_simple_playback(&led_pwm, &led_pwm_seq_down, 1, NRFX_PWM_FLAG_STOP);
+    return 0;
+}
+
+int esirem_quantum_main_led_pwm_init(uint32_t pin, bool active_low)
+{
+    nrfx_pwm_config_t config = {
+        .output_pins  = {
+            pin | (active_low ? NRFX_PWM_PIN_INVERTED : 0),
+            NRFX_PWM_PIN_NOT_USED,
+            NRFX_PWM_PIN_NOT_USED,
+            NRFX_PWM_PIN_NOT_USED,
+        },
+        .irq_priority = NRFX_PWM_DEFAULT_CONFIG_IRQ_PRIORITY,
+        .base_clock   = NRF_PWM_CLK_1MHz,
+        .count_mode   = NRF_PWM_MODE_UP,
+        .top_value    = LED_PWM_COUNTERTOP,
+        .load_mode    = NRF_PWM_LOAD_COMMON,
+        .step_mode    = NRF_PWM_STEP_AUTO,
+    };
+    nrfx_err_t err;
+
+    led_pwm_polarity = active_low ? 0 : LED_PWM_POLARITY_FALLING;
+
+    /* Sans gestionnaire, aucune interruption : la lecture est autonome */
+    err = nrfx_pwm_init(&led_pwm, &config, NULL, NULL);
+    if (err != NRFX_SUCCESS)
+    {
+        LOG_ERR("Failed to init LED PWM, err: %08x", err);
+        return -EIO;
+    }
+
+    esirem_quantum_main_led_pwm_configure(100, 0, 0);
+    return 0;
+}
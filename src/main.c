@@ -15,8 +15,19 @@
 
 #include <include/ble.h>
 #include <include/core.h>
+#include <include/deepsleep.h>
+#include <include/eventlog.h>
+#include <include/latency.h>
+#include <include/memstat.h>
+#include <include/odometer.h>
+#include <include/retained.h>
 #include <include/settings.h>
+#include <include/stats.h>
+#include <include/trace.h>
+#include <include/trigger_input.h>
+#include <include/watchdog.h>
 
+#include <drivers/hwinfo.h>
 #include <sys/reboot.h>
 #include <zephyr.h>
 
@@ -26,25 +37,63 @@ LOG_MODULE_REGISTER(esirem_quantum_main, CONFIG_LOG_MAX_LEVEL);
 
 void main(void)
 {
+    uint32_t reset_cause = 0;
+
+#if defined(CONFIG_HWINFO)
+    if (!hwinfo_get_reset_cause(&reset_cause))
+    {
+        hwinfo_clear_reset_cause();
+    }
+#endif
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_TRACE)
+    esirem_quantum_main_trace_init();
+#endif
+    esirem_quantum_main_retained_init();
+    esirem_quantum_main_stats_init();
+    esirem_quantum_main_odometer_init();
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG)
+    esirem_quantum_main_eventlog_init(reset_cause);
+#endif
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_WATCHDOG)
+    esirem_quantum_main_watchdog_init(reset_cause);
+#endif
+    esirem_quantum_main_latency_init();
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT)
+    esirem_quantum_main_memstat_init();
+#endif
     esirem_quantum_main_settings_init();
     if (esirem_quantum_main_core_init())
     {
         LOG_ERR("CRITICAL: failed to init esirem_quantum_main core, entering infinite loop");
         while (1)
         {
+            esirem_quantum_main_watchdog_main_feed();
             k_sleep(K_MSEC(CONFIG_CODIUM_APP_MAIN_RUN_INTERVAL_MS));
         };
     }
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT)
+    esirem_quantum_main_trigger_input_init();
+#endif
     ble_init();
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP)
+    esirem_quantum_main_deepsleep_init();
+#endif
 
     for (;;)
     {
+        esirem_quantum_main_watchdog_main_feed();
         if (esirem_quantum_main_core_error_occured())
         {
             LOG_ERR("Error occured, cold rebooting");
+            esirem_quantum_main_odometer_flush();
+            esirem_quantum_main_eventlog_add(ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_REBOOT, 0);
+            esirem_quantum_main_eventlog_flush_sync();
             k_sleep(K_MSEC(1000));
             sys_reboot(SYS_REBOOT_COLD);
         }
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_TRACE)
+        esirem_quantum_main_trace_process();
+#endif
         k_sleep(K_MSEC(CONFIG_CODIUM_APP_MAIN_RUN_INTERVAL_MS));
     }
 }
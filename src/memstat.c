@@ -0,0 +1,265 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * memstat.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Les piles sont remplies d'un motif au demarrage (CONFIG_INIT_STACKS).
+ * Un echantillonnage periodique depuis la file d'attente systeme mesure la
+ * zone jamais ecrasee de chaque thread et conserve le pire cas. Le motif ne
+ * pouvant etre restaure, la mesure est deja un maximum depuis le boot.
+ * - Le parcours des threads se fait sans verrou : les threads de
+ * l'application sont statiques, la liste ne change pas apres le demarrage.
+ * - Le tas malloc de la libc minimale n'expose aucune statistique : les
+ * appels malloc/calloc/realloc/free sont rediriges a l'edition de liens
+ * (--wrap) vers des fonctions qui prefixent chaque bloc de sa taille et
+ * tiennent le compte des octets alloues.
+ */
+
+#include <include/memstat.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/math_extras.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_memstat, CONFIG_LOG_MAX_LEVEL);
+
+struct memstat_stack_entry
+{
+    const struct k_thread* thread;
+    struct esirem_quantum_main_memstat_stack stat;
+};
+
+static struct memstat_stack_entry
+    memstat_stacks[CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT_MAX_THREADS];
+static uint8_t memstat_stack_count = 0;
+static K_MUTEX_DEFINE(memstat_stack_mutex);
+
+static void memstat_sample_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(memstat_sample_work, memstat_sample_work_fn);
+
+static void memstat_thread_cb(const struct k_thread* thread, void* user_data)
+{
+    struct memstat_stack_entry* entry = NULL;
+    const char* name;
+    size_t unused;
+    uint32_t used;
+
+    if (k_thread_stack_space_get(thread, &unused))
+    {
+        return;
+    }
+    used = (uint32_t) (thread->stack_info.size - unused);
+
+    for (uint8_t i = 0; i < memstat_stack_count; i++)
+    {
+        if (memstat_stacks[i].thread == thread)
+        {
+            entry = &memstat_stacks[i];
+            break;
+        }
+    }
+
+    if (!entry)
+    {
+        if (memstat_stack_count >= ARRAY_SIZE(memstat_stacks))
+        {
+            return;
+        }
+
+        entry         = &memstat_stacks[memstat_stack_count++];
+        entry->thread = thread;
+        entry->stat.size = (uint32_t) thread->stack_info.size;
+
+        name = k_thread_name_get((k_tid_t) thread);
+        strncpy(entry->stat.name, name ? name : "", sizeof(entry->stat.name));
+    }
+
+    entry->stat.max_used = MAX(entry->stat.max_used, used);
+}
+
+void esirem_quantum_main_memstat_sample(void)
+{
+    k_mutex_lock(&memstat_stack_mutex, K_FOREVER);
+    k_thread_foreach_unlocked(memstat_thread_cb, NULL);
+    k_mutex_unlock(&memstat_stack_mutex);
+}
+
+static void memstat_sample_work_fn(struct k_work* work)
+{
+    esirem_quantum_main_memstat_sample();
+    k_work_schedule(
+        &memstat_sample_work, K_SECONDS(CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT_SAMPLE_INTERVAL_S));
+}
+
+uint8_t esirem_quantum_main_memstat_get_stacks(
+    struct esirem_quantum_main_memstat_stack* stacks, uint8_t max_count)
+{
+    uint8_t count;
+
+    k_mutex_lock(&memstat_stack_mutex, K_FOREVER);
+    count = MIN(memstat_stack_count, max_count);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        stacks[i] = memstat_stacks[i].stat;
+    }
+    k_mutex_unlock(&memstat_stack_mutex);
+
+    return count;
+}
+
+int esirem_quantum_main_memstat_init(void)
+{
+    k_work_schedule(&memstat_sample_work, K_NO_WAIT);
+    return 0;
+}
+
+/*
+ * Comptage du tas malloc
+ */
+
+static atomic_t memstat_heap_cur = ATOMIC_INIT(0);
+static atomic_t memstat_heap_max = ATOMIC_INIT(0);
+
+void esirem_quantum_main_memstat_get_heap(struct esirem_quantum_main_memstat_heap* heap)
+{
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT_HEAP)
+    heap->arena_size = CONFIG_MINIMAL_LIBC_MALLOC_ARENA_SIZE;
+#else
+    heap->arena_size = 0;
+#endif
+    heap->cur_used = (uint32_t) atomic_get(&memstat_heap_cur);
+    heap->max_used = (uint32_t) atomic_get(&memstat_heap_max);
+}
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT_HEAP)
+
+/* Entete de 8 octets pour conserver l'alignement rendu par la libc */
+#define MEMSTAT_HEAP_HDR_SZ (8)
+
+void* __real_malloc(size_t size);
+void* __real_realloc(void* ptr, size_t size);
+void __real_free(void* ptr);
+
+static void memstat_heap_add(size_t size)
+{
+    atomic_val_t cur = atomic_add(&memstat_heap_cur, (atomic_val_t) size) + (atomic_val_t) size;
+    atomic_val_t max;
+
+    do
+    {
+        max = atomic_get(&memstat_heap_max);
+        if (cur <= max)
+        {
+            break;
+        }
+    } while (!atomic_cas(&memstat_heap_max, max, cur));
+}
+
+static void* memstat_heap_track(uint8_t* hdr, size_t size)
+{
+    if (!hdr)
+    {
+        return NULL;
+    }
+
+    *(size_t*) hdr = size;
+    memstat_heap_add(size);
+    return hdr + MEMSTAT_HEAP_HDR_SZ;
+}
+
+void* __wrap_malloc(size_t size)
+{
+    if (size > SIZE_MAX - MEMSTAT_HEAP_HDR_SZ)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    return memstat_heap_track(__real_malloc(size + MEMSTAT_HEAP_HDR_SZ), size);
+}
+
+void* __wrap_calloc(size_t nmemb, size_t size)
+{
+    size_t total;
+    void* ptr;
+
+    if (size_mul_overflow(nmemb, size, &total))
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    ptr = __wrap_malloc(total);
+    if (ptr)
+    {
+        memset(ptr, 0, total);
+    }
+    return ptr;
+}
+
+void __wrap_free(void* ptr)
+{
+    uint8_t* hdr;
+
+    if (!ptr)
+    {
+        return;
+    }
+
+    hdr = (uint8_t*) ptr - MEMSTAT_HEAP_HDR_SZ;
+    atomic_sub(&memstat_heap_cur, (atomic_val_t) * (size_t*) hdr);
+    __real_free(hdr);
+}
+
+void* __wrap_realloc(void* ptr, size_t size)
+{
+    uint8_t* hdr;
+    size_t old_size;
+
+    if (!ptr)
+    {
+        return __wrap_malloc(size);
+    }
+
+    if (!size)
+    {
+        __wrap_free(ptr);
+        return NULL;
+    }
+
+    if (size > SIZE_MAX - MEMSTAT_HEAP_HDR_SZ)
+    {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    hdr      = (uint8_t*) ptr - MEMSTAT_HEAP_HDR_SZ;
+    old_size = *(size_t*) hdr;
+
+    /* En cas d'echec l'ancien bloc reste valide et compte */
+    hdr = __real_realloc(hdr, size + MEMSTAT_HEAP_HDR_SZ);
+    if (!hdr)
+    {
+        return NULL;
+    }
+
+    atomic_sub(&memstat_heap_cur, (atomic_val_t) old_size);
+    return memstat_heap_track(hdr, size);
+}
+
+#endif // CONFIG_ESIREM_QUANTUM_MAIN_MEMSTAT_HEAP
@@ -0,0 +1,445 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * mesh.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Le noeud est provisionne (PB-ADV ou PB-GATT) puis abonne a une adresse
+ * de groupe par le provisionneur : une seule publication atteint alors
+ * toutes les cartes du groupe, relayee de proche en proche.
+ * - Generic OnOff Set -> declenchement / arret du core, Generic OnOff Get ->
+ * etat courant. Les changements d'etat du core sont publies.
+ * - Le modele vendeur ecrit les parametres de sequence par l'API settings
+ * (meme chemin que le service BLE configuration).
+ * - Le declenchement vendeur porte le TTL initial et l'horodatage d'emission
+ * (base de temps du central, voir clock_sync.c) : le noeud en deduit le
+ * nombre de sauts et, s'il est synchronise, la latence de bout en bout.
+ *
+ * La publication des modeles remplace l'advertising connectable de
+ * l'application : le proxy GATT mesh reste connectable et donne acces aux
+ * services BLE de la carte.
+ */
+
+#include <include/clock_sync.h>
+#include <include/common.h>
+#include <include/core.h>
+#include <include/eventlog.h>
+#include <include/mesh.h>
+#include <include/odometer.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <bluetooth/bluetooth.h>
+#include <bluetooth/mesh.h>
+#include <drivers/hwinfo.h>
+#include <settings/settings.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_mesh, CONFIG_LOG_MAX_LEVEL);
+
+#define MESH_CID CONFIG_ESIREM_QUANTUM_MAIN_MESH_COMPANY_ID
+
+#define MESH_OP_GEN_ONOFF_GET       BT_MESH_MODEL_OP_2(0x82, 0x01)
+#define MESH_OP_GEN_ONOFF_SET       BT_MESH_MODEL_OP_2(0x82, 0x02)
+#define MESH_OP_GEN_ONOFF_SET_UNACK BT_MESH_MODEL_OP_2(0x82, 0x03)
+#define MESH_OP_GEN_ONOFF_STATUS    BT_MESH_MODEL_OP_2(0x82, 0x04)
+
+#define MESH_OP_VND(_op) BT_MESH_MODEL_OP_3(_op, MESH_CID)
+
+/**@brief Duree pendant laquelle un meme TID d'une meme source est ignore */
+#define MESH_GEN_ONOFF_TID_TIMEOUT_MS (6000)
+
+/**@brief Taille de la charge utile d'un declenchement vendeur :
+ * onoff (1) + TTL initial (1) + horodatage d'emission (8) */
+#define MESH_VND_TRIG_LEN (2 + sizeof(int64_t))
+
+/**@brief Taille des statistiques transmises (voir mesh_vnd_stats_get) */
+#define MESH_VND_STATS_LEN (4 + 1 + 1 + 4 + 4 + 4 + 4 + 4)
+
+static uint8_t mesh_dev_uuid[16];
+
+static struct k_spinlock mesh_stats_lock;
+static struct esirem_quantum_main_mesh_stats mesh_stats = {
+    .hop_min        = UINT8_MAX,
+    .latency_min_us = UINT32_MAX,
+};
+
+static uint16_t mesh_gen_onoff_last_src = BT_MESH_ADDR_UNASSIGNED;
+static uint8_t mesh_gen_onoff_last_tid  = 0;
+static int64_t mesh_gen_onoff_last_ts   = 0;
+
+static int mesh_apply_onoff(bool onoff)
+{
+    int status;
+
+    if (onoff)
+    {
+        status = esirem_quantum_main_core_trig_new_cycle();
+    }
+    else
+    {
+        status = esirem_quantum_main_core_stop_cycle();
+    }
+
+    if (status)
+    {
+        LOG_DBG("Mesh onoff %u refused, err: %d", onoff, status);
+    }
+    return status;
+}
+
+/*
+ * Generic OnOff server
+ */
+
+BT_MESH_MODEL_PUB_DEFINE(mesh_gen_onoff_pub, NULL, 2 + 1);
+
+static void mesh_gen_onoff_status_send(
+    struct bt_mesh_model* model, struct bt_mesh_msg_ctx* ctx)
+{
+    BT_MESH_MODEL_BUF_DEFINE(msg, MESH_OP_GEN_ONOFF_STATUS, 1);
+
+    bt_mesh_model_msg_init(&msg, MESH_OP_GEN_ONOFF_STATUS);
+    net_buf_simple_add_u8(&msg, esirem_quantum_main_core_device_running() ? 1 : 0);
+
+    if (bt_mesh_model_send(model, ctx, &msg, NULL, NULL))
+    {
+        LOG_ERR("Failed to send onoff status");
+    }
+}
+
+static void mesh_gen_onoff_get(
+    struct bt_mesh_model* model, struct bt_mesh_msg_ctx* ctx,
+    struct net_buf_simple* buf)
+{
+    mesh_gen_onoff_status_send(model, ctx);
+}
+
+static bool mesh_gen_onoff_set_common(
+    struct bt_mesh_msg_ctx* ctx, struct net_buf_simple* buf)
+{
+    uint8_t onoff = net_buf_simple_pull_u8(buf);
+    uint8_t tid   = net_buf_simple_pull_u8(buf);
+    int64_t now   = k_uptime_get();
+
+    /* Les messages sont retransmis par les relais : un meme TID recu de la
+     * meme source dans la fenetre de 6 s est une repetition */
+    if (ctx->addr == mesh_gen_onoff_last_src && tid == mesh_gen_onoff_last_tid
+        && (now - mesh_gen_onoff_last_ts) < MESH_GEN_ONOFF_TID_TIMEOUT_MS)
+    {
+        return false;
+    }
+    mesh_gen_onoff_last_src = ctx->addr;
+    mesh_gen_onoff_last_tid = tid;
+    mesh_gen_onoff_last_ts  = now;
+
+    mesh_apply_onoff(onoff != 0);
+    return true;
+}
+
+static void mesh_gen_onoff_set(
+    struct bt_mesh_model* model, struct bt_mesh_msg_ctx* ctx,
+    struct net_buf_simple* buf)
+{
+    mesh_gen_onoff_set_common(ctx, buf);
+    mesh_gen_onoff_status_send(model, ctx);
+}
+
+static void mesh_gen_onoff_set_unack(
+    struct bt_mesh_model* model, struct bt_mesh_msg_ctx* ctx,
+    struct net_buf_simple* buf)
+{
+    mesh_gen_onoff_set_common(ctx, buf);
+}
+
+static const struct bt_mesh_model_op mesh_gen_onoff_srv_op[] = {
+    {MESH_OP_GEN_ONOFF_GET, 0, mesh_gen_onoff_get},
+    {MESH_OP_GEN_ONOFF_SET, 2, mesh_gen_onoff_set},
+    {MESH_OP_GEN_ONOFF_SET_UNACK, 2, mesh_gen_onoff_set_unack},
+    BT_MESH_MODEL_OP_END,
+};
+
+/*
+ * Modele vendeur
+ */
+
+BT_MESH_MODEL_PUB_DEFINE(mesh_vnd_pub, NULL, 3 + MESH_VND_STATS_LEN);
+
+static void mesh_vnd_config_status_send(
+    struct bt_mesh_model* model, struct bt_mesh_msg_ctx* ctx)
+{
+    BT_MESH_MODEL_BUF_DEFINE(
+        msg, MESH_OP_VND(ESIREM_QUANTUM_MAIN_MESH_VND_OP_CONFIG_STATUS),
+        ESIREM_QUANTUM_MAIN_CORE_SETTINGS_MAX_COUNT * sizeof(uint32_t));
+    uint32_t size = esirem_quantum_main_core_setting_get_map_uuid_keyptr_size();
+
+    bt_mesh_model_msg_init(&msg, MESH_OP_VND(ESIREM_QUANTUM_MAIN_MESH_VND_OP_CONFIG_STATUS));
+    for (uint32_t i = 0; i < size; i++)
+    {
+        net_buf_simple_add_le32(
+            &msg, (uint32_t) atomic_get(
+                      (atomic_t*) esirem_quantum_main_core_setting_map_uuid_keyptr[i].ptrval));
+    }
+
+    if (bt_mesh_model_send(model, ctx, &msg, NULL, NULL))
+    {
+        LOG_ERR("Failed to send config status");
+    }
+}
+
+static void mesh_vnd_config_get(
+    struct bt_mesh_model* model, struct bt_mesh_msg_ctx* ctx,
+    struct net_buf_simple* buf)
+{
+    mesh_vnd_config_status_send(model, ctx);
+}
+
+/* Ecriture de tous les parametres, dans l'ordre de la table
+ * esirem_quantum_main_core_setting_map_uuid_keyptr */
+static void mesh_vnd_config_set(
+    struct bt_mesh_model* model, struct bt_mesh_msg_ctx* ctx,
+    struct net_buf_simple* buf)
+{
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    enum esirem_quantum_main_core_setting_check_result result;
+    int status;
+
+    if (buf->len != sizeof(values))
+    {
+        LOG_ERR("Invalid mesh config size");
+        return;
+    }
+
+    for (uint32_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        values[i] = net_buf_simple_pull_le32(buf);
+    }
+
+    /* Valide en une passe, sauvegarde puis publie : le status renvoie les
+     * valeurs courantes, inchangees en cas de refus ou d'echec d'ecriture */
+    status = esirem_quantum_main_core_settings_store(values, &result, NULL, NULL);
+    if (result != ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK)
+    {
+        LOG_ERR("Mesh config refused, rule %u", result);
+    }
+    else if (status)
+    {
+        LOG_ERR("Failed to save settings to flash, err: %d", status);
+    }
+    else
+    {
+        esirem_quantum_main_odometer_add(ESIREM_QUANTUM_MAIN_ODOMETER_CONFIG_WRITES, 1);
+        esirem_quantum_main_eventlog_add(
+            ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_CONFIG_WRITE,
+            esirem_quantum_main_core_setting_get_generation());
+    }
+
+    mesh_vnd_config_status_send(model, ctx);
+}
+
+static void mesh_vnd_trig(
+    struct bt_mesh_model* model, struct bt_mesh_msg_ctx* ctx,
+    struct net_buf_simple* buf)
+{
+    uint8_t onoff       = net_buf_simple_pull_u8(buf);
+    uint8_t initial_ttl = net_buf_simple_pull_u8(buf);
+    int64_t origin_us   = (int64_t) net_buf_simple_pull_le64(buf);
+    int64_t now_us      = 0;
+    uint8_t hops        = 0;
+    k_spinlock_key_t key;
+
+    mesh_apply_onoff(onoff != 0);
+
+    /* Chaque relais decremente le TTL d'une unite */
+    if (initial_ttl >= ctx->recv_ttl)
+    {
+        hops = initial_ttl - ctx->recv_ttl;
+    }
+
+    key = k_spin_lock(&mesh_stats_lock);
+    mesh_stats.rx_count++;
+    mesh_stats.hop_sum += hops;
+    mesh_stats.hop_min = MIN(mesh_stats.hop_min, hops);
+    mesh_stats.hop_max = MAX(mesh_stats.hop_max, hops);
+
+    if (!esirem_quantum_main_clock_sync_central_us(&now_us) && now_us >= origin_us
+        && (now_us - origin_us) <= UINT32_MAX)
+    {
+        uint32_t latency_us = (uint32_t) (now_us - origin_us);
+
+        mesh_stats.latency_count++;
+        mesh_stats.latency_sum_us += latency_us;
+        mesh_stats.latency_min_us = MIN(mesh_stats.latency_min_us, latency_us);
+        mesh_stats.latency_max_us = MAX(mesh_stats.latency_max_us, latency_us);
+    }
+    k_spin_unlock(&mesh_stats_lock, key);
+}
+
+static void mesh_vnd_stats_get(
+    struct bt_mesh_model* model, struct bt_mesh_msg_ctx* ctx,
+    struct net_buf_simple* buf)
+{
+    BT_MESH_MODEL_BUF_DEFINE(
+        msg, MESH_OP_VND(ESIREM_QUANTUM_MAIN_MESH_VND_OP_STATS_STATUS), MESH_VND_STATS_LEN);
+    struct esirem_quantum_main_mesh_stats stats;
+
+    esirem_quantum_main_mesh_get_stats(&stats);
+
+    bt_mesh_model_msg_init(&msg, MESH_OP_VND(ESIREM_QUANTUM_MAIN_MESH_VND_OP_STATS_STATUS));
+    net_buf_simple_add_le32(&msg, stats.rx_count);
+    net_buf_simple_add_u8(&msg, stats.hop_min);
+    net_buf_simple_add_u8(&msg, stats.hop_max);
+    net_buf_simple_add_le32(&msg, stats.hop_sum);
+    net_buf_simple_add_le32(&msg, stats.latency_count);
+    net_buf_simple_add_le32(&msg, stats.latency_min_us);
+    net_buf_simple_add_le32(&msg, stats.latency_max_us);
+    net_buf_simple_add_le32(
+        &msg, stats.latency_count ? (uint32_t) (stats.latency_sum_us / stats.latency_count) : 0);
+
+    if (bt_mesh_model_send(model, ctx, &msg, NULL, NULL))
+    {
+        LOG_ERR("Failed to send stats status");
+    }
+}
+
+static const struct bt_mesh_model_op mesh_vnd_op[] = {
+    {MESH_OP_VND(ESIREM_QUANTUM_MAIN_MESH_VND_OP_CONFIG_GET), 0, mesh_vnd_config_get},
+    {MESH_OP_VND(ESIREM_QUANTUM_MAIN_MESH_VND_OP_CONFIG_SET), sizeof(uint32_t),
+     mesh_vnd_config_set},
+    {MESH_OP_VND(ESIREM_QUANTUM_MAIN_MESH_VND_OP_TRIG), MESH_VND_TRIG_LEN, mesh_vnd_trig},
+    {MESH_OP_VND(ESIREM_QUANTUM_MAIN_MESH_VND_OP_STATS_GET), 0, mesh_vnd_stats_get},
+    BT_MESH_MODEL_OP_END,
+};
+
+/*
+ * Composition du noeud
+ */
+
+static struct bt_mesh_model mesh_root_models[] = {
+    BT_MESH_MODEL_CFG_SRV,
+    BT_MESH_MODEL(
+        BT_MESH_MODEL_ID_GEN_ONOFF_SRV, mesh_gen_onoff_srv_op, &mesh_gen_onoff_pub, NULL),
+};
+
+static struct bt_mesh_model mesh_vnd_models[] = {
+    BT_MESH_MODEL_VND(
+        MESH_CID, ESIREM_QUANTUM_MAIN_MESH_VND_MODEL_ID, mesh_vnd_op, &mesh_vnd_pub, NULL),
+};
+
+static struct bt_mesh_elem mesh_elements[] = {
+    BT_MESH_ELEM(0, mesh_root_models, mesh_vnd_models),
+};
+
+static const struct bt_mesh_comp mesh_comp = {
+    .cid        = MESH_CID,
+    .elem       = mesh_elements,
+    .elem_count = ARRAY_SIZE(mesh_elements),
+};
+
+static void mesh_prov_complete(uint16_t net_idx, uint16_t addr)
+{
+    LOG_DBG("Mesh provisioned, addr 0x%04x", addr);
+}
+
+static void mesh_prov_reset(void)
+{
+    bt_mesh_prov_enable(BT_MESH_PROV_ADV | BT_MESH_PROV_GATT);
+}
+
+static const struct bt_mesh_prov mesh_prov = {
+    .uuid     = mesh_dev_uuid,
+    .complete = mesh_prov_complete,
+    .reset    = mesh_prov_reset,
+};
+
+/* Publication de l'etat du core (appele a chaque debut / fin de cycle) */
+void esirem_quantum_main_mesh_state_publish(bool device_state)
+{
+    struct bt_mesh_model* model = &mesh_root_models[1];
+    int err;
+
+    if (!bt_mesh_is_provisioned() || model->pub->addr == BT_MESH_ADDR_UNASSIGNED)
+    {
+        return;
+    }
+
+    bt_mesh_model_msg_init(model->pub->msg, MESH_OP_GEN_ONOFF_STATUS);
+    net_buf_simple_add_u8(model->pub->msg, device_state ? 1 : 0);
+
+    err = bt_mesh_model_publish(model);
+    if (err)
+    {
+        LOG_ERR("Failed to publish onoff state, err: %d", err);
+    }
+}
+
+void esirem_quantum_main_mesh_get_stats(struct esirem_quantum_main_mesh_stats* stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&mesh_stats_lock);
+
+    memcpy(stats, &mesh_stats, sizeof(*stats));
+    k_spin_unlock(&mesh_stats_lock, key);
+}
+
+struct bt_mesh_elem* esirem_quantum_main_mesh_elem(void)
+{
+    return &mesh_elements[0];
+}
+
+/* A appeler apres bt_enable et avant settings_load : la pile mesh restaure
+ * son etat de provisionnement depuis les settings */
+int esirem_quantum_main_mesh_init(void)
+{
+    ssize_t id_len;
+    int err;
+
+    id_len = hwinfo_get_device_id(mesh_dev_uuid, sizeof(mesh_dev_uuid));
+    if (id_len < 0)
+    {
+        LOG_ERR("Failed to get device id, err: %d", (int) id_len);
+    }
+
+    err = bt_mesh_init(&mesh_prov, &mesh_comp);
+    if (err)
+    {
+        LOG_ERR("Failed to init mesh, err: %d", err);
+        return err;
+    }
+    LOG_DBG("Mesh initialized");
+
+    return 0;
+}
+
+/* A appeler apres settings_load */
+int esirem_quantum_main_mesh_start(void)
+{
+    int err;
+
+    if (bt_mesh_is_provisioned())
+    {
+        return 0;
+    }
+
+    err = bt_mesh_prov_enable(BT_MESH_PROV_ADV | BT_MESH_PROV_GATT);
+    if (err)
+    {
+        LOG_ERR("Failed to enable mesh provisioning, err: %d", err);
+        return err;
+    }
+    LOG_DBG("Mesh provisioning enabled");
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * odometer.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Les compteurs sont une partie sauvegardee de la RAM retenue (voir
+ * retained.c), sauvegardee aussi immediatement avant un redemarrage
+ * volontaire.
+ * - Le demarrage est compte avant le chargement des settings : il s'ajoute
+ * a la valeur de la flash apres un demarrage a froid.
+ */
+
+#include <include/odometer.h>
+#include <include/retained.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <settings/settings.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_odometer, CONFIG_LOG_MAX_LEVEL);
+
+#define ODOMETER_SETTINGS_KEY_MODULE   "esirem_quantum_main_odo"
+#define ODOMETER_SETTINGS_KEY_COUNTERS "counters"
+
+static void odometer_merge(void* data, const void* saved);
+
+static ESIREM_QUANTUM_MAIN_RETAINED_STORE_DEFINE(
+    odometer_store, ODOMETER_SETTINGS_KEY_MODULE "/" ODOMETER_SETTINGS_KEY_COUNTERS, odometer,
+    CONFIG_ESIREM_QUANTUM_MAIN_ODOMETER_FLUSH_INTERVAL_S, NULL, odometer_merge);
+
+void esirem_quantum_main_odometer_add(
+    enum esirem_quantum_main_odometer_counter counter, uint32_t value)
+{
+    k_spinlock_key_t key;
+
+    if (counter >= ESIREM_QUANTUM_MAIN_ODOMETER_COUNT || !value)
+    {
+        return;
+    }
+
+    key = k_spin_lock(&odometer_store.lock);
+    esirem_quantum_main_retained.odometer.counters[counter] += value;
+    odometer_store.dirty = true;
+    k_spin_unlock(&odometer_store.lock, key);
+
+    esirem_quantum_main_retained_update();
+}
+
+void esirem_quantum_main_odometer_get(struct esirem_quantum_main_odometer* odometer)
+{
+    k_spinlock_key_t key = k_spin_lock(&odometer_store.lock);
+
+    memcpy(odometer, &esirem_quantum_main_retained.odometer, sizeof(*odometer));
+    k_spin_unlock(&odometer_store.lock, key);
+}
+
+int esirem_quantum_main_odometer_flush(void)
+{
+    return esirem_quantum_main_retained_store_flush(&odometer_store);
+}
+
+int esirem_quantum_main_odometer_init(void)
+{
+    esirem_quantum_main_odometer_add(ESIREM_QUANTUM_MAIN_ODOMETER_REBOOTS, 1);
+    esirem_quantum_main_retained_store_start(&odometer_store);
+
+    return 0;
+}
+
+/*
+ * Gestion des parametres : compteurs sauvegardes en flash
+ */
+
+static void odometer_merge(void* data, const void* saved)
+{
+    struct esirem_quantum_main_odometer* odometer             = data;
+    const struct esirem_quantum_main_odometer* saved_odometer = saved;
+
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_ODOMETER_COUNT; i++)
+    {
+        odometer->counters[i] += saved_odometer->counters[i];
+    }
+}
+
+static int odometer_settings_set(
+    const char* name, size_t len, settings_read_cb read_cb, void* cb_arg)
+{
+    const char* next;
+
+    if (!settings_name_steq(name, ODOMETER_SETTINGS_KEY_COUNTERS, &next) || next)
+    {
+        return -ENOENT;
+    }
+
+    return esirem_quantum_main_retained_store_load(&odometer_store, len, read_cb, cb_arg);
+}
+
+struct settings_handler esirem_quantum_main_odometer_settings_hdlrs = {
+    .name  = ODOMETER_SETTINGS_KEY_MODULE,
+    .h_set = odometer_settings_set,
+};
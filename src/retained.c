@@ -0,0 +1,188 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * retained.c - 07/12/2021
+ * Donnees conservees en RAM au travers d'un reset a chaud
+ *
+ * Chaque module modifie sa partie de la zone sous son propre verrou puis
+ * appelle esirem_quantum_main_retained_update pour recalculer le CRC.
+ *
+ * Fonctionnement des parties sauvegardees en flash (stats, odometre) :
+ *
+ * - Les compteurs survivent a un reset a chaud sans ecriture flash.
+ * - Ils sont sauvegardes par les settings a intervalle long, uniquement
+ * s'ils ont change, pour limiter l'usure. Un echec est retente a
+ * l'echeance suivante.
+ * - Au demarrage a froid la RAM retenue est remise a zero : les valeurs de
+ * la flash y sont ajoutees au chargement des settings, ce qui conserve les
+ * evenements comptes entre le reset et le chargement. On perd au plus un
+ * intervalle de sauvegarde.
+ * - Apres un reset a chaud la RAM retenue est plus recente que la flash et
+ * la valeur sauvegardee est ignoree.
+ */
+
+#include <include/retained.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/crc.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_retained, CONFIG_LOG_MAX_LEVEL);
+
+#define RETAINED_MAGIC 0x45514d52 /* "EQMR" */
+
+#define RETAINED_CRC_OFFSET (offsetof(struct esirem_quantum_main_retained, crc) + sizeof(uint32_t))
+
+__noinit struct esirem_quantum_main_retained esirem_quantum_main_retained;
+
+static struct k_spinlock retained_lock;
+static bool retained_was_valid = false;
+
+static uint32_t retained_crc(void)
+{
+    return crc32_ieee(
+        (const uint8_t*) &esirem_quantum_main_retained + RETAINED_CRC_OFFSET,
+        sizeof(esirem_quantum_main_retained) - RETAINED_CRC_OFFSET);
+}
+
+/* Valide la zone au demarrage, la remet a zero si elle est invalide.
+ * Renvoie true si les donnees d'avant le reset ont ete conservees. */
+bool esirem_quantum_main_retained_init(void)
+{
+    if (esirem_quantum_main_retained.magic == RETAINED_MAGIC
+        && esirem_quantum_main_retained.crc == retained_crc())
+    {
+        LOG_DBG("Retained RAM valid");
+        retained_was_valid = true;
+        return true;
+    }
+
+    LOG_DBG("Retained RAM invalid, clearing");
+    memset(&esirem_quantum_main_retained, 0, sizeof(esirem_quantum_main_retained));
+    esirem_quantum_main_retained.magic = RETAINED_MAGIC;
+    esirem_quantum_main_retained_update();
+    retained_was_valid = false;
+    return false;
+}
+
+bool esirem_quantum_main_retained_was_valid(void)
+{
+    return retained_was_valid;
+}
+
+void esirem_quantum_main_retained_update(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&retained_lock);
+
+    esirem_quantum_main_retained.crc = retained_crc();
+    k_spin_unlock(&retained_lock, key);
+}
+
+/*
+ * Parties sauvegardees en flash
+ */
+
+static void retained_store_flush_work_fn(struct k_work* work)
+{
+    struct k_work_delayable* dwork = k_work_delayable_from_work(work);
+    struct esirem_quantum_main_retained_store* store =
+        CONTAINER_OF(dwork, struct esirem_quantum_main_retained_store, flush_work);
+
+    esirem_quantum_main_retained_store_flush(store);
+    k_work_schedule(&store->flush_work, K_SECONDS(store->flush_interval_s));
+}
+
+void esirem_quantum_main_retained_store_start(struct esirem_quantum_main_retained_store* store)
+{
+    k_work_init_delayable(&store->flush_work, retained_store_flush_work_fn);
+    k_work_schedule(&store->flush_work, K_SECONDS(store->flush_interval_s));
+}
+
+int esirem_quantum_main_retained_store_flush(struct esirem_quantum_main_retained_store* store)
+{
+    uint64_t data[ESIREM_QUANTUM_MAIN_RETAINED_STORE_MAX_SIZE / sizeof(uint64_t)];
+    k_spinlock_key_t key = k_spin_lock(&store->lock);
+    bool dirty;
+    int status;
+
+    if (store->prepare)
+    {
+        store->prepare(store->data);
+    }
+    memcpy(data, store->data, store->size);
+    dirty        = store->dirty;
+    store->dirty = false;
+    k_spin_unlock(&store->lock, key);
+
+    if (store->prepare)
+    {
+        esirem_quantum_main_retained_update();
+    }
+
+    if (!dirty)
+    {
+        return 0;
+    }
+
+    status = settings_save_one(store->key, data, store->size);
+    if (status)
+    {
+        LOG_ERR("Failed to save %s, err: %d", store->key, status);
+        /* Nouvelle tentative a la prochaine echeance */
+        key          = k_spin_lock(&store->lock);
+        store->dirty = true;
+        k_spin_unlock(&store->lock, key);
+    }
+
+    return status;
+}
+
+int esirem_quantum_main_retained_store_load(
+    struct esirem_quantum_main_retained_store* store, size_t len, settings_read_cb read_cb,
+    void* cb_arg)
+{
+    /* Aligne comme les compteurs 64 bits de la RAM retenue */
+    uint64_t saved[ESIREM_QUANTUM_MAIN_RETAINED_STORE_MAX_SIZE / sizeof(uint64_t)];
+    k_spinlock_key_t key;
+    int status;
+
+    if (retained_was_valid)
+    {
+        return 0;
+    }
+
+    if (len != store->size)
+    {
+        LOG_ERR("Invalid size");
+        return -EINVAL;
+    }
+
+    status = read_cb(cb_arg, saved, store->size);
+    if (status < 0)
+    {
+        LOG_ERR("Failed to read settings value");
+        return status;
+    }
+
+    key = k_spin_lock(&store->lock);
+    store->merge(store->data, saved);
+    /* La flash ne contient pas les evenements comptes avant le chargement */
+    store->dirty = true;
+    k_spin_unlock(&store->lock, key);
+
+    esirem_quantum_main_retained_update();
+    return 0;
+}
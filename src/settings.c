@@ -35,7 +35,11 @@
 #include <settings/settings.h>
 #include <storage/flash_map.h>
 
+#include <include/ble_beacon_trigger.h>
+#include <include/ble_service_prov.h>
 #include <include/core.h>
+#include <include/odometer.h>
+#include <include/stats.h>
 
 LOG_MODULE_REGISTER(esirem_quantum_main_settings, CONFIG_LOG_MAX_LEVEL);
 
@@ -63,6 +67,12 @@ BT_UUID_DIS_PNP_ID -> donnees d'identification fournisseur supplementaires
  */
 
 const uint32_t settings_val_max_percent = 100;
+/* Bornes des durees et du courant LED, voir aussi les regles entre
+ * parametres dans core.c */
+const uint32_t settings_val_max_duration_ms     = 60000;
+const uint32_t settings_val_max_seq_duration_ms = 86400000;
+const uint32_t settings_val_max_current_ua      = 1000000;
+const uint32_t settings_val_max_seq_mode        = ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_EXACT;
 
 int esirem_quantum_main_settings_init()
 {
@@ -78,6 +88,14 @@ int esirem_quantum_main_settings_init()
     LOG_DBG(STR_LOG_SUCCESS);
 
     settings_register(&esirem_quantum_main_core_settings_hdlrs);
+    settings_register(&esirem_quantum_main_stats_settings_hdlrs);
+    settings_register(&esirem_quantum_main_odometer_settings_hdlrs);
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER)
+    settings_register(&esirem_quantum_main_beacon_trigger_settings_hdlrs);
+#endif
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_PROVISION)
+    settings_register(&esirem_quantum_main_prov_settings_hdlrs);
+#endif
 
     return 0;
 }
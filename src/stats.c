@@ -0,0 +1,184 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * stats.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Le core signale chaque changement d'etat : le temps passe dans l'etat
+ * precedent est ajoute au compteur de residence correspondant.
+ * - Les compteurs sont une partie sauvegardee de la RAM retenue (voir
+ * retained.c).
+ * - L'energie LED est estimee a la lecture a partir du temps ON, du courant
+ * LED configure et de la tension d'alimentation (Kconfig).
+ */
+
+#include <include/core.h>
+#include <include/odometer.h>
+#include <include/retained.h>
+#include <include/stats.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <settings/settings.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_stats, CONFIG_LOG_MAX_LEVEL);
+
+#define STATS_SETTINGS_KEY_MODULE   "esirem_quantum_main_stats"
+#define STATS_SETTINGS_KEY_COUNTERS "counters"
+
+static void stats_prepare(void* data);
+static void stats_merge(void* data, const void* saved);
+
+static ESIREM_QUANTUM_MAIN_RETAINED_STORE_DEFINE(
+    stats_store, STATS_SETTINGS_KEY_MODULE "/" STATS_SETTINGS_KEY_COUNTERS, stats,
+    CONFIG_ESIREM_QUANTUM_MAIN_STATS_FLUSH_INTERVAL_S, stats_prepare, stats_merge);
+
+static enum esirem_quantum_main_stats_state stats_cur_state = ESIREM_QUANTUM_MAIN_STATS_STATE_IDLE;
+static int64_t stats_cur_state_ts                           = 0;
+
+/* A appeler verrou pris : cumule le temps passe dans l'etat courant */
+static void stats_accumulate_locked(void)
+{
+    int64_t now = k_uptime_get();
+    int64_t delta = now - stats_cur_state_ts;
+
+    esirem_quantum_main_retained.stats.residency_ms[stats_cur_state] += (uint64_t) delta;
+    if (stats_cur_state == ESIREM_QUANTUM_MAIN_STATS_STATE_ON)
+    {
+        esirem_quantum_main_odometer_add(ESIREM_QUANTUM_MAIN_ODOMETER_LED_ON_MS, (uint32_t) delta);
+    }
+    stats_cur_state_ts = now;
+    stats_store.dirty  = true;
+}
+
+void esirem_quantum_main_stats_state_enter(enum esirem_quantum_main_stats_state state)
+{
+    k_spinlock_key_t key;
+
+    if (state >= ESIREM_QUANTUM_MAIN_STATS_STATE_COUNT)
+    {
+        return;
+    }
+
+    key = k_spin_lock(&stats_store.lock);
+    stats_accumulate_locked();
+    stats_cur_state = state;
+    k_spin_unlock(&stats_store.lock, key);
+
+    esirem_quantum_main_retained_update();
+}
+
+void esirem_quantum_main_stats_count(enum esirem_quantum_main_stats_counter counter)
+{
+    k_spinlock_key_t key = k_spin_lock(&stats_store.lock);
+
+    esirem_quantum_main_retained.stats.counters[counter]++;
+    stats_store.dirty = true;
+    k_spin_unlock(&stats_store.lock, key);
+
+    esirem_quantum_main_retained_update();
+}
+
+void esirem_quantum_main_stats_get(struct esirem_quantum_main_stats* stats)
+{
+    k_spinlock_key_t key = k_spin_lock(&stats_store.lock);
+    uint64_t on_ms;
+    uint64_t power_nw;
+
+    stats_accumulate_locked();
+    memcpy(&stats->counters, &esirem_quantum_main_retained.stats, sizeof(stats->counters));
+    k_spin_unlock(&stats_store.lock, key);
+
+    esirem_quantum_main_retained_update();
+
+    /* uA x mV = nW. Secondes et millisecondes sont converties separement :
+     * nW x s = nJ, sans debordement avant un siecle de temps ON a 1 A. */
+    on_ms    = stats->counters.residency_ms[ESIREM_QUANTUM_MAIN_STATS_STATE_ON];
+    power_nw = (uint64_t) esirem_quantum_main_core_get_led_current_ua()
+               * CONFIG_ESIREM_QUANTUM_MAIN_STATS_LED_VOLTAGE_MV;
+    stats->led_energy_uj = (on_ms / 1000) * power_nw / 1000 + (on_ms % 1000) * power_nw / 1000000;
+}
+
+void esirem_quantum_main_stats_reset(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&stats_store.lock);
+
+    memset(&esirem_quantum_main_retained.stats, 0, sizeof(esirem_quantum_main_retained.stats));
+    stats_cur_state_ts = k_uptime_get();
+    stats_store.dirty  = true;
+    k_spin_unlock(&stats_store.lock, key);
+
+    esirem_quantum_main_retained_update();
+    k_work_reschedule(&stats_store.flush_work, K_NO_WAIT);
+}
+
+void esirem_quantum_main_stats_flush(void)
+{
+    esirem_quantum_main_retained_store_flush(&stats_store);
+}
+
+/* A appeler apres esirem_quantum_main_retained_init */
+int esirem_quantum_main_stats_init(void)
+{
+    stats_cur_state_ts = k_uptime_get();
+    esirem_quantum_main_retained_store_start(&stats_store);
+
+    return 0;
+}
+
+/*
+ * Gestion des parametres : compteurs sauvegardes en flash
+ */
+
+/* Le temps passe dans l'etat courant est sauvegarde avec les autres */
+static void stats_prepare(void* data)
+{
+    stats_accumulate_locked();
+}
+
+static void stats_merge(void* data, const void* saved)
+{
+    struct esirem_quantum_main_stats_counters* counters             = data;
+    const struct esirem_quantum_main_stats_counters* saved_counters = saved;
+
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_STATS_STATE_COUNT; i++)
+    {
+        counters->residency_ms[i] += saved_counters->residency_ms[i];
+    }
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_STATS_COUNTER_COUNT; i++)
+    {
+        counters->counters[i] += saved_counters->counters[i];
+    }
+}
+
+static int stats_settings_set(
+    const char* name, size_t len, settings_read_cb read_cb, void* cb_arg)
+{
+    const char* next;
+
+    if (!settings_name_steq(name, STATS_SETTINGS_KEY_COUNTERS, &next) || next)
+    {
+        return -ENOENT;
+    }
+
+    return esirem_quantum_main_retained_store_load(&stats_store, len, read_cb, cb_arg);
+}
+
+struct settings_handler esirem_quantum_main_stats_settings_hdlrs = {
+    .name  = STATS_SETTINGS_KEY_MODULE,
+    .h_set = stats_settings_set,
+};
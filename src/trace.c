@@ -0,0 +1,176 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * trace.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Chaque enregistrement reserve un emplacement par un increment atomique
+ * de l'index d'ecriture, puis remplit l'emplacement : pas de verrou, utilisable
+ * depuis une ISR, le thread BLE ou la file d'attente systeme.
+ * - Le buffer est circulaire, les evenements les plus anciens sont ecrases.
+ * Le numero de sequence (16 bits de poids faible de l'index) permet au
+ * decodeur de reperer un enregistrement ecrase pendant le vidage.
+ * - Le vidage est demande par l'hote en ecrivant 'd' sur le canal RTT
+ * descendant dedie ; le buffer est alors envoye en binaire sur le canal RTT
+ * montant du meme numero, precede d'un entete. Voir scripts/trace_decode.py.
+ * - Le vidage tourne dans la boucle principale : si l'hote ne lit pas le
+ * canal montant, il est abandonne apres
+ * CONFIG_ESIREM_QUANTUM_MAIN_TRACE_DUMP_TIMEOUT_MS, bien avant l'expiration
+ * du canal superviseur du watchdog. Le decodeur voit alors moins
+ * d'enregistrements qu'annonce par l'entete.
+ */
+
+#include <include/trace.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include <SEGGER_RTT.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_trace, CONFIG_LOG_MAX_LEVEL);
+
+BUILD_ASSERT(
+    IS_POWER_OF_TWO(CONFIG_ESIREM_QUANTUM_MAIN_TRACE_BUF_COUNT),
+    "Trace buffer count must be a power of two");
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_WATCHDOG)
+BUILD_ASSERT(
+    CONFIG_ESIREM_QUANTUM_MAIN_TRACE_DUMP_TIMEOUT_MS < CONFIG_ESIREM_QUANTUM_MAIN_WATCHDOG_MAIN_TIMEOUT_MS / 2,
+    "Trace dump must end well before the supervisor watchdog expires");
+#endif
+
+#define TRACE_RTT_CHANNEL      CONFIG_ESIREM_QUANTUM_MAIN_TRACE_RTT_CHANNEL
+#define TRACE_RTT_BUF_SZ       (256)
+#define TRACE_DUMP_MAGIC       0x52545145 /* "EQTR" */
+#define TRACE_DUMP_VERSION     (1)
+#define TRACE_DUMP_CMD         'd'
+
+/**@brief Entete du vidage, suivi de count enregistrements du plus ancien au
+ * plus recent */
+struct trace_dump_header
+{
+    uint32_t magic;
+    uint8_t version;
+    uint8_t record_sz;
+    uint16_t count;
+    uint32_t cycles_per_sec;
+} __packed;
+
+static struct esirem_quantum_main_trace_record
+    trace_buf[CONFIG_ESIREM_QUANTUM_MAIN_TRACE_BUF_COUNT];
+static atomic_t trace_head = ATOMIC_INIT(0);
+
+static uint8_t trace_rtt_up_buf[TRACE_RTT_BUF_SZ];
+static uint8_t trace_rtt_down_buf[16];
+
+void esirem_quantum_main_trace_record(uint16_t evt, uint32_t arg)
+{
+    uint32_t idx = (uint32_t) atomic_inc(&trace_head);
+    struct esirem_quantum_main_trace_record* rec =
+        &trace_buf[idx & (CONFIG_ESIREM_QUANTUM_MAIN_TRACE_BUF_COUNT - 1)];
+
+    rec->timestamp = k_cycle_get_32();
+    rec->arg       = arg;
+    rec->evt       = evt;
+    rec->seq       = (uint16_t) idx;
+}
+
+static int trace_rtt_write(const void* data, size_t len, int64_t deadline)
+{
+    const uint8_t* ptr = data;
+
+    /* Le canal est en mode non bloquant : on attend que l'hote ait lu,
+     * jusqu'a l'echeance du vidage */
+    while (len)
+    {
+        unsigned int written = SEGGER_RTT_Write(TRACE_RTT_CHANNEL, ptr, len);
+
+        ptr += written;
+        len -= written;
+        if (len)
+        {
+            if (k_uptime_get() >= deadline)
+            {
+                return -ETIMEDOUT;
+            }
+            k_sleep(K_MSEC(1));
+        }
+    }
+
+    return 0;
+}
+
+static void trace_dump(void)
+{
+    int64_t deadline = k_uptime_get() + CONFIG_ESIREM_QUANTUM_MAIN_TRACE_DUMP_TIMEOUT_MS;
+    uint32_t head  = (uint32_t) atomic_get(&trace_head);
+    uint32_t count = MIN(head, CONFIG_ESIREM_QUANTUM_MAIN_TRACE_BUF_COUNT);
+    struct trace_dump_header header = {
+        .magic          = TRACE_DUMP_MAGIC,
+        .version        = TRACE_DUMP_VERSION,
+        .record_sz      = sizeof(struct esirem_quantum_main_trace_record),
+        .count          = (uint16_t) count,
+        .cycles_per_sec = (uint32_t) sys_clock_hw_cycles_per_sec(),
+    };
+
+    if (trace_rtt_write(&header, sizeof(header), deadline))
+    {
+        LOG_WRN("Trace dump aborted, host not reading");
+        return;
+    }
+    for (uint32_t idx = head - count; idx != head; idx++)
+    {
+        if (trace_rtt_write(
+                &trace_buf[idx & (CONFIG_ESIREM_QUANTUM_MAIN_TRACE_BUF_COUNT - 1)],
+                sizeof(struct esirem_quantum_main_trace_record), deadline))
+        {
+            LOG_WRN("Trace dump aborted, host not reading");
+            return;
+        }
+    }
+}
+
+/* Appele periodiquement depuis la boucle principale */
+void esirem_quantum_main_trace_process(void)
+{
+    char cmd;
+
+    while (SEGGER_RTT_Read(TRACE_RTT_CHANNEL, &cmd, sizeof(cmd)) == sizeof(cmd))
+    {
+        if (cmd == TRACE_DUMP_CMD)
+        {
+            LOG_DBG("Dumping trace buffer");
+            trace_dump();
+        }
+    }
+}
+
+int esirem_quantum_main_trace_init(void)
+{
+    if (SEGGER_RTT_ConfigUpBuffer(
+            TRACE_RTT_CHANNEL, "esirem_trace", trace_rtt_up_buf,
+            sizeof(trace_rtt_up_buf), SEGGER_RTT_MODE_NO_BLOCK_SKIP)
+            < 0
+        || SEGGER_RTT_ConfigDownBuffer(
+               TRACE_RTT_CHANNEL, "esirem_trace", trace_rtt_down_buf,
+               sizeof(trace_rtt_down_buf), SEGGER_RTT_MODE_NO_BLOCK_SKIP)
+               < 0)
+    {
+        LOG_ERR("Failed to configure trace RTT channel");
+        return -EIO;
+    }
+
+    return 0;
+}
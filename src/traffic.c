@@ -0,0 +1,89 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * traffic.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Les callbacks GATT comptent chaque commande recue, chaque erreur ATT
+ * retournee et le resultat de chaque envoi de notification.
+ * - Le debit est calcule sans timer : les commandes sont cumulees dans une
+ * fenetre d'une seconde d'uptime, fermee par la premiere commande ou lecture
+ * de la seconde suivante. Une seconde sans commande donne un debit nul.
+ * - Les compteurs sont en RAM uniquement : ils mesurent une session de test
+ * et sont remis a zero par le point de controle du service diagnostic.
+ */
+
+#include <include/traffic.h>
+
+#include <zephyr.h>
+
+#include <string.h>
+
+static struct k_spinlock traffic_lock;
+static struct esirem_quantum_main_traffic traffic_cur;
+static int64_t traffic_window_s         = 0;
+static uint32_t traffic_window_commands = 0;
+
+/* A appeler verrou pris : ferme la fenetre courante si la seconde a change */
+static void traffic_window_update_locked(void)
+{
+    int64_t now_s = k_uptime_get() / MSEC_PER_SEC;
+
+    if (now_s == traffic_window_s)
+    {
+        return;
+    }
+
+    traffic_cur.commands_per_s = (now_s == traffic_window_s + 1) ? traffic_window_commands : 0;
+    traffic_cur.commands_per_s_max =
+        MAX(traffic_cur.commands_per_s_max, traffic_window_commands);
+    traffic_window_s        = now_s;
+    traffic_window_commands = 0;
+}
+
+void esirem_quantum_main_traffic_count(enum esirem_quantum_main_traffic_counter counter)
+{
+    k_spinlock_key_t key;
+
+    if (counter >= ESIREM_QUANTUM_MAIN_TRAFFIC_COUNTER_COUNT)
+    {
+        return;
+    }
+
+    key = k_spin_lock(&traffic_lock);
+    traffic_cur.counters[counter]++;
+    if (counter == ESIREM_QUANTUM_MAIN_TRAFFIC_COMMANDS)
+    {
+        traffic_window_update_locked();
+        traffic_window_commands++;
+    }
+    k_spin_unlock(&traffic_lock, key);
+}
+
+void esirem_quantum_main_traffic_get(struct esirem_quantum_main_traffic* traffic)
+{
+    k_spinlock_key_t key = k_spin_lock(&traffic_lock);
+
+    traffic_window_update_locked();
+    *traffic = traffic_cur;
+    k_spin_unlock(&traffic_lock, key);
+}
+
+void esirem_quantum_main_traffic_reset(void)
+{
+    k_spinlock_key_t key = k_spin_lock(&traffic_lock);
+
+    memset(&traffic_cur, 0, sizeof(traffic_cur));
+    traffic_window_s        = k_uptime_get() / MSEC_PER_SEC;
+    traffic_window_commands = 0;
+    k_spin_unlock(&traffic_lock, key);
+}
@@ -0,0 +1,218 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * trigger_input.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - L'entree est decrite par l'alias devicetree trigger-input (voir
+ * trigger.overlay). Chaque front genere une interruption GPIO.
+ * - L'anti-rebond est a front montant : le premier front est pris en compte
+ * immediatement, les fronts suivants sont ignores pendant
+ * CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS. Le rebond d'un
+ * contact suit toujours le premier front, l'anti-rebond n'ajoute donc
+ * aucune latence.
+ * - Mode contact : l'entree peut encore rebondir quand elle est lue dans
+ * l'interruption, et un relachement dans la fenetre est ignore. A la fin de
+ * la fenetre, l'entree est relue depuis la file d'attente systeme et son
+ * niveau applique s'il differe du dernier applique : une impulsion plus
+ * courte que la fenetre finit a l'arret, un rebond au relachement ne laisse
+ * pas le cycle tourner. Un depart refuse pendant un arret en cours est
+ * retente a chaque fenetre jusqu'a la fin du cycle.
+ * - Le core est appele depuis l'interruption, sans passer par la pile BLE :
+ * la latence entree -> premier front LED est celle de la file d'attente du
+ * core, mesuree par la sonde de latence "declenchement -> allumage".
+ */
+
+#include <include/core.h>
+#include <include/latency.h>
+#include <include/trigger_input.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+
+#include <device.h>
+#include <drivers/gpio.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_trigger_input, CONFIG_LOG_MAX_LEVEL);
+
+#define TRIGGER_INPUT_NODE DT_ALIAS(trigger_input)
+
+#if !DT_NODE_HAS_STATUS(TRIGGER_INPUT_NODE, okay)
+#error "trigger-input devicetree alias is not defined (see trigger.overlay)"
+#endif
+
+#define TRIGGER_INPUT_PIN   DT_GPIO_PIN(TRIGGER_INPUT_NODE, gpios)
+#define TRIGGER_INPUT_FLAGS DT_GPIO_FLAGS(TRIGGER_INPUT_NODE, gpios)
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_MODE_LEVEL)
+#define TRIGGER_INPUT_INT_FLAGS GPIO_INT_EDGE_BOTH
+#else
+#define TRIGGER_INPUT_INT_FLAGS GPIO_INT_EDGE_TO_ACTIVE
+#endif
+
+static const struct device* trigger_input_dev;
+static struct gpio_callback trigger_input_cb_data;
+/**@brief Fin de la fenetre d'anti-rebond (ticks d'uptime) */
+static int64_t trigger_input_lockout_ticks = 0;
+
+static int trigger_input_start(void)
+{
+    int err;
+
+    esirem_quantum_main_latency_start(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_TRIG_TO_EDGE);
+    err = esirem_quantum_main_core_trig_new_cycle();
+    if (err)
+    {
+        esirem_quantum_main_latency_cancel(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_TRIG_TO_EDGE);
+        LOG_DBG("Input trigger refused, err: %d", err);
+    }
+    return err;
+}
+
+static int trigger_input_stop(void)
+{
+    int err;
+
+    esirem_quantum_main_latency_start(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_STOP_TO_OFF);
+    err = esirem_quantum_main_core_stop_cycle();
+    if (err)
+    {
+        esirem_quantum_main_latency_cancel(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_STOP_TO_OFF);
+        LOG_DBG("Input stop refused, err: %d", err);
+    }
+    return err;
+}
+
+static void trigger_input_lockout(void)
+{
+    trigger_input_lockout_ticks =
+        k_uptime_ticks() + k_ms_to_ticks_ceil64(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS);
+}
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_MODE_LEVEL)
+/* Au moins un tick entre deux relectures avec une fenetre nulle */
+#define TRIGGER_INPUT_SETTLE_DELAY K_MSEC(MAX(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS, 1))
+
+static void trigger_input_settle_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(trigger_input_settle_work, trigger_input_settle_work_fn);
+/**@brief Dernier niveau applique au core */
+static int trigger_input_level = 0;
+
+/* Interruption ou file d'attente systeme */
+static void trigger_input_apply(int level)
+{
+    int err = level ? trigger_input_start() : trigger_input_stop();
+
+    if (err == -EBUSY && level && esirem_quantum_main_core_stop_pending())
+    {
+        /* Le cycle precedent se termine : depart retente a la relecture */
+        k_work_reschedule(&trigger_input_settle_work, TRIGGER_INPUT_SETTLE_DELAY);
+        return;
+    }
+
+    trigger_input_level = level;
+    trigger_input_lockout();
+    k_work_reschedule(&trigger_input_settle_work, TRIGGER_INPUT_SETTLE_DELAY);
+}
+
+/* Relecture de l'entree stabilisee en fin de fenetre d'anti-rebond */
+static void trigger_input_settle_work_fn(struct k_work* work)
+{
+    unsigned int key = irq_lock();
+    int level        = gpio_pin_get(trigger_input_dev, TRIGGER_INPUT_PIN);
+
+    if (level >= 0 && level != trigger_input_level)
+    {
+        trigger_input_apply(level);
+    }
+    irq_unlock(key);
+}
+#endif
+
+/* Contexte interruption */
+static void trigger_input_cb(const struct device* dev, struct gpio_callback* cb, uint32_t pins)
+{
+    if (k_uptime_ticks() < trigger_input_lockout_ticks)
+    {
+        return;
+    }
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_MODE_LEVEL)
+    int level = gpio_pin_get(dev, TRIGGER_INPUT_PIN);
+
+    if (level >= 0 && level != trigger_input_level)
+    {
+        trigger_input_apply(level);
+    }
+    else
+    {
+        /* Entree lue pendant un rebond : le niveau est relu plus tard */
+        k_work_reschedule(&trigger_input_settle_work, TRIGGER_INPUT_SETTLE_DELAY);
+    }
+#else
+    trigger_input_lockout();
+    if (esirem_quantum_main_core_device_running())
+    {
+        trigger_input_stop();
+    }
+    else
+    {
+        trigger_input_start();
+    }
+#endif
+}
+
+int esirem_quantum_main_trigger_input_init(void)
+{
+    int err;
+
+    trigger_input_dev = device_get_binding(DT_GPIO_LABEL(TRIGGER_INPUT_NODE, gpios));
+    if (!trigger_input_dev)
+    {
+        LOG_ERR("Trigger input device not found");
+        return -ENODEV;
+    }
+
+    err = gpio_pin_configure(
+        trigger_input_dev, TRIGGER_INPUT_PIN, GPIO_INPUT | TRIGGER_INPUT_FLAGS);
+    if (err)
+    {
+        LOG_ERR("Failed to configure trigger input, err: %d", err);
+        return err;
+    }
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_MODE_LEVEL)
+    /* Un contact deja ferme au demarrage ne declenche pas */
+    trigger_input_level = MAX(gpio_pin_get(trigger_input_dev, TRIGGER_INPUT_PIN), 0);
+#endif
+
+    gpio_init_callback(&trigger_input_cb_data, trigger_input_cb, BIT(TRIGGER_INPUT_PIN));
+    err = gpio_add_callback(trigger_input_dev, &trigger_input_cb_data);
+    if (err)
+    {
+        return err;
+    }
+
+    err = gpio_pin_interrupt_configure(
+        trigger_input_dev, TRIGGER_INPUT_PIN, TRIGGER_INPUT_INT_FLAGS);
+    if (err)
+    {
+        LOG_ERR("Failed to enable trigger input interrupt, err: %d", err);
+        return err;
+    }
+
+    LOG_DBG("Trigger input ready");
+    return 0;
+}
@@ -0,0 +1,213 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * watchdog.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Un canal du task watchdog par tache surveillee, le watchdog materiel
+ * sert de secours si les timers ne tournent plus.
+ * - Core : le canal n'existe que pendant un cycle. Il est installe au
+ * premier front avec le plus long de Ton et Toff plus une marge, puis
+ * simplement alimente a chaque front : un front en retard declenche le
+ * watchdog. Il n'est reinstalle que si une periode plus longue arrive en
+ * cours de cycle (modification des parametres).
+ * - BLE : une commande HCI est envoyee periodiquement depuis la file
+ * d'attente systeme, le canal est alimente a chaque reponse. Un blocage de
+ * la pile hote ou du controleur declenche le watchdog.
+ * - Superviseur : alimente a chaque tour de la boucle principale.
+ * - Au declenchement, le canal fautif est note en RAM retenue puis la carte
+ * redemarre ; le cycle en cours reprend (voir core.c) et la faute est
+ * enregistree dans le journal au demarrage suivant.
+ */
+
+#include <include/eventlog.h>
+#include <include/retained.h>
+#include <include/watchdog.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+
+#include <bluetooth/hci.h>
+#include <device.h>
+#include <drivers/hwinfo.h>
+#include <sys/reboot.h>
+#include <task_wdt/task_wdt.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_watchdog, CONFIG_LOG_MAX_LEVEL);
+
+#define WATCHDOG_HW_NODE DT_NODELABEL(wdt)
+
+static int watchdog_core_channel        = -1;
+static uint32_t watchdog_core_timeout_ms = 0;
+static int watchdog_ble_channel         = -1;
+static int watchdog_main_channel        = -1;
+
+static void watchdog_ble_probe_work_fn(struct k_work* work);
+static K_WORK_DELAYABLE_DEFINE(watchdog_ble_probe_work, watchdog_ble_probe_work_fn);
+
+/* Appele depuis le timer du task watchdog (contexte interruption) */
+static void watchdog_timeout_cb(int channel_id, void* user_data)
+{
+    struct esirem_quantum_main_watchdog_fault* fault = &esirem_quantum_main_retained.watchdog;
+
+    fault->last_channel = (uint32_t) (uintptr_t) user_data;
+    fault->uptime_ms    = k_uptime_get_32();
+    fault->count++;
+    fault->pending = 1;
+    esirem_quantum_main_retained_update();
+
+    sys_reboot(SYS_REBOOT_COLD);
+}
+
+void esirem_quantum_main_watchdog_core_feed(uint32_t timeout_ms)
+{
+    timeout_ms += CONFIG_ESIREM_QUANTUM_MAIN_WATCHDOG_CORE_MARGIN_MS;
+
+    /* Un delai plus court que celui du canal installe est couvert */
+    if (watchdog_core_channel >= 0 && timeout_ms > watchdog_core_timeout_ms)
+    {
+        task_wdt_delete(watchdog_core_channel);
+        watchdog_core_channel = -1;
+    }
+
+    if (watchdog_core_channel < 0)
+    {
+        watchdog_core_channel = task_wdt_add(
+            timeout_ms, watchdog_timeout_cb,
+            (void*) (uintptr_t) ESIREM_QUANTUM_MAIN_WATCHDOG_CHANNEL_CORE);
+        if (watchdog_core_channel < 0)
+        {
+            LOG_ERR("Failed to add core watchdog channel, err: %d", watchdog_core_channel);
+            return;
+        }
+        watchdog_core_timeout_ms = timeout_ms;
+    }
+
+    task_wdt_feed(watchdog_core_channel);
+}
+
+void esirem_quantum_main_watchdog_core_disarm(void)
+{
+    if (watchdog_core_channel >= 0)
+    {
+        task_wdt_delete(watchdog_core_channel);
+        watchdog_core_channel = -1;
+    }
+}
+
+void esirem_quantum_main_watchdog_main_feed(void)
+{
+    if (watchdog_main_channel >= 0)
+    {
+        task_wdt_feed(watchdog_main_channel);
+    }
+}
+
+static void watchdog_ble_probe_work_fn(struct k_work* work)
+{
+    struct net_buf* rsp = NULL;
+    int err;
+
+    err = bt_hci_cmd_send_sync(BT_HCI_OP_READ_LOCAL_VERSION_INFO, NULL, &rsp);
+    if (err)
+    {
+        LOG_ERR("BLE liveness probe failed, err: %d", err);
+    }
+    else
+    {
+        net_buf_unref(rsp);
+        task_wdt_feed(watchdog_ble_channel);
+    }
+
+    k_work_schedule(
+        &watchdog_ble_probe_work, K_MSEC(CONFIG_ESIREM_QUANTUM_MAIN_WATCHDOG_BLE_PROBE_INTERVAL_MS));
+}
+
+int esirem_quantum_main_watchdog_ble_start(void)
+{
+    watchdog_ble_channel = task_wdt_add(
+        CONFIG_ESIREM_QUANTUM_MAIN_WATCHDOG_BLE_TIMEOUT_MS, watchdog_timeout_cb,
+        (void*) (uintptr_t) ESIREM_QUANTUM_MAIN_WATCHDOG_CHANNEL_BLE);
+    if (watchdog_ble_channel < 0)
+    {
+        LOG_ERR("Failed to add BLE watchdog channel, err: %d", watchdog_ble_channel);
+        return watchdog_ble_channel;
+    }
+
+    k_work_schedule(&watchdog_ble_probe_work, K_NO_WAIT);
+    return 0;
+}
+
+void esirem_quantum_main_watchdog_get_fault(struct esirem_quantum_main_watchdog_fault* fault)
+{
+    *fault = esirem_quantum_main_retained.watchdog;
+}
+
+/* Releve la faute ayant provoque le reset : canal note par le callback, ou
+ * watchdog materiel d'apres la cause du reset */
+static void watchdog_fault_check(uint32_t reset_cause)
+{
+    struct esirem_quantum_main_watchdog_fault* fault = &esirem_quantum_main_retained.watchdog;
+
+    if (!fault->pending && (reset_cause & RESET_WATCHDOG))
+    {
+        fault->last_channel = ESIREM_QUANTUM_MAIN_WATCHDOG_CHANNEL_HW;
+        fault->uptime_ms    = 0;
+        fault->count++;
+        fault->pending = 1;
+    }
+
+    if (!fault->pending)
+    {
+        return;
+    }
+
+    LOG_ERR(
+        "Reset by watchdog channel %u after %u ms", fault->last_channel, fault->uptime_ms);
+    esirem_quantum_main_eventlog_add(
+        ESIREM_QUANTUM_MAIN_EVENTLOG_EVT_WATCHDOG, fault->last_channel);
+    fault->pending = 0;
+    esirem_quantum_main_retained_update();
+}
+
+int esirem_quantum_main_watchdog_init(uint32_t reset_cause)
+{
+    const struct device* hw_wdt = NULL;
+    int err;
+
+#if DT_NODE_HAS_STATUS(WATCHDOG_HW_NODE, okay)
+    hw_wdt = device_get_binding(DT_LABEL(WATCHDOG_HW_NODE));
+#endif
+
+    watchdog_fault_check(reset_cause);
+
+    err = task_wdt_init(hw_wdt);
+    if (err)
+    {
+        LOG_ERR("Failed to init task watchdog, err: %d", err);
+        return err;
+    }
+
+    watchdog_main_channel = task_wdt_add(
+        CONFIG_ESIREM_QUANTUM_MAIN_WATCHDOG_MAIN_TIMEOUT_MS, watchdog_timeout_cb,
+        (void*) (uintptr_t) ESIREM_QUANTUM_MAIN_WATCHDOG_CHANNEL_MAIN);
+    if (watchdog_main_channel < 0)
+    {
+        LOG_ERR("Failed to add main watchdog channel, err: %d", watchdog_main_channel);
+        return watchdog_main_channel;
+    }
+
+    return 0;
+}
@@ -0,0 +1,340 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * main.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Application separee du firmware (le demarrage de celui-ci n'est pas
+ * retarde) : les modules sont initialises dans l'ordre de src/main.c, puis
+ * le thread principal mesure, avec l'API timing, les chemins critiques de
+ * l'application :
+ *   - lecture et ecriture des caracteristiques de configuration, par les
+ *   callbacks GATT eux-memes (l'ecriture inclut la sauvegarde flash) ;
+ *   - settings_save_one seul ;
+ *   - settings_load pour un nombre croissant de cles stockees ;
+ *   - la fonction de travail du core, pendant un cycle court joue avec
+ *   des parametres temporaires (non sauvegardes) ;
+ *   - l'envoi de la notification d'etat du service utilisateur, qui n'est
+ *   significatif qu'avec un central connecte et abonne ;
+ *   - l'appel d'un LOG_INF a deux arguments entiers (cote thread appelant,
+ *   hors traitement par le backend), pour comparer logs texte et
+ *   dictionnaire.
+ * - Le resume est imprime sur la console au format CSV, une ligne par
+ * mesure, pour etre compare entre deux versions du firmware.
+ * - Les ecritures de configuration reecrivent la valeur courante mais
+ * comptent dans les compteurs de vie et le journal : a reserver aux cartes
+ * de developpement.
+ */
+
+#include <include/ble.h>
+#include <include/ble_service_config.h>
+#include <include/ble_service_user.h>
+#include <include/bench.h>
+#include <include/core.h>
+#include <include/eventlog.h>
+#include <include/latency.h>
+#include <include/odometer.h>
+#include <include/retained.h>
+#include <include/settings.h>
+#include <include/stats.h>
+#include <include/trigger_input.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <bluetooth/gatt.h>
+#include <settings/settings.h>
+#include <sys/printk.h>
+#include <timing/timing.h>
+
+#include <logging/log.h>
+
+LOG_MODULE_REGISTER(esirem_quantum_main_bench, CONFIG_LOG_MAX_LEVEL);
+
+#define BENCH_SETTINGS_KEY_MODULE "esirem_quantum_main_bench"
+
+/* Cycle court joue pour mesurer la fonction de travail du core */
+#define BENCH_CORE_TON_MS      (10)
+#define BENCH_CORE_TOFF_MS     (10)
+#define BENCH_CORE_PERIODS     (10)
+#define BENCH_CORE_TIMEOUT_MS  (5000)
+
+struct bench_stat
+{
+    uint32_t count;
+    uint64_t min;
+    uint64_t max;
+    uint64_t total;
+};
+
+static struct k_spinlock bench_lock;
+static struct bench_stat bench_probes[ESIREM_QUANTUM_MAIN_BENCH_PROBE_COUNT];
+
+static void bench_stat_add(struct bench_stat* stat, uint64_t cycles)
+{
+    if (!stat->count || cycles < stat->min)
+    {
+        stat->min = cycles;
+    }
+    stat->max = MAX(stat->max, cycles);
+    stat->total += cycles;
+    stat->count++;
+}
+
+void esirem_quantum_main_bench_record(enum esirem_quantum_main_bench_probe probe, uint64_t cycles)
+{
+    k_spinlock_key_t key = k_spin_lock(&bench_lock);
+
+    bench_stat_add(&bench_probes[probe], cycles);
+    k_spin_unlock(&bench_lock, key);
+}
+
+static void bench_print(const char* name, uint32_t param, const struct bench_stat* stat)
+{
+    if (!stat->count)
+    {
+        printk("BENCH,%s,%u,0,0,0,0\n", name, param);
+        return;
+    }
+
+    printk(
+        "BENCH,%s,%u,%u,%u,%u,%u\n", name, param, stat->count,
+        (uint32_t) timing_cycles_to_ns(stat->min),
+        (uint32_t) timing_cycles_to_ns(stat->total / stat->count),
+        (uint32_t) timing_cycles_to_ns(stat->max));
+}
+
+static const struct bt_gatt_attr* bench_config_attr(uint32_t index)
+{
+    return bt_gatt_find_by_uuid(
+        esirem_quantum_main_service_config.attrs, esirem_quantum_main_service_config.attr_count,
+        esirem_quantum_main_core_setting_map_uuid_keyptr[index].uuid);
+}
+
+static void bench_config_read_write(void)
+{
+    uint32_t size = esirem_quantum_main_core_setting_get_map_uuid_keyptr_size();
+    struct bench_stat read_stat  = {0};
+    struct bench_stat write_stat = {0};
+    timing_t start;
+    timing_t end;
+    uint32_t val;
+    ssize_t ret;
+
+    for (uint32_t n = 0; n < CONFIG_ESIREM_QUANTUM_MAIN_BENCH_ITERATIONS; n++)
+    {
+        const struct bt_gatt_attr* attr = bench_config_attr(n % size);
+
+        start = timing_counter_get();
+        ret   = attr->read(NULL, attr, &val, sizeof(val), 0);
+        end   = timing_counter_get();
+        if (ret != sizeof(val))
+        {
+            LOG_ERR("Config read failed, err: %d", ret);
+            continue;
+        }
+        bench_stat_add(&read_stat, timing_cycles_get(&start, &end));
+
+        start = timing_counter_get();
+        ret   = attr->write(NULL, attr, &val, sizeof(val), 0, 0);
+        end   = timing_counter_get();
+        if (ret != sizeof(val))
+        {
+            LOG_ERR("Config write failed, err: %d", ret);
+            continue;
+        }
+        bench_stat_add(&write_stat, timing_cycles_get(&start, &end));
+    }
+
+    bench_print("config_read", 0, &read_stat);
+    bench_print("config_write", 0, &write_stat);
+}
+
+static void bench_key(char* key, size_t key_sz, uint32_t index)
+{
+    snprintf(key, key_sz, BENCH_SETTINGS_KEY_MODULE "/%u", index);
+}
+
+static void bench_settings(void)
+{
+    char key[sizeof(BENCH_SETTINGS_KEY_MODULE) + 12];
+    struct bench_stat save_stat = {0};
+    uint32_t stored             = 0;
+    timing_t start;
+    timing_t end;
+
+    /* settings_load avec 0, 1, 2, 4... cles supplementaires stockees */
+    for (uint32_t target = 0; target <= CONFIG_ESIREM_QUANTUM_MAIN_BENCH_MAX_KEYS;
+         target = target ? target * 2 : 1)
+    {
+        struct bench_stat load_stat = {0};
+
+        for (; stored < target; stored++)
+        {
+            bench_key(key, sizeof(key), stored);
+            start = timing_counter_get();
+            settings_save_one(key, &stored, sizeof(stored));
+            end = timing_counter_get();
+            bench_stat_add(&save_stat, timing_cycles_get(&start, &end));
+        }
+
+        for (uint32_t n = 0; n < CONFIG_ESIREM_QUANTUM_MAIN_BENCH_LOAD_ITERATIONS; n++)
+        {
+            start = timing_counter_get();
+            settings_load();
+            end = timing_counter_get();
+            bench_stat_add(&load_stat, timing_cycles_get(&start, &end));
+        }
+        bench_print("settings_load", target, &load_stat);
+    }
+    bench_print("settings_save_one", 0, &save_stat);
+
+    for (uint32_t i = 0; i < stored; i++)
+    {
+        bench_key(key, sizeof(key), i);
+        settings_delete(key);
+    }
+}
+
+static void bench_core_work(void)
+{
+    uint32_t saved_vals[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    uint32_t bench_vals[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    struct bench_stat stat;
+    k_spinlock_key_t key;
+    int64_t deadline;
+
+    if (!esirem_quantum_main_core_is_idle())
+    {
+        LOG_WRN("Core busy, core work not measured");
+        return;
+    }
+
+    /* Valeurs en RAM seulement, publiees ensemble (regles entre parametres)
+     * et restaurees a la fin */
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        saved_vals[i] = esirem_quantum_main_core_setting_get(&esirem_quantum_main_core_setting_map_uuid_keyptr[i]);
+        bench_vals[i] = saved_vals[i];
+    }
+    bench_vals[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] =
+        BENCH_CORE_PERIODS * (BENCH_CORE_TON_MS + BENCH_CORE_TOFF_MS);
+    bench_vals[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]  = BENCH_CORE_TON_MS;
+    bench_vals[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS] = BENCH_CORE_TOFF_MS;
+    if (esirem_quantum_main_core_settings_publish(bench_vals) != ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK)
+    {
+        LOG_ERR("Failed to set bench parameters");
+        return;
+    }
+
+    key = k_spin_lock(&bench_lock);
+    memset(&bench_probes[ESIREM_QUANTUM_MAIN_BENCH_PROBE_CORE_WORK], 0, sizeof(stat));
+    k_spin_unlock(&bench_lock, key);
+
+    if (!esirem_quantum_main_core_trig_new_cycle())
+    {
+        deadline = k_uptime_get() + BENCH_CORE_TIMEOUT_MS;
+        do
+        {
+            k_sleep(K_MSEC(BENCH_CORE_TON_MS));
+        } while (!esirem_quantum_main_core_is_idle() && k_uptime_get() < deadline);
+    }
+
+    esirem_quantum_main_core_settings_publish(saved_vals);
+
+    key  = k_spin_lock(&bench_lock);
+    stat = bench_probes[ESIREM_QUANTUM_MAIN_BENCH_PROBE_CORE_WORK];
+    k_spin_unlock(&bench_lock, key);
+    bench_print("core_work", BENCH_CORE_PERIODS, &stat);
+}
+
+static void bench_notify(void)
+{
+    struct bench_stat stat = {0};
+    timing_t start;
+    timing_t end;
+
+    for (uint32_t n = 0; n < CONFIG_ESIREM_QUANTUM_MAIN_BENCH_ITERATIONS; n++)
+    {
+        start = timing_counter_get();
+        esirem_quantum_main_ble_service_user_chrc_state_indicate_change(
+            esirem_quantum_main_core_device_running() != 0);
+        end = timing_counter_get();
+        bench_stat_add(&stat, timing_cycles_get(&start, &end));
+    }
+    bench_print("state_notify", 0, &stat);
+}
+
+static void bench_log(void)
+{
+    struct bench_stat stat = {0};
+    timing_t start;
+    timing_t end;
+
+    for (uint32_t n = 0; n < CONFIG_ESIREM_QUANTUM_MAIN_BENCH_ITERATIONS; n++)
+    {
+        start = timing_counter_get();
+        LOG_INF("Bench log %u %u", n, stat.count);
+        end = timing_counter_get();
+        bench_stat_add(&stat, timing_cycles_get(&start, &end));
+
+        /* Laisse le thread de log vider le buffer : un message perdu
+         * fausserait la mesure */
+        k_msleep(1);
+    }
+    bench_print("log_msg", 0, &stat);
+}
+
+void main(void)
+{
+    esirem_quantum_main_retained_init();
+    esirem_quantum_main_stats_init();
+    esirem_quantum_main_odometer_init();
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_EVENTLOG)
+    esirem_quantum_main_eventlog_init(0);
+#endif
+    esirem_quantum_main_latency_init();
+    esirem_quantum_main_settings_init();
+    if (esirem_quantum_main_core_init())
+    {
+        LOG_ERR("Failed to init esirem_quantum_main core, benchmark aborted");
+        return;
+    }
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT)
+    esirem_quantum_main_trigger_input_init();
+#endif
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_BENCH_BLE)
+    if (ble_init())
+    {
+        LOG_ERR("Failed to init ble, state_notify without central");
+    }
+    /* Laisse a un central le temps de se connecter et de s'abonner a
+     * l'etat avant la mesure des notifications */
+    k_msleep(CONFIG_ESIREM_QUANTUM_MAIN_BENCH_START_DELAY_MS);
+#else
+    settings_load();
+#endif
+
+    LOG_INF("Benchmark started");
+    printk("BENCH,name,param,count,min_ns,avg_ns,max_ns\n");
+
+    bench_config_read_write();
+    bench_settings();
+    bench_core_work();
+    bench_notify();
+    bench_log();
+
+    printk("BENCH,done,0,0,0,0,0\n");
+}
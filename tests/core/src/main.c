@@ -0,0 +1,103 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * main.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Les modules sont initialises dans l'ordre de src/main.c, sans la pile
+ * BLE : les callbacks GATT sont appeles directement par les tests.
+ * - Les settings sont stockes sur le simulateur de flash, qui peut garder
+ * le contenu d'une execution precedente : chaque test de parametres part
+ * d'un jeu de reference sauvegarde par test_settings_reset.
+ * - Le temps de native_posix est simule : les durees ON / OFF et les
+ * latences mesurees ne dependent pas de la charge du poste.
+ * - Beacons et mesh s'excluent : leurs suites ne tournent que dans le
+ * scenario qui active le module (voir testcase.yaml), comme celle de la
+ * mise en veille.
+ */
+
+#include "tests.h"
+
+#include <include/latency.h>
+#include <include/odometer.h>
+#include <include/retained.h>
+#include <include/settings.h>
+#include <include/stats.h>
+#include <include/trigger_input.h>
+
+#include <settings/settings.h>
+#include <ztest.h>
+
+void test_main(void)
+{
+    esirem_quantum_main_retained_init();
+    esirem_quantum_main_stats_init();
+    esirem_quantum_main_odometer_init();
+    esirem_quantum_main_latency_init();
+    esirem_quantum_main_settings_init();
+    esirem_quantum_main_core_init();
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT)
+    esirem_quantum_main_trigger_input_init();
+#endif
+    settings_load();
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP)
+    test_deepsleep_init();
+#endif
+    test_core_wait_idle(1000);
+
+    ztest_test_suite(
+        esirem_quantum_main_core,
+        ztest_unit_test(test_core_idle_after_init),
+        ztest_unit_test_setup_teardown(test_core_cycle_periods, test_settings_reset, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_core_cycle_exact, test_settings_reset, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_core_stop, test_settings_reset, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_core_trig_busy, test_settings_reset, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_core_trig_at, test_settings_reset, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_clock_sync_trig_at, test_settings_reset, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_trigger_input_latency, test_settings_reset, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_trigger_input_level, test_settings_reset, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_settings_check_rules, test_settings_reset, unit_test_noop),
+        ztest_unit_test(test_settings_full_key),
+        ztest_unit_test_setup_teardown(test_settings_store_load, test_settings_reset, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_settings_store_rollback, test_settings_reset, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_settings_set_invalid, test_settings_reset, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_gatt_config_write, test_settings_reset, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_gatt_config_all_write, test_settings_reset, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_traffic_counters, test_settings_reset, test_settings_reset));
+    ztest_run_test_suite(esirem_quantum_main_core);
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP)
+    ztest_test_suite(
+        esirem_quantum_main_deepsleep,
+        ztest_unit_test_setup_teardown(test_deepsleep_idle, test_deepsleep_setup, test_deepsleep_teardown),
+        ztest_unit_test_setup_teardown(test_deepsleep_adv_error, test_deepsleep_setup, test_deepsleep_teardown));
+    ztest_run_test_suite(esirem_quantum_main_deepsleep);
+#endif
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER)
+    ztest_test_suite(
+        esirem_quantum_main_beacon,
+        ztest_unit_test_setup_teardown(test_beacon_mac, test_beacon_setup, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_beacon_replay, test_beacon_setup, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_beacon_counter_bound, test_beacon_setup, test_settings_reset));
+    ztest_run_test_suite(esirem_quantum_main_beacon);
+#endif
+
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_MESH)
+    ztest_test_suite(
+        esirem_quantum_main_mesh,
+        ztest_unit_test_setup_teardown(test_mesh_gen_onoff, test_mesh_setup, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_mesh_vnd_config, test_mesh_setup, test_settings_reset),
+        ztest_unit_test_setup_teardown(test_mesh_vnd_trig, test_mesh_setup, test_settings_reset));
+    ztest_run_test_suite(esirem_quantum_main_mesh);
+#endif
+}
@@ -0,0 +1,176 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * test_beacon.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Les donnees constructeur sont passees directement au traitement du
+ * callback de scan : le scan n'est pas demarre, la cle est posee en RAM.
+ * - Les beacons sont signes ici avec tinycrypt, independamment du code
+ * teste.
+ * - Le compteur repart de 0 par settings_runtime_set : la borne laissee en
+ * flash par une execution precedente n'est pas rechargee avant le premier
+ * beacon.
+ * - Redemarrage simule par settings_load : le dernier compteur accepte
+ * repart de la borne sauvegardee.
+ */
+
+#include "tests.h"
+
+#include <include/ble_beacon_trigger.h>
+
+#include <settings/settings.h>
+#include <string.h>
+#include <sys/byteorder.h>
+#include <ztest.h>
+
+#include <tinycrypt/aes.h>
+#include <tinycrypt/cmac_mode.h>
+#include <tinycrypt/constants.h>
+
+#define TEST_BEACON_STEP CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_COUNTER_STEP
+
+/* Cycle long : seul un beacon d'arret ou le teardown l'arrete */
+#define TEST_TON_MS  (10)
+#define TEST_TOFF_MS (10)
+
+static const uint8_t test_beacon_key[ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_KEY_LEN] = {
+    0x2b, 0x7e, 0x15, 0x16, 0x28, 0xae, 0xd2, 0xa6, 0xab, 0xf7, 0x15, 0x88, 0x09, 0xcf, 0x4f, 0x3c,
+};
+
+static void test_beacon_build(uint8_t* data, uint8_t opcode, uint32_t counter)
+{
+    struct tc_aes_key_sched_struct sched;
+    struct tc_cmac_struct state;
+    uint8_t tag[TC_AES_BLOCK_SIZE];
+
+    sys_put_le16(CONFIG_ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_COMPANY_ID, &data[0]);
+    sys_put_le16(ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_TAG, &data[2]);
+    data[4] = opcode;
+    sys_put_le32(counter, &data[5]);
+
+    zassert_equal(tc_cmac_setup(&state, test_beacon_key, &sched), TC_CRYPTO_SUCCESS, NULL);
+    zassert_equal(
+        tc_cmac_update(&state, data, ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_SIGNED_LEN), TC_CRYPTO_SUCCESS,
+        NULL);
+    zassert_equal(tc_cmac_final(tag, &state), TC_CRYPTO_SUCCESS, NULL);
+    memcpy(&data[ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_SIGNED_LEN], tag, ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_MAC_LEN);
+}
+
+static void test_beacon_send(uint8_t opcode, uint32_t counter)
+{
+    uint8_t data[ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_DATA_LEN];
+
+    test_beacon_build(data, opcode, counter);
+    esirem_quantum_main_beacon_trigger_process(data, sizeof(data));
+}
+
+/* Laisse la file systeme sauvegarder la borne et executer la commande */
+static void test_beacon_wait_saved(void)
+{
+    k_msleep(10);
+}
+
+static void test_beacon_assert_trig(uint32_t counter, bool accepted)
+{
+    test_beacon_send(ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_OPCODE_TRIG, counter);
+    test_beacon_wait_saved();
+    zassert_equal(
+        !esirem_quantum_main_core_is_idle(), accepted, "Counter %u %s", counter,
+        accepted ? "refused" : "accepted");
+    esirem_quantum_main_core_stop_cycle();
+    test_core_wait_idle(1000);
+}
+
+void test_beacon_setup(void)
+{
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    uint32_t counter = 0;
+
+    test_settings_reset();
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] = 1000 * (TEST_TON_MS + TEST_TOFF_MS);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]          = TEST_TON_MS;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS]         = TEST_TOFF_MS;
+    zassert_equal(
+        esirem_quantum_main_core_settings_publish(values), ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK,
+        "Test cycle refused");
+
+    esirem_quantum_main_beacon_trigger_set_key(test_beacon_key);
+    zassert_ok(
+        settings_runtime_set("esirem_quantum_main_beacon/ctr", &counter, sizeof(counter)),
+        "Counter reset refused");
+}
+
+void test_beacon_mac(void)
+{
+    uint8_t data[ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_DATA_LEN];
+
+    /* Premier compteur : borne atteinte, execute apres sauvegarde */
+    test_beacon_assert_trig(1, true);
+
+    /* MAC faux : ignore, le compteur n'est pas consomme */
+    test_beacon_build(data, ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_OPCODE_TRIG, 2);
+    data[ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_DATA_LEN - 1] ^= 0x01;
+    esirem_quantum_main_beacon_trigger_process(data, sizeof(data));
+    zassert_true(esirem_quantum_main_core_is_idle(), "Invalid MAC accepted");
+
+    /* Donnees signees modifiees apres coup */
+    test_beacon_build(data, ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_OPCODE_STOP, 2);
+    data[4] = ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_OPCODE_TRIG;
+    esirem_quantum_main_beacon_trigger_process(data, sizeof(data));
+    zassert_true(esirem_quantum_main_core_is_idle(), "Modified opcode accepted");
+
+    /* Autre constructeur ou taille differente : ignores avant le MAC */
+    test_beacon_build(data, ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_OPCODE_TRIG, 2);
+    esirem_quantum_main_beacon_trigger_process(data, sizeof(data) - 1);
+    zassert_true(esirem_quantum_main_core_is_idle(), "Short beacon accepted");
+    data[2] ^= 0xff;
+    esirem_quantum_main_beacon_trigger_process(data, sizeof(data));
+    zassert_true(esirem_quantum_main_core_is_idle(), "Foreign beacon accepted");
+
+    /* Sous la borne : execute directement dans le callback */
+    test_beacon_send(ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_OPCODE_TRIG, 2);
+    zassert_false(esirem_quantum_main_core_is_idle(), "Valid beacon refused");
+
+    test_beacon_send(ESIREM_QUANTUM_MAIN_BEACON_TRIGGER_OPCODE_STOP, 3);
+    test_core_wait_idle(1000);
+    zassert_true(esirem_quantum_main_core_is_idle(), "Stop beacon refused");
+}
+
+void test_beacon_replay(void)
+{
+    test_beacon_assert_trig(10, true);
+    test_beacon_assert_trig(10, false);
+    test_beacon_assert_trig(9, false);
+    test_beacon_assert_trig(11, true);
+}
+
+void test_beacon_counter_bound(void)
+{
+    /* Borne sauvegardee : 1 + pas */
+    test_beacon_assert_trig(1, true);
+    test_beacon_assert_trig(TEST_BEACON_STEP, true);
+
+    /* Redemarrage : les compteurs acceptes depuis la sauvegarde et ceux
+     * sous la borne sont refuses */
+    zassert_ok(settings_load(), "Load failed");
+    test_beacon_assert_trig(TEST_BEACON_STEP, false);
+    test_beacon_assert_trig(TEST_BEACON_STEP + 1, false);
+
+    /* Au-dela de la borne : nouvelle sauvegarde puis execution */
+    test_beacon_assert_trig(TEST_BEACON_STEP + 2, true);
+    zassert_ok(settings_load(), "Load failed");
+    test_beacon_assert_trig(2 * TEST_BEACON_STEP + 1, false);
+    test_beacon_assert_trig(2 * TEST_BEACON_STEP + 2, false);
+    test_beacon_assert_trig(2 * TEST_BEACON_STEP + 3, true);
+}
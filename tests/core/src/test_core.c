@@ -0,0 +1,364 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * test_core.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - La broche de la LED (gpio-emul) est echantillonnee toutes les 100 us
+ * d'horloge simulee, chaque changement est date depuis la demande.
+ * - Les durees ON / OFF sont comparees aux parametres a TEST_EDGE_TOL_US
+ * pres (pas d'echantillonnage et arrondi au tick du noyau).
+ * - Les parametres des cycles sont publies en RAM seulement.
+ */
+
+#include "tests.h"
+
+#include <include/clock_sync.h>
+
+#include <device.h>
+#include <drivers/gpio.h>
+#include <drivers/gpio/gpio_emul.h>
+#include <string.h>
+#include <ztest.h>
+
+#define TEST_LED_NODE DT_ALIAS(led0)
+#define TEST_LED_PIN  DT_GPIO_PIN(TEST_LED_NODE, gpios)
+
+#define TEST_SAMPLE_US   (100)
+#define TEST_EDGE_TOL_US (300)
+#define TEST_EDGES_MAX   (32)
+
+/* Cycles courts joues par les tests */
+#define TEST_TON_MS  (10)
+#define TEST_TOFF_MS (10)
+
+/* Horodatage arbitraire du central pour la synchronisation d'horloge */
+#define TEST_CENTRAL_T1_US (1000000000000LL)
+
+/* Identites de deux centraux : clock_sync ne fait que comparer les
+ * pointeurs de connexion */
+static const uint8_t test_central_a;
+static const uint8_t test_central_b;
+#define TEST_CONN_A ((const struct bt_conn*) &test_central_a)
+#define TEST_CONN_B ((const struct bt_conn*) &test_central_b)
+
+struct test_edges
+{
+    uint32_t count;
+    /* Instant de chaque front depuis la demande */
+    int64_t t_us[TEST_EDGES_MAX];
+    int value[TEST_EDGES_MAX];
+    /* Retour au repos depuis la demande, -1 si non atteint */
+    int64_t idle_us;
+};
+
+static const struct device* test_led_dev(void)
+{
+    return device_get_binding(DT_GPIO_LABEL(TEST_LED_NODE, gpios));
+}
+
+static int64_t test_now_us(void)
+{
+    return (int64_t) k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static void test_core_record(struct test_edges* edges, int64_t t0_us, uint32_t timeout_ms)
+{
+    const struct device* dev = test_led_dev();
+    int64_t deadline_us      = t0_us + (int64_t) timeout_ms * 1000;
+    int last                 = gpio_emul_output_get(dev, TEST_LED_PIN);
+    int value;
+
+    memset(edges, 0, sizeof(*edges));
+    edges->idle_us = -1;
+
+    while (test_now_us() < deadline_us)
+    {
+        k_usleep(TEST_SAMPLE_US);
+        value = gpio_emul_output_get(dev, TEST_LED_PIN);
+        if (value != last)
+        {
+            if (edges->count < TEST_EDGES_MAX)
+            {
+                edges->t_us[edges->count]  = test_now_us() - t0_us;
+                edges->value[edges->count] = value;
+                edges->count++;
+            }
+            last = value;
+        }
+        if (!value && esirem_quantum_main_core_is_idle())
+        {
+            edges->idle_us = test_now_us() - t0_us;
+            return;
+        }
+    }
+}
+
+/* periods periodes ON / OFF, la derniere de duree last_ton_ms */
+static void test_core_check_edges(
+    const struct test_edges* edges, uint32_t periods, uint32_t last_ton_ms)
+{
+    zassert_equal(edges->count, 2 * periods, "%u edges", edges->count);
+    zassert_true(edges->idle_us >= 0, "Core not idle");
+
+    for (uint32_t i = 0; i < periods; i++)
+    {
+        uint32_t ton_ms = (i == periods - 1) ? last_ton_ms : TEST_TON_MS;
+
+        zassert_equal(edges->value[2 * i], 1, "Edge %u not rising", 2 * i);
+        zassert_equal(edges->value[2 * i + 1], 0, "Edge %u not falling", 2 * i + 1);
+        zassert_within(
+            edges->t_us[2 * i + 1] - edges->t_us[2 * i], ton_ms * 1000, TEST_EDGE_TOL_US,
+            "Period %u ON lasted %lld us", i, edges->t_us[2 * i + 1] - edges->t_us[2 * i]);
+        if (i + 1 < periods)
+        {
+            zassert_within(
+                edges->t_us[2 * i + 2] - edges->t_us[2 * i + 1], TEST_TOFF_MS * 1000,
+                TEST_EDGE_TOL_US, "Period %u OFF lasted %lld us", i,
+                edges->t_us[2 * i + 2] - edges->t_us[2 * i + 1]);
+        }
+    }
+}
+
+static void test_core_publish(uint32_t seq_ms, uint32_t seq_mode)
+{
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] = seq_ms;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]          = TEST_TON_MS;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS]         = TEST_TOFF_MS;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_MODE]        = seq_mode;
+    zassert_equal(
+        esirem_quantum_main_core_settings_publish(values), ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK,
+        "Test cycle refused");
+}
+
+void test_core_wait_idle(uint32_t timeout_ms)
+{
+    int64_t deadline = k_uptime_get() + timeout_ms;
+
+    while (!esirem_quantum_main_core_is_idle() && k_uptime_get() < deadline)
+    {
+        k_msleep(1);
+    }
+}
+
+void test_core_idle_after_init(void)
+{
+    zassert_true(esirem_quantum_main_core_is_idle(), "Core not idle after init");
+    zassert_equal(esirem_quantum_main_core_device_running(), 0, "Core running after init");
+    zassert_equal(gpio_emul_output_get(test_led_dev(), TEST_LED_PIN), 0, "LED on after init");
+}
+
+void test_core_cycle_periods(void)
+{
+    struct esirem_quantum_main_core_progress progress;
+    struct test_edges edges;
+    int64_t t0_us;
+
+    /* 5 periodes entieres, le reste de la sequence est ignore */
+    test_core_publish(5 * (TEST_TON_MS + TEST_TOFF_MS) + 5, ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_PERIODS);
+
+    t0_us = test_now_us();
+    zassert_ok(esirem_quantum_main_core_trig_new_cycle(), "Trigger refused");
+    test_core_record(&edges, t0_us, 1000);
+
+    test_core_check_edges(&edges, 5, TEST_TON_MS);
+    zassert_within(edges.t_us[0], 0, TEST_EDGE_TOL_US, "First edge after %lld us", edges.t_us[0]);
+    /* Pas de temps OFF apres la derniere periode */
+    zassert_within(
+        edges.idle_us, edges.t_us[edges.count - 1], TEST_EDGE_TOL_US, "Idle after %lld us",
+        edges.idle_us);
+
+    esirem_quantum_main_core_get_progress(&progress);
+    zassert_equal(progress.elapsed_ms, 0, "Progress not cleared");
+}
+
+void test_core_cycle_exact(void)
+{
+    struct test_edges edges;
+    int64_t t0_us;
+
+    /* Derniere periode tronquee pendant le temps ON */
+    test_core_publish(2 * (TEST_TON_MS + TEST_TOFF_MS) + 5, ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_EXACT);
+    t0_us = test_now_us();
+    zassert_ok(esirem_quantum_main_core_trig_new_cycle(), "Trigger refused");
+    test_core_record(&edges, t0_us, 1000);
+    test_core_check_edges(&edges, 3, 5);
+    zassert_within(edges.idle_us, 45000, TEST_EDGE_TOL_US, "Idle after %lld us", edges.idle_us);
+
+    /* Derniere periode tronquee pendant le temps OFF : le cycle dure
+     * exactement la sequence */
+    test_core_publish(
+        2 * (TEST_TON_MS + TEST_TOFF_MS) + TEST_TON_MS + 5, ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_EXACT);
+    t0_us = test_now_us();
+    zassert_ok(esirem_quantum_main_core_trig_new_cycle(), "Trigger refused");
+    test_core_record(&edges, t0_us, 1000);
+    test_core_check_edges(&edges, 3, TEST_TON_MS);
+    zassert_within(edges.idle_us, 55000, TEST_EDGE_TOL_US, "Idle after %lld us", edges.idle_us);
+}
+
+void test_core_stop(void)
+{
+    struct test_edges edges;
+    int64_t t0_us;
+
+    test_core_publish(1000 * (TEST_TON_MS + TEST_TOFF_MS), ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_PERIODS);
+    zassert_ok(esirem_quantum_main_core_trig_new_cycle(), "Trigger refused");
+    k_msleep(TEST_TON_MS + TEST_TOFF_MS + TEST_TON_MS / 2);
+    zassert_not_equal(esirem_quantum_main_core_device_running(), 0, "Core not running");
+
+    /* L'arret prend effet au prochain front OFF */
+    t0_us = test_now_us();
+    zassert_ok(esirem_quantum_main_core_stop_cycle(), "Stop refused");
+    test_core_record(&edges, t0_us, 1000);
+    zassert_true(edges.idle_us >= 0, "Core not idle after stop");
+    zassert_true(
+        edges.idle_us <= (TEST_TON_MS + TEST_TOFF_MS) * 1000 + TEST_EDGE_TOL_US,
+        "Idle %lld us after stop", edges.idle_us);
+    zassert_equal(gpio_emul_output_get(test_led_dev(), TEST_LED_PIN), 0, "LED on after stop");
+}
+
+void test_core_trig_busy(void)
+{
+    struct test_edges edges;
+
+    test_core_publish(10 * (TEST_TON_MS + TEST_TOFF_MS), ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_PERIODS);
+    zassert_ok(esirem_quantum_main_core_trig_new_cycle(), "Trigger refused");
+    zassert_equal(esirem_quantum_main_core_trig_new_cycle(), -EBUSY, "Trigger accepted while running");
+    zassert_ok(esirem_quantum_main_core_stop_cycle(), "Stop refused");
+    test_core_wait_idle(1000);
+
+    /* Depart programme en attente : tout autre declenchement est refuse,
+     * l'arret l'annule */
+    zassert_ok(
+        esirem_quantum_main_core_trig_new_cycle_at(k_uptime_ticks() + k_ms_to_ticks_ceil64(50)),
+        "Scheduled start refused");
+    zassert_false(esirem_quantum_main_core_is_idle(), "Scheduled start not pending");
+    zassert_equal(esirem_quantum_main_core_trig_new_cycle(), -EBUSY, "Trigger accepted while scheduled");
+    zassert_equal(
+        esirem_quantum_main_core_trig_new_cycle_at(k_uptime_ticks() + k_ms_to_ticks_ceil64(20)),
+        -EBUSY, "Second scheduled start accepted");
+    zassert_ok(esirem_quantum_main_core_stop_cycle(), "Cancel refused");
+    zassert_true(esirem_quantum_main_core_is_idle(), "Scheduled start not cancelled");
+
+    test_core_record(&edges, test_now_us(), 100);
+    zassert_equal(edges.count, 0, "LED switched after cancel");
+}
+
+void test_core_trig_at(void)
+{
+    struct test_edges edges;
+    int64_t t0_us;
+
+    test_core_publish(TEST_TON_MS + TEST_TOFF_MS, ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_PERIODS);
+    zassert_equal(
+        esirem_quantum_main_core_trig_new_cycle_at(k_uptime_ticks()), -ETIME,
+        "Start in the past accepted");
+
+    t0_us = test_now_us();
+    zassert_ok(
+        esirem_quantum_main_core_trig_new_cycle_at(k_uptime_ticks() + k_ms_to_ticks_ceil64(50)),
+        "Scheduled start refused");
+    test_core_record(&edges, t0_us, 1000);
+    test_core_check_edges(&edges, 1, TEST_TON_MS);
+    zassert_within(edges.t_us[0], 50000, TEST_EDGE_TOL_US, "Start after %lld us", edges.t_us[0]);
+}
+
+void test_clock_sync_trig_at(void)
+{
+    struct esirem_quantum_main_clock_sync_report report;
+    struct test_edges edges;
+    int64_t central_us;
+    int64_t t0_us;
+
+    zassert_equal(
+        esirem_quantum_main_clock_sync_trig_new_cycle_at(TEST_CONN_A, TEST_CENTRAL_T1_US), -EAGAIN,
+        "Start accepted before sync");
+
+    esirem_quantum_main_clock_sync_ping(TEST_CONN_A, TEST_CENTRAL_T1_US);
+    zassert_ok(esirem_quantum_main_clock_sync_update(TEST_CONN_A, TEST_CENTRAL_T1_US, 0), "Sync refused");
+    zassert_ok(esirem_quantum_main_clock_sync_central_us(&central_us), "Not synced");
+
+    /* Un second central ne melange pas ses echanges a ceux du premier : son
+     * ping remplace la base de temps, la mise a jour du premier est
+     * refusee */
+    zassert_equal(
+        esirem_quantum_main_clock_sync_trig_new_cycle_at(TEST_CONN_B, central_us + 50000), -EAGAIN,
+        "Start accepted from an unsynchronized central");
+    esirem_quantum_main_clock_sync_ping(TEST_CONN_A, TEST_CENTRAL_T1_US);
+    esirem_quantum_main_clock_sync_ping(TEST_CONN_B, TEST_CENTRAL_T1_US / 2);
+    zassert_false(esirem_quantum_main_clock_sync_is_synced(), "Sync kept after another central's ping");
+    zassert_equal(
+        esirem_quantum_main_clock_sync_update(TEST_CONN_A, TEST_CENTRAL_T1_US, 0), -EINVAL,
+        "Update from the previous central accepted");
+    zassert_ok(esirem_quantum_main_clock_sync_update(TEST_CONN_B, TEST_CENTRAL_T1_US / 2, 0), "Sync refused");
+
+    /* Deconnexion du central synchronise : base de temps oubliee */
+    esirem_quantum_main_clock_sync_disconnected(TEST_CONN_A);
+    zassert_true(esirem_quantum_main_clock_sync_is_synced(), "Sync lost on another central's disconnection");
+    esirem_quantum_main_clock_sync_disconnected(TEST_CONN_B);
+    zassert_false(esirem_quantum_main_clock_sync_is_synced(), "Sync kept after disconnection");
+
+    esirem_quantum_main_clock_sync_ping(TEST_CONN_A, TEST_CENTRAL_T1_US);
+    zassert_ok(esirem_quantum_main_clock_sync_update(TEST_CONN_A, TEST_CENTRAL_T1_US, 0), "Sync refused");
+    zassert_ok(esirem_quantum_main_clock_sync_central_us(&central_us), "Not synced");
+
+    /* Instants passes, negatifs ou au-dela de l'horizon */
+    zassert_equal(
+        esirem_quantum_main_clock_sync_trig_new_cycle_at(TEST_CONN_A, central_us - 1000), -ETIME,
+        "Start in the past accepted");
+    zassert_equal(
+        esirem_quantum_main_clock_sync_trig_new_cycle_at(TEST_CONN_A, INT64_MIN), -ETIME,
+        "Negative start accepted");
+    zassert_equal(
+        esirem_quantum_main_clock_sync_trig_new_cycle_at(
+            TEST_CONN_A, central_us + (CONFIG_ESIREM_QUANTUM_MAIN_CLOCK_SYNC_MAX_HORIZON_MS + 1) * 1000LL),
+        -ERANGE, "Start beyond horizon accepted");
+    zassert_equal(
+        esirem_quantum_main_clock_sync_trig_new_cycle_at(TEST_CONN_A, INT64_MAX), -ERANGE,
+        "Start at INT64_MAX accepted");
+
+    /* Depart synchronise : le rapport donne l'instant reel */
+    test_core_publish(TEST_TON_MS + TEST_TOFF_MS, ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_PERIODS);
+    zassert_ok(esirem_quantum_main_clock_sync_central_us(&central_us), "Not synced");
+    t0_us = test_now_us();
+    zassert_ok(esirem_quantum_main_clock_sync_trig_new_cycle_at(TEST_CONN_A, central_us + 50000), "Start refused");
+    zassert_equal(esirem_quantum_main_core_trig_new_cycle(), -EBUSY, "Trigger accepted while scheduled");
+    test_core_record(&edges, t0_us, 1000);
+    test_core_check_edges(&edges, 1, TEST_TON_MS);
+    zassert_within(edges.t_us[0], 50000, TEST_EDGE_TOL_US, "Start after %lld us", edges.t_us[0]);
+
+    esirem_quantum_main_clock_sync_get_report(&report);
+    zassert_within(
+        report.start_central_us, central_us + 50000, TEST_EDGE_TOL_US, "Reported start %lld us",
+        report.start_central_us - central_us);
+    zassert_true(
+        report.start_err_us >= 0 && report.start_err_us <= TEST_EDGE_TOL_US, "Start error %d us",
+        report.start_err_us);
+
+    /* Un depart manuel ne reprend pas le rapport d'une demande precedente */
+    zassert_ok(esirem_quantum_main_core_trig_new_cycle(), "Trigger refused");
+    test_core_wait_idle(1000);
+    esirem_quantum_main_clock_sync_get_report(&report);
+    zassert_equal(report.start_central_us, 0, "Manual start reported as synchronized");
+
+    /* Demande annulee puis depart manuel */
+    zassert_ok(esirem_quantum_main_clock_sync_central_us(&central_us), "Not synced");
+    zassert_ok(esirem_quantum_main_clock_sync_trig_new_cycle_at(TEST_CONN_A, central_us + 50000), "Start refused");
+    zassert_ok(esirem_quantum_main_core_stop_cycle(), "Cancel refused");
+    zassert_ok(esirem_quantum_main_core_trig_new_cycle(), "Trigger refused");
+    test_core_wait_idle(1000);
+    esirem_quantum_main_clock_sync_get_report(&report);
+    zassert_equal(report.start_central_us, 0, "Cancelled start reported");
+}
@@ -0,0 +1,191 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * test_deepsleep.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Scenarios deepsleep et deepsleep_off de testcase.yaml : delai
+ * d'inactivite d'une minute, horloge simulee non ralentie au temps reel.
+ * - Les hooks de la mise en veille comptent les appels et simulent le
+ * nombre de centraux connectes. Hors de cette suite, un central est
+ * toujours connecte : la carte ne se met pas en veille pendant les autres
+ * tests.
+ * - Le bouton de reveil est la broche sw0 de gpio-emul.
+ */
+
+#include "tests.h"
+
+#include <include/deepsleep.h>
+
+#include <device.h>
+#include <drivers/gpio.h>
+#include <drivers/gpio/gpio_emul.h>
+#include <ztest.h>
+
+#define TEST_BUTTON_NODE DT_ALIAS(sw0)
+#define TEST_BUTTON_PIN  DT_GPIO_PIN(TEST_BUTTON_NODE, gpios)
+
+#define TEST_IDLE_MS  (CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP_IDLE_MIN * 60 * 1000)
+#define TEST_WAKE_MS  (CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP_WAKE_INTERVAL_MIN * 60 * 1000)
+#define TEST_SLACK_MS (1000)
+
+/* Cycle plus long que le delai d'inactivite */
+#define TEST_TON_MS  (10)
+#define TEST_TOFF_MS (10)
+
+static atomic_t test_deepsleep_conns = ATOMIC_INIT(1);
+static atomic_t test_deepsleep_suspend_calls;
+static atomic_t test_deepsleep_resume_calls;
+static atomic_t test_deepsleep_off_calls;
+static int test_deepsleep_suspend_err;
+
+static uint8_t test_deepsleep_conn_count(void)
+{
+    return (uint8_t) atomic_get(&test_deepsleep_conns);
+}
+
+static int test_deepsleep_adv_suspend(void)
+{
+    atomic_inc(&test_deepsleep_suspend_calls);
+    return test_deepsleep_suspend_err;
+}
+
+static int test_deepsleep_adv_resume(void)
+{
+    atomic_inc(&test_deepsleep_resume_calls);
+    return 0;
+}
+
+static void test_deepsleep_system_off(void)
+{
+    atomic_inc(&test_deepsleep_off_calls);
+}
+
+static const struct esirem_quantum_main_deepsleep_hooks test_deepsleep_hooks = {
+    .conn_count  = test_deepsleep_conn_count,
+    .adv_suspend = test_deepsleep_adv_suspend,
+    .adv_resume  = test_deepsleep_adv_resume,
+    .system_off  = test_deepsleep_system_off,
+};
+
+void test_deepsleep_init(void)
+{
+    esirem_quantum_main_deepsleep_set_hooks(&test_deepsleep_hooks);
+    zassert_ok(esirem_quantum_main_deepsleep_init(), "Deep sleep init failed");
+}
+
+void test_deepsleep_setup(void)
+{
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+
+    test_settings_reset();
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] = 3 * TEST_IDLE_MS;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]          = TEST_TON_MS;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS]         = TEST_TOFF_MS;
+    zassert_equal(
+        esirem_quantum_main_core_settings_publish(values), ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK,
+        "Test cycle refused");
+
+    test_deepsleep_suspend_err = 0;
+    atomic_clear(&test_deepsleep_suspend_calls);
+    atomic_clear(&test_deepsleep_resume_calls);
+    atomic_clear(&test_deepsleep_off_calls);
+}
+
+void test_deepsleep_teardown(void)
+{
+    atomic_set(&test_deepsleep_conns, 1);
+    test_deepsleep_suspend_err = 0;
+    test_settings_reset();
+}
+
+static void test_deepsleep_assert_calls(uint32_t suspend, uint32_t resume, uint32_t off, const char* step)
+{
+    zassert_equal(atomic_get(&test_deepsleep_suspend_calls), suspend, "%s: suspend calls", step);
+    zassert_equal(atomic_get(&test_deepsleep_resume_calls), resume, "%s: resume calls", step);
+    zassert_equal(atomic_get(&test_deepsleep_off_calls), off, "%s: System OFF calls", step);
+}
+
+void test_deepsleep_idle(void)
+{
+    /* Central connecte : pas de veille, le delai n'est relance que par la
+     * deconnexion */
+    esirem_quantum_main_deepsleep_activity();
+    k_msleep(TEST_IDLE_MS + TEST_SLACK_MS);
+    test_deepsleep_assert_calls(0, 0, 0, "Connected");
+    atomic_set(&test_deepsleep_conns, 0);
+    k_msleep(TEST_IDLE_MS + TEST_SLACK_MS);
+    test_deepsleep_assert_calls(0, 0, 0, "Timer re-armed while connected");
+
+    /* Cycle en cours : pas de veille, la fin du cycle relance le delai */
+    zassert_ok(esirem_quantum_main_core_trig_new_cycle(), "Trigger refused");
+    esirem_quantum_main_deepsleep_activity();
+    k_msleep(TEST_IDLE_MS + TEST_SLACK_MS);
+    test_deepsleep_assert_calls(0, 0, 0, "Running");
+    zassert_ok(esirem_quantum_main_core_stop_cycle(), "Stop refused");
+    test_core_wait_idle(1000);
+
+    k_msleep(TEST_IDLE_MS - TEST_SLACK_MS);
+    test_deepsleep_assert_calls(0, 0, 0, "Before the idle delay");
+    k_msleep(2 * TEST_SLACK_MS);
+
+#if CONFIG_ESIREM_QUANTUM_MAIN_DEEPSLEEP_WAKE_INTERVAL_MIN > 0
+    const struct device* button = device_get_binding(DT_GPIO_LABEL(TEST_BUTTON_NODE, gpios));
+
+    test_deepsleep_assert_calls(1, 0, 0, "Idle");
+
+    /* Reveil par le timer, puis nouvelle veille apres le delai */
+    k_msleep(TEST_WAKE_MS - 2 * TEST_SLACK_MS);
+    test_deepsleep_assert_calls(1, 0, 0, "Before the wake timer");
+    k_msleep(2 * TEST_SLACK_MS);
+    test_deepsleep_assert_calls(1, 1, 0, "Timer wake");
+    k_msleep(TEST_IDLE_MS + TEST_SLACK_MS);
+    test_deepsleep_assert_calls(2, 1, 0, "Idle after timer wake");
+
+    /* Reveil par le bouton avant le timer */
+    zassert_not_null(button, "Button not found");
+    zassert_ok(gpio_emul_input_set(button, TEST_BUTTON_PIN, 1), NULL);
+    k_msleep(10);
+    zassert_ok(gpio_emul_input_set(button, TEST_BUTTON_PIN, 0), NULL);
+    test_deepsleep_assert_calls(2, 2, 0, "Button wake");
+
+    /* Un appui hors veille ne reveille rien */
+    zassert_ok(gpio_emul_input_set(button, TEST_BUTTON_PIN, 1), NULL);
+    k_msleep(10);
+    zassert_ok(gpio_emul_input_set(button, TEST_BUTTON_PIN, 0), NULL);
+    test_deepsleep_assert_calls(2, 2, 0, "Button while awake");
+#else
+    /* System OFF apres sauvegarde, sans autre delai */
+    test_deepsleep_assert_calls(1, 0, 1, "Idle");
+    k_msleep(TEST_IDLE_MS + TEST_SLACK_MS);
+    test_deepsleep_assert_calls(1, 0, 1, "Timer re-armed after System OFF");
+#endif
+}
+
+void test_deepsleep_adv_error(void)
+{
+    /* Advertising non suspendu : la veille est retentee apres un nouveau
+     * delai */
+    test_deepsleep_suspend_err = -EIO;
+    atomic_set(&test_deepsleep_conns, 0);
+    esirem_quantum_main_deepsleep_activity();
+    k_msleep(TEST_IDLE_MS + TEST_SLACK_MS);
+    test_deepsleep_assert_calls(1, 0, 0, "Suspend failed");
+    k_msleep(TEST_IDLE_MS);
+    test_deepsleep_assert_calls(2, 0, 0, "Suspend retried");
+
+    /* Reconnexion pendant le delai : abandon */
+    atomic_set(&test_deepsleep_conns, 1);
+    k_msleep(TEST_IDLE_MS);
+    test_deepsleep_assert_calls(2, 0, 0, "Connected");
+}
@@ -0,0 +1,218 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * test_mesh.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Scenario mesh de testcase.yaml (overlay-mesh.conf) : la pile mesh n'est
+ * pas initialisee, les handlers des modeles sont retrouves par opcode dans
+ * la composition et appeles avec un contexte de reception construit ici.
+ * - Les reponses (status) echouent faute de provisionnement : seuls les
+ * effets sur le core, les parametres et les statistiques sont verifies.
+ */
+
+#include "tests.h"
+
+#include <include/clock_sync.h>
+#include <include/mesh.h>
+
+#include <bluetooth/mesh.h>
+#include <settings/settings.h>
+#include <sys/byteorder.h>
+#include <ztest.h>
+
+#define TEST_MESH_CID CONFIG_ESIREM_QUANTUM_MAIN_MESH_COMPANY_ID
+
+#define TEST_MESH_OP_GEN_ONOFF_SET_UNACK BT_MESH_MODEL_OP_2(0x82, 0x03)
+#define TEST_MESH_OP_VND(_op)            BT_MESH_MODEL_OP_3(_op, TEST_MESH_CID)
+
+#define TEST_MESH_SRC_A (0x0101)
+#define TEST_MESH_SRC_B (0x0102)
+
+/* Cycle long : seul un message d'arret ou le teardown l'arrete */
+#define TEST_TON_MS  (10)
+#define TEST_TOFF_MS (10)
+
+/* Identite du central pour la synchronisation d'horloge */
+static const uint8_t test_mesh_central;
+
+static void test_mesh_recv(
+    struct bt_mesh_model* model, uint32_t opcode, uint16_t src, uint8_t recv_ttl,
+    struct net_buf_simple* msg)
+{
+    struct bt_mesh_msg_ctx ctx = {
+        .addr     = src,
+        .recv_ttl = recv_ttl,
+    };
+
+    zassert_not_null(model, "Model not found");
+    for (const struct bt_mesh_model_op* op = model->op; op->func; op++)
+    {
+        if (op->opcode == opcode)
+        {
+            op->func(model, &ctx, msg);
+            return;
+        }
+    }
+    zassert_unreachable("Opcode 0x%06x not handled", opcode);
+}
+
+static void test_mesh_onoff(uint16_t src, uint8_t onoff, uint8_t tid)
+{
+    NET_BUF_SIMPLE_DEFINE(msg, 2);
+
+    net_buf_simple_add_u8(&msg, onoff);
+    net_buf_simple_add_u8(&msg, tid);
+    test_mesh_recv(
+        bt_mesh_model_find(esirem_quantum_main_mesh_elem(), BT_MESH_MODEL_ID_GEN_ONOFF_SRV),
+        TEST_MESH_OP_GEN_ONOFF_SET_UNACK, src, 0, &msg);
+}
+
+static struct bt_mesh_model* test_mesh_vnd_model(void)
+{
+    return bt_mesh_model_find_vnd(
+        esirem_quantum_main_mesh_elem(), TEST_MESH_CID, ESIREM_QUANTUM_MAIN_MESH_VND_MODEL_ID);
+}
+
+static void test_mesh_send_trig(uint8_t onoff, uint8_t initial_ttl, uint8_t recv_ttl, int64_t origin_us)
+{
+    NET_BUF_SIMPLE_DEFINE(msg, 2 + sizeof(int64_t));
+
+    net_buf_simple_add_u8(&msg, onoff);
+    net_buf_simple_add_u8(&msg, initial_ttl);
+    net_buf_simple_add_le64(&msg, (uint64_t) origin_us);
+    test_mesh_recv(
+        test_mesh_vnd_model(), TEST_MESH_OP_VND(ESIREM_QUANTUM_MAIN_MESH_VND_OP_TRIG), TEST_MESH_SRC_A,
+        recv_ttl, &msg);
+}
+
+static void test_mesh_vnd_config_set(const uint32_t* values, uint32_t count)
+{
+    NET_BUF_SIMPLE_DEFINE(msg, (ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT + 1) * sizeof(uint32_t));
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        net_buf_simple_add_le32(&msg, values[i]);
+    }
+    test_mesh_recv(
+        test_mesh_vnd_model(), TEST_MESH_OP_VND(ESIREM_QUANTUM_MAIN_MESH_VND_OP_CONFIG_SET),
+        TEST_MESH_SRC_A, 0, &msg);
+}
+
+static uint32_t test_mesh_setting(enum esirem_quantum_main_core_setting_index setting)
+{
+    return esirem_quantum_main_core_setting_get(&esirem_quantum_main_core_setting_map_uuid_keyptr[setting]);
+}
+
+void test_mesh_setup(void)
+{
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+
+    test_settings_reset();
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] = 1000 * (TEST_TON_MS + TEST_TOFF_MS);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]          = TEST_TON_MS;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS]         = TEST_TOFF_MS;
+    zassert_equal(
+        esirem_quantum_main_core_settings_publish(values), ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK,
+        "Test cycle refused");
+}
+
+void test_mesh_gen_onoff(void)
+{
+    test_mesh_onoff(TEST_MESH_SRC_A, 1, 1);
+    zassert_false(esirem_quantum_main_core_is_idle(), "OnOff ON refused");
+    test_mesh_onoff(TEST_MESH_SRC_A, 0, 2);
+    test_core_wait_idle(1000);
+    zassert_true(esirem_quantum_main_core_is_idle(), "OnOff OFF refused");
+
+    /* Meme TID de la meme source : repetition d'un relais, ignoree */
+    test_mesh_onoff(TEST_MESH_SRC_A, 1, 2);
+    zassert_true(esirem_quantum_main_core_is_idle(), "Repeated message applied");
+
+    /* Meme TID d'une autre source : message distinct */
+    test_mesh_onoff(TEST_MESH_SRC_B, 1, 2);
+    zassert_false(esirem_quantum_main_core_is_idle(), "Other source refused");
+    test_mesh_onoff(TEST_MESH_SRC_B, 0, 3);
+    test_core_wait_idle(1000);
+    zassert_true(esirem_quantum_main_core_is_idle(), "OnOff OFF refused");
+}
+
+void test_mesh_vnd_config(void)
+{
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    uint32_t masked[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT] = 60;
+    test_mesh_vnd_config_set(values, ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT);
+    zassert_equal(test_mesh_setting(ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT), 60, "Config not applied");
+
+    /* La valeur publiee est celle de la flash */
+    test_settings_baseline(masked);
+    zassert_equal(
+        esirem_quantum_main_core_settings_publish(masked), ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK, NULL);
+    zassert_ok(settings_load(), "Load failed");
+    zassert_equal(test_mesh_setting(ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT), 60, "Config not saved");
+
+    /* Taille differente de la table ou regle violee : rien n'est applique */
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT] = 50;
+    test_mesh_vnd_config_set(values, ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT - 1);
+    zassert_equal(test_mesh_setting(ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT), 60, "Short config applied");
+    test_mesh_vnd_config_set(values, ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT + 1);
+    zassert_equal(test_mesh_setting(ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT), 60, "Long config applied");
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT] = 101;
+    test_mesh_vnd_config_set(values, ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT);
+    zassert_equal(test_mesh_setting(ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT), 60, "Invalid config applied");
+}
+
+void test_mesh_vnd_trig(void)
+{
+    const struct bt_conn* central = (const struct bt_conn*) &test_mesh_central;
+    struct esirem_quantum_main_mesh_stats before;
+    struct esirem_quantum_main_mesh_stats after;
+    int64_t central_us;
+
+    /* Non synchronise (le ping d'un nouveau central oublie la base de temps
+     * precedente) : sauts comptes, pas de latence */
+    esirem_quantum_main_clock_sync_ping(central, 1000000);
+    esirem_quantum_main_mesh_get_stats(&before);
+    test_mesh_send_trig(1, 7, 5, 0);
+    zassert_false(esirem_quantum_main_core_is_idle(), "Vendor trigger refused");
+    esirem_quantum_main_mesh_get_stats(&after);
+    zassert_equal(after.rx_count, before.rx_count + 1, NULL);
+    zassert_equal(after.hop_sum, before.hop_sum + 2, NULL);
+    zassert_true(after.hop_min <= 2 && after.hop_max >= 2, "Hops %u..%u", after.hop_min, after.hop_max);
+    zassert_equal(after.latency_count, before.latency_count, "Latency counted without sync");
+
+    /* Synchronise : latence depuis l'horodatage d'emission */
+    zassert_ok(esirem_quantum_main_clock_sync_update(central, 1000000, 0), "Sync refused");
+    zassert_ok(esirem_quantum_main_clock_sync_central_us(&central_us), "Not synced");
+
+    before = after;
+    test_mesh_send_trig(0, 3, 3, central_us - 5000);
+    test_core_wait_idle(1000);
+    zassert_true(esirem_quantum_main_core_is_idle(), "Vendor stop refused");
+    esirem_quantum_main_mesh_get_stats(&after);
+    zassert_equal(after.rx_count, before.rx_count + 1, NULL);
+    zassert_equal(after.hop_min, 0, NULL);
+    zassert_equal(after.latency_count, before.latency_count + 1, "Latency not counted");
+    zassert_true(after.latency_max_us >= 5000, "Latency %u us", after.latency_max_us);
+
+    /* Horodatage dans le futur du central : pas de latence */
+    before = after;
+    test_mesh_send_trig(0, 3, 3, central_us + 1000000);
+    esirem_quantum_main_mesh_get_stats(&after);
+    zassert_equal(after.latency_count, before.latency_count, "Future origin counted");
+
+    esirem_quantum_main_clock_sync_disconnected(central);
+}
@@ -0,0 +1,365 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * test_settings.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Regles de validation : chaque code de refus est provoque a partir du
+ * jeu de reference.
+ * - Sauvegarde : les valeurs stockees sont relues par settings_load apres
+ * une publication en RAM seulement qui les masque.
+ * - Service configuration : les callbacks GATT sont appeles sans connexion,
+ * les attributs sont retrouves par UUID comme le ferait un central.
+ */
+
+#include "tests.h"
+
+#include <include/ble_service_config.h>
+
+#include <bluetooth/gatt.h>
+#include <settings/settings.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/byteorder.h>
+#include <ztest.h>
+
+void test_settings_baseline(uint32_t* values)
+{
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] = 1000;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]          = 100;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS]         = 100;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_CURRENT_UA]      = 10000;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT]   = 100;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_FADE_IN_MS]      = 0;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_FADE_OUT_MS]     = 0;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_MODE]        = ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_PERIODS;
+}
+
+/* Arrete tout cycle puis sauvegarde et publie le jeu de reference */
+void test_settings_reset(void)
+{
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    enum esirem_quantum_main_core_setting_check_result result;
+
+    esirem_quantum_main_core_stop_cycle();
+    test_core_wait_idle(1000);
+
+    test_settings_baseline(values);
+    zassert_ok(
+        esirem_quantum_main_core_settings_store(values, &result, NULL, NULL),
+        "Failed to store baseline");
+}
+
+static void test_settings_assert_values(const uint32_t* values)
+{
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        zassert_equal(
+            esirem_quantum_main_core_setting_get(&esirem_quantum_main_core_setting_map_uuid_keyptr[i]),
+            values[i], "Setting %u differs", i);
+    }
+}
+
+static int test_settings_commit_fail(void* user_data)
+{
+    return -EIO;
+}
+
+void test_settings_check_rules(void)
+{
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+
+    test_settings_baseline(values);
+    zassert_equal(
+        esirem_quantum_main_core_settings_check(values), ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK,
+        "Baseline refused");
+
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT] = 101;
+    zassert_equal(
+        esirem_quantum_main_core_settings_check(values),
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OUT_OF_RANGE, NULL);
+
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]  = 0;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS] = CONFIG_ESIREM_QUANTUM_MAIN_CORE_PERIOD_MIN_MS - 1;
+    zassert_equal(
+        esirem_quantum_main_core_settings_check(values),
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_PERIOD_TOO_SHORT, NULL);
+
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] = 199;
+    zassert_equal(
+        esirem_quantum_main_core_settings_check(values),
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_SEQ_TOO_SHORT, NULL);
+
+    /* Mode duree exacte : sequence plus courte qu'une periode acceptee,
+     * sequence nulle refusee */
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_MODE] = ESIREM_QUANTUM_MAIN_CORE_SEQ_MODE_EXACT;
+    zassert_equal(
+        esirem_quantum_main_core_settings_check(values), ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK,
+        NULL);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] = 0;
+    zassert_equal(
+        esirem_quantum_main_core_settings_check(values),
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_SEQ_TOO_SHORT, NULL);
+
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]  = CONFIG_ESIREM_QUANTUM_MAIN_CORE_PERIOD_MIN_MS;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS] = 0;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] =
+        CONFIG_ESIREM_QUANTUM_MAIN_CORE_PERIOD_MIN_MS * (CONFIG_ESIREM_QUANTUM_MAIN_CORE_PERIOD_COUNT_MAX + 1);
+    zassert_equal(
+        esirem_quantum_main_core_settings_check(values),
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_TOO_MANY_PERIODS, NULL);
+
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] = 1001;
+    zassert_equal(
+        esirem_quantum_main_core_settings_check(values),
+        IS_ENABLED(CONFIG_ESIREM_QUANTUM_MAIN_CORE_SEQ_DIVISIBLE)
+            ? ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_NOT_DIVISIBLE
+            : ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK,
+        NULL);
+
+    /* Une seule valeur remplacee dans les parametres courants */
+    zassert_equal(
+        esirem_quantum_main_core_setting_check(
+            &esirem_quantum_main_core_setting_map_uuid_keyptr[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS],
+            1000),
+        ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_SEQ_TOO_SHORT, NULL);
+}
+
+void test_settings_full_key(void)
+{
+    char key[ESIREM_QUANTUM_MAIN_CORE_SETTINGS_KEY_STR_MAX_LEN];
+    char expected[ESIREM_QUANTUM_MAIN_CORE_SETTINGS_KEY_STR_MAX_LEN];
+    size_t len;
+
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        const struct esirem_quantum_main_core_setting_map_uuid_keyptr* map =
+            &esirem_quantum_main_core_setting_map_uuid_keyptr[i];
+
+        zassert_ok(
+            esirem_quantum_main_core_setting_get_full_key(map, key, sizeof(key)),
+            "Key %s rejected", map->key);
+        snprintf(expected, sizeof(expected), "%s/%s", esirem_quantum_main_core_setting_key_module, map->key);
+        zassert_equal(strcmp(key, expected), 0, "Key %s built as %s", map->key, key);
+
+        /* Buffer exact accepte, un octet de moins refuse */
+        len = strlen(expected) + 1;
+        memset(key, 'x', sizeof(key));
+        zassert_ok(esirem_quantum_main_core_setting_get_full_key(map, key, len), NULL);
+        zassert_equal(key[len - 1], '\0', "Key %s not terminated", map->key);
+        zassert_equal(
+            esirem_quantum_main_core_setting_get_full_key(map, key, len - 1), -EINVAL,
+            "Key %s accepted in a short buffer", map->key);
+    }
+
+    zassert_equal(esirem_quantum_main_core_setting_get_full_key(NULL, key, sizeof(key)), -EINVAL, NULL);
+}
+
+void test_settings_store_load(void)
+{
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    uint32_t masked[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    enum esirem_quantum_main_core_setting_check_result result;
+    uint32_t generation = esirem_quantum_main_core_setting_get_generation();
+
+    /* Chaque valeur rechargee seule respecte les regles : le chargement
+     * apres le premier commit valide cle par cle */
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]     = 150;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS]    = 100;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_CURRENT_UA] = 20000;
+    zassert_ok(esirem_quantum_main_core_settings_store(values, &result, NULL, NULL), "Store failed");
+    zassert_equal(result, ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK, NULL);
+    test_settings_assert_values(values);
+    zassert_not_equal(esirem_quantum_main_core_setting_get_generation(), generation, "Generation unchanged");
+
+    test_settings_baseline(masked);
+    zassert_equal(
+        esirem_quantum_main_core_settings_publish(masked), ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK,
+        NULL);
+    test_settings_assert_values(masked);
+
+    zassert_ok(settings_load(), "Load failed");
+    test_settings_assert_values(values);
+
+    /* Jeu invalide : rien n'est sauvegarde ni publie */
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] = 0;
+    zassert_equal(
+        esirem_quantum_main_core_settings_store(values, &result, NULL, NULL), -EINVAL, NULL);
+    zassert_equal(result, ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_SEQ_TOO_SHORT, NULL);
+    zassert_equal(
+        esirem_quantum_main_core_setting_get(
+            &esirem_quantum_main_core_setting_map_uuid_keyptr[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS]),
+        1000, "Invalid value published");
+}
+
+void test_settings_store_rollback(void)
+{
+    uint32_t before[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    enum esirem_quantum_main_core_setting_check_result result;
+    uint32_t generation = esirem_quantum_main_core_setting_get_generation();
+
+    test_settings_baseline(before);
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT] = 40;
+
+    /* Echec apres la sauvegarde : la flash est restauree, rien n'est
+     * publie */
+    zassert_equal(
+        esirem_quantum_main_core_settings_store(values, &result, test_settings_commit_fail, NULL),
+        -EIO, NULL);
+    zassert_equal(result, ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK, NULL);
+    test_settings_assert_values(before);
+    zassert_equal(esirem_quantum_main_core_setting_get_generation(), generation, "Generation changed");
+
+    zassert_ok(settings_load(), "Load failed");
+    test_settings_assert_values(before);
+}
+
+void test_settings_set_invalid(void)
+{
+    uint32_t value = 50;
+    uint16_t short_value = 50;
+
+    /* Taille, cle prolongee, valeur hors bornes */
+    zassert_equal(
+        settings_runtime_set("esirem_quantum_main/cfg/led/intensity_pct", &short_value, sizeof(short_value)),
+        -EINVAL, NULL);
+    zassert_equal(
+        settings_runtime_set("esirem_quantum_main/cfg/led/intensity_pctX", &value, sizeof(value)),
+        -EINVAL, NULL);
+    value = 101;
+    zassert_equal(
+        settings_runtime_set("esirem_quantum_main/cfg/led/intensity_pct", &value, sizeof(value)),
+        -EINVAL, NULL);
+    zassert_equal(
+        esirem_quantum_main_core_setting_get(
+            &esirem_quantum_main_core_setting_map_uuid_keyptr[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT]),
+        100, "Invalid value applied");
+
+    value = 50;
+    zassert_ok(
+        settings_runtime_set("esirem_quantum_main/cfg/led/intensity_pct", &value, sizeof(value)), NULL);
+    zassert_equal(
+        esirem_quantum_main_core_setting_get(
+            &esirem_quantum_main_core_setting_map_uuid_keyptr[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_INTENSITY_PCT]),
+        50, NULL);
+}
+
+static const struct bt_gatt_attr* test_gatt_config_attr(const struct bt_uuid_128* uuid)
+{
+    const struct bt_gatt_attr* attr = bt_gatt_find_by_uuid(
+        esirem_quantum_main_service_config.attrs, esirem_quantum_main_service_config.attr_count,
+        &uuid->uuid);
+
+    zassert_not_null(attr, "Attribute not found");
+    return attr;
+}
+
+static uint32_t test_gatt_config_read_u32(const struct bt_gatt_attr* attr)
+{
+    uint8_t buf[sizeof(uint32_t)];
+
+    zassert_equal(attr->read(NULL, attr, buf, sizeof(buf), 0), sizeof(buf), "Read failed");
+    return sys_get_le32(buf);
+}
+
+void test_gatt_config_write(void)
+{
+    const struct bt_gatt_attr* intensity =
+        test_gatt_config_attr(&esirem_quantum_main_ble_uuid_service_config_chrc_led_intensity_pct);
+    const struct bt_gatt_attr* ton =
+        test_gatt_config_attr(&esirem_quantum_main_ble_uuid_service_config_chrc_led_ton_ms);
+    uint32_t masked[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    uint8_t buf[sizeof(uint32_t)];
+
+    sys_put_le32(60, buf);
+    zassert_equal(intensity->write(NULL, intensity, buf, sizeof(buf), 0, 0), sizeof(buf), NULL);
+    zassert_equal(test_gatt_config_read_u32(intensity), 60, NULL);
+
+    /* La valeur publiee est celle de la flash */
+    test_settings_baseline(masked);
+    zassert_equal(
+        esirem_quantum_main_core_settings_publish(masked), ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK,
+        NULL);
+    zassert_ok(settings_load(), "Load failed");
+    zassert_equal(test_gatt_config_read_u32(intensity), 60, "Write not saved");
+
+    sys_put_le32(101, buf);
+    zassert_equal(
+        intensity->write(NULL, intensity, buf, sizeof(buf), 0, 0), BT_GATT_ERR(BT_ATT_ERR_OUT_OF_RANGE),
+        NULL);
+    zassert_equal(
+        intensity->write(NULL, intensity, buf, sizeof(uint16_t), 0, 0),
+        BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN), NULL);
+    zassert_equal(
+        intensity->write(NULL, intensity, buf, sizeof(buf), 1, 0),
+        BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET), NULL);
+    zassert_equal(test_gatt_config_read_u32(intensity), 60, "Refused write applied");
+
+    /* Regle entre parametres : erreur ATT applicative */
+    sys_put_le32(1000, buf);
+    zassert_equal(
+        ton->write(NULL, ton, buf, sizeof(buf), 0, 0),
+        BT_GATT_ERR(ESIREM_QUANTUM_MAIN_SERVICE_CONFIG_ATT_ERR_SEQ_TOO_SHORT), NULL);
+    zassert_equal(test_gatt_config_read_u32(ton), 100, "Refused write applied");
+}
+
+void test_gatt_config_all_write(void)
+{
+    const struct bt_gatt_attr* all =
+        test_gatt_config_attr(&esirem_quantum_main_ble_uuid_service_config_chrc_all);
+    const struct bt_gatt_attr* generation =
+        test_gatt_config_attr(&esirem_quantum_main_ble_uuid_service_config_chrc_generation);
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+    uint8_t buf[sizeof(values)];
+    uint32_t gen = test_gatt_config_read_u32(generation);
+
+    /* Passage direct a un jeu dont les etapes intermediaires seraient
+     * refusees une par une */
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] = 20000;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]          = 2000;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS]         = 2000;
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        sys_put_le32(values[i], &buf[i * sizeof(uint32_t)]);
+    }
+    zassert_equal(all->write(NULL, all, buf, sizeof(buf), 0, 0), sizeof(buf), NULL);
+    test_settings_assert_values(values);
+    zassert_equal(test_gatt_config_read_u32(generation), gen + 1, "Generation not incremented");
+
+    memset(buf, 0, sizeof(buf));
+    zassert_equal(all->read(NULL, all, buf, sizeof(buf), 0), sizeof(buf), NULL);
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        zassert_equal(sys_get_le32(&buf[i * sizeof(uint32_t)]), values[i], "Value %u read back", i);
+    }
+
+    /* Jeu refuse : ni publication ni changement de generation */
+    sys_put_le32(0, &buf[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS * sizeof(uint32_t)]);
+    sys_put_le32(0, &buf[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS * sizeof(uint32_t)]);
+    zassert_equal(
+        all->write(NULL, all, buf, sizeof(buf), 0, 0),
+        BT_GATT_ERR(ESIREM_QUANTUM_MAIN_SERVICE_CONFIG_ATT_ERR_PERIOD_TOO_SHORT), NULL);
+    zassert_equal(
+        all->write(NULL, all, buf, sizeof(buf) - 1, 0, 0),
+        BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN), NULL);
+    test_settings_assert_values(values);
+    zassert_equal(test_gatt_config_read_u32(generation), gen + 1, "Generation changed");
+}
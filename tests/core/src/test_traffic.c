@@ -0,0 +1,149 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * test_traffic.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Pendant de scripts/gatt_load.py executable sans adaptateur : chaque
+ * central simule est un thread qui appelle les callbacks d'ecriture GATT
+ * en boucle, en cedant la main entre deux ecritures pour entrelacer les
+ * commandes comme le thread RX.
+ * - Scenarios trig (declenchements / arrets) et params (Ton valide, puis
+ * ecriture de taille invalide).
+ * - Les compteurs de commandes et d'erreurs ATT de la carte doivent egaler
+ * la somme des ecritures et des refus vus par les centraux.
+ */
+
+#include "tests.h"
+
+#include <include/ble_service_config.h>
+#include <include/ble_uuid.h>
+#include <include/traffic.h>
+
+#include <bluetooth/gatt.h>
+#include <sys/byteorder.h>
+#include <ztest.h>
+
+#define TEST_TRAFFIC_CENTRALS   (3)
+#define TEST_TRAFFIC_ITERATIONS (100)
+#define TEST_TRAFFIC_STACK_SIZE (2048)
+
+struct test_traffic_central
+{
+    void (*scenario)(struct test_traffic_central* central);
+    uint32_t commands;
+    uint32_t att_errors;
+};
+
+K_THREAD_STACK_ARRAY_DEFINE(test_traffic_stacks, TEST_TRAFFIC_CENTRALS, TEST_TRAFFIC_STACK_SIZE);
+static struct k_thread test_traffic_threads[TEST_TRAFFIC_CENTRALS];
+
+static const struct bt_gatt_attr* test_traffic_attr_state;
+static const struct bt_gatt_attr* test_traffic_attr_ton;
+
+static void test_traffic_write(
+    struct test_traffic_central* central, const struct bt_gatt_attr* attr, const uint8_t* buf,
+    uint16_t len)
+{
+    ssize_t ret = attr->write(NULL, attr, buf, len, 0, 0);
+
+    central->commands++;
+    if (ret != len)
+    {
+        central->att_errors++;
+    }
+    k_yield();
+}
+
+static void test_traffic_scenario_trig(struct test_traffic_central* central)
+{
+    const uint8_t on  = 0x01;
+    const uint8_t off = 0x00;
+
+    for (uint32_t i = 0; i < TEST_TRAFFIC_ITERATIONS; i++)
+    {
+        test_traffic_write(central, test_traffic_attr_state, &on, sizeof(on));
+        test_traffic_write(central, test_traffic_attr_state, &off, sizeof(off));
+    }
+}
+
+static void test_traffic_scenario_params(struct test_traffic_central* central)
+{
+    uint8_t buf[sizeof(uint32_t)];
+    uint32_t ton;
+
+    ton =esirem_quantum_main_core_setting_get(
+        &esirem_quantum_main_core_setting_map_uuid_keyptr[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]);
+
+    for (uint32_t i = 0; i < TEST_TRAFFIC_ITERATIONS; i++)
+    {
+        sys_put_le32(ton + (i & 1), buf);
+        test_traffic_write(central, test_traffic_attr_ton, buf, sizeof(buf));
+        test_traffic_write(central, test_traffic_attr_ton, buf, sizeof(uint16_t));
+    }
+}
+
+static void test_traffic_thread(void* p1, void* p2, void* p3)
+{
+    struct test_traffic_central* central = p1;
+
+    central->scenario(central);
+}
+
+void test_traffic_counters(void)
+{
+    struct test_traffic_central centrals[TEST_TRAFFIC_CENTRALS] = {
+        {.scenario = test_traffic_scenario_trig},
+        {.scenario = test_traffic_scenario_trig},
+        {.scenario = test_traffic_scenario_params},
+    };
+    struct esirem_quantum_main_traffic traffic;
+    uint32_t commands   = 0;
+    uint32_t att_errors = 0;
+
+    test_traffic_attr_state = bt_gatt_find_by_uuid(
+        NULL, 0,
+        ESIREM_QUANTUM_MAIN_BLE_UUID_DECLARE_SERVICE_CHRC(
+            ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER_CHRC_STATE));
+    test_traffic_attr_ton = bt_gatt_find_by_uuid(
+        esirem_quantum_main_service_config.attrs, esirem_quantum_main_service_config.attr_count,
+        &esirem_quantum_main_ble_uuid_service_config_chrc_led_ton_ms.uuid);
+    zassert_not_null(test_traffic_attr_state, "State attribute not found");
+    zassert_not_null(test_traffic_attr_ton, "Ton attribute not found");
+
+    esirem_quantum_main_traffic_reset();
+
+    for (uint32_t i = 0; i < TEST_TRAFFIC_CENTRALS; i++)
+    {
+        k_thread_create(
+            &test_traffic_threads[i], test_traffic_stacks[i], K_THREAD_STACK_SIZEOF(test_traffic_stacks[i]),
+            test_traffic_thread, &centrals[i], NULL, NULL, k_thread_priority_get(k_current_get()), 0,
+            K_NO_WAIT);
+    }
+    for (uint32_t i = 0; i < TEST_TRAFFIC_CENTRALS; i++)
+    {
+        zassert_ok(k_thread_join(&test_traffic_threads[i], K_SECONDS(10)), "Central %u stuck", i);
+        commands += centrals[i].commands;
+        att_errors += centrals[i].att_errors;
+    }
+
+    esirem_quantum_main_traffic_get(&traffic);
+    zassert_equal(
+        traffic.counters[ESIREM_QUANTUM_MAIN_TRAFFIC_COMMANDS], commands, "%u commands counted, %u sent",
+        traffic.counters[ESIREM_QUANTUM_MAIN_TRAFFIC_COMMANDS], commands);
+    zassert_equal(
+        traffic.counters[ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERRORS], att_errors,
+        "%u ATT errors counted, %u seen", traffic.counters[ESIREM_QUANTUM_MAIN_TRAFFIC_ATT_ERRORS],
+        att_errors);
+    /* Au moins les ecritures de taille invalide */
+    zassert_true(att_errors >= TEST_TRAFFIC_ITERATIONS, "%u ATT errors", att_errors);
+}
@@ -0,0 +1,185 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * test_trigger_input.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - L'entree de declenchement est pilotee par gpio_emul_input_set : le
+ * callback GPIO est appele comme depuis l'interruption.
+ * - La latence entree -> premier front LED est mesuree en temps simule en
+ * echantillonnant la LED toutes les 100 us, et relue dans l'histogramme de
+ * la sonde "declenchement -> allumage".
+ * - Mode bouton (bascule) : un appui declenche, un appui apres la fenetre
+ * d'anti-rebond arrete, un rebond dans la fenetre est ignore.
+ * - Mode contact (scenario trigger_level de testcase.yaml) : le niveau
+ * relu en fin de fenetre l'emporte sur les fronts ignores pendant la
+ * fenetre.
+ */
+
+#include "tests.h"
+
+#include <include/latency.h>
+
+#include <device.h>
+#include <drivers/gpio.h>
+#include <drivers/gpio/gpio_emul.h>
+#include <ztest.h>
+
+#define TEST_LED_NODE   DT_ALIAS(led0)
+#define TEST_LED_PIN    DT_GPIO_PIN(TEST_LED_NODE, gpios)
+#define TEST_INPUT_NODE DT_ALIAS(trigger_input)
+#define TEST_INPUT_PIN  DT_GPIO_PIN(TEST_INPUT_NODE, gpios)
+
+#define TEST_SAMPLE_US      (100)
+#define TEST_LATENCY_MAX_US (1000)
+
+/* Cycle long : seul l'appui suivant l'arrete */
+#define TEST_TON_MS  (10)
+#define TEST_TOFF_MS (10)
+
+/* Attend que la LED prenne la valeur donnee, renvoie le temps ecoule (us)
+ * ou -1 */
+static int64_t test_trigger_input_wait_led(int value, uint32_t timeout_us)
+{
+    const struct device* dev = device_get_binding(DT_GPIO_LABEL(TEST_LED_NODE, gpios));
+    int64_t t0_us            = (int64_t) k_ticks_to_us_floor64(k_uptime_ticks());
+    int64_t elapsed_us       = 0;
+
+    while (elapsed_us <= timeout_us)
+    {
+        if (gpio_emul_output_get(dev, TEST_LED_PIN) == value)
+        {
+            return elapsed_us;
+        }
+        k_usleep(TEST_SAMPLE_US);
+        elapsed_us = (int64_t) k_ticks_to_us_floor64(k_uptime_ticks()) - t0_us;
+    }
+
+    return -1;
+}
+
+static void test_trigger_input_publish_cycle(void)
+{
+    uint32_t values[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+
+    test_settings_baseline(values);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_SEQ_DURATION_MS] = 1000 * (TEST_TON_MS + TEST_TOFF_MS);
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS]          = TEST_TON_MS;
+    values[ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TOFF_MS]         = TEST_TOFF_MS;
+    zassert_equal(
+        esirem_quantum_main_core_settings_publish(values), ESIREM_QUANTUM_MAIN_CORE_SETTING_CHECK_OK,
+        "Test cycle refused");
+}
+
+void test_trigger_input_latency(void)
+{
+    const struct device* input = device_get_binding(DT_GPIO_LABEL(TEST_INPUT_NODE, gpios));
+    struct esirem_quantum_main_latency_hist hist;
+    int64_t latency_us;
+
+    if (!IS_ENABLED(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_MODE_TOGGLE))
+    {
+        ztest_test_skip();
+        return;
+    }
+
+    test_trigger_input_publish_cycle();
+
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 0);
+    k_msleep(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS + 1);
+    esirem_quantum_main_latency_reset();
+
+    /* Appui : premier front LED en moins d'une milliseconde */
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 1);
+    latency_us = test_trigger_input_wait_led(1, 10000);
+    zassert_true(latency_us >= 0, "LED not switched on");
+    zassert_true(latency_us < TEST_LATENCY_MAX_US, "Input to edge took %lld us", latency_us);
+
+    esirem_quantum_main_latency_get(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_TRIG_TO_EDGE, &hist);
+    zassert_equal(hist.count, 1, "%u latency samples", hist.count);
+    zassert_true(hist.max_us < TEST_LATENCY_MAX_US, "Probe measured %u us", hist.max_us);
+
+    /* Rebond dans la fenetre d'anti-rebond : ignore */
+    if (CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS)
+    {
+        gpio_emul_input_set(input, TEST_INPUT_PIN, 0);
+        gpio_emul_input_set(input, TEST_INPUT_PIN, 1);
+        k_msleep(TEST_TON_MS + TEST_TOFF_MS);
+        zassert_not_equal(esirem_quantum_main_core_device_running(), 0, "Bounce stopped the cycle");
+    }
+    k_msleep(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS + 1);
+
+    /* Second appui : arret au prochain front OFF */
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 0);
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 1);
+    test_core_wait_idle(TEST_TON_MS + TEST_TOFF_MS + 2);
+    zassert_true(esirem_quantum_main_core_is_idle(), "Second press did not stop the cycle");
+    zassert_equal(test_trigger_input_wait_led(0, 0), 0, "LED on after stop");
+
+    esirem_quantum_main_latency_get(ESIREM_QUANTUM_MAIN_LATENCY_PROBE_STOP_TO_OFF, &hist);
+    zassert_equal(hist.count, 1, "%u stop latency samples", hist.count);
+
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 0);
+}
+
+void test_trigger_input_level(void)
+{
+    const struct device* input = device_get_binding(DT_GPIO_LABEL(TEST_INPUT_NODE, gpios));
+
+    if (!IS_ENABLED(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_MODE_LEVEL))
+    {
+        ztest_test_skip();
+        return;
+    }
+
+    test_trigger_input_publish_cycle();
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 0);
+    k_msleep(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS + 1);
+
+    /* Impulsion plus courte que la fenetre : le relachement est ignore par
+     * l'interruption, puis applique a la relecture */
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 1);
+    zassert_false(esirem_quantum_main_core_is_idle(), "Contact closure did not trigger");
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 0);
+    test_core_wait_idle(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS + TEST_TON_MS + TEST_TOFF_MS + 2);
+    zassert_true(esirem_quantum_main_core_is_idle(), "Short pulse left the cycle running");
+    k_msleep(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS + 1);
+
+    /* Fermeture avec rebonds : le cycle tourne apres la fenetre */
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 1);
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 0);
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 1);
+    k_msleep(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS + TEST_TON_MS + TEST_TOFF_MS);
+    zassert_not_equal(esirem_quantum_main_core_device_running(), 0, "Closure bounce stopped the cycle");
+
+    /* Relachement avec rebonds : arret, pas de redemarrage */
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 0);
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 1);
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 0);
+    test_core_wait_idle(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS + TEST_TON_MS + TEST_TOFF_MS + 2);
+    zassert_true(esirem_quantum_main_core_is_idle(), "Release bounce left the cycle running");
+    k_msleep(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS + 2 * (TEST_TON_MS + TEST_TOFF_MS));
+    zassert_true(esirem_quantum_main_core_is_idle(), "Release bounce restarted the cycle");
+
+    /* Refermeture pendant l'arret : le depart refuse est retente a la fin
+     * du cycle, le cycle tourne avec le contact ferme */
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 1);
+    k_msleep(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS + 1);
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 0);
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 1);
+    k_msleep(2 * CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS + 2 * (TEST_TON_MS + TEST_TOFF_MS));
+    zassert_not_equal(esirem_quantum_main_core_device_running(), 0, "Cycle stopped with the contact closed");
+
+    gpio_emul_input_set(input, TEST_INPUT_PIN, 0);
+    test_core_wait_idle(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS + TEST_TON_MS + TEST_TOFF_MS + 2);
+    k_msleep(CONFIG_ESIREM_QUANTUM_MAIN_TRIGGER_INPUT_DEBOUNCE_MS + 1);
+}
@@ -0,0 +1,65 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * tests.h - 07/12/2021
+ * Cas de test du core et des parametres
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_TESTS_CORE_TESTS_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_TESTS_CORE_TESTS_H_INCLUDED
+
+#include <include/core.h>
+
+#include <zephyr.h>
+
+/**@brief Jeu de parametres valide de reference, ordre de la table */
+void test_settings_baseline(uint32_t* values);
+/**@brief Attend le retour au repos du core (LED eteinte, rien de programme) */
+void test_core_wait_idle(uint32_t timeout_ms);
+
+void test_core_idle_after_init(void);
+void test_core_cycle_periods(void);
+void test_core_cycle_exact(void);
+void test_core_stop(void);
+void test_core_trig_busy(void);
+void test_core_trig_at(void);
+void test_clock_sync_trig_at(void);
+void test_trigger_input_latency(void);
+void test_trigger_input_level(void);
+
+void test_settings_check_rules(void);
+void test_settings_full_key(void);
+void test_settings_store_load(void);
+void test_settings_store_rollback(void);
+void test_settings_set_invalid(void);
+void test_gatt_config_write(void);
+void test_gatt_config_all_write(void);
+void test_settings_reset(void);
+
+void test_traffic_counters(void);
+
+void test_deepsleep_init(void);
+void test_deepsleep_setup(void);
+void test_deepsleep_teardown(void);
+void test_deepsleep_idle(void);
+void test_deepsleep_adv_error(void);
+
+void test_beacon_setup(void);
+void test_beacon_mac(void);
+void test_beacon_replay(void);
+void test_beacon_counter_bound(void);
+
+void test_mesh_setup(void);
+void test_mesh_gen_onoff(void);
+void test_mesh_vnd_config(void);
+void test_mesh_vnd_trig(void);
+
+#endif // ESIREM_QUANTUM_MAIN_TESTS_CORE_TESTS_H_INCLUDED
@@ -0,0 +1,274 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * fuzz.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Chaque entree est aiguillee vers un callback d'ecriture GATT (services
+ * utilisateur, configuration, provisionnement) ou vers un handler settings,
+ * avec l'offset et la longueur de l'entree : les callbacks sont appeles
+ * directement, sans la pile BLE, comme par le thread RX.
+ * - Le handler settings recoit soit les valeurs de settings_runtime_set,
+ * soit un read_cb qui rend moins d'octets qu'annonce ou une erreur, comme
+ * un enregistrement tronque en flash.
+ * - Les donnees sont recopiees dans un buffer de leur taille exacte : une
+ * lecture au-dela est vue par ASAN.
+ * - Les sanitizers arretent le programme a la premiere erreur.
+ */
+
+#include "fuzz.h"
+
+#include <include/ble_service_config.h>
+#include <include/ble_service_prov.h>
+#include <include/ble_service_user.h>
+#include <include/ble_uuid.h>
+#include <include/core.h>
+#include <include/latency.h>
+#include <include/odometer.h>
+#include <include/retained.h>
+#include <include/settings.h>
+#include <include/stats.h>
+
+#include <zephyr.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/byteorder.h>
+
+#include <bluetooth/gatt.h>
+#include <settings/settings.h>
+
+struct fuzz_read_ctx
+{
+    const uint8_t* data;
+    size_t len;
+    bool fail;
+};
+
+static struct settings_handler* const fuzz_settings_hdlrs[] = {
+    &esirem_quantum_main_core_settings_hdlrs,
+    &esirem_quantum_main_stats_settings_hdlrs,
+    &esirem_quantum_main_odometer_settings_hdlrs,
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_PROVISION)
+    &esirem_quantum_main_prov_settings_hdlrs,
+#endif
+};
+
+static const struct bt_gatt_attr* fuzz_attr_user_state;
+static const struct bt_gatt_attr* fuzz_attr_user_clock;
+static const struct bt_gatt_attr* fuzz_attr_config[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT];
+static const struct bt_gatt_attr* fuzz_attr_config_all;
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_PROVISION)
+static const struct bt_gatt_attr* fuzz_attr_prov_ctrl;
+#endif
+static bool fuzz_ready = false;
+
+static const struct bt_gatt_attr* fuzz_attr(const struct bt_uuid* uuid)
+{
+    const struct bt_gatt_attr* attr = bt_gatt_find_by_uuid(NULL, 0, uuid);
+
+    if (!attr || !attr->write)
+    {
+        printk("FUZZ,error,attribute not found\n");
+        abort();
+    }
+    return attr;
+}
+
+void fuzz_init(void)
+{
+    if (fuzz_ready)
+    {
+        return;
+    }
+
+    esirem_quantum_main_retained_init();
+    esirem_quantum_main_stats_init();
+    esirem_quantum_main_odometer_init();
+    esirem_quantum_main_latency_init();
+    esirem_quantum_main_settings_init();
+    esirem_quantum_main_core_init();
+    settings_load();
+
+    fuzz_attr_user_state = fuzz_attr(ESIREM_QUANTUM_MAIN_BLE_UUID_DECLARE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER_CHRC_STATE));
+    fuzz_attr_user_clock = fuzz_attr(ESIREM_QUANTUM_MAIN_BLE_UUID_DECLARE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_USER_CHRC_CLOCK));
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        fuzz_attr_config[i] = fuzz_attr(esirem_quantum_main_core_setting_map_uuid_keyptr[i].uuid);
+    }
+    fuzz_attr_config_all = fuzz_attr(&esirem_quantum_main_ble_uuid_service_config_chrc_all.uuid);
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_PROVISION)
+    fuzz_attr_prov_ctrl = fuzz_attr(ESIREM_QUANTUM_MAIN_BLE_UUID_DECLARE_SERVICE_CHRC(
+        ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_PROV, ESIREM_QUANTUM_MAIN_BLE_UUID_SERVICE_PROV_CHRC_CTRL));
+#endif
+
+    fuzz_ready = true;
+}
+
+static void fuzz_gatt_write(
+    const struct bt_gatt_attr* attr, const uint8_t* data, size_t len, uint16_t offset)
+{
+    ssize_t ret = attr->write(NULL, attr, data, (uint16_t) len, offset, 0);
+
+    /* Un callback rend la longueur ecrite ou une erreur ATT, rien d'autre */
+    if (ret != (ssize_t) len && (ret >= 0 || ret < BT_GATT_ERR(0xff)))
+    {
+        printk("FUZZ,error,write returned %d for %u bytes\n", (int) ret, (uint32_t) len);
+        abort();
+    }
+}
+
+/* Separe "nom\0valeur" : le nom est toujours termine dans name */
+static size_t fuzz_split_name(
+    const uint8_t* data, size_t len, char* name, size_t name_sz, const uint8_t** value)
+{
+    const uint8_t* end = memchr(data, '\0', len);
+    size_t name_len    = end ? (size_t) (end - data) : len;
+
+    memcpy(name, data, MIN(name_len, name_sz - 1));
+    name[MIN(name_len, name_sz - 1)] = '\0';
+
+    *value = end ? end + 1 : data + len;
+    return end ? len - name_len - 1 : 0;
+}
+
+static void fuzz_settings_runtime(uint8_t arg, const uint8_t* data, size_t len)
+{
+    char name[SETTINGS_MAX_NAME_LEN + 1];
+    const uint8_t* value = data;
+    size_t value_len     = len;
+
+    if (arg < 0x80)
+    {
+        if (esirem_quantum_main_core_setting_get_full_key(
+                &esirem_quantum_main_core_setting_map_uuid_keyptr[arg % ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT],
+                name, sizeof(name)))
+        {
+            printk("FUZZ,error,full key refused\n");
+            abort();
+        }
+    }
+    else
+    {
+        value_len = fuzz_split_name(data, len, name, sizeof(name), &value);
+    }
+
+    settings_runtime_set(name, value, value_len);
+}
+
+static ssize_t fuzz_read_cb(void* cb_arg, void* data, size_t len)
+{
+    struct fuzz_read_ctx* ctx = cb_arg;
+    size_t read_len;
+
+    if (ctx->fail)
+    {
+        return -EIO;
+    }
+
+    read_len = MIN(len, ctx->len);
+    memcpy(data, ctx->data, read_len);
+    ctx->data += read_len;
+    ctx->len -= read_len;
+    return read_len;
+}
+
+static void fuzz_settings_handler(uint8_t arg, uint16_t offset, const uint8_t* data, size_t len)
+{
+    struct settings_handler* hdlr = fuzz_settings_hdlrs[arg % ARRAY_SIZE(fuzz_settings_hdlrs)];
+    char name[SETTINGS_MAX_NAME_LEN + 1];
+    struct fuzz_read_ctx ctx;
+    size_t value_len;
+
+    value_len = fuzz_split_name(data, len, name, sizeof(name), &ctx.data);
+    ctx.len   = value_len;
+    ctx.fail  = (offset & BIT(15)) != 0;
+
+    /* Longueur annoncee superieure aux octets disponibles : enregistrement
+     * tronque */
+    hdlr->h_set(name, value_len + (offset & 0xff), fuzz_read_cb, &ctx);
+    if (hdlr->h_commit)
+    {
+        hdlr->h_commit();
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    uint8_t* buf;
+    size_t len;
+    uint8_t target;
+    uint8_t arg;
+    uint16_t offset;
+
+    if (size < FUZZ_HEADER_LEN)
+    {
+        return 0;
+    }
+
+    fuzz_init();
+
+    target = data[0] % FUZZ_TARGET_COUNT;
+    arg    = data[1];
+    offset = sys_get_le16(&data[2]);
+    len    = MIN(size - FUZZ_HEADER_LEN, FUZZ_DATA_MAX_LEN);
+
+    /* Copie a la taille exacte, au moins un octet pour malloc */
+    buf = malloc(len ? len : 1);
+    if (!buf)
+    {
+        return 0;
+    }
+    memcpy(buf, &data[FUZZ_HEADER_LEN], len);
+
+    switch (target)
+    {
+        case FUZZ_TARGET_USER_STATE:
+            fuzz_gatt_write(fuzz_attr_user_state, buf, len, offset);
+            break;
+
+        case FUZZ_TARGET_USER_CLOCK:
+            fuzz_gatt_write(fuzz_attr_user_clock, buf, len, offset);
+            break;
+
+        case FUZZ_TARGET_CONFIG:
+            fuzz_gatt_write(fuzz_attr_config[arg % ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT], buf, len, offset);
+            break;
+
+        case FUZZ_TARGET_CONFIG_ALL:
+            fuzz_gatt_write(fuzz_attr_config_all, buf, len, offset);
+            break;
+
+        case FUZZ_TARGET_SETTINGS_RUNTIME:
+            fuzz_settings_runtime(arg, buf, len);
+            break;
+
+        case FUZZ_TARGET_SETTINGS_HANDLER:
+            fuzz_settings_handler(arg, offset, buf, len);
+            break;
+
+        case FUZZ_TARGET_PROV_CTRL:
+#if defined(CONFIG_ESIREM_QUANTUM_MAIN_PROVISION)
+            fuzz_gatt_write(fuzz_attr_prov_ctrl, buf, len, offset);
+#endif
+            break;
+
+        default:
+            break;
+    }
+
+    free(buf);
+    return 0;
+}
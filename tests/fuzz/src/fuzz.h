@@ -0,0 +1,65 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * fuzz.h - 07/12/2021
+ * Harnais de fuzzing des callbacks GATT et des handlers settings
+ *
+ * Format d'une entree :
+ *
+ * | cible (1) | argument (1) | offset (2) | donnees (0 a 512) |
+ *
+ * L'offset est en little endian. Pour les cibles settings, les donnees
+ * contiennent le nom de la cle, un octet nul, puis la valeur.
+ */
+
+#ifndef ESIREM_QUANTUM_MAIN_TESTS_FUZZ_FUZZ_H_INCLUDED
+#define ESIREM_QUANTUM_MAIN_TESTS_FUZZ_FUZZ_H_INCLUDED
+
+#include <zephyr/types.h>
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**@brief Taille de l'entete d'une entree */
+#define FUZZ_HEADER_LEN 4
+
+/**@brief Taille maximale des donnees (valeur d'attribut ATT maximale) */
+#define FUZZ_DATA_MAX_LEN 512
+
+enum fuzz_target
+{
+    /* Ecriture de la caracteristique etat (argument ignore) */
+    FUZZ_TARGET_USER_STATE = 0x00UL,
+    /* Ecriture de la caracteristique horloge (argument ignore) */
+    FUZZ_TARGET_USER_CLOCK = 0x01UL,
+    /* Ecriture d'un parametre (argument : index dans la table) */
+    FUZZ_TARGET_CONFIG = 0x02UL,
+    /* Ecriture de tous les parametres (argument ignore) */
+    FUZZ_TARGET_CONFIG_ALL = 0x03UL,
+    /* settings_runtime_set (argument : cle de la table si < 0x80, sinon
+     * nom lu dans les donnees) */
+    FUZZ_TARGET_SETTINGS_RUNTIME = 0x04UL,
+    /* h_set d'un handler avec un read_cb court ou en erreur (argument :
+     * handler ; offset : octets annonces en plus, bit 15 = read_cb en
+     * erreur) */
+    FUZZ_TARGET_SETTINGS_HANDLER = 0x05UL,
+    /* Ecriture du point de controle de provisionnement (argument ignore) */
+    FUZZ_TARGET_PROV_CTRL = 0x06UL,
+    FUZZ_TARGET_COUNT,
+};
+
+/**@brief Initialise les modules dans l'ordre de src/main.c, une seule fois */
+void fuzz_init(void);
+
+/**@brief Point d'entree libFuzzer, appele aussi par le pilote de tests/fuzz */
+int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+#endif // ESIREM_QUANTUM_MAIN_TESTS_FUZZ_FUZZ_H_INCLUDED
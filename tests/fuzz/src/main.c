@@ -0,0 +1,348 @@
+/*
+ *   ____ ___  ____ ___ _   _ __  __
+ *  / ___/ _ \|  _ \_ _| | | |  \/  |
+ * | |  | | | | | | | || | | | |  | |
+ * | |__| |_| | |_| | || |_| | |  | |
+ *  \____\___/|____/___|\___/|_|  |_|
+ *
+ * (c) 2021 - Codium Electronique
+ * Tous droits reserves
+ * Ce fichier fait partie du projet ESIREM Quantum main board
+ *
+ * main.c - 07/12/2021
+ *
+ * Fonctionnement :
+ *
+ * - Pilote de fuzzing integre pour native_posix, a la place du moteur
+ * libFuzzer : les entrees sont tirees d'un corpus de depart (une entree
+ * valide par cible) et mutees avec un generateur pseudo-aleatoire
+ * initialise par la graine, puis passees a LLVMFuzzerTestOneInput.
+ * - Une meme graine rejoue la meme suite d'entrees. En cas d'erreur d'un
+ * sanitizer, l'entree en cours est imprimee en hexa avant l'arret et peut
+ * etre rejouee seule avec --fuzz_input.
+ * - Le debit (entrees par seconde, temps du poste) est imprime toutes les
+ * CONFIG_ESIREM_QUANTUM_MAIN_FUZZ_REPORT_INTERVAL_S secondes.
+ * - Le temps simule avance d'un tick toutes les FUZZ_SLEEP_EVERY entrees :
+ * les timers et les files d'attente du core tournent pendant le fuzzing.
+ */
+
+/* clock_gettime de la libc du poste */
+#define _POSIX_C_SOURCE 200809L
+
+#include "fuzz.h"
+
+#include <include/core.h>
+
+#include <zephyr.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/byteorder.h>
+#include <sys/printk.h>
+#include <sys/util.h>
+
+#include "cmdline.h"
+#include "posix_board_if.h"
+#include "soc.h"
+
+#if defined(CONFIG_ASAN) || defined(CONFIG_UBSAN)
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#define FUZZ_INPUT_MAX_LEN (FUZZ_HEADER_LEN + FUZZ_DATA_MAX_LEN)
+#define FUZZ_POOL_COUNT    (64)
+#define FUZZ_SLEEP_EVERY   (16)
+
+struct fuzz_input
+{
+    uint8_t data[FUZZ_INPUT_MAX_LEN];
+    size_t len;
+};
+
+static uint32_t fuzz_seed        = CONFIG_ESIREM_QUANTUM_MAIN_FUZZ_SEED;
+static uint32_t fuzz_iterations  = CONFIG_ESIREM_QUANTUM_MAIN_FUZZ_ITERATIONS;
+static uint32_t fuzz_duration_s  = CONFIG_ESIREM_QUANTUM_MAIN_FUZZ_DURATION_S;
+static char* fuzz_replay_hex     = NULL;
+static uint64_t fuzz_rand_state;
+
+/* Entree en cours, imprimee par le callback de mort des sanitizers */
+static struct fuzz_input fuzz_current;
+/* Corpus de depart puis entrees ayant passe sans erreur, base des
+ * mutations suivantes ; le corpus de depart n'est jamais remplace */
+static struct fuzz_input fuzz_pool[FUZZ_POOL_COUNT];
+static uint32_t fuzz_pool_count      = 0;
+static uint32_t fuzz_pool_seed_count = 0;
+
+static void fuzz_add_options(void)
+{
+    static struct args_struct_t fuzz_options[] = {
+        {.option   = "fuzz_seed",
+         .name     = "seed",
+         .type     = 'u',
+         .dest     = (void*) &fuzz_seed,
+         .descript = "Graine du generateur de mutations"},
+        {.option   = "fuzz_iterations",
+         .name     = "count",
+         .type     = 'u',
+         .dest     = (void*) &fuzz_iterations,
+         .descript = "Nombre d'entrees, 0 : sans limite"},
+        {.option   = "fuzz_duration",
+         .name     = "s",
+         .type     = 'u',
+         .dest     = (void*) &fuzz_duration_s,
+         .descript = "Duree en secondes du poste, 0 : sans limite"},
+        {.option   = "fuzz_input",
+         .name     = "hex",
+         .type     = 's',
+         .dest     = (void*) &fuzz_replay_hex,
+         .descript = "Rejoue une seule entree (hexa) puis s'arrete"},
+        ARG_TABLE_ENDMARKER,
+    };
+
+    native_add_command_line_opts(fuzz_options);
+}
+NATIVE_TASK(fuzz_add_options, PRE_BOOT_1, 1);
+
+static uint64_t fuzz_host_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * MSEC_PER_SEC + ts.tv_nsec / NSEC_PER_MSEC;
+}
+
+/* xorshift64* : rapide et reproductible d'une machine a l'autre */
+static uint32_t fuzz_rand(void)
+{
+    fuzz_rand_state ^= fuzz_rand_state >> 12;
+    fuzz_rand_state ^= fuzz_rand_state << 25;
+    fuzz_rand_state ^= fuzz_rand_state >> 27;
+    return (uint32_t) ((fuzz_rand_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+static void fuzz_print_current(void)
+{
+    printk("FUZZ,input,");
+    for (size_t i = 0; i < fuzz_current.len; i++)
+    {
+        printk("%02x", fuzz_current.data[i]);
+    }
+    printk("\n");
+}
+
+static void fuzz_run_one(void)
+{
+    LLVMFuzzerTestOneInput(fuzz_current.data, fuzz_current.len);
+}
+
+static void fuzz_pool_add(const uint8_t* data, size_t len)
+{
+    struct fuzz_input* slot;
+
+    if (fuzz_pool_count < FUZZ_POOL_COUNT)
+    {
+        slot = &fuzz_pool[fuzz_pool_count++];
+    }
+    else
+    {
+        slot = &fuzz_pool[fuzz_pool_seed_count + fuzz_rand() % (FUZZ_POOL_COUNT - fuzz_pool_seed_count)];
+    }
+    memcpy(slot->data, data, len);
+    slot->len = len;
+}
+
+static void fuzz_pool_add_seed(uint8_t target, uint8_t arg, uint16_t offset, const void* data, size_t len)
+{
+    uint8_t input[FUZZ_INPUT_MAX_LEN];
+
+    input[0] = target;
+    input[1] = arg;
+    sys_put_le16(offset, &input[2]);
+    memcpy(&input[FUZZ_HEADER_LEN], data, len);
+    fuzz_pool_add(input, FUZZ_HEADER_LEN + len);
+}
+
+/* Une entree valide par cible : les mutations partent de formats acceptes */
+static void fuzz_pool_init(void)
+{
+    static const uint8_t state_on[]       = {0x01};
+    static const uint8_t state_off[]      = {0x00};
+    static const uint8_t state_at[]       = {0x02, 0x40, 0x42, 0x0f, 0, 0, 0, 0, 0};
+    static const uint8_t clock_ping[]     = {0x40, 0x42, 0x0f, 0, 0, 0, 0, 0};
+    static const uint8_t clock_sync[]     = {0x40, 0x42, 0x0f, 0, 0, 0, 0, 0, 0xe8, 0x03, 0, 0};
+    static const uint8_t config_ton[]     = {0x64, 0, 0, 0};
+    static const uint8_t settings_name[]  = "cfg/led/ton_ms\0\x64\0\0\0";
+    static const uint8_t settings_full[]  = "esirem_quantum_main/cfg/led/ton_ms\0\x64\0\0\0";
+    static const uint8_t prov_begin[]     = {0x01};
+    static const uint8_t prov_data[]      = {0x02, 0, 0, 0x01, 0x04, '0', '0', '4', '2'};
+    uint8_t config_all[ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT * sizeof(uint32_t)];
+
+    /* Parametres courants, valides par construction */
+    for (uint8_t i = 0; i < ESIREM_QUANTUM_MAIN_CORE_SETTING_COUNT; i++)
+    {
+        sys_put_le32(
+            esirem_quantum_main_core_setting_get(&esirem_quantum_main_core_setting_map_uuid_keyptr[i]),
+            &config_all[i * sizeof(uint32_t)]);
+    }
+
+    fuzz_pool_add_seed(FUZZ_TARGET_USER_STATE, 0, 0, state_on, sizeof(state_on));
+    fuzz_pool_add_seed(FUZZ_TARGET_USER_STATE, 0, 0, state_off, sizeof(state_off));
+    fuzz_pool_add_seed(FUZZ_TARGET_USER_STATE, 0, 0, state_at, sizeof(state_at));
+    fuzz_pool_add_seed(FUZZ_TARGET_USER_CLOCK, 0, 0, clock_ping, sizeof(clock_ping));
+    fuzz_pool_add_seed(FUZZ_TARGET_USER_CLOCK, 0, 0, clock_sync, sizeof(clock_sync));
+    fuzz_pool_add_seed(FUZZ_TARGET_CONFIG, ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS, 0, config_ton, sizeof(config_ton));
+    fuzz_pool_add_seed(FUZZ_TARGET_CONFIG_ALL, 0, 0, config_all, sizeof(config_all));
+    fuzz_pool_add_seed(
+        FUZZ_TARGET_SETTINGS_RUNTIME, ESIREM_QUANTUM_MAIN_CORE_SETTING_LED_TON_MS, 0, config_ton,
+        sizeof(config_ton));
+    fuzz_pool_add_seed(FUZZ_TARGET_SETTINGS_RUNTIME, 0x80, 0, settings_full, sizeof(settings_full) - 1);
+    fuzz_pool_add_seed(FUZZ_TARGET_SETTINGS_HANDLER, 0, 0, settings_name, sizeof(settings_name) - 1);
+    fuzz_pool_add_seed(FUZZ_TARGET_SETTINGS_HANDLER, 0, 2, settings_name, sizeof(settings_name) - 1);
+    fuzz_pool_add_seed(FUZZ_TARGET_PROV_CTRL, 0, 0, prov_begin, sizeof(prov_begin));
+    fuzz_pool_add_seed(FUZZ_TARGET_PROV_CTRL, 0, 0, prov_data, sizeof(prov_data));
+    fuzz_pool_seed_count = fuzz_pool_count;
+}
+
+static void fuzz_mutate(struct fuzz_input* input)
+{
+    static const uint32_t interesting[] = {0, 1, 0x7f, 0x80, 0xff, 0x7fff, 0xffff, 0x7fffffff, 0xffffffff};
+    uint32_t count                      = 1 + fuzz_rand() % 4;
+    size_t pos;
+
+    for (uint32_t n = 0; n < count; n++)
+    {
+        pos = input->len ? fuzz_rand() % input->len : 0;
+
+        switch (fuzz_rand() % 7)
+        {
+            case 0: /* Bit inverse */
+                if (input->len)
+                {
+                    input->data[pos] ^= BIT(fuzz_rand() % 8);
+                }
+                break;
+
+            case 1: /* Octet aleatoire */
+                if (input->len)
+                {
+                    input->data[pos] = (uint8_t) fuzz_rand();
+                }
+                break;
+
+            case 2: /* Valeur remarquable sur 4 octets */
+                if (input->len >= sizeof(uint32_t))
+                {
+                    pos = MIN(pos, input->len - sizeof(uint32_t));
+                    sys_put_le32(interesting[fuzz_rand() % ARRAY_SIZE(interesting)], &input->data[pos]);
+                }
+                break;
+
+            case 3: /* Octet insere */
+                if (input->len < FUZZ_INPUT_MAX_LEN)
+                {
+                    memmove(&input->data[pos + 1], &input->data[pos], input->len - pos);
+                    input->data[pos] = (uint8_t) fuzz_rand();
+                    input->len++;
+                }
+                break;
+
+            case 4: /* Octet supprime */
+                if (input->len)
+                {
+                    memmove(&input->data[pos], &input->data[pos + 1], input->len - pos - 1);
+                    input->len--;
+                }
+                break;
+
+            case 5: /* Longueur changee */
+                input->len = fuzz_rand() % (FUZZ_INPUT_MAX_LEN + 1);
+                break;
+
+            default: /* Entete d'une autre entree : meme donnees, autre cible */
+                if (input->len >= FUZZ_HEADER_LEN)
+                {
+                    memcpy(input->data, fuzz_pool[fuzz_rand() % fuzz_pool_count].data, FUZZ_HEADER_LEN);
+                }
+                break;
+        }
+    }
+}
+
+static void fuzz_replay(void)
+{
+    size_t hex_len = strlen(fuzz_replay_hex);
+
+    fuzz_current.len = hex2bin(fuzz_replay_hex, hex_len, fuzz_current.data, sizeof(fuzz_current.data));
+    if (!fuzz_current.len && hex_len)
+    {
+        printk("FUZZ,error,invalid input\n");
+        posix_exit(1);
+    }
+
+    fuzz_print_current();
+    fuzz_run_one();
+    k_sleep(K_TICKS(1));
+    printk("FUZZ,done,1\n");
+    posix_exit(0);
+}
+
+void main(void)
+{
+    uint64_t start_ms;
+    uint64_t report_ms;
+    uint64_t now_ms;
+    uint32_t n;
+
+#if defined(CONFIG_ASAN) || defined(CONFIG_UBSAN)
+    __sanitizer_set_death_callback(fuzz_print_current);
+#endif
+
+    fuzz_init();
+    if (fuzz_replay_hex)
+    {
+        fuzz_replay();
+        return;
+    }
+
+    /* Graine nulle : etat fige du generateur */
+    fuzz_rand_state = ((uint64_t) fuzz_seed << 32) | 0x9e3779b9UL;
+    fuzz_pool_init();
+
+    printk("FUZZ,start,seed=%u\n", fuzz_seed);
+    start_ms  = fuzz_host_ms();
+    report_ms = start_ms;
+
+    for (n = 0; !fuzz_iterations || n < fuzz_iterations; n++)
+    {
+        fuzz_current = fuzz_pool[fuzz_rand() % fuzz_pool_count];
+        fuzz_mutate(&fuzz_current);
+        fuzz_run_one();
+        fuzz_pool_add(fuzz_current.data, fuzz_current.len);
+
+        if (!(n % FUZZ_SLEEP_EVERY))
+        {
+            k_sleep(K_TICKS(1));
+        }
+
+        now_ms = fuzz_host_ms();
+        if (now_ms - report_ms >= CONFIG_ESIREM_QUANTUM_MAIN_FUZZ_REPORT_INTERVAL_S * MSEC_PER_SEC)
+        {
+            printk(
+                "FUZZ,stats,%u,%u\n", n + 1,
+                (uint32_t) ((uint64_t) (n + 1) * MSEC_PER_SEC / (now_ms - start_ms)));
+            report_ms = now_ms;
+        }
+        if (fuzz_duration_s && now_ms - start_ms >= (uint64_t) fuzz_duration_s * MSEC_PER_SEC)
+        {
+            n++;
+            break;
+        }
+    }
+
+    now_ms = fuzz_host_ms();
+    printk(
+        "FUZZ,done,%u,%u\n", n,
+        (uint32_t) ((uint64_t) n * MSEC_PER_SEC / MAX(now_ms - start_ms, 1)));
+    posix_exit(0);
+}